@@ -9,6 +9,24 @@
 #include <GL/glu.h>
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 bool flag_fill = false; 
 int m_angle = 0;
 
@@ -213,12 +231,12 @@ public:
     
     void draw()
     {   
+        TRACE_SCOPE ("Roue");
         dessiner_roue();
     }
 }; // Roue
 
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
 enum CamProj { P_ORTHO, P_FRUSTUM, P_MAX };
@@ -227,7 +245,12 @@ enum CamProj { P_ORTHO, P_FRUSTUM, P_MAX };
 class MyApp
 {
     bool m_ok = false;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     bool m_anim_flag = false;
     double m_anim_angle = 0, m_start_angle = 0;
     double m_cam_z, m_cam_hr, m_cam_near, m_cam_far;
@@ -240,7 +263,7 @@ class MyApp
     void animate()
     {
         // Change l'angle en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
+        double time = m_ctx.get_time();        // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = slice - std::floor(slice);  // partie fractionnaire
         m_anim_angle = m_start_angle + a*360.0;
@@ -249,7 +272,9 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
         glLoadIdentity();
         gluLookAt (0, 0, m_cam_z, 0, 0, 0, 0, 1, 0);
@@ -261,6 +286,7 @@ class MyApp
         glRotated(m_angle, 0.0, 0.0, 1.0);
         Roue roue1(10, 0.5, 1.0, 0.2, 1.0, 0, 0, 0.2);
         roue1.draw();
+        m_gpu_timer.end_object ("roue1");
         glPopMatrix();
 
         glPushMatrix();
@@ -268,6 +294,7 @@ class MyApp
         glRotated(-m_angle, 0.0, 0.0, 1.0);
         Roue roue2(10, 0.5, 1.0, 0.2, 0, 1.0, 0, 0.2);
         roue2.draw();
+        m_gpu_timer.end_object ("roue2");
         glPopMatrix();
 
         glPushMatrix();
@@ -275,7 +302,9 @@ class MyApp
         glRotated(m_angle, 0.0, 0.0, 1.0);
         Roue roue3(20, 0.3, 1.0, 0.2, 0, 0, 1.0, 0.1);
         roue3.draw();
+        m_gpu_timer.end_object ("roue3");
         glPopMatrix();
+        m_gpu_timer.end_pass ("scene");
     }
 
 
@@ -394,7 +423,7 @@ static void on_key_func (GLFWwindow* window, int key, int scancode,
         that->m_anim_flag = !that->m_anim_flag;
         if (that->m_anim_flag) {
             that->m_start_angle = that->m_anim_angle;
-            glfwSetTime(0);
+            that->m_ctx.set_time (0);
         }
         break;
     case GLFW_KEY_P : {
@@ -435,7 +464,7 @@ static void on_key_func (GLFWwindow* window, int key, int scancode,
         print_help ();
         break;
     case GLFW_KEY_ESCAPE :
-        that->m_ok = false;
+        glfwSetWindowShouldClose (window, GL_TRUE);
         break;
     case GLFW_KEY_SPACE :
         m_angle++;
@@ -486,37 +515,55 @@ static void on_key_func (GLFWwindow* window, int key, int scancode,
         std::cerr << "Error: " << description << std::endl;
     }
 
-public:
-
-    MyApp()
+    // Seules les options du contexte sont reconnues
+    bool parse_args (int argc, char* argv[])
     {
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
+        int i = 1;
+        while (i < argc) {
+            int nb_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_args < 0) return false;
+            if (nb_args == 0) {
+                std::cerr << "Options: " << GLContext::usage() << " "
+                    << FrameBench::usage() << " " << FramePacer::usage()
+                    << " " << GpuTimer::usage() << " "
+                    << FrameCapture::usage() << std::endl;
+                return false;
+            }
+            i += nb_args;
         }
-        glfwSetErrorCallback (on_error_func);
+        return true;
+    }
 
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
+public:
 
-        // Commenter la ligne en salle TP si l'affichage "bave"
-        glfwWindowHint (GLFW_SAMPLES, 16);
+    MyApp (int argc, char* argv[])
+    {
+        // Taille, nombre d'échantillons et mode hors écran peuvent venir
+        // des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "Tetraèdre";
+        // Mettre à 0 en salle TP si l'affichage "bave"
+        cfg.samples = 16;
 
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "Tetraèdre", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetKeyCallback (m_window, on_key_func);
+        glfwSetErrorCallback (on_error_func);
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        // Les callbacks pour GLFW étant statiques, on mémorise l'instance
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
         m_ok = true;
 
         cam_init();
@@ -524,41 +571,68 @@ public:
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
         set_projection();
 
         glEnable (GL_DEPTH_TEST);
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_bench.enabled()) return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
+                m_pacer.wait (m_ctx);
                 animate();
             }
-            else glfwWaitEvents();
+            else m_ctx.wait_events();
         }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
     }
 
-    ~MyApp()
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
     {
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
+        }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
 }; // MyApp
 
 
-int main() 
+int main(int argc, char* argv[]) 
 {
-    MyApp app;
-    app.run();
+    MyApp app {argc, argv};
+    return app.run();
 }
 
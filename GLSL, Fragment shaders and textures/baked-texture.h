@@ -0,0 +1,228 @@
+/*
+    Conteneur de textures précalculées (.btex)
+
+    Produit hors ligne par texbake (make bake) : la chaîne de mipmaps est
+    déjà calculée et éventuellement compressée par blocs (BC1 ou BC3), si
+    bien qu'au chargement il n'y a ni décodage PNG ni glGenerateMipmap.
+    BakedFile projette le fichier en mémoire avec mmap ; TextureResidency
+    (texture-residency.h) en envoie ensuite chaque niveau directement.
+
+    Format, entiers little-endian :
+      BakedHeader
+      BakedLevel[nb_levels]     du plus grand au plus petit
+      données des niveaux       toutes les couches d'un niveau à la suite
+*/
+
+#ifndef BAKED_TEXTURE_H
+#define BAKED_TEXTURE_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "glad.h"
+
+const char BAKED_MAGIC[4] = { 'B', 'T', 'E', 'X' };
+const uint32_t BAKED_VERSION = 1;
+const uint32_t BAKED_MAX_LEVELS = 16;
+
+struct BakedHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;        // GL_RGBA8, GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+                            // ou GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+    uint32_t width, height;
+    uint32_t nb_layers;     // 1 : GL_TEXTURE_2D, sinon GL_TEXTURE_2D_ARRAY
+    uint32_t nb_levels;
+};
+
+struct BakedLevel {
+    uint32_t width, height;
+    uint64_t offset;        // depuis le début du fichier
+    uint64_t size;          // pour toutes les couches
+};
+
+// Taille en octets d'une couche d'un niveau, 0 si format inconnu
+inline uint64_t baked_layer_size (uint32_t format, uint32_t width, uint32_t height)
+{
+    uint64_t nb_blocks = uint64_t ((width + 3) / 4) * ((height + 3) / 4);
+    switch (format) {
+        case GL_RGBA8 : return uint64_t (width) * height * 4;
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT : return nb_blocks * 8;
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : return nb_blocks * 16;
+    }
+    return 0;
+}
+
+inline const char* baked_format_name (uint32_t format)
+{
+    switch (format) {
+        case GL_RGBA8 : return "RGBA8";
+        case GL_COMPRESSED_RGB_S3TC_DXT1_EXT : return "BC1";
+        case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT : return "BC3";
+    }
+    return "?";
+}
+
+// Vérifie l'en-tête et la table des niveaux contre la taille du fichier
+inline bool baked_check (const unsigned char* data, size_t file_size,
+    std::string& error)
+{
+    if (file_size < sizeof (BakedHeader)) {
+        error = "file too short"; return false;
+    }
+    BakedHeader h;
+    memcpy (&h, data, sizeof h);
+    if (memcmp (h.magic, BAKED_MAGIC, 4) != 0 || h.version != BAKED_VERSION) {
+        error = "not a btex file, or bad version"; return false;
+    }
+    if (baked_layer_size (h.format, 1, 1) == 0) {
+        error = "unknown format"; return false;
+    }
+    if (h.width == 0 || h.height == 0 || h.nb_layers == 0 ||
+        h.nb_levels == 0 || h.nb_levels > BAKED_MAX_LEVELS) {
+        error = "bad dimensions"; return false;
+    }
+    // GL refuse un niveau au-delà de la chaîne complète
+    uint32_t nb_full = 1;
+    while ((std::max (h.width, h.height) >> nb_full) != 0) nb_full++;
+    if (h.nb_levels > nb_full) {
+        error = "too many levels for " + std::to_string (h.width) + "x"
+            + std::to_string (h.height); return false;
+    }
+    if (file_size < sizeof h + h.nb_levels * sizeof (BakedLevel)) {
+        error = "truncated level table"; return false;
+    }
+    for (uint32_t i = 0; i < h.nb_levels; i++) {
+        BakedLevel l;
+        memcpy (&l, data + sizeof h + i * sizeof l, sizeof l);
+        // Le niveau i doit avoir la taille que GL lui attribue
+        uint32_t width = std::max (1u, h.width >> i);
+        uint32_t height = std::max (1u, h.height >> i);
+        if (l.width != width || l.height != height) {
+            error = "level " + std::to_string (i) + " is "
+                + std::to_string (l.width) + "x" + std::to_string (l.height)
+                + ", expected " + std::to_string (width) + "x"
+                + std::to_string (height);
+            return false;
+        }
+        uint64_t expected = baked_layer_size (h.format, l.width, l.height)
+            * h.nb_layers;
+        if (l.size != expected || l.offset > file_size ||
+            l.size > file_size - l.offset) {
+            error = "bad level " + std::to_string (i); return false;
+        }
+    }
+    return true;
+}
+
+// Fichier .btex projeté en mémoire, vérifié à l'ouverture
+class BakedFile
+{
+    void* m_map = MAP_FAILED;
+    size_t m_size = 0;
+
+public:
+    BakedHeader header;
+
+    BakedFile() = default;
+    BakedFile (const BakedFile&) = delete;
+    BakedFile& operator= (const BakedFile&) = delete;
+
+    ~BakedFile()
+    {
+        if (m_map != MAP_FAILED) munmap (m_map, m_size);
+    }
+
+    bool open (const char* path, std::string& error)
+    {
+        int fd = ::open (path, O_RDONLY);
+        if (fd < 0) {
+            error = strerror (errno); return false;
+        }
+        struct stat st;
+        if (fstat (fd, &st) < 0 || st.st_size == 0) {
+            error = "empty file"; ::close (fd); return false;
+        }
+        m_size = st.st_size;
+        m_map = mmap (nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close (fd);
+        if (m_map == MAP_FAILED) {
+            error = strerror (errno); return false;
+        }
+        if (!baked_check (bytes(), m_size, error)) return false;
+        memcpy (&header, bytes(), sizeof header);
+
+        if (header.format != GL_RGBA8 && !GLAD_GL_EXT_texture_compression_s3tc) {
+            error = std::string (baked_format_name (header.format))
+                + " not supported by driver";
+            return false;
+        }
+        return true;
+    }
+
+    GLenum target() const
+    {
+        return header.nb_layers > 1 ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+    }
+
+    BakedLevel level (uint32_t i) const
+    {
+        BakedLevel l;
+        memcpy (&l, bytes() + sizeof header + i * sizeof l, sizeof l);
+        return l;
+    }
+
+    // Envoie le niveau i dans la texture liée ; sub : niveau déjà alloué,
+    // sinon (re)spécification du niveau
+    void upload_level (uint32_t i, bool sub) const
+    {
+        BakedLevel l = level (i);
+        const void* pixels = bytes() + l.offset;
+        GLenum t = target();
+        GLenum f = header.format;
+        GLsizei n = header.nb_layers;
+
+        if (f == GL_RGBA8) {
+            if (t == GL_TEXTURE_2D) {
+                if (sub) glTexSubImage2D (t, i, 0, 0, l.width, l.height,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                else glTexImage2D (t, i, f, l.width, l.height, 0,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            } else {
+                if (sub) glTexSubImage3D (t, i, 0, 0, 0, l.width, l.height, n,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+                else glTexImage3D (t, i, f, l.width, l.height, n, 0,
+                    GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            }
+        } else {
+            if (t == GL_TEXTURE_2D) {
+                if (sub) glCompressedTexSubImage2D (t, i, 0, 0, l.width,
+                    l.height, f, l.size, pixels);
+                else glCompressedTexImage2D (t, i, f, l.width, l.height, 0,
+                    l.size, pixels);
+            } else {
+                if (sub) glCompressedTexSubImage3D (t, i, 0, 0, 0, l.width,
+                    l.height, n, f, l.size, pixels);
+                else glCompressedTexImage3D (t, i, f, l.width, l.height, n, 0,
+                    l.size, pixels);
+            }
+        }
+    }
+
+private:
+    const unsigned char* bytes() const
+    {
+        return static_cast<const unsigned char*> (m_map);
+    }
+
+}; // BakedFile
+
+#endif // BAKED_TEXTURE_H
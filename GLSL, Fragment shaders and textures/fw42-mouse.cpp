@@ -23,6 +23,27 @@
 
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
+// Sommets des formes fixes (cubes), calculés à la compilation
+#include "static-mesh.h"
+
 //------------------------------ T R I A N G L E S ----------------------------
 
 class Triangles
@@ -34,6 +55,7 @@ public:
     Triangles(GLint vPos_loc, GLint vCol_loc)
         : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc}
     {
+        TRACE_SCOPE("Triangles");
         // Données
         GLfloat positions[] = {
             -0.7, -0.5, -0.1,
@@ -105,72 +127,15 @@ public:
 
 class WireCube
 {
-    bool m_is_white;
-    GLfloat m_radius;
     GLuint m_VAO_id, m_VBO_id, m_EBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    WireCube(bool is_white, GLfloat radius, GLint vPos_loc, GLint vCol_loc)
-        : m_is_white{is_white}, m_radius{radius},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc}
+    // mesh : static_mesh::wire_cube, calculé à la compilation
+    WireCube(const static_mesh::WireCubeMesh &mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc}
     {
-        GLfloat r = m_radius;
-
-        // Positions
-        GLfloat positions[] = {
-            -r, -r, -r, // P0                 6 ------- 7
-            r, -r, -r,  // P1               / |       / |
-            -r, r, -r,  // P2             /   |     /   |
-            r, r, -r,   // P3           2 ------- 3     |
-            -r, -r, r,  // P4           |     4 --|---- 5
-            r, -r, r,   // P5           |   /     |   /
-            -r, r, r,   // P6           | /       | /
-            r, r, r,    // P7           0 ------- 1
-        };
-
-        // Indices : positions, couleurs
-        GLint indexes[] = {
-            0, 1, 0, 0,
-            2, 3, 0, 0,
-            4, 5, 0, 0,
-            6, 7, 0, 0,
-            0, 2, 1, 1,
-            1, 3, 1, 1,
-            4, 6, 1, 1,
-            5, 7, 1, 1,
-            0, 4, 2, 2,
-            1, 5, 2, 2,
-            2, 6, 2, 2,
-            3, 7, 2, 2};
-
-        // Couleurs
-        GLfloat colors_rgb[] = {
-            1.0, 0.0, 0.0, // C0       C1  C2
-            0.0, 1.0, 0.0, // C1       | /
-            0.0, 0.0, 1.0  // C2       + --C0
-        };
-        GLfloat colors_white[] = {
-            1.0, 1.0, 1.0, // C0
-            1.0, 1.0, 1.0, // C1
-            1.0, 1.0, 1.0  // C2
-        };
-        GLfloat *colors = (is_white) ? colors_white : colors_rgb;
-
-        // Création d'une structure de données à plat
-        std::vector<GLfloat> vertices;
-        for (int i = 0; i < 12 * 4; i += 4)
-        {
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(positions[indexes[i + 0] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(colors[indexes[i + 2] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(positions[indexes[i + 1] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(colors[indexes[i + 3] * 3 + j]);
-        }
-
+        TRACE_SCOPE("WireCube");
         // Création du VAO
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
@@ -180,8 +145,7 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
 
         // Copie le buffer dans la mémoire du serveur
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         // VAA associant les données à la variable vPos du shader, avec l'offset 0
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE,
@@ -213,7 +177,6 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC = 30.0;
 const double ANIM_DURATION = 18.0;
 
 // En salle TP mettre à 0 si l'affichage "bave"
@@ -229,7 +192,12 @@ enum CamProj
 class MyApp
 {
     bool m_ok = false;
-    GLFWwindow *m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow *m_window = nullptr;    // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -281,7 +249,7 @@ class MyApp
         { return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime(); // durée depuis init
+        double time = m_ctx.get_time(); // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a * 360.0;
@@ -289,6 +257,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable(GL_DEPTH_TEST);
@@ -304,13 +273,15 @@ class MyApp
 
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize(m_window, &width, &height);
+        m_ctx.get_size(width, height);
         m_mousePos = {width / 2.0f, height / 2.0f, (float)width, (float)height};
 
         // Création des objets graphiques
         m_triangles = new Triangles{m_vPos_loc, m_vCol_loc};
-        m_wire_cube_white = new WireCube{true, 0.5, m_vPos_loc, m_vCol_loc};
-        m_wire_cube_rgb = new WireCube{false, 0.5, m_vPos_loc, m_vCol_loc};
+        static constexpr auto WIRE_CUBE_WHITE = static_mesh::wire_cube(0.5f, true);
+        static constexpr auto WIRE_CUBE_RGB = static_mesh::wire_cube(0.5f, false);
+        m_wire_cube_white = new WireCube{WIRE_CUBE_WHITE, m_vPos_loc, m_vCol_loc};
+        m_wire_cube_rgb = new WireCube{WIRE_CUBE_RGB, m_vPos_loc, m_vCol_loc};
         // initiation de utiem
         m_uTime_loc = glGetUniformLocation(m_program, "uTime");
     }
@@ -327,8 +298,10 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE("displayGL");
         // glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass("clear");
 
         glUseProgram(m_program);
 
@@ -342,13 +315,16 @@ class MyApp
 
         // Dessins
         m_triangles->draw();
+        m_gpu_timer.end_object("triangles");
 
         if (m_cube_color == 1)
             m_wire_cube_white->draw();
         else if (m_cube_color == 2)
             m_wire_cube_rgb->draw();
+        m_gpu_timer.end_object("cube");
         if (m_uTime_loc != -1)
-            glUniform1f(m_uTime_loc, glfwGetTime()); // Envoi du temps au shader
+            glUniform1f(m_uTime_loc, m_ctx.get_time()); // Envoi du temps au shader
+        m_gpu_timer.end_pass("scene");
     }
 
     void set_projection(vmath::mat4 &matrix)
@@ -376,6 +352,7 @@ class MyApp
 
     void compile_shader(GLuint shader, const char *name)
     {
+        TRACE_SCOPE("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader(shader);
 
@@ -399,6 +376,7 @@ class MyApp
 
     void link_program(GLuint program)
     {
+        TRACE_SCOPE("link_program");
         std::cout << "Link program...\n";
         glLinkProgram(program);
 
@@ -450,6 +428,7 @@ class MyApp
     GLuint load_and_compile_program(const std::string vertex_shader_path,
                                     const std::string fragment_shader_path)
     {
+        TRACE_SCOPE("load_and_compile_program");
         std::string vertex_shader_code = load_shader_code(vertex_shader_path,
                                                           m_default_vertex_shader_text);
         std::string fragment_shader_code = load_shader_code(fragment_shader_path,
@@ -579,7 +558,7 @@ class MyApp
             if (that->m_anim_flag)
             {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime(0);
+                that->m_ctx.set_time(0);
             }
             break;
         case GLFW_KEY_P:
@@ -630,7 +609,7 @@ class MyApp
             print_help();
             break;
         case GLFW_KEY_ESCAPE:
-            that->m_ok = false;
+            glfwSetWindowShouldClose(window, GL_TRUE);
             break;
         default:
             return;
@@ -689,6 +668,44 @@ class MyApp
         int i = 1;
         while (i < argc)
         {
+            int nb_ctx_args = m_ctx.parse_arg(argc, argv, i);
+            if (nb_ctx_args < 0)
+                return false;
+            if (nb_ctx_args > 0)
+            {
+                i += nb_ctx_args;
+                continue;
+            }
+            int nb_bench_args = m_bench.parse_arg(argc, argv, i);
+            if (nb_bench_args < 0)
+                return false;
+            if (nb_bench_args > 0)
+            {
+                i += nb_bench_args;
+                continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg(argc, argv, i);
+            if (nb_pacer_args < 0)
+                return false;
+            if (nb_pacer_args > 0)
+            {
+                i += nb_pacer_args;
+                continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg(argc, argv, i);
+            if (nb_timer_args > 0)
+            {
+                i += nb_timer_args;
+                continue;
+            }
+            int nb_capture_args = m_capture.parse_arg(argc, argv, i);
+            if (nb_capture_args < 0)
+                return false;
+            if (nb_capture_args > 0)
+            {
+                i += nb_capture_args;
+                continue;
+            }
             if (strcmp(argv[i], "-vs") == 0 && i + 1 < argc)
             {
                 m_vertex_shader_path = argv[i + 1];
@@ -703,7 +720,12 @@ class MyApp
             }
             if (strcmp(argv[i], "--help") == 0)
             {
-                std::cout << "Options: -vs vs_file -fs fs_file\n";
+                std::cout << "Options: -vs vs_file -fs fs_file "
+                          << GLContext::usage() << " "
+                          << FrameBench::usage() << " "
+                          << FramePacer::usage() << " "
+                          << GpuTimer::usage() << " "
+                          << FrameCapture::usage() << "\n";
                 return false;
             }
             std::cerr << "Error, bad arguments. Try --help" << std::endl;
@@ -715,86 +737,111 @@ class MyApp
 public:
     MyApp(int argc, char *argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config &cfg = m_ctx.config();
+        cfg.title = "Mouse in uniform";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args(argc, argv))
             return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled())
+            cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit())
-        {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback(on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint(GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-        // glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow(640, 480, "Mouse in uniform", NULL, NULL);
-        if (!m_window)
-        {
-            std::cerr << "GLFW: window creation failed" << std::endl;
+        if (!m_ctx.create())
             return;
-        }
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer(m_window, this);
-        glfwSetWindowSizeCallback(m_window, on_reshape_func);
-        glfwSetCursorPosCallback(m_window, on_mouse_func);
-        glfwSetKeyCallback(m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent(m_window);
-        glfwSwapInterval(1);
+        if (m_window)
+        {
+            glfwSetWindowUserPointer(m_window, this);
+            glfwSetWindowSizeCallback(m_window, on_reshape_func);
+            glfwSetCursorPosCallback(m_window, on_mouse_func);
+            glfwSetKeyCallback(m_window, on_key_func);
+        }
+        m_pacer.start(m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL();
+        gladLoadGLLoader(GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
                   << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize(m_window, &width, &height);
+        m_ctx.get_size(width, height);
         set_viewport(width, height);
 
         initGL();
+        if (!m_gpu_timer.start())
+            m_ok = false;
+        if (!m_capture.start(m_ctx))
+            m_ok = false;
     }
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose(m_window))
+        if (m_ok && m_bench.enabled())
+            return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers(m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag)
             {
-                glfwWaitEventsTimeout(1.0 / FRAMES_PER_SEC);
+                m_pacer.wait(m_ctx);
                 animate();
             }
             else
-                glfwWaitEvents();
+                m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval(0);
+        m_bench.start(m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done())
+        {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
-        tearGL();
-        if (m_window)
-            glfwDestroyWindow(m_window);
-        glfwTerminate();
+        // Sans contexte, les fonctions GL ne sont pas chargées
+        if (m_ok) tearGL();
     }
 
 }; // MyApp
@@ -802,5 +849,5 @@ public:
 int main(int argc, char *argv[])
 {
     MyApp app{argc, argv};
-    app.run();
+    return app.run();
 }
@@ -23,9 +23,38 @@
 
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
+// Sommets des formes fixes (cubes), calculés à la compilation
+#include "static-mesh.h"
+
 // Pour charger des images avec le module stb_image
 #include "stb_image.h"
 
+// Décodage des textures sur un pool de threads, upload sur le thread GL
+#include "texture-loader.h"
+
+// Textures précalculées par texbake (make bake), chargées par mmap et
+// gardées résidentes dans un budget mémoire
+#include "baked-texture.h"
+#include "texture-residency.h"
+
 //------------------------------ T R I A N G L E S ----------------------------
 
 class Triangles
@@ -37,6 +66,7 @@ public:
     Triangles(GLint vPos_loc, GLint vTex_loc)
         : m_vPos_loc{vPos_loc}, m_vTex_loc{vTex_loc}
     {
+        TRACE_SCOPE("Triangles");
         // Données
         GLfloat positions[] = {
             -0.7, -0.5, -0.1,
@@ -111,163 +141,26 @@ public:
 }; // Triangles
 
 //------------------------------ CUBE TEXTURES ----------------------------
+
+// Les six faces sont les six couches d'un GL_TEXTURE_2D_ARRAY : la couche est
+// déduite de gl_VertexID (4 sommets par face) dans le vertex shader, donc un
+// cube se dessine avec un seul bind et un seul glDrawElements. Chaque instance
+// a son attribut vInst (décalage xyz, échelle w), ce qui dessine autant de
+// cubes qu'on veut en un seul appel.
 class CubeTextures
 {
-    GLuint m_VAO_id, m_VBO_id, m_EBO_id;
-    GLint m_vPos_loc, m_vTex_loc;
+    GLuint m_VAO_id, m_VBO_id, m_EBO_id, m_inst_VBO_id;
+    GLint m_vPos_loc, m_vTex_loc, m_vInst_loc;
+    GLsizei m_nb_instances = 0;
 
 public:
-    CubeTextures(GLint vPos_loc, GLint vTex_loc)
-        : m_vPos_loc{vPos_loc}, m_vTex_loc{vTex_loc}
+    CubeTextures(GLint vPos_loc, GLint vTex_loc, GLint vInst_loc)
+        : m_vPos_loc{vPos_loc}, m_vTex_loc{vTex_loc}, m_vInst_loc{vInst_loc}
     {
-        // Positions des sommets du cube
-        GLfloat positions[] = {
-            // Face avant
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-
-            // Face arrière
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-
-            // Face gauche
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-
-            // Face droite
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-
-            // Face haut
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            0.5f,
-            -0.5f,
-
-            // Face bas
-            -0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            0.5f,
-            -0.5f,
-            -0.5f,
-            0.5f,
-        };
-
-        // Coordonnées de texture (mappage 1:1 sur chaque face)
-        GLfloat tex_coords[] = {
-            0.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            0.0f,
-            0.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-            1.0f,
-            0.0f,
-            1.0f,
-        };
-
-        // Indices pour former les 12 triangles du cube (2 par face)
-        GLuint indices[] = {
-            0, 1, 2, 2, 3, 0,       // Avant
-            4, 5, 6, 6, 7, 4,       // Arrière
-            8, 9, 10, 10, 11, 8,    // Gauche
-            12, 13, 14, 14, 15, 12, // Droite
-            16, 17, 18, 18, 19, 16, // Haut
-            20, 21, 22, 22, 23, 20  // Bas
-        };
+        TRACE_SCOPE("CubeTextures");
+        // Sommets (xyz, uv) et indices calculés à la compilation
+        static constexpr auto vertices = static_mesh::textured_cube();
+        static constexpr auto indices = static_mesh::textured_cube_indices();
 
         // Création et remplissage du VAO, VBO et EBO
         glCreateVertexArrays(1, &m_VAO_id);
@@ -276,47 +169,57 @@ public:
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
 
-        std::vector<GLfloat> vertices;
-        for (int i = 0; i < 24; i++)
-        {
-            vertices.push_back(positions[i * 3 + 0]);
-            vertices.push_back(positions[i * 3 + 1]);
-            vertices.push_back(positions[i * 3 + 2]);
-            vertices.push_back(tex_coords[i * 2 + 0]);
-            vertices.push_back(tex_coords[i * 2 + 1]);
-        }
-
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices.data(), GL_STATIC_DRAW);
 
         // Création et remplissage du EBO
         glGenBuffers(1, &m_EBO_id);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO_id);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), reinterpret_cast<void *>(0));
         glEnableVertexAttribArray(m_vPos_loc);
         glVertexAttribPointer(m_vTex_loc, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), reinterpret_cast<void *>(3 * sizeof(GLfloat)));
         glEnableVertexAttribArray(m_vTex_loc);
 
+        // VBO des instances : un vec4 par cube, avancé une fois par instance
+        glGenBuffers(1, &m_inst_VBO_id);
+        glBindBuffer(GL_ARRAY_BUFFER, m_inst_VBO_id);
+        glVertexAttribPointer(m_vInst_loc, 4, GL_FLOAT, GL_FALSE, 4 * sizeof(GLfloat), reinterpret_cast<void *>(0));
+        glVertexAttribDivisor(m_vInst_loc, 1);
+        glEnableVertexAttribArray(m_vInst_loc);
+
         glBindVertexArray(0);
+
+        // Par défaut un seul cube, centré, à l'échelle 1
+        set_instances({0.0f, 0.0f, 0.0f, 1.0f});
     }
 
     ~CubeTextures()
     {
         glDeleteBuffers(1, &m_VBO_id);
         glDeleteBuffers(1, &m_EBO_id); // Delete the EBO
+        glDeleteBuffers(1, &m_inst_VBO_id);
         glDeleteVertexArrays(1, &m_VAO_id);
     }
 
-    void draw(const std::vector<GLuint> &textures)
+    // instances : x, y, z, échelle pour chaque cube
+    void set_instances(const std::vector<GLfloat> &instances)
+    {
+        m_nb_instances = instances.size() / 4;
+        glBindBuffer(GL_ARRAY_BUFFER, m_inst_VBO_id);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(GLfloat),
+                     instances.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    GLsizei nb_instances() const { return m_nb_instances; }
+
+    void draw(GLuint texture_array)
     {
         glBindVertexArray(m_VAO_id);
 
-        for (int i = 0; i < 6; i++)
-        {
-            glBindTexture(GL_TEXTURE_2D, textures[i]);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, reinterpret_cast<void *>(i * 6 * sizeof(GLuint)));
-        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, texture_array);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, reinterpret_cast<void *>(0), m_nb_instances);
 
         glBindVertexArray(0);
     }
@@ -326,72 +229,15 @@ public:
 
 class WireCube
 {
-    bool m_is_white;
-    GLfloat m_radius;
     GLuint m_VAO_id, m_VBO_id, m_EBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    WireCube(bool is_white, GLfloat radius, GLint vPos_loc, GLint vCol_loc)
-        : m_is_white{is_white}, m_radius{radius},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc}
+    // mesh : static_mesh::wire_cube, calculé à la compilation
+    WireCube(const static_mesh::WireCubeMesh &mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc}
     {
-        GLfloat r = m_radius;
-
-        // Positions
-        GLfloat positions[] = {
-            -r, -r, -r, // P0                 6 ------- 7
-            r, -r, -r,  // P1               / |       / |
-            -r, r, -r,  // P2             /   |     /   |
-            r, r, -r,   // P3           2 ------- 3     |
-            -r, -r, r,  // P4           |     4 --|---- 5
-            r, -r, r,   // P5           |   /     |   /
-            -r, r, r,   // P6           | /       | /
-            r, r, r,    // P7           0 ------- 1
-        };
-
-        // Indices : positions, couleurs
-        GLint indexes[] = {
-            0, 1, 0, 0,
-            2, 3, 0, 0,
-            4, 5, 0, 0,
-            6, 7, 0, 0,
-            0, 2, 1, 1,
-            1, 3, 1, 1,
-            4, 6, 1, 1,
-            5, 7, 1, 1,
-            0, 4, 2, 2,
-            1, 5, 2, 2,
-            2, 6, 2, 2,
-            3, 7, 2, 2};
-
-        // Couleurs
-        GLfloat colors_rgb[] = {
-            1.0, 0.0, 0.0, // C0       C1  C2
-            0.0, 1.0, 0.0, // C1       | /
-            0.0, 0.0, 1.0  // C2       + --C0
-        };
-        GLfloat colors_white[] = {
-            1.0, 1.0, 1.0, // C0
-            1.0, 1.0, 1.0, // C1
-            1.0, 1.0, 1.0  // C2
-        };
-        GLfloat *colors = (is_white) ? colors_white : colors_rgb;
-
-        // Création d'une structure de données à plat
-        std::vector<GLfloat> vertices;
-        for (int i = 0; i < 12 * 4; i += 4)
-        {
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(positions[indexes[i + 0] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(colors[indexes[i + 2] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(positions[indexes[i + 1] * 3 + j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back(colors[indexes[i + 3] * 3 + j]);
-        }
-
+        TRACE_SCOPE("WireCube");
         // Création du VAO
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
@@ -401,8 +247,7 @@ public:
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
 
         // Copie le buffer dans la mémoire du serveur
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat),
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         // VAA associant les données à la variable vPos du shader, avec l'offset 0
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE,
@@ -434,9 +279,17 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC = 30.0;
 const double ANIM_DURATION = 18.0;
 
+// Temps maximal consacré aux uploads de textures à chaque frame, en secondes
+const double TEXTURE_UPLOAD_BUDGET = 0.004;
+
+// Nombre de cubes par côté de la grille (touche g)
+const int CUBE_GRID_SIZE = 16;
+
+// Budget mémoire vidéo des textures précalculées, en Kio (option -vram)
+const int DEFAULT_VRAM_BUDGET = 64 * 1024;
+
 // En salle TP mettre à 0 si l'affichage "bave"
 const int NUM_SAMPLES = 16;
 
@@ -450,7 +303,12 @@ enum CamProj
 class MyApp
 {
     bool m_ok = false;
-    GLFWwindow *m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow *m_window = nullptr;    // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -463,6 +321,7 @@ class MyApp
     WireCube *m_wire_cube_rgb = nullptr;
     WireCube *m_wire_cube_white = nullptr;
     CubeTextures *m_cube_textures = nullptr;
+    bool m_cube_grid = false;
 
     const char *m_default_vertex_shader_text =
         "#version 330\n"
@@ -488,12 +347,41 @@ class MyApp
         "    fragColor = texture2D (uTex, texCoord);\n"
         "}\n";
 
+    // Shaders du cube : couche du tableau de textures selon la face
+    const char *m_cube_vertex_shader_text =
+        "#version 330\n"
+        "in vec4 vPos;\n"
+        "in vec2 vTex;\n"
+        "in vec4 vInst;\n"
+        "out vec3 texCoord;\n"
+        "uniform mat4 matMVP;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    gl_Position = matMVP * vec4 (vPos.xyz * vInst.w + vInst.xyz, 1.0);\n"
+        "    texCoord = vec3 (vTex, gl_VertexID / 4);\n"
+        "}\n";
+
+    const char *m_cube_fragment_shader_text =
+        "#version 330\n"
+        "in vec3 texCoord;\n"
+        "out vec4 fragColor;\n"
+        "uniform sampler2DArray uTex;\n"
+        "\n"
+        "void main()\n"
+        "{\n"
+        "    fragColor = texture (uTex, texCoord);\n"
+        "}\n";
+
     std::string m_vertex_shader_path, m_fragment_shader_path;
 
     GLuint m_program;
     GLint m_vPos_loc, m_vCol_loc, m_vTex_loc;
     GLint m_matMVP_loc;
 
+    GLuint m_cube_program;
+    GLint m_cube_matMVP_loc;
+
     vmath::vec4 m_mousePos; // mouse_x, mouse_y, width, height
     GLint m_mousePos_loc;
     // the one of the triangles i kept them seperate just to check
@@ -501,7 +389,11 @@ class MyApp
     // const char *m_texture_path1 = "side1.png";
     // const char *m_texture_path2 = "side2.png";
     //  vecteur des textures
-    std::vector<GLuint> m_texture_ids;
+    TextureLoader *m_texture_loader = nullptr;
+    GLuint m_cube_texture_array = 0;
+    TextureResidency *m_residency = nullptr;
+    int m_cube_handle = -1;
+    long m_vram_budget = DEFAULT_VRAM_BUDGET;
     std::vector<std::string> m_texture_paths = {
         "side1.png",
         "side2.png",
@@ -509,6 +401,7 @@ class MyApp
         "side4.png",
         "side5.png",
         "side6.png"};
+    const char *m_baked_cube_path = "cube.btex";
 
     void animate()
     {
@@ -516,7 +409,7 @@ class MyApp
         { return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime(); // durée depuis init
+        double time = m_ctx.get_time(); // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a * 360.0;
@@ -524,6 +417,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable(GL_DEPTH_TEST);
@@ -538,9 +432,13 @@ class MyApp
         m_matMVP_loc = glGetUniformLocation(m_program, "matMVP");
         m_mousePos_loc = glGetUniformLocation(m_program, "mousePos");
 
+        m_cube_program = compile_program(m_cube_vertex_shader_text,
+                                         m_cube_fragment_shader_text);
+        m_cube_matMVP_loc = glGetUniformLocation(m_cube_program, "matMVP");
+
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize(m_window, &width, &height);
+        m_ctx.get_size(width, height);
         m_mousePos = {width / 2.0f, height / 2.0f, (float)width, (float)height};
 
         // Création des textures
@@ -549,16 +447,47 @@ class MyApp
 
         // Création des objets graphiques
         m_triangles = new Triangles{m_vPos_loc, m_vTex_loc};
-        m_wire_cube_white = new WireCube{true, 0.5, m_vPos_loc, m_vCol_loc};
-        m_wire_cube_rgb = new WireCube{false, 0.5, m_vPos_loc, m_vCol_loc};
-        m_cube_textures = new CubeTextures(m_vPos_loc, m_vTex_loc);
+        static constexpr auto WIRE_CUBE_WHITE = static_mesh::wire_cube(0.5f, true);
+        static constexpr auto WIRE_CUBE_RGB = static_mesh::wire_cube(0.5f, false);
+        m_wire_cube_white = new WireCube{WIRE_CUBE_WHITE, m_vPos_loc, m_vCol_loc};
+        m_wire_cube_rgb = new WireCube{WIRE_CUBE_RGB, m_vPos_loc, m_vCol_loc};
+        m_cube_textures = new CubeTextures(
+            glGetAttribLocation(m_cube_program, "vPos"),
+            glGetAttribLocation(m_cube_program, "vTex"),
+            glGetAttribLocation(m_cube_program, "vInst"));
+
+        // Les textures sont utilisables tout de suite (image provisoire 1x1),
+        // la boucle d'événements est réveillée à chaque image décodée
+        m_texture_loader = new TextureLoader{[this] { m_ctx.post_empty_event(); }};
+        // Tableau précalculé s'il existe, affiné au fil des frames dans le
+        // budget mémoire ; sinon décodage des PNG
+        m_residency = new TextureResidency{uint64_t(m_vram_budget) * 1024};
+        m_cube_handle = m_residency->add(m_baked_cube_path);
+        if (m_cube_handle < 0)
+            m_cube_texture_array = load_texture_array(m_texture_paths);
+    }
 
-        for (const auto &path : m_texture_paths)
+    // Un seul cube, ou une grille de CUBE_GRID_SIZE^3 cubes dans le même volume
+    void update_cube_instances()
+    {
+        if (!m_cube_grid)
         {
-            GLuint texture_id = load_texture(path.c_str());
-            if (texture_id != 0)
-                m_texture_ids.push_back(texture_id);
+            m_cube_textures->set_instances({0.0f, 0.0f, 0.0f, 1.0f});
+            return;
         }
+        const int n = CUBE_GRID_SIZE;
+        std::vector<GLfloat> instances;
+        instances.reserve(n * n * n * 4);
+        for (int i = 0; i < n; i++)
+            for (int j = 0; j < n; j++)
+                for (int k = 0; k < n; k++)
+                {
+                    instances.push_back((i + 0.5f) / n - 0.5f);
+                    instances.push_back((j + 0.5f) / n - 0.5f);
+                    instances.push_back((k + 0.5f) / n - 0.5f);
+                    instances.push_back(0.5f / n);
+                }
+        m_cube_textures->set_instances(instances);
     }
 
     void tearGL()
@@ -571,20 +500,27 @@ class MyApp
 
         // glDeleteTextures(1, &m_texture_id1);
         // glDeleteTextures(1, &m_texture_id2);
-        for (GLuint texture_id : m_texture_ids)
-        {
-            glDeleteTextures(1, &texture_id);
-        }
-        m_texture_ids.clear();
+        delete m_texture_loader;
+        m_texture_loader = nullptr;
+        glDeleteTextures(1, &m_cube_texture_array);
+        delete m_residency;
+        m_residency = nullptr;
 
         glDeleteProgram(m_program);
+        glDeleteProgram(m_cube_program);
     }
 
     void displayGL()
     {
+        TRACE_SCOPE("displayGL");
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass("clear");
         glUseProgram(m_program);
 
+        // Remplace les textures provisoires par les images déjà décodées
+        m_texture_loader->upload_pending(TEXTURE_UPLOAD_BUDGET);
+        m_gpu_timer.end_pass("upload");
+
         vmath::mat4 matrix;
         set_projection(matrix);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, matrix);
@@ -594,9 +530,24 @@ class MyApp
             glUniform4fv(m_mousePos_loc, 1, m_mousePos);
 
         // Dessins
-        // dessin de textcube
-        if (m_texture_ids.size() == 6)
-            m_cube_textures->draw(m_texture_ids);
+        // dessin de textcube : un bind, un appel pour toutes les instances
+        glUseProgram(m_cube_program);
+        glUniformMatrix4fv(m_cube_matMVP_loc, 1, GL_FALSE, matrix);
+        if (m_cube_handle >= 0)
+        {
+            // En grille, les cubes sont CUBE_GRID_SIZE fois plus petits :
+            // les niveaux les plus fins sont inutiles
+            uint32_t wanted_level = m_cube_grid ? std::log2(CUBE_GRID_SIZE) : 0;
+            m_cube_textures->draw(m_residency->use(m_cube_handle, wanted_level));
+        }
+        else
+            m_cube_textures->draw(m_cube_texture_array);
+        m_gpu_timer.end_pass("cubes");
+
+        m_residency->end_frame();
+        const TextureResidency::Stats &stats = m_residency->stats();
+        if (stats.streamed_bytes > 0 || stats.evictions > 0)
+            m_residency->print_stats();
     }
 
     void set_projection(vmath::mat4 &matrix)
@@ -624,6 +575,7 @@ class MyApp
 
     void compile_shader(GLuint shader, const char *name)
     {
+        TRACE_SCOPE("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader(shader);
 
@@ -647,6 +599,7 @@ class MyApp
 
     void link_program(GLuint program)
     {
+        TRACE_SCOPE("link_program");
         std::cout << "Link program...\n";
         glLinkProgram(program);
 
@@ -698,14 +651,20 @@ class MyApp
     GLuint load_and_compile_program(const std::string vertex_shader_path,
                                     const std::string fragment_shader_path)
     {
+        TRACE_SCOPE("load_and_compile_program");
         std::string vertex_shader_code = load_shader_code(vertex_shader_path,
                                                           m_default_vertex_shader_text);
         std::string fragment_shader_code = load_shader_code(fragment_shader_path,
                                                             m_default_fragment_shader_text);
 
-        const char *vertex_shader_text = vertex_shader_code.c_str();
-        const char *fragment_shader_text = fragment_shader_code.c_str();
+        return compile_program(vertex_shader_code.c_str(),
+                               fragment_shader_code.c_str());
+    }
 
+    GLuint compile_program(const char *vertex_shader_text,
+                           const char *fragment_shader_text)
+    {
+        TRACE_SCOPE("compile_program");
         const GLuint vertex_shader = glCreateShader(GL_VERTEX_SHADER);
         glShaderSource(vertex_shader, 1, &vertex_shader_text, NULL);
         compile_shader(vertex_shader, "vertex");
@@ -767,29 +726,23 @@ class MyApp
         return texture_id;
     }
 */
+    // Renvoie tout de suite une texture 1x1 provisoire ; l'image, retournée
+    // verticalement, est décodée en arrière-plan puis envoyée par upload_pending()
     GLuint load_texture(const char *path)
     {
-        GLuint texture_id;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_2D, texture_id);
-
-        // Flip the image before loading
-        stbi_set_flip_vertically_on_load(1);
-
-        int width, height, n_comp;
-        unsigned char *data = stbi_load(path, &width, &height, &n_comp, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            glGenerateMipmap(GL_TEXTURE_2D);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Failed to load texture: " << path << std::endl;
-        }
+        TRACE_SCOPE("load_texture");
+        std::cout << "Loading texture \"" << path << "\" ..." << std::endl;
+        return m_texture_loader->request(path, true);
+    }
 
-        return texture_id;
+    // Idem pour un tableau de textures, une couche par image
+    GLuint load_texture_array(const std::vector<std::string> &paths)
+    {
+        std::cout << "Loading texture array";
+        for (const auto &path : paths)
+            std::cout << " \"" << path << "\"";
+        std::cout << " ..." << std::endl;
+        return m_texture_loader->request_array(paths, true);
     }
 
     void cam_init()
@@ -819,7 +772,7 @@ class MyApp
     static void print_help()
     {
         std::cout << "h help  i init  a anim  p proj  zZ cam_z  rR radius  "
-                  << "nN near  fF far  dD dist  b z-buffer  c cube  u update program"
+                  << "nN near  fF far  dD dist  b z-buffer  c cube  g grid  v vram  u update program"
                   << std::endl;
     }
 
@@ -883,7 +836,7 @@ class MyApp
             if (that->m_anim_flag)
             {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime(0);
+                that->m_ctx.set_time(0);
             }
             break;
         case GLFW_KEY_P:
@@ -927,6 +880,14 @@ class MyApp
         case GLFW_KEY_C:
             that->m_cube_color = (that->m_cube_color + 1) % 3;
             break;
+        case GLFW_KEY_G:
+            that->m_cube_grid = !that->m_cube_grid;
+            that->update_cube_instances();
+            std::cout << that->m_cube_textures->nb_instances() << " cube(s)" << std::endl;
+            break;
+        case GLFW_KEY_V:
+            that->m_residency->print_stats();
+            break;
         case GLFW_KEY_U:
             that->reload_program();
             break;
@@ -934,7 +895,7 @@ class MyApp
             print_help();
             break;
         case GLFW_KEY_ESCAPE:
-            that->m_ok = false;
+            glfwSetWindowShouldClose(window, GL_TRUE);
             break;
         default:
             return;
@@ -993,6 +954,44 @@ class MyApp
         int i = 1;
         while (i < argc)
         {
+            int nb_ctx_args = m_ctx.parse_arg(argc, argv, i);
+            if (nb_ctx_args < 0)
+                return false;
+            if (nb_ctx_args > 0)
+            {
+                i += nb_ctx_args;
+                continue;
+            }
+            int nb_bench_args = m_bench.parse_arg(argc, argv, i);
+            if (nb_bench_args < 0)
+                return false;
+            if (nb_bench_args > 0)
+            {
+                i += nb_bench_args;
+                continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg(argc, argv, i);
+            if (nb_pacer_args < 0)
+                return false;
+            if (nb_pacer_args > 0)
+            {
+                i += nb_pacer_args;
+                continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg(argc, argv, i);
+            if (nb_timer_args > 0)
+            {
+                i += nb_timer_args;
+                continue;
+            }
+            int nb_capture_args = m_capture.parse_arg(argc, argv, i);
+            if (nb_capture_args < 0)
+                return false;
+            if (nb_capture_args > 0)
+            {
+                i += nb_capture_args;
+                continue;
+            }
             if (strcmp(argv[i], "-vs") == 0 && i + 1 < argc)
             {
                 m_vertex_shader_path = argv[i + 1];
@@ -1005,9 +1004,20 @@ class MyApp
                 i += 2;
                 continue;
             }
+            if (strcmp(argv[i], "-vram") == 0 && i + 1 < argc)
+            {
+                m_vram_budget = atol(argv[i + 1]);
+                i += 2;
+                continue;
+            }
             if (strcmp(argv[i], "--help") == 0)
             {
-                std::cout << "Options: -vs vs_file -fs fs_file\n";
+                std::cout << "Options: -vs vs_file -fs fs_file -vram KiB "
+                          << GLContext::usage() << " "
+                          << FrameBench::usage() << " "
+                          << FramePacer::usage() << " "
+                          << GpuTimer::usage() << " "
+                          << FrameCapture::usage() << "\n";
                 return false;
             }
             std::cerr << "Error, bad arguments. Try --help" << std::endl;
@@ -1019,86 +1029,116 @@ class MyApp
 public:
     MyApp(int argc, char *argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config &cfg = m_ctx.config();
+        cfg.title = "Textures";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args(argc, argv))
             return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled())
+            cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit())
-        {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback(on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint(GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-        // glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow(640, 480, "Textures", NULL, NULL);
-        if (!m_window)
-        {
-            std::cerr << "GLFW: window creation failed" << std::endl;
+        if (!m_ctx.create())
             return;
-        }
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer(m_window, this);
-        glfwSetWindowSizeCallback(m_window, on_reshape_func);
-        glfwSetCursorPosCallback(m_window, on_mouse_func);
-        glfwSetKeyCallback(m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent(m_window);
-        glfwSwapInterval(1);
+        if (m_window)
+        {
+            glfwSetWindowUserPointer(m_window, this);
+            glfwSetWindowSizeCallback(m_window, on_reshape_func);
+            glfwSetCursorPosCallback(m_window, on_mouse_func);
+            glfwSetKeyCallback(m_window, on_key_func);
+        }
+        m_pacer.start(m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL();
+        gladLoadGLLoader(GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
                   << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize(m_window, &width, &height);
+        m_ctx.get_size(width, height);
         set_viewport(width, height);
 
         initGL();
+        if (!m_gpu_timer.start())
+            m_ok = false;
+        if (!m_capture.start(m_ctx))
+            m_ok = false;
     }
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose(m_window))
+        if (m_ok && m_bench.enabled())
+            return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers(m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag)
             {
-                glfwWaitEventsTimeout(1.0 / FRAMES_PER_SEC);
+                m_pacer.wait(m_ctx);
                 animate();
             }
+            // Des images décodées ou des niveaux de mipmap n'ont pas tenu
+            // dans le budget de la frame
+            else if (m_texture_loader->has_decoded() ||
+                     m_residency->has_pending())
+                m_ctx.poll_events();
             else
-                glfwWaitEvents();
+                m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval(0);
+        m_bench.start(m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done())
+        {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
-        tearGL();
-        if (m_window)
-            glfwDestroyWindow(m_window);
-        glfwTerminate();
+        // Sans contexte, les fonctions GL ne sont pas chargées
+        if (m_ok) tearGL();
     }
 
 }; // MyApp
@@ -1106,5 +1146,5 @@ public:
 int main(int argc, char *argv[])
 {
     MyApp app{argc, argv};
-    app.run();
+    return app.run();
 }
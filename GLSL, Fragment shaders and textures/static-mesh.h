@@ -0,0 +1,206 @@
+/*
+    Maillages de forme fixe calculés à la compilation
+
+    Les boîtes chanfreinées (Pedale, Boite), les cubes fil de fer et le cube
+    texturé ne dépendent que de quelques dimensions connues à la compilation.
+    Chaque fonction ci-dessous est constexpr et renvoie un std::array déjà
+    entrelacé dans le format attendu par la classe ; déclaré
+
+        static constexpr auto PEDALE = static_mesh::chamfered_box (...);
+
+    le tableau est placé dans les données en lecture seule de l'exécutable et
+    glBufferData le copie directement : ni calcul ni allocation au démarrage.
+
+    Les expressions sont celles des anciennes tables positions[] (mêmes
+    opérations en float, couleurs * 0.7 en double puis arrondies en float) :
+    les sommets sont identiques au bit près.
+*/
+
+#ifndef STATIC_MESH_H
+#define STATIC_MESH_H
+
+#include <array>
+
+namespace static_mesh
+{
+    // Boîte chanfreinée : 34 sommets xyz rgb. Face avant (0-7) et face
+    // arrière (8-15) en GL_TRIANGLE_STRIP de 8, pourtour (16-33) en strip
+    // de 18, de couleur assombrie
+    constexpr int CHAMFERED_BOX_NB_VERTICES = 34;
+    typedef std::array<float, CHAMFERED_BOX_NB_VERTICES * 6> ChamferedBoxMesh;
+
+    // Cube fil de fer : 12 arêtes, 24 sommets xyz rgb pour GL_LINES
+    typedef std::array<float, 24 * 6> WireCubeMesh;
+
+    // Cube texturé : 4 sommets xyz uv par face, 36 indices
+    typedef std::array<float, 24 * 5> TexturedCubeMesh;
+    typedef std::array<unsigned, 36> CubeIndices;
+
+    // Boîte éclairée : 4 sommets xyz rgb normale par face, 36 indices
+    typedef std::array<float, 24 * 9> BoxWithNormalsMesh;
+
+
+    namespace detail
+    {
+        constexpr void put3 (float* out, float a, float b, float c)
+        {
+            out[0] = a;
+            out[1] = b;
+            out[2] = c;
+        }
+    }
+
+
+    constexpr ChamferedBoxMesh chamfered_box (float larg, float long_, float haut,
+        float chanf, float coul_r, float coul_v, float coul_b)
+    {
+        // Contour d'une face A B H C G D F E, en zigzag pour le strip
+        const float x[8] = {
+            -larg/2+chanf, larg/2-chanf, - larg/2, larg/2,
+            -larg/2, larg/2, -larg/2+chanf, larg/2-chanf };
+        const float y[8] = {
+            haut/2, haut/2, haut/2 - chanf, haut/2 - chanf,
+            -haut/2 + chanf, -haut/2 + chanf, - haut/2, - haut/2 };
+        // Pourtour : B C D E F G H A B
+        const int ring[9] = { 1, 3, 5, 7, 6, 4, 2, 0, 1 };
+
+        const float dark_r = coul_r * 0.7, dark_v = coul_v * 0.7,
+                    dark_b = coul_b * 0.7;
+
+        ChamferedBoxMesh mesh {};
+        float* out = &mesh[0];
+        for (int face = 0; face < 2; face++) {
+            float z = face == 0 ? long_/2 : -long_/2;
+            for (int i = 0; i < 8; i++, out += 6) {
+                detail::put3 (out, x[i], y[i], z);
+                detail::put3 (out + 3, coul_r, coul_v, coul_b);
+            }
+        }
+        for (int k = 0; k < 9; k++) {
+            int i = ring[k];
+            detail::put3 (out, x[i], y[i], long_/2);
+            detail::put3 (out + 3, dark_r, dark_v, dark_b);
+            detail::put3 (out + 6, x[i], y[i], -long_/2);
+            detail::put3 (out + 9, dark_r, dark_v, dark_b);
+            out += 12;
+        }
+        return mesh;
+    }
+
+
+    constexpr WireCubeMesh wire_cube (float r, bool is_white)
+    {
+        //                    6 ------- 7
+        //                  / |       / |
+        //                /   |     /   |
+        //              2 ------- 3     |
+        //              |     4 --|---- 5
+        //              |   /     |   /
+        //              | /       | /
+        //              0 ------- 1
+        const float positions[8][3] = {
+            {-r, -r, -r}, { r, -r, -r}, {-r,  r, -r}, { r,  r, -r},
+            {-r, -r,  r}, { r, -r,  r}, {-r,  r,  r}, { r,  r,  r} };
+
+        // Arêtes selon x (couleur C0), y (C1), z (C2)
+        const int edges[12][2] = {
+            {0, 1}, {2, 3}, {4, 5}, {6, 7},
+            {0, 2}, {1, 3}, {4, 6}, {5, 7},
+            {0, 4}, {1, 5}, {2, 6}, {3, 7} };
+        const float colors_rgb[3][3] = { {1, 0, 0}, {0, 1, 0}, {0, 0, 1} };
+
+        WireCubeMesh mesh {};
+        float* out = &mesh[0];
+        for (int e = 0; e < 12; e++) {
+            const float* col = colors_rgb[e / 4];
+            for (int k = 0; k < 2; k++, out += 6) {
+                const float* p = positions[edges[e][k]];
+                detail::put3 (out, p[0], p[1], p[2]);
+                if (is_white) detail::put3 (out + 3, 1, 1, 1);
+                else detail::put3 (out + 3, col[0], col[1], col[2]);
+            }
+        }
+        return mesh;
+    }
+
+
+    // Cube de côté 1 centré, texture plaquée 1:1 sur chaque face ; faces
+    // avant, arrière, gauche, droite, haut, bas
+    constexpr TexturedCubeMesh textured_cube()
+    {
+        const float positions[24][3] = {
+            {-0.5f, -0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f},
+            {-0.5f, -0.5f, -0.5f}, {-0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f},
+            {-0.5f, -0.5f, -0.5f}, {-0.5f, -0.5f,  0.5f}, {-0.5f,  0.5f,  0.5f}, {-0.5f,  0.5f, -0.5f},
+            { 0.5f, -0.5f, -0.5f}, { 0.5f,  0.5f, -0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f, -0.5f,  0.5f},
+            {-0.5f,  0.5f, -0.5f}, {-0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f,  0.5f}, { 0.5f,  0.5f, -0.5f},
+            {-0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f, -0.5f}, { 0.5f, -0.5f,  0.5f}, {-0.5f, -0.5f,  0.5f} };
+        const float tex_coords[24][2] = {
+            {0, 0}, {1, 0}, {1, 1}, {0, 1},
+            {0, 0}, {0, 1}, {1, 1}, {1, 0},
+            {0, 0}, {1, 0}, {1, 1}, {0, 1},
+            {0, 0}, {1, 0}, {1, 1}, {0, 1},
+            {0, 0}, {0, 1}, {1, 1}, {1, 0},
+            {0, 0}, {1, 0}, {1, 1}, {0, 1} };
+
+        TexturedCubeMesh mesh {};
+        for (int i = 0; i < 24; i++) {
+            detail::put3 (&mesh[i * 5], positions[i][0], positions[i][1], positions[i][2]);
+            mesh[i * 5 + 3] = tex_coords[i][0];
+            mesh[i * 5 + 4] = tex_coords[i][1];
+        }
+        return mesh;
+    }
+
+    // 2 triangles par face de textured_cube
+    constexpr CubeIndices textured_cube_indices()
+    {
+        CubeIndices indices {};
+        for (unsigned face = 0; face < 6; face++) {
+            const unsigned order[6] = { 0, 1, 2, 2, 3, 0 };
+            for (int k = 0; k < 6; k++) indices[face * 6 + k] = face * 4 + order[k];
+        }
+        return indices;
+    }
+
+
+    // Boîte width x height x depth centrée ; faces avant, arrière, gauche,
+    // droite, haut, bas
+    constexpr BoxWithNormalsMesh box_with_normals (float width, float height,
+        float depth, float coul_r, float coul_v, float coul_b)
+    {
+        const float w = width / 2.0f, h = height / 2.0f, d = depth / 2.0f;
+        const float positions[24][3] = {
+            {-w, -h,  d}, { w, -h,  d}, { w,  h,  d}, {-w,  h,  d},
+            {-w, -h, -d}, { w, -h, -d}, { w,  h, -d}, {-w,  h, -d},
+            {-w, -h, -d}, {-w, -h,  d}, {-w,  h,  d}, {-w,  h, -d},
+            { w, -h, -d}, { w, -h,  d}, { w,  h,  d}, { w,  h, -d},
+            {-w,  h,  d}, { w,  h,  d}, { w,  h, -d}, {-w,  h, -d},
+            {-w, -h,  d}, { w, -h,  d}, { w, -h, -d}, {-w, -h, -d} };
+        const float normals[6][3] = {
+            {0, 0, 1}, {0, 0, -1}, {-1, 0, 0}, {1, 0, 0}, {0, 1, 0}, {0, -1, 0} };
+
+        BoxWithNormalsMesh mesh {};
+        for (int i = 0; i < 24; i++) {
+            float* out = &mesh[i * 9];
+            detail::put3 (out, positions[i][0], positions[i][1], positions[i][2]);
+            detail::put3 (out + 3, coul_r, coul_v, coul_b);
+            detail::put3 (out + 6, normals[i / 4][0], normals[i / 4][1], normals[i / 4][2]);
+        }
+        return mesh;
+    }
+
+    // 2 triangles par face de box_with_normals, face arrière retournée
+    constexpr CubeIndices box_with_normals_indices()
+    {
+        return CubeIndices {
+            0, 1, 2,  0, 2, 3,
+            5, 4, 7,  5, 7, 6,
+            8, 9, 10,  8, 10, 11,
+            12, 13, 14,  12, 14, 15,
+            16, 17, 18,  16, 18, 19,
+            20, 21, 22,  20, 22, 23 };
+    }
+}
+
+#endif // STATIC_MESH_H
@@ -0,0 +1,302 @@
+/*
+    Précalcul de textures : PNG -> conteneur .btex (voir baked-texture.h)
+
+    Calcule la chaîne de mipmaps complète (filtre boîte 2x2) et compresse
+    éventuellement chaque niveau par blocs 4x4 :
+      -bc1   RGB, 8 octets par bloc  (GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+      -bc3   RGBA, 16 octets par bloc (GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+      -rgba  sans compression         (GL_RGBA8)
+    Plusieurs images de même taille donnent un tableau de textures.
+
+    Usage : texbake [-bc1|-bc3|-rgba] [-flip] -o sortie.btex image.png...
+*/
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "stb_image.h"
+#include "baked-texture.h"
+
+//----------------------------------- M I P S ---------------------------------
+
+struct Image
+{
+    int width, height;
+    std::vector<uint8_t> rgba;
+
+    const uint8_t* pixel (int x, int y) const
+    {
+        // Bords répétés pour les blocs et niveaux impairs
+        if (x >= width) x = width-1;
+        if (y >= height) y = height-1;
+        return &rgba[(y*width + x) * 4];
+    }
+};
+
+
+// Niveau suivant : moyenne de 2x2 texels
+Image half_size (const Image& src)
+{
+    Image dst;
+    dst.width = src.width > 1 ? src.width/2 : 1;
+    dst.height = src.height > 1 ? src.height/2 : 1;
+    dst.rgba.resize (dst.width * dst.height * 4);
+
+    for (int y = 0; y < dst.height; y++)
+    for (int x = 0; x < dst.width; x++)
+    for (int c = 0; c < 4; c++) {
+        int sum = src.pixel (2*x, 2*y)[c] + src.pixel (2*x+1, 2*y)[c] +
+                  src.pixel (2*x, 2*y+1)[c] + src.pixel (2*x+1, 2*y+1)[c];
+        dst.rgba[(y*dst.width + x) * 4 + c] = (sum + 2) / 4;
+    }
+    return dst;
+}
+
+//------------------------------------ B C 1 ----------------------------------
+
+uint16_t pack_565 (const float c[3])
+{
+    auto q = [] (float v, int max) {
+        int i = int (v / 255.f * max + 0.5f);
+        return i < 0 ? 0 : i > max ? max : i;
+    };
+    return (q (c[0], 31) << 11) | (q (c[1], 63) << 5) | q (c[2], 31);
+}
+
+void unpack_565 (uint16_t v, int c[3])
+{
+    int r = (v >> 11) & 31, g = (v >> 5) & 63, b = v & 31;
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+
+// Bloc couleur 4x4 : extrémités sur l'axe principal des couleurs (itération
+// de la puissance sur la covariance), puis indice de la plus proche des 4
+// couleurs de la palette pour chaque texel. Toujours en mode 4 couleurs.
+void encode_color_block (const uint8_t block[16][4], uint8_t out[8])
+{
+    float mean[3] = {0, 0, 0};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++) mean[c] += block[i][c] / 16.f;
+
+    float cov[6] = {0, 0, 0, 0, 0, 0};
+    for (int i = 0; i < 16; i++) {
+        float r = block[i][0]-mean[0], g = block[i][1]-mean[1],
+              b = block[i][2]-mean[2];
+        cov[0] += r*r; cov[1] += r*g; cov[2] += r*b;
+        cov[3] += g*g; cov[4] += g*b; cov[5] += b*b;
+    }
+    float axis[3] = {1, 1, 1};
+    for (int k = 0; k < 8; k++) {
+        float a[3] = {
+            cov[0]*axis[0] + cov[1]*axis[1] + cov[2]*axis[2],
+            cov[1]*axis[0] + cov[3]*axis[1] + cov[4]*axis[2],
+            cov[2]*axis[0] + cov[4]*axis[1] + cov[5]*axis[2] };
+        float n = std::max (std::abs (a[0]), std::max (std::abs (a[1]), std::abs (a[2])));
+        if (n < 1e-6f) break;       // bloc uni
+        for (int c = 0; c < 3; c++) axis[c] = a[c] / n;
+    }
+
+    float t_min = 1e30f, t_max = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = 0;
+        for (int c = 0; c < 3; c++) t += (block[i][c]-mean[c]) * axis[c];
+        t_min = std::min (t_min, t); t_max = std::max (t_max, t);
+    }
+    float norm2 = axis[0]*axis[0] + axis[1]*axis[1] + axis[2]*axis[2];
+    float e0[3], e1[3];
+    for (int c = 0; c < 3; c++) {
+        e0[c] = mean[c] + axis[c] * t_max / norm2;
+        e1[c] = mean[c] + axis[c] * t_min / norm2;
+    }
+
+    uint16_t c0 = pack_565 (e0), c1 = pack_565 (e1);
+    if (c0 < c1) std::swap (c0, c1);
+
+    int pal[4][3];
+    unpack_565 (c0, pal[0]);
+    unpack_565 (c1, pal[1]);
+    for (int c = 0; c < 3; c++) {
+        pal[2][c] = (2*pal[0][c] + pal[1][c]) / 3;
+        pal[3][c] = (pal[0][c] + 2*pal[1][c]) / 3;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1)
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_d = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int d = 0;
+                for (int c = 0; c < 3; c++) {
+                    int e = block[i][c] - pal[p][c];
+                    d += e*e;
+                }
+                if (d < best_d) { best_d = d; best = p; }
+            }
+            indices |= uint32_t (best) << (2*i);
+        }
+
+    out[0] = c0 & 0xff; out[1] = c0 >> 8;
+    out[2] = c1 & 0xff; out[3] = c1 >> 8;
+    for (int k = 0; k < 4; k++) out[4+k] = (indices >> (8*k)) & 0xff;
+}
+
+
+// Bloc alpha de BC3 : 8 niveaux entre le min et le max, indices sur 3 bits
+void encode_alpha_block (const uint8_t block[16][4], uint8_t out[8])
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++) {
+        a0 = std::max (a0, int (block[i][3]));
+        a1 = std::min (a1, int (block[i][3]));
+    }
+
+    int pal[8] = { a0, a1 };
+    for (int i = 1; i <= 6; i++)
+        pal[i+1] = ((7-i)*a0 + i*a1) / 7;
+
+    uint64_t indices = 0;
+    if (a0 != a1)
+        for (int i = 0; i < 16; i++) {
+            int best = 0, best_d = 256;
+            for (int p = 0; p < 8; p++) {
+                int d = std::abs (block[i][3] - pal[p]);
+                if (d < best_d) { best_d = d; best = p; }
+            }
+            indices |= uint64_t (best) << (3*i);
+        }
+
+    out[0] = a0; out[1] = a1;
+    for (int k = 0; k < 6; k++) out[2+k] = (indices >> (8*k)) & 0xff;
+}
+
+
+void encode_level (const Image& img, uint32_t format, std::vector<uint8_t>& out)
+{
+    if (format == GL_RGBA8) {
+        out.insert (out.end(), img.rgba.begin(), img.rgba.end());
+        return;
+    }
+    for (int by = 0; by < img.height; by += 4)
+    for (int bx = 0; bx < img.width; bx += 4) {
+        uint8_t block[16][4];
+        for (int i = 0; i < 16; i++)
+            memcpy (block[i], img.pixel (bx + i%4, by + i/4), 4);
+
+        uint8_t bytes[16];
+        if (format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT) {
+            encode_alpha_block (block, bytes);
+            encode_color_block (block, bytes + 8);
+            out.insert (out.end(), bytes, bytes + 16);
+        } else {
+            encode_color_block (block, bytes);
+            out.insert (out.end(), bytes, bytes + 8);
+        }
+    }
+}
+
+//------------------------------------ M A I N --------------------------------
+
+int main (int argc, char* argv[])
+{
+    uint32_t format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    bool flip = false;
+    std::string out_path;
+    std::vector<std::string> in_paths;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp (argv[i], "-bc1") == 0) format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+        else if (strcmp (argv[i], "-bc3") == 0) format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+        else if (strcmp (argv[i], "-rgba") == 0) format = GL_RGBA8;
+        else if (strcmp (argv[i], "-flip") == 0) flip = true;
+        else if (strcmp (argv[i], "-o") == 0 && i+1 < argc) out_path = argv[++i];
+        else if (argv[i][0] == '-') {
+            std::cerr << "Error, bad option " << argv[i] << std::endl;
+            return 1;
+        }
+        else in_paths.push_back (argv[i]);
+    }
+    if (out_path.empty() || in_paths.empty()) {
+        std::cerr << "Usage: " << argv[0]
+            << " [-bc1|-bc3|-rgba] [-flip] -o out.btex image.png..." << std::endl;
+        return 1;
+    }
+
+    // Chaîne de mipmaps de chaque couche
+    stbi_set_flip_vertically_on_load (flip);
+    std::vector<std::vector<Image>> layers;
+    for (const auto& path : in_paths) {
+        Image img;
+        int n_comp;
+        uint8_t* data = stbi_load (path.c_str(), &img.width, &img.height, &n_comp, 4);
+        if (!data) {
+            std::cerr << "### Loading error \"" << path << "\": "
+                << stbi_failure_reason() << std::endl;
+            return 1;
+        }
+        img.rgba.assign (data, data + img.width * img.height * 4);
+        stbi_image_free (data);
+
+        if (!layers.empty() && (img.width != layers[0][0].width ||
+                                img.height != layers[0][0].height)) {
+            std::cerr << "Error, \"" << path << "\" size differs from first image"
+                << std::endl;
+            return 1;
+        }
+        std::vector<Image> mips { img };
+        while (mips.back().width > 1 || mips.back().height > 1)
+            mips.push_back (half_size (mips.back()));
+        layers.push_back (std::move (mips));
+    }
+
+    BakedHeader header;
+    memcpy (header.magic, BAKED_MAGIC, 4);
+    header.version = BAKED_VERSION;
+    header.format = format;
+    header.width = layers[0][0].width;
+    header.height = layers[0][0].height;
+    header.nb_layers = layers.size();
+    header.nb_levels = std::min<size_t> (layers[0].size(), BAKED_MAX_LEVELS);
+
+    // Données : niveau par niveau, couches à la suite, alignées sur 16 octets
+    std::vector<BakedLevel> levels (header.nb_levels);
+    std::vector<uint8_t> payload;
+    uint64_t base = sizeof header + header.nb_levels * sizeof (BakedLevel);
+    for (uint32_t i = 0; i < header.nb_levels; i++) {
+        while ((base + payload.size()) % 16) payload.push_back (0);
+        levels[i].width = layers[0][i].width;
+        levels[i].height = layers[0][i].height;
+        levels[i].offset = base + payload.size();
+        for (const auto& mips : layers)
+            encode_level (mips[i], format, payload);
+        levels[i].size = base + payload.size() - levels[i].offset;
+    }
+
+    std::ofstream file (out_path, std::ios::binary);
+    file.write (reinterpret_cast<const char*> (&header), sizeof header);
+    file.write (reinterpret_cast<const char*> (levels.data()),
+        levels.size() * sizeof (BakedLevel));
+    file.write (reinterpret_cast<const char*> (payload.data()), payload.size());
+    if (!file) {
+        std::cerr << "### Write error \"" << out_path << "\"" << std::endl;
+        return 1;
+    }
+
+    uint64_t raw_size = 0;
+    for (const auto& mips : layers)
+        for (uint32_t i = 0; i < header.nb_levels; i++)
+            raw_size += mips[i].rgba.size();
+    std::cout << out_path << ": " << header.width << "x" << header.height
+        << "x" << header.nb_layers << ", " << header.nb_levels << " levels, "
+        << baked_format_name (format) << ", " << payload.size() / 1024
+        << " KiB (RGBA8: " << raw_size / 1024 << " KiB)" << std::endl;
+    return 0;
+}
@@ -0,0 +1,500 @@
+/*
+    Chargement asynchrone de textures
+
+    Les images sont décodées par stb_image sur un pool de threads ; request()
+    renvoie tout de suite un identifiant de texture lié à une image 1x1 de
+    remplacement. Les uploads (glTexImage2D + glGenerateMipmap) restent sur
+    le thread GL et sont faits par upload_pending() dans un budget de temps
+    par frame, si bien que le temps jusqu'à la première image ne dépend pas
+    du nombre de textures.
+
+    request_array() fait de même pour un GL_TEXTURE_2D_ARRAY : chaque image
+    devient une couche, et le tableau est envoyé d'un bloc quand toutes ses
+    images sont décodées.
+
+    Si le driver a glBufferStorage (GL 4.4), les threads de travail recopient
+    les pixels décodés dans une tranche d'un pixel unpack buffer mappé en
+    permanence : glTexImage2D lit alors le PBO de façon asynchrone au lieu
+    de recopier l'image sur le thread GL. Une tranche est rendue quand la
+    fence posée après son upload est passée.
+*/
+
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "glad.h"
+#include "stb_image.h"
+#include "thread-pool.h"
+#include "trace.h"
+
+
+class TextureLoader
+{
+    struct Slice {
+        GLintptr offset;
+        GLsizeiptr size;
+        GLsync fence = nullptr;         // posée après l'upload
+    };
+
+    struct Image {
+        std::string path;
+        unsigned char* data = nullptr;  // décodée par stb_image, ou
+        GLintptr pbo_offset = -1;       // recopiée dans le PBO
+        int width = 0, height = 0, n_comp = 0;
+        std::string error;
+
+        bool ok() const { return data || pbo_offset >= 0; }
+    };
+
+    struct Job {
+        GLuint texture_id;
+        GLenum target;                  // GL_TEXTURE_2D ou GL_TEXTURE_2D_ARRAY
+        bool flip, srgb;
+        std::vector<Image> images;      // une seule pour GL_TEXTURE_2D
+        std::atomic<int> nb_remaining;  // images encore à décoder
+
+        Job (GLuint texture_id_, GLenum target_, bool flip_, bool srgb_,
+             const std::vector<std::string>& paths)
+            : texture_id {texture_id_}, target {target_}, flip {flip_},
+              srgb {srgb_}, images (paths.size()),
+              nb_remaining {(int) paths.size()}
+        {
+            for (size_t i = 0; i < paths.size(); i++)
+                images[i].path = paths[i];
+        }
+
+        ~Job()
+        {
+            for (auto& image : images)
+                stbi_image_free (image.data);
+        }
+    };
+
+    // Toutes les tâches non encore envoyées, décodées ou non ; seul le
+    // thread GL y touche
+    std::vector<std::unique_ptr<Job>> m_jobs;
+
+    std::mutex m_mutex;
+    std::deque<Job*> m_decoded;         // protégé par m_mutex
+    std::function<void()> m_on_decoded;
+
+    // Anneau de tranches dans le PBO, protégé par m_mutex
+    GLuint m_pbo = 0;
+    unsigned char* m_pbo_ptr = nullptr;
+    GLsizeiptr m_pbo_size = 0;
+    std::deque<Slice> m_slices;         // dans l'ordre d'allocation
+
+    std::unique_ptr<ThreadPool> m_pool;
+
+public:
+    // on_decoded est appelé depuis un thread de travail à chaque texture
+    // décodée, par exemple pour réveiller la boucle d'événements.
+    // pbo_size : taille de l'anneau de PBO, 0 pour ne pas en utiliser.
+    // À construire avec le contexte GL courant.
+    TextureLoader (std::function<void()> on_decoded = nullptr, int nb_workers = 0,
+                   GLsizeiptr pbo_size = 16 << 20)
+        : m_on_decoded {on_decoded}
+    {
+        if (pbo_size > 0 && (GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage))
+            create_pbo (pbo_size);
+        m_pool.reset (new ThreadPool {nb_workers});
+    }
+
+    ~TextureLoader()
+    {
+        // Arrête les threads avant de libérer ce qui reste en attente :
+        // tâches décodées, en cours ou jamais commencées
+        m_pool.reset();
+        m_decoded.clear();
+        m_jobs.clear();
+        for (auto& slice : m_slices)
+            if (slice.fence) glDeleteSync (slice.fence);
+        if (m_pbo) {
+            glBindBuffer (GL_PIXEL_UNPACK_BUFFER, m_pbo);
+            glUnmapBuffer (GL_PIXEL_UNPACK_BUFFER);
+            glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+            glDeleteBuffers (1, &m_pbo);
+        }
+    }
+
+    // Crée la texture avec l'image de remplacement et lance le décodage ;
+    // srgb : texels en sRGB, convertis en linéaire à l'échantillonnage
+    GLuint request (const char* path, bool flip = false, bool srgb = false)
+    {
+        GLuint texture_id = create_texture (GL_TEXTURE_2D);
+
+        // Texel gris : une image 1x1 est une chaîne de mipmaps complète
+        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA,
+            GL_UNSIGNED_BYTE, s_placeholder);
+
+        submit (new Job {texture_id, GL_TEXTURE_2D, flip, srgb, {path}});
+        return texture_id;
+    }
+
+    // Idem pour un tableau de textures, une couche par image ; les images
+    // doivent avoir la même taille que la première
+    GLuint request_array (const std::vector<std::string>& paths, bool flip = false,
+                          bool srgb = false)
+    {
+        GLuint texture_id = create_texture (GL_TEXTURE_2D_ARRAY);
+        GLsizei nb_layers = paths.size();
+
+        std::vector<GLubyte> placeholder;
+        for (GLsizei i = 0; i < nb_layers; i++)
+            placeholder.insert (placeholder.end(), s_placeholder, s_placeholder+4);
+        glTexImage3D (GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, 1, 1, nb_layers, 0,
+            GL_RGBA, GL_UNSIGNED_BYTE, placeholder.data());
+
+        submit (new Job {texture_id, GL_TEXTURE_2D_ARRAY, flip, srgb, paths});
+        return texture_id;
+    }
+
+    // Vrai si des textures décodées attendent leur upload
+    bool has_decoded()
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        return !m_decoded.empty();
+    }
+
+    // À appeler sur le thread GL, une fois par frame. Envoie les textures
+    // décodées tant que budget (en secondes) n'est pas dépassé, et au moins
+    // une par appel pour garantir la progression. Renvoie le nombre envoyé.
+    int upload_pending (double budget)
+    {
+        TRACE_SCOPE ("upload_pending");
+        auto start = std::chrono::steady_clock::now();
+        int nb_uploaded = 0;
+
+        release_slices();
+
+        GLint prev_texture, prev_array, prev_alignment;
+        glGetIntegerv (GL_TEXTURE_BINDING_2D, &prev_texture);
+        glGetIntegerv (GL_TEXTURE_BINDING_2D_ARRAY, &prev_array);
+        glGetIntegerv (GL_UNPACK_ALIGNMENT, &prev_alignment);
+        if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, m_pbo);
+
+        for (;;) {
+            Job* job;
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                if (m_decoded.empty()) break;
+                job = m_decoded.front();
+                m_decoded.pop_front();
+            }
+
+            if (job->target == GL_TEXTURE_2D_ARRAY)
+                upload_array (job);
+            else upload (job);
+            fence_slices (job);
+            release_job (job);
+            nb_uploaded++;
+
+            std::chrono::duration<double> elapsed =
+                std::chrono::steady_clock::now() - start;
+            if (elapsed.count() >= budget) break;
+        }
+
+        if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, prev_alignment);
+        glBindTexture (GL_TEXTURE_2D, prev_texture);
+        glBindTexture (GL_TEXTURE_2D_ARRAY, prev_array);
+        return nb_uploaded;
+    }
+
+private:
+    static constexpr GLubyte s_placeholder[4] = { 128, 128, 128, 255 };
+
+    void create_pbo (GLsizeiptr size)
+    {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+            GL_MAP_COHERENT_BIT;
+
+        glGenBuffers (1, &m_pbo);
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, m_pbo);
+        glBufferStorage (GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+        m_pbo_ptr = static_cast<unsigned char*> (
+            glMapBufferRange (GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+        glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+
+        if (!m_pbo_ptr) {
+            std::cout << "### PBO mapping failed, uploading from client memory"
+                << std::endl;
+            glDeleteBuffers (1, &m_pbo);
+            m_pbo = 0;
+            return;
+        }
+        m_pbo_size = size;
+    }
+
+    GLuint create_texture (GLenum target)
+    {
+        GLuint texture_id;
+
+        glGenTextures (1, &texture_id);
+        glBindTexture (target, texture_id);
+
+        // Options de filtrage pour le mipmap
+        glTexParameteri (target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri (target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        return texture_id;
+    }
+
+    // Une tâche par image, pour qu'un tableau soit décodé en parallèle ;
+    // le chargeur garde la propriété de job
+    void submit (Job* job)
+    {
+        m_jobs.emplace_back (job);
+        for (size_t i = 0; i < job->images.size(); i++)
+            m_pool->submit ([this, job, i] { decode (job, i); });
+    }
+
+    void release_job (Job* job)
+    {
+        for (auto& owned : m_jobs)
+            if (owned.get() == job) {
+                std::swap (owned, m_jobs.back());
+                m_jobs.pop_back();
+                return;
+            }
+    }
+
+    // Réserve une tranche à la suite de la dernière, en revenant au début
+    // du PBO si besoin ; -1 si l'anneau est plein. Appelé sous m_mutex.
+    GLintptr alloc_slice (GLsizeiptr size)
+    {
+        size = (size + 63) & ~GLsizeiptr (63);
+        if (size > m_pbo_size) return -1;
+
+        GLintptr offset;
+        if (m_slices.empty()) offset = 0;
+        else {
+            GLintptr tail = m_slices.front().offset;
+            GLintptr head = m_slices.back().offset + m_slices.back().size;
+            if (head > tail) {
+                if (head + size <= m_pbo_size) offset = head;
+                else if (size <= tail) offset = 0;
+                else return -1;
+            }
+            else if (head + size <= tail) offset = head;
+            else return -1;
+        }
+        m_slices.push_back ({offset, size});
+        return offset;
+    }
+
+    // Sur un thread de travail : pas d'appel GL ici
+    void decode (Job* job, size_t i)
+    {
+        TRACE_SCOPE ("decode");
+        Image& image = job->images[i];
+
+        // Le réglage du retournement est local au thread dans stb_image.
+        // Les couches d'un tableau sont toutes en RGBA pour partager un format.
+        int req_comp = job->target == GL_TEXTURE_2D_ARRAY ? 4 : 0;
+        stbi_set_flip_vertically_on_load_thread (job->flip);
+        image.data = stbi_load (image.path.c_str(), &image.width, &image.height,
+            &image.n_comp, req_comp);
+        if (!image.data)
+            image.error = stbi_failure_reason();
+        else if (req_comp) image.n_comp = req_comp;
+
+        // Recopie dans le PBO ; à défaut de place l'upload se fera depuis
+        // la mémoire du client
+        if (image.data && m_pbo) {
+            GLsizeiptr size = GLsizeiptr (image.width) * image.height * image.n_comp;
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                image.pbo_offset = alloc_slice (size);
+            }
+            if (image.pbo_offset >= 0) {
+                memcpy (m_pbo_ptr + image.pbo_offset, image.data, size);
+                stbi_image_free (image.data);
+                image.data = nullptr;
+            }
+        }
+
+        // La dernière image décodée publie la texture
+        if (--job->nb_remaining > 0) return;
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_decoded.push_back (job);
+        }
+        if (m_on_decoded) m_on_decoded();
+    }
+
+    // Pose une fence par tranche lue par les uploads de job
+    void fence_slices (Job* job)
+    {
+        for (const auto& image : job->images) {
+            if (image.pbo_offset < 0) continue;
+            GLsync fence = glFenceSync (GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            std::lock_guard<std::mutex> lock (m_mutex);
+            for (auto& slice : m_slices)
+                if (slice.offset == image.pbo_offset) {
+                    slice.fence = fence;
+                    break;
+                }
+        }
+    }
+
+    // Rend les tranches les plus anciennes dont l'upload est terminé
+    void release_slices()
+    {
+        std::lock_guard<std::mutex> lock (m_mutex);
+        while (!m_slices.empty() && m_slices.front().fence) {
+            GLenum status = glClientWaitSync (m_slices.front().fence, 0, 0);
+            if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+                break;
+            glDeleteSync (m_slices.front().fence);
+            m_slices.pop_front();
+        }
+    }
+
+    static void print_error (const Image& image, const std::string& error)
+    {
+        std::cout << "### Loading error \"" << image.path << "\": "
+            << error << std::endl;
+    }
+
+    static void print_loaded (const Image& image)
+    {
+        std::cout << "Texture \"" << image.path << "\" loaded ("
+            << image.width << "x" << image.height << ", "
+            << image.n_comp << " comp" << (image.pbo_offset >= 0 ? ", PBO" : "")
+            << ")" << std::endl;
+    }
+
+    // Formats externe et interne selon le nombre de composantes ; les
+    // images en niveaux de gris sont étendues par swizzle
+    static void image_format (int n_comp, bool srgb, GLenum& format,
+        GLint& internal_format)
+    {
+        switch (n_comp) {
+            case 1 : format = GL_RED;  internal_format = GL_R8; break;
+            case 2 : format = GL_RG;   internal_format = GL_RG8; break;
+            case 3 : format = GL_RGB;
+                     internal_format = srgb ? GL_SRGB8 : GL_RGB8; break;
+            default: format = GL_RGBA;
+                     internal_format = srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+        }
+    }
+
+    static void set_swizzle (GLenum target, int n_comp)
+    {
+        GLint grey[4]  = { GL_RED, GL_RED, GL_RED, GL_ONE };
+        GLint grey_alpha[4] = { GL_RED, GL_RED, GL_RED, GL_GREEN };
+        GLint rgba[4]  = { GL_RED, GL_GREEN, GL_BLUE, GL_ALPHA };
+        glTexParameteriv (target, GL_TEXTURE_SWIZZLE_RGBA,
+            n_comp == 1 ? grey : n_comp == 2 ? grey_alpha : rgba);
+    }
+
+    // Lignes non multiples de 4 octets : alignement à 1
+    static void set_alignment (const Image& image)
+    {
+        glPixelStorei (GL_UNPACK_ALIGNMENT,
+            (image.width * image.n_comp) % 4 == 0 ? 4 : 1);
+    }
+
+    // Pointeur à passer à glTex*Image : offset dans le PBO lié, ou adresse
+    // client (le PBO est alors délié le temps de l'appel)
+    const void* pixels (const Image& image)
+    {
+        if (image.pbo_offset >= 0)
+            return reinterpret_cast<const void*> (image.pbo_offset);
+        if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        return image.data;
+    }
+
+    void rebind_pbo()
+    {
+        if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, m_pbo);
+    }
+
+    void upload (Job* job)
+    {
+        const Image& image = job->images[0];
+        if (!image.ok()) {
+            // La texture garde son image de remplacement
+            print_error (image, image.error);
+            return;
+        }
+        print_loaded (image);
+
+        GLenum format; GLint internal_format;
+        image_format (image.n_comp, job->srgb, format, internal_format);
+
+        glBindTexture (GL_TEXTURE_2D, job->texture_id);
+        set_swizzle (GL_TEXTURE_2D, image.n_comp);
+        set_alignment (image);
+        glTexImage2D (GL_TEXTURE_2D, 0, internal_format, image.width,
+            image.height, 0, format, GL_UNSIGNED_BYTE, pixels (image));
+        rebind_pbo();
+        glGenerateMipmap (GL_TEXTURE_2D);
+    }
+
+    void upload_array (Job* job)
+    {
+        // La taille du tableau est celle de la première image lisible
+        const Image* first = nullptr;
+        for (const auto& image : job->images)
+            if (image.ok()) { first = &image; break; }
+        if (!first) {
+            // Le tableau garde ses couches de remplacement
+            for (const auto& image : job->images)
+                print_error (image, image.error);
+            return;
+        }
+        int width = first->width, height = first->height;
+        GLsizei nb_layers = job->images.size();
+
+        GLenum format; GLint internal_format;
+        image_format (4, job->srgb, format, internal_format);
+
+        glBindTexture (GL_TEXTURE_2D_ARRAY, job->texture_id);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
+        if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+        glTexImage3D (GL_TEXTURE_2D_ARRAY, 0, internal_format, width, height,
+            nb_layers, 0, format, GL_UNSIGNED_BYTE, nullptr);
+        rebind_pbo();
+
+        for (GLsizei layer = 0; layer < nb_layers; layer++) {
+            const Image& image = job->images[layer];
+            const void* data;
+            std::vector<GLubyte> grey;
+
+            if (!image.ok() || image.width != width || image.height != height) {
+                if (!image.ok()) print_error (image, image.error);
+                else print_error (image, "size differs from first layer");
+                // Couche grise, comme l'image de remplacement
+                grey.assign (width * height * 4, s_placeholder[0]);
+                if (m_pbo) glBindBuffer (GL_PIXEL_UNPACK_BUFFER, 0);
+                data = grey.data();
+            }
+            else {
+                print_loaded (image);
+                data = pixels (image);
+            }
+
+            glTexSubImage3D (GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height,
+                1, format, GL_UNSIGNED_BYTE, data);
+            rebind_pbo();
+        }
+        glGenerateMipmap (GL_TEXTURE_2D_ARRAY);
+    }
+
+}; // TextureLoader
+
+#endif // TEXTURE_LOADER_H
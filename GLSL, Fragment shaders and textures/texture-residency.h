@@ -0,0 +1,280 @@
+/*
+    Gestion de la résidence des textures dans un budget mémoire
+
+    Les textures sont des fichiers .btex (voir baked-texture.h), projetés en
+    mémoire : seuls les niveaux de mipmap résidents occupent la mémoire
+    vidéo. À l'ajout, seule la queue de la chaîne (niveaux de côté
+    <= RESIDENCY_TAIL_SIZE) est envoyée ; ensuite chaque use() qui trouve la
+    texture moins fine que demandé compte un défaut, et end_frame() affine
+    d'un niveau à la fois, du plus grossier au plus fin, dans une limite
+    d'octets par frame. Quand le budget serait dépassé, les niveaux les plus
+    fins des textures utilisées le moins récemment sont évincés.
+
+    Les textures sont mutables : GL_TEXTURE_BASE_LEVEL désigne le niveau le
+    plus fin résident, et un niveau évincé est respécifié en taille 0.
+*/
+
+#ifndef TEXTURE_RESIDENCY_H
+#define TEXTURE_RESIDENCY_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "glad.h"
+#include "baked-texture.h"
+
+// Les niveaux dont le côté ne dépasse pas cette taille restent résidents
+const uint32_t RESIDENCY_TAIL_SIZE = 32;
+
+
+class TextureResidency
+{
+public:
+    struct Stats {
+        uint64_t resident_bytes = 0;
+        uint64_t streamed_bytes = 0;    // envoyés pendant la frame
+        double stream_seconds = 0;      // temps passé à les envoyer
+        int misses = 0;                 // use() sur une texture trop grossière
+        int evictions = 0;              // niveaux évincés
+    };
+
+private:
+    struct Entry {
+        std::string path;
+        std::unique_ptr<BakedFile> file;
+        GLuint texture_id = 0;
+        uint32_t tail_level;            // premier niveau toujours résident
+        uint32_t base_level;            // niveau le plus fin résident
+        uint32_t wanted_level = 0;      // niveau demandé au dernier use()
+        uint64_t last_use = 0;          // numéro de frame
+    };
+
+    std::vector<Entry> m_entries;
+    uint64_t m_budget, m_upload_limit;
+    uint64_t m_frame = 1;
+    Stats m_stats, m_last_stats;
+
+public:
+    // budget : octets de mémoire vidéo pour toutes les textures gérées ;
+    // upload_limit : octets envoyés au plus par frame (au moins un niveau)
+    TextureResidency (uint64_t budget, uint64_t upload_limit = 1 << 20)
+        : m_budget {budget}, m_upload_limit {upload_limit}
+    {}
+
+    ~TextureResidency()
+    {
+        for (auto& e : m_entries)
+            glDeleteTextures (1, &e.texture_id);
+    }
+
+    // Ouvre le fichier et envoie la queue de la chaîne ; renvoie un
+    // identifiant pour use(), ou -1 en cas d'échec
+    int add (const char* path)
+    {
+        Entry e;
+        e.path = path;
+        e.file.reset (new BakedFile);
+        std::string error;
+        if (!e.file->open (path, error)) {
+            std::cout << "### Loading error \"" << path << "\": " << error
+                << std::endl;
+            return -1;
+        }
+        const BakedHeader& h = e.file->header;
+        GLenum target = e.file->target();
+
+        e.tail_level = h.nb_levels - 1;
+        while (e.tail_level > 0) {
+            BakedLevel l = e.file->level (e.tail_level - 1);
+            if (std::max (l.width, l.height) > RESIDENCY_TAIL_SIZE) break;
+            e.tail_level--;
+        }
+        e.base_level = h.nb_levels;
+
+        GLint prev_texture;
+        glGetIntegerv (binding (target), &prev_texture);
+
+        glGenTextures (1, &e.texture_id);
+        glBindTexture (target, e.texture_id);
+        glTexParameteri (target, GL_TEXTURE_MAX_LEVEL, h.nb_levels - 1);
+        glTexParameteri (target, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri (target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        while (e.base_level > e.tail_level) {
+            e.base_level--;
+            e.file->upload_level (e.base_level, false);
+            m_stats.resident_bytes += e.file->level (e.base_level).size;
+        }
+        glTexParameteri (target, GL_TEXTURE_BASE_LEVEL, e.base_level);
+        glBindTexture (target, prev_texture);
+
+        std::cout << "Texture \"" << path << "\" registered (" << h.width
+            << "x" << h.height << "x" << h.nb_layers << ", levels "
+            << e.tail_level << ".." << h.nb_levels - 1 << " resident)"
+            << std::endl;
+
+        m_entries.push_back (std::move (e));
+        return m_entries.size() - 1;
+    }
+
+    // Texture à lier pour dessiner pendant cette frame ; wanted_level est le
+    // niveau le plus fin utile (0 : pleine résolution)
+    GLuint use (int handle, uint32_t wanted_level = 0)
+    {
+        Entry& e = m_entries[handle];
+        e.last_use = m_frame;
+        e.wanted_level = std::min (wanted_level, e.tail_level);
+        if (e.base_level > e.wanted_level) m_stats.misses++;
+        return e.texture_id;
+    }
+
+    // Vrai si des niveaux demandés ne sont pas encore résidents
+    bool has_pending() const
+    {
+        for (const auto& e : m_entries)
+            if (e.last_use == m_frame - 1 && e.base_level > e.wanted_level &&
+                can_refine (e))
+                return true;
+        return false;
+    }
+
+    // À appeler après les dessins de la frame : affine les textures
+    // utilisées, en évinçant si besoin, puis passe à la frame suivante
+    void end_frame()
+    {
+        auto start = std::chrono::steady_clock::now();
+
+        // Les plus récemment utilisées d'abord, puis les plus grossières
+        std::vector<Entry*> todo;
+        for (auto& e : m_entries)
+            if (e.last_use == m_frame && e.base_level > e.wanted_level)
+                todo.push_back (&e);
+        std::sort (todo.begin(), todo.end(), [] (Entry* a, Entry* b) {
+            if (a->last_use != b->last_use) return a->last_use > b->last_use;
+            return a->base_level > b->base_level;
+        });
+
+        bool progress = true;
+        while (progress) {
+            progress = false;
+            for (Entry* e : todo) {
+                if (e->base_level <= e->wanted_level) continue;
+                if (m_stats.streamed_bytes > 0 && m_stats.streamed_bytes +
+                    next_level_size (*e) > m_upload_limit) continue;
+                if (refine (*e)) progress = true;
+            }
+        }
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        m_stats.stream_seconds = elapsed.count();
+
+        m_last_stats = m_stats;
+        m_stats.streamed_bytes = 0;
+        m_stats.stream_seconds = 0;
+        m_stats.misses = 0;
+        m_stats.evictions = 0;
+        m_frame++;
+    }
+
+    // Statistiques de la dernière frame terminée
+    const Stats& stats() const { return m_last_stats; }
+
+    void print_stats() const
+    {
+        const Stats& s = m_last_stats;
+        double mb_per_s = s.stream_seconds > 0 ?
+            s.streamed_bytes / s.stream_seconds / (1 << 20) : 0;
+        std::cout << "Residency: " << s.resident_bytes / 1024 << " / "
+            << m_budget / 1024 << " KiB, streamed "
+            << s.streamed_bytes / 1024 << " KiB (" << mb_per_s << " MiB/s), "
+            << s.misses << " misses, " << s.evictions << " evictions"
+            << std::endl;
+    }
+
+private:
+    static GLenum binding (GLenum target)
+    {
+        return target == GL_TEXTURE_2D ? GL_TEXTURE_BINDING_2D :
+            GL_TEXTURE_BINDING_2D_ARRAY;
+    }
+
+    uint64_t next_level_size (const Entry& e) const
+    {
+        return e.file->level (e.base_level - 1).size;
+    }
+
+    // Vrai si le niveau suivant tient dans le budget, quitte à évincer
+    bool can_refine (const Entry& e) const
+    {
+        uint64_t evictable = 0;
+        for (const auto& o : m_entries)
+            if (&o != &e && o.last_use < m_frame - 1)
+                for (uint32_t i = o.base_level; i < o.tail_level; i++)
+                    evictable += o.file->level (i).size;
+        return m_stats.resident_bytes + next_level_size (e) <=
+            m_budget + evictable;
+    }
+
+    // Envoie le niveau plus fin suivant de e ; false si le budget l'interdit
+    bool refine (Entry& e)
+    {
+        uint64_t size = next_level_size (e);
+        while (m_stats.resident_bytes + size > m_budget)
+            if (!evict_lru (e)) return false;
+
+        GLenum target = e.file->target();
+        GLint prev_texture;
+        glGetIntegerv (binding (target), &prev_texture);
+        glBindTexture (target, e.texture_id);
+
+        e.base_level--;
+        e.file->upload_level (e.base_level, false);
+        glTexParameteri (target, GL_TEXTURE_BASE_LEVEL, e.base_level);
+        glBindTexture (target, prev_texture);
+
+        m_stats.resident_bytes += size;
+        m_stats.streamed_bytes += size;
+        return true;
+    }
+
+    // Évince le niveau le plus fin de la texture utilisée le moins récemment,
+    // hors celles de la frame courante et hors queue de chaîne
+    bool evict_lru (const Entry& keep)
+    {
+        Entry* lru = nullptr;
+        for (auto& o : m_entries)
+            if (&o != &keep && o.last_use < m_frame &&
+                o.base_level < o.tail_level &&
+                (!lru || o.last_use < lru->last_use))
+                lru = &o;
+        if (!lru) return false;
+
+        GLenum target = lru->file->target();
+        GLint prev_texture;
+        glGetIntegerv (binding (target), &prev_texture);
+        glBindTexture (target, lru->texture_id);
+
+        uint32_t level = lru->base_level++;
+        glTexParameteri (target, GL_TEXTURE_BASE_LEVEL, lru->base_level);
+        // Respécifié vide : la mémoire du niveau est rendue
+        if (target == GL_TEXTURE_2D)
+            glTexImage2D (target, level, GL_RGBA8, 0, 0, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, nullptr);
+        else glTexImage3D (target, level, GL_RGBA8, 0, 0, 0, 0, GL_RGBA,
+                GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture (target, prev_texture);
+
+        m_stats.resident_bytes -= lru->file->level (level).size;
+        m_stats.evictions++;
+        return true;
+    }
+
+}; // TextureResidency
+
+#endif // TEXTURE_RESIDENCY_H
@@ -0,0 +1,84 @@
+/*
+    Pool de threads de travail minimal : une file de tâches partagée,
+    consommée par un nombre fixe de threads.
+*/
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace.h"
+
+
+class ThreadPool
+{
+    std::vector<std::thread> m_workers;
+    std::deque<std::function<void()>> m_tasks;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    bool m_stop = false;
+
+public:
+    // nb_workers = 0 : un thread par coeur, moins celui du thread GL
+    ThreadPool (int nb_workers = 0)
+    {
+        if (nb_workers <= 0) {
+            int nb_cores = std::thread::hardware_concurrency();
+            nb_workers = nb_cores > 1 ? nb_cores - 1 : 1;
+        }
+        for (int i = 0; i < nb_workers; i++)
+            m_workers.emplace_back ([this] { worker_loop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        for (auto& worker : m_workers)
+            worker.join();
+    }
+
+    int size() const
+    {
+        return m_workers.size();
+    }
+
+    void submit (std::function<void()> task)
+    {
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_tasks.push_back (std::move (task));
+        }
+        m_cond.notify_one();
+    }
+
+private:
+    void worker_loop()
+    {
+        TRACE_THREAD ("worker");
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock (m_mutex);
+                m_cond.wait (lock, [this] { return m_stop || !m_tasks.empty(); });
+                // À l'arrêt, les tâches non commencées sont abandonnées
+                if (m_stop) return;
+                task = std::move (m_tasks.front());
+                m_tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+}; // ThreadPool
+
+#endif // THREAD_POOL_H
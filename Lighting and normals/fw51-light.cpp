@@ -24,9 +24,30 @@
 
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 // Pour charger des images avec le module stb_image
 #include "stb_image.h"
 
+// Décodage des textures sur un pool de threads, upload sur le thread GL
+#include "texture-loader.h"
+
 bool flag_fill = false;
 //--------------------------------- K I T E -----------------------------------
 
@@ -39,6 +60,7 @@ public:
     Kite (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc)
         : m_vPos_loc {vPos_loc}, m_vCol_loc {vCol_loc}, m_vNor_loc {vNor_loc}
     {
+        TRACE_SCOPE ("Kite");
         // Positions
         GLfloat positions[] = {
             0.2,  0.5,  0.2,    // 0 A
@@ -168,6 +190,7 @@ RoueNor (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc, int nb_dents, double r_
         m_ep_roue {ep_roue}
         
     {
+        TRACE_SCOPE ("RoueNor");
         std::vector<GLfloat> positions; // positions pour les 2 faces
 
 
@@ -457,9 +480,11 @@ RoueNor (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc, int nb_dents, double r_
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
+// Temps maximal consacré aux uploads de textures à chaque frame, en secondes
+const double TEXTURE_UPLOAD_BUDGET = 0.004;
+
 // En salle TP mettre à 0 si l'affichage "bave"
 const int NUM_SAMPLES = 16;
 
@@ -470,7 +495,12 @@ class MyApp
 {
     bool m_ok = false;
     float m_angle = 0.0f;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -541,13 +571,16 @@ class MyApp
     vmath::vec4 m_mousePos;  // mouse_x, mouse_y, width, height
     GLint m_mousePos_loc;
 
+    // Créé au premier appel de load_texture()
+    TextureLoader* m_texture_loader = nullptr;
+
 
     void animate()
     {
         auto frac_part = [](double x){ return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
+        double time = m_ctx.get_time();        // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a*360.0;
@@ -556,6 +589,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE ("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable (GL_DEPTH_TEST);
@@ -573,7 +607,7 @@ class MyApp
 
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         m_mousePos = {width/2.0f, height/2.0f, (float) width, (float) height};
 
         // Création des objets graphiques
@@ -586,6 +620,7 @@ class MyApp
     {
         // Destruction des objets graphiques
         delete m_kite;
+        delete m_texture_loader; m_texture_loader = nullptr;
 
         glDeleteProgram (m_program);
     }
@@ -593,11 +628,18 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         //glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
         glUseProgram (m_program);
 
+        // Remplace les textures provisoires par les images déjà décodées
+        if (m_texture_loader)
+            m_texture_loader->upload_pending (TEXTURE_UPLOAD_BUDGET);
+        m_gpu_timer.end_pass ("upload");
+
         vmath::mat4 mat_MVP;
         vmath::mat3 mat_Nor;
         set_projection (mat_MVP, mat_Nor);
@@ -615,7 +657,7 @@ class MyApp
         // glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix1);
         
         m_roue->draw ();
-
+        m_gpu_timer.end_pass ("scene");
     }
 
 
@@ -650,6 +692,7 @@ class MyApp
 
     void compile_shader (GLuint shader, const char* name)
     {
+        TRACE_SCOPE ("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader (shader);
 
@@ -671,6 +714,7 @@ class MyApp
 
     void link_program (GLuint program)
     {
+        TRACE_SCOPE ("link_program");
         std::cout << "Link program...\n";
         glLinkProgram (program);
     
@@ -718,6 +762,7 @@ class MyApp
     GLuint load_and_compile_program (const std::string vertex_shader_path, 
                                      const std::string fragment_shader_path)
     {
+        TRACE_SCOPE ("load_and_compile_program");
         std::string vertex_shader_code = load_shader_code (vertex_shader_path,
             m_default_vertex_shader_text);
         std::string fragment_shader_code = load_shader_code (fragment_shader_path,
@@ -758,34 +803,16 @@ class MyApp
     }
 
 
+    // Renvoie tout de suite une texture 1x1 provisoire ; l'image est
+    // décodée en arrière-plan puis envoyée par upload_pending()
     GLuint load_texture (const char* path)
     {
-        GLuint texture_id;
-
-        glGenTextures (1, &texture_id);
-        glBindTexture (GL_TEXTURE_2D, texture_id);
-
-        // Options de filtrage pour le mipmap
-        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        TRACE_SCOPE ("load_texture");
+        if (!m_texture_loader)
+            m_texture_loader = new TextureLoader { [this] { m_ctx.post_empty_event(); } };
 
-        // Charge l'image et génère la texture
-        int width, height, n_comp;
         std::cout << "Loading texture \"" << path << "\" ..." << std::endl;
-        unsigned char *data = stbi_load (path, &width, &height, &n_comp, 0);
-
-        if (!data) {
-            std::cout << "### Loading error: " << stbi_failure_reason() << std::endl;
-            glDeleteTextures (1, &texture_id);
-            return 0;
-        }
-
-        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, 
-            GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap (GL_TEXTURE_2D);
-        stbi_image_free (data);
-
-        return texture_id;
+        return m_texture_loader->request (path);
     }
 
 
@@ -874,7 +901,7 @@ class MyApp
             that->m_anim_flag = !that->m_anim_flag;
             if (that->m_anim_flag) {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime (0);
+                that->m_ctx.set_time (0);
             }
             break;
         case GLFW_KEY_P : {
@@ -925,7 +952,7 @@ class MyApp
         that->m_angle+= 0.2f;
         break;
         case GLFW_KEY_ESCAPE :
-            that->m_ok = false;
+            glfwSetWindowShouldClose (window, GL_TRUE);
             break;
         default: 
             return;
@@ -978,6 +1005,30 @@ class MyApp
     {
         int i = 1;
         while (i < argc) {
+            int nb_ctx_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_ctx_args < 0) return false;
+            if (nb_ctx_args > 0) {
+                i += nb_ctx_args; continue;
+            }
+            int nb_bench_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_bench_args < 0) return false;
+            if (nb_bench_args > 0) {
+                i += nb_bench_args; continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_pacer_args < 0) return false;
+            if (nb_pacer_args > 0) {
+                i += nb_pacer_args; continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_timer_args > 0) {
+                i += nb_timer_args; continue;
+            }
+            int nb_capture_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_capture_args < 0) return false;
+            if (nb_capture_args > 0) {
+                i += nb_capture_args; continue;
+            }
             if (strcmp(argv[i], "-vs") == 0 && i+1 < argc) {
                 m_vertex_shader_path = argv[i+1]; 
                 i += 2; continue;
@@ -987,7 +1038,12 @@ class MyApp
                 i += 2; continue;
             }
             if (strcmp(argv[i], "--help") == 0) {
-                std::cout << "Options: -vs vs_file -fs fs_file -ps\n";
+                std::cout << "Options: -vs vs_file -fs fs_file -ps "
+                    << GLContext::usage() << " "
+                    << FrameBench::usage() << " "
+                    << FramePacer::usage() << " "
+                    << GpuTimer::usage() << " "
+                    << FrameCapture::usage() << "\n";
                 return false;
             }
             if (strcmp(argv[i], "-ps") == 0) {
@@ -1008,81 +1064,104 @@ public:
 
     MyApp (int argc, char* argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "Rendu de lumière";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback (on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint (GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 3);
-        //glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "Rendu de lumière", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetCursorPosCallback (m_window, on_mouse_func);
-        glfwSetKeyCallback (m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetCursorPosCallback (m_window, on_mouse_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL(); 
+        gladLoadGLLoader (GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
             << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
 
         initGL();
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_bench.enabled()) return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
+                m_pacer.wait (m_ctx);
                 animate();
             }
-            else glfwWaitEvents();
+            // Des images décodées n'ont pas tenu dans le budget de la frame
+            else if (m_texture_loader && m_texture_loader->has_decoded())
+                m_ctx.poll_events();
+            else m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
         if (m_ok) tearGL();
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
     }
 
 }; // MyApp
@@ -1091,6 +1170,6 @@ public:
 int main(int argc, char* argv[]) 
 {
     MyApp app {argc, argv};
-    app.run();
+    return app.run();
 }
 
@@ -24,6 +24,24 @@
 
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 // Pour charger des images avec le module stb_image
 #include "stb_image.h"
 
@@ -42,6 +60,7 @@ public:
         : m_vPos_loc {vPos_loc}, m_vCol_loc {vCol_loc}, m_vNor_loc {vNor_loc},
           m_phong {phong}
     {
+        TRACE_SCOPE ("Kite");
         // Positions
         GLfloat positions[] = {
             0.2,  0.5,  0.2,    // 0 A
@@ -175,6 +194,7 @@ public:
     m_coul_b {coul_b},
     m_flag_lissage {flag_lissage},
     m_nb_etapes(nb_etapes){
+        TRACE_SCOPE ("Sphere");
 
         
         std::vector<GLfloat> vertices;
@@ -291,7 +311,6 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
 // En salle TP mettre à 0 si l'affichage "bave"
@@ -303,7 +322,12 @@ enum CamProj { P_ORTHO, P_FRUSTUM, P_MAX };
 class MyApp
 {
     bool m_ok = false;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -401,7 +425,7 @@ class MyApp
         auto frac_part = [](double x){ return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
+        double time = m_ctx.get_time();        // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a*360.0;
@@ -410,6 +434,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE ("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable (GL_DEPTH_TEST);
@@ -428,7 +453,7 @@ class MyApp
 
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         m_mousePos = {width/2.0f, height/2.0f, (float) width, (float) height};
 
         // Création des objets graphiques
@@ -451,8 +476,10 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         //glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
         glUseProgram (m_program);
 
@@ -473,6 +500,7 @@ class MyApp
         }else{
             m_sphere2->draw ();
         }
+        m_gpu_timer.end_pass ("scene");
     }
 
 
@@ -508,6 +536,7 @@ class MyApp
 
     void compile_shader (GLuint shader, const char* name)
     {
+        TRACE_SCOPE ("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader (shader);
 
@@ -529,6 +558,7 @@ class MyApp
 
     void link_program (GLuint program)
     {
+        TRACE_SCOPE ("link_program");
         std::cout << "Link program...\n";
         glLinkProgram (program);
     
@@ -576,6 +606,7 @@ class MyApp
     GLuint load_and_compile_program (const std::string vertex_shader_path, 
                                      const std::string fragment_shader_path)
     {
+        TRACE_SCOPE ("load_and_compile_program");
         std::string vertex_shader_code = load_shader_code (vertex_shader_path,
             m_default_vertex_shader_text);
         std::string fragment_shader_code = load_shader_code (fragment_shader_path,
@@ -618,6 +649,7 @@ class MyApp
 
     GLuint load_texture (const char* path)
     {
+        TRACE_SCOPE ("load_texture");
         GLuint texture_id;
 
         glGenTextures (1, &texture_id);
@@ -638,8 +670,19 @@ class MyApp
             return 0;
         }
 
-        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, 
+        // Format selon le nombre de composantes ; les niveaux de gris sont
+        // étendus par swizzle, et les lignes ne sont pas forcément alignées
+        GLenum format = n_comp == 1 ? GL_RED : n_comp == 2 ? GL_RG :
+                        n_comp == 3 ? GL_RGB : GL_RGBA;
+        if (n_comp <= 2) {
+            GLint swizzle[4] = { GL_RED, GL_RED, GL_RED,
+                                 n_comp == 2 ? GL_GREEN : GL_ONE };
+            glTexParameteriv (GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D (GL_TEXTURE_2D, 0, format, width, height, 0, format,
             GL_UNSIGNED_BYTE, data);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
         glGenerateMipmap (GL_TEXTURE_2D);
         stbi_image_free (data);
 
@@ -732,7 +775,7 @@ class MyApp
             that->m_anim_flag = !that->m_anim_flag;
             if (that->m_anim_flag) {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime (0);
+                that->m_ctx.set_time (0);
             }
             break;
         case GLFW_KEY_P : {
@@ -780,7 +823,7 @@ class MyApp
             print_help ();
             break;
         case GLFW_KEY_ESCAPE :
-            that->m_ok = false;
+            glfwSetWindowShouldClose (window, GL_TRUE);
             break;
 
         case GLFW_KEY_L :
@@ -838,6 +881,30 @@ class MyApp
     {
         int i = 1;
         while (i < argc) {
+            int nb_ctx_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_ctx_args < 0) return false;
+            if (nb_ctx_args > 0) {
+                i += nb_ctx_args; continue;
+            }
+            int nb_bench_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_bench_args < 0) return false;
+            if (nb_bench_args > 0) {
+                i += nb_bench_args; continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_pacer_args < 0) return false;
+            if (nb_pacer_args > 0) {
+                i += nb_pacer_args; continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_timer_args > 0) {
+                i += nb_timer_args; continue;
+            }
+            int nb_capture_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_capture_args < 0) return false;
+            if (nb_capture_args > 0) {
+                i += nb_capture_args; continue;
+            }
             if (strcmp(argv[i], "-vs") == 0 && i+1 < argc) {
                 m_vertex_shader_path = argv[i+1]; 
                 i += 2; continue;
@@ -847,7 +914,12 @@ class MyApp
                 i += 2; continue;
             }
             if (strcmp(argv[i], "--help") == 0) {
-                std::cout << "Options: -vs vs_file -fs fs_file -ps\n";
+                std::cout << "Options: -vs vs_file -fs fs_file -ps "
+                    << GLContext::usage() << " "
+                    << FrameBench::usage() << " "
+                    << FramePacer::usage() << " "
+                    << GpuTimer::usage() << " "
+                    << FrameCapture::usage() << "\n";
                 return false;
             }
             if (strcmp(argv[i], "-ps") == 0) {
@@ -868,81 +940,101 @@ public:
 
     MyApp (int argc, char* argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "Spéculaire";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback (on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint (GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 3);
-        //glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "Spéculaire", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetCursorPosCallback (m_window, on_mouse_func);
-        glfwSetKeyCallback (m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetCursorPosCallback (m_window, on_mouse_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL(); 
+        gladLoadGLLoader (GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
             << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
 
         initGL();
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_bench.enabled()) return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
+                m_pacer.wait (m_ctx);
                 animate();
             }
-            else glfwWaitEvents();
+            else m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
         if (m_ok) tearGL();
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
     }
 
 }; // MyApp
@@ -951,5 +1043,5 @@ public:
 int main(int argc, char* argv[]) 
 {
     MyApp app {argc, argv};
-    app.run();
+    return app.run();
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+/*
+    Trajet d'une chaîne autour de deux pignons, paramétré par l'abscisse
+    curviligne
+
+    Le trajet est une boucle fermée parcourue dans le sens trigonométrique :
+    arc sur la roue 1, brin inférieur, arc sur la roue 2, brin supérieur.
+    Les brins sont les tangentes extérieures communes aux deux cercles. La
+    table m_pieces garde, pour chacune des quatre pièces, son abscisse de
+    départ et ce qu'il faut pour y placer un point sans recherche.
+
+    place() pose nb maillons à pas constant length() / nb, le premier à
+    l'abscisse s0 : faire avancer s0 de r1 * angle de la roue 1 (en
+    radians) fait tourner la chaîne avec elle. Les abscisses croissent avec
+    le maillon, on passe donc d'une pièce à la suivante sans revenir en
+    arrière : le coût est constant par maillon, quelle que soit la longueur
+    de la chaîne. place_parallel() répartit les maillons entre les threads
+    d'un ThreadPool (thread-pool.h) fourni par l'appelant, quand il y en a
+    assez pour amortir la répartition.
+
+    Chaque maillon est une vmath::Affine dans le plan des roues (z = 0) :
+    rotation selon la tangente au trajet (l'axe x du maillon suit la
+    chaîne) puis translation au point du trajet. table() exporte les
+    pièces pour refaire le même calcul dans un shader.
+*/
+
+#ifndef CHAIN_PATH_H
+#define CHAIN_PATH_H
+
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <mutex>
+
+#include "thread-pool.h"
+#include "vmath-xform.h"
+
+class ChainPath
+{
+public:
+    // Au-dessous, place_parallel() reste sur le thread appelant
+    static const int PARALLEL_MIN = 16384;
+
+    // Roues de centres (x1, y1) et (x2, y2) et de rayons r1 et r2 ; elles
+    // ne doivent pas se contenir : distance des centres > |r1 - r2|
+    ChainPath (float x1, float y1, float r1, float x2, float y2, float r2)
+    {
+        double dx = x2 - x1, dy = y2 - y1;
+        double d = std::sqrt (dx * dx + dy * dy);
+        double ux = dx / d, uy = dy / d;
+
+        // Normale aux brins : cos theta = (r1 - r2) / d par rapport à l'axe
+        // des centres, de part et d'autre
+        double cos_t = (r1 - r2) / d, sin_t = std::sqrt (1 - cos_t * cos_t);
+        double theta = std::acos (cos_t);
+        double axis = std::atan2 (uy, ux);
+        double nx_up = cos_t * ux - sin_t * uy, ny_up = cos_t * uy + sin_t * ux;
+        double nx_low = cos_t * ux + sin_t * uy, ny_low = cos_t * uy - sin_t * ux;
+
+        double straight = std::sqrt (d * d - (r1 - r2) * (r1 - r2));
+
+        // Roue 1 : de la normale supérieure à l'inférieure par l'arrière
+        add_arc (x1, y1, r1, axis + theta, 2 * M_PI - 2 * theta);
+        add_segment (x1 + r1 * nx_low, y1 + r1 * ny_low,
+                     x2 + r2 * nx_low, y2 + r2 * ny_low, straight);
+        // Roue 2 : de la normale inférieure à la supérieure par l'avant
+        add_arc (x2, y2, r2, axis - theta, 2 * theta);
+        add_segment (x2 + r2 * nx_up, y2 + r2 * ny_up,
+                     x1 + r1 * nx_up, y1 + r1 * ny_up, straight);
+    }
+
+    double length() const { return m_length; }
+
+    // out[k] = maillon first + k pour k < count, sur nb maillons en tout
+    void place (double s0, int nb, int first, int count, vmath::Affine* out) const
+    {
+        double pitch = m_length / nb;
+
+        // Tours entiers retirés des abscisses, et pièce du premier maillon
+        double start = s0 + first * pitch;
+        double turns = std::floor (start / m_length) * m_length;
+        int p = find_piece (start - turns);
+
+        for (int k = 0; k < count; k++) {
+            // Abscisse recalculée depuis s0, sans cumuler d'erreur
+            double s = s0 + (first + k) * pitch - turns;
+            while (s >= m_pieces[p].s_end) {
+                if (++p == NB_PIECES) {
+                    p = 0;
+                    s -= m_length;
+                    turns += m_length;
+                }
+            }
+            put (m_pieces[p], s - m_pieces[p].s_start, out[k]);
+        }
+    }
+
+    // out[k] = maillon k pour k < nb ; pool peut être nul
+    void place_parallel (double s0, int nb, vmath::Affine* out,
+        ThreadPool* pool) const
+    {
+        int nb_threads = pool ? pool->size() + 1 : 1;
+        if (nb < PARALLEL_MIN || nb_threads <= 1) {
+            place (s0, nb, 0, nb, out);
+            return;
+        }
+
+        // Une tranche contiguë par thread, la première sur celui-ci
+        std::mutex mutex;
+        std::condition_variable done;
+        int chunk = (nb + nb_threads - 1) / nb_threads;
+        int nb_pending = (nb + chunk - 1) / chunk - 1;
+        for (int first = chunk; first < nb; first += chunk) {
+            int count = std::min (chunk, nb - first);
+            pool->submit ([&, s0, nb, first, count, out] {
+                place (s0, nb, first, count, out + first);
+                std::lock_guard<std::mutex> lock (mutex);
+                if (--nb_pending == 0) done.notify_one();
+            });
+        }
+        place (s0, nb, 0, std::min (chunk, nb), out);
+
+        std::unique_lock<std::mutex> lock (mutex);
+        done.wait (lock, [&] { return nb_pending == 0; });
+    }
+
+    static const int NB_PIECES = 4;
+
+    // Table des pièces pour un shader, 8 flottants par pièce :
+    // (s_start, s_end, x, y) puis (r, a0, dx, dy), r = 0 pour un segment
+    void table (float out[NB_PIECES][8]) const
+    {
+        for (int i = 0; i < NB_PIECES; i++) {
+            const Piece& p = m_pieces[i];
+            const double v[8] = { p.s_start, p.s_end, p.x, p.y,
+                                  p.r, p.a0, p.dx, p.dy };
+            for (int k = 0; k < 8; k++) out[i][k] = float (v[k]);
+        }
+    }
+
+private:
+    enum PieceKind { ARC, SEGMENT };
+
+    struct Piece
+    {
+        PieceKind kind;
+        double s_start, s_end;
+        // ARC : centre (x, y), rayon r, angle de départ a0
+        // SEGMENT : départ (x, y), direction unitaire (dx, dy)
+        double x, y, r, a0, dx, dy;
+    };
+
+    Piece m_pieces[NB_PIECES];
+    int m_nb_pieces = 0;
+    double m_length = 0;
+
+    void add_arc (double x, double y, double r, double a0, double angle)
+    {
+        Piece& p = m_pieces[m_nb_pieces++];
+        p.kind = ARC;
+        p.s_start = m_length;
+        p.s_end = m_length += r * angle;
+        p.x = x; p.y = y; p.r = r; p.a0 = a0;
+        p.dx = p.dy = 0;
+    }
+
+    void add_segment (double x1, double y1, double x2, double y2, double len)
+    {
+        Piece& p = m_pieces[m_nb_pieces++];
+        p.kind = SEGMENT;
+        p.s_start = m_length;
+        p.s_end = m_length += len;
+        p.x = x1; p.y = y1; p.r = 0; p.a0 = 0;
+        p.dx = (x2 - x1) / len; p.dy = (y2 - y1) / len;
+    }
+
+    int find_piece (double s) const
+    {
+        int p = 0;
+        while (p < NB_PIECES - 1 && s >= m_pieces[p].s_end) p++;
+        return p;
+    }
+
+    // Maillon à l'abscisse u sur la pièce p, axe x selon la tangente
+    static void put (const Piece& p, double u, vmath::Affine& out)
+    {
+        double x, y, c, s;
+        if (p.kind == ARC) {
+            double a = p.a0 + u / p.r;
+            double ca = std::cos (a), sa = std::sin (a);
+            x = p.x + p.r * ca;
+            y = p.y + p.r * sa;
+            c = -sa;
+            s = ca;
+        } else {
+            x = p.x + u * p.dx;
+            y = p.y + u * p.dy;
+            c = p.dx;
+            s = p.dy;
+        }
+        out = vmath::Translation (float (x), float (y), 0.f);
+        out.m[0][0] = float (c);   out.m[0][1] = float (s);
+        out.m[1][0] = float (-s);  out.m[1][1] = float (c);
+    }
+};
+
+#endif // CHAIN_PATH_H
@@ -22,11 +22,50 @@
 // + ajout de calculs dans vmath-et.h
 #include "vmath-et.h"
 
+// Translations, rotations... composées sans passer par des mat4 complètes
+#include "vmath-xform.h"
+
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 // Pour charger des images avec le module stb_image
 #include "stb_image.h"
 
+// Décodage des textures sur un pool de threads, upload sur le thread GL
+#include "texture-loader.h"
+
+// Hiérarchie des pièces du pédalier, matrices monde recalculées au besoin
+#include "scene-graph.h"
+
+// Sommets des pièces de forme fixe, calculés à la compilation
+#include "static-mesh.h"
+
+// Simulation à pas fixe sur son propre thread, interpolée à l'affichage
+#include "sim-loop.h"
+
+// Trajet de la chaîne autour du plateau et du pignon
+#include "chain-path.h"
+
+// Enregistrement des sessions et relecture image par image
+#include "replay.h"
+
 
 bool flag_fill = false;
 
@@ -60,6 +99,89 @@ struct UBO_Uniforms {
 const GLint UBO_BINDING_POINT = 0;
 
 
+//--------------------------------- P O S E S ---------------------------------
+
+// Pièces dont les programmes pose-color et pose-diffuse calculent la
+// matrice monde ; une ligne par appel de dessin, choisie par l'uniform part
+enum PosePart {
+    PART_PLATEAU, PART_PIGNON,
+    PART_MANIVELLE, PART_MANIVELLE_LIEN, PART_MANIVELLE_PEDALE,
+    PART_PEDALE, PART_MAILLON_1, PART_MAILLON_2,
+    NB_POSE_PARTS
+};
+
+// Code GLSL commun aux programmes de pose. D'une image à l'autre seuls
+// alpha et animAngle changent ; les tables, constantes, sont envoyées
+// une fois par MyApp::upload_pose_tables(). Pour la pièce part :
+//   partParams    centre de la roue sur x, tours par tour du plateau,
+//                 contre-rotation (pédales), 1 pour un maillon de chaîne
+//   partInstance  pose de l'instance gl_InstanceID (devant, derrière)
+//                 sur sa roue
+//   partSub       sous-transformation constante (Manivelle, Maillon)
+// Pour la chaîne, gl_InstanceID est le numéro du maillon, placé comme
+// par ChainPath::place() avec la table de ChainPath::table().
+// NB_PARTS vaut NB_POSE_PARTS.
+#define POSE_GLSL \
+    "const int NB_PARTS = 8;\n" \
+    "uniform float alpha;\n" \
+    "uniform float animAngle;\n" \
+    "uniform int part;\n" \
+    "uniform vec4 partParams[NB_PARTS];\n" \
+    "uniform mat4 partInstance[2 * NB_PARTS];\n" \
+    "uniform mat4 partSub[NB_PARTS];\n" \
+    "uniform vec4 chainPieces[8];\n" \
+    "uniform vec2 chainParams;    // nombre de maillons, rayon du plateau\n" \
+    "\n" \
+    "// Angle en degrés, axe non normalisé comme vmath::rotate\n" \
+    "mat4 axis_rotation (float deg, vec3 v)\n" \
+    "{\n" \
+    "    float a = radians (deg), c = cos (a), s = sin (a), omc = 1.0 - c;\n" \
+    "    return mat4 (\n" \
+    "        v.x*v.x*omc + c, v.y*v.x*omc + v.z*s, v.x*v.z*omc - v.y*s, 0.0,\n" \
+    "        v.x*v.y*omc - v.z*s, v.y*v.y*omc + c, v.y*v.z*omc + v.x*s, 0.0,\n" \
+    "        v.x*v.z*omc + v.y*s, v.y*v.z*omc - v.x*s, v.z*v.z*omc + c, 0.0,\n" \
+    "        0.0, 0.0, 0.0, 1.0);\n" \
+    "}\n" \
+    "\n" \
+    "mat4 pose_2d (vec2 pos, vec2 dir)\n" \
+    "{\n" \
+    "    return mat4 (dir.x, dir.y, 0.0, 0.0,  -dir.y, dir.x, 0.0, 0.0,\n" \
+    "                 0.0, 0.0, 1.0, 0.0,  pos.x, pos.y, 0.0, 1.0);\n" \
+    "}\n" \
+    "\n" \
+    "mat4 chain_link (int k)\n" \
+    "{\n" \
+    "    float len = chainPieces[6].y;\n" \
+    "    float s = mod (radians (alpha) * chainParams.y\n" \
+    "                   + float (k) * len / chainParams.x, len);\n" \
+    "    int p = 0;\n" \
+    "    while (p < 3 && s >= chainPieces[2*p].y) p++;\n" \
+    "    vec4 a = chainPieces[2*p], b = chainPieces[2*p + 1];\n" \
+    "    float u = s - a.x;\n" \
+    "    if (b.x > 0.0) {\n" \
+    "        float t = b.y + u / b.x;\n" \
+    "        vec2 dir = vec2 (cos (t), sin (t));\n" \
+    "        return pose_2d (a.zw + b.x * dir, vec2 (-dir.y, dir.x));\n" \
+    "    }\n" \
+    "    return pose_2d (a.zw + u * b.zw, b.zw);\n" \
+    "}\n" \
+    "\n" \
+    "mat4 part_world()\n" \
+    "{\n" \
+    "    vec4 p = partParams[part];\n" \
+    "    mat4 pose;\n" \
+    "    if (p.w > 0.0) pose = chain_link (gl_InstanceID);\n" \
+    "    else {\n" \
+    "        float r = radians (p.y * alpha), q = radians (p.z * alpha);\n" \
+    "        pose = pose_2d (vec2 (p.x, 0.0), vec2 (cos (r), sin (r)))\n" \
+    "             * partInstance[2*part + gl_InstanceID]\n" \
+    "             * pose_2d (vec2 (0.0), vec2 (cos (q), -sin (q)));\n" \
+    "    }\n" \
+    "    return axis_rotation (animAngle, vec3 (0.0, 1.0, 0.15)) * pose\n" \
+    "         * partSub[part];\n" \
+    "}\n"
+
+
 
 
 //------------------------------ R O U E ----------------------------
@@ -88,6 +210,7 @@ RoueNor (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc, int nb_dents, double r_
         m_ep_roue {ep_roue}
         
     {
+        TRACE_SCOPE ("RoueNor");
         std::vector<GLfloat> positions; // positions pour les 2 faces
 
 
@@ -394,6 +517,7 @@ public:
         : m_ep_cyl(ep_cyl), m_r_cyl(r_cyl), m_nb_fac(nb_fac),
           m_coul_r(coul_r), m_coul_v(coul_v), m_coul_b(coul_b),
           m_vPos_loc(vPos_loc), m_vCol_loc(vCol_loc) {
+        TRACE_SCOPE ("Cylindre");
         generateVerticesAndColors();
         setupBuffers();
     }
@@ -471,18 +595,18 @@ public:
         glBindVertexArray(0);
     }
 
-    void draw() {
+    void draw(int nb_instances = 1) {
         glBindVertexArray(m_VAO_id);
 
         // Dessiner la facette avant (côté -ep_cyl/2)
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, m_nb_fac + 2);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, m_nb_fac + 2, nb_instances);
 
         // Dessiner la facette arrière (côté +ep_cyl/2)
-        glDrawArrays(GL_TRIANGLE_FAN, m_nb_fac + 2, m_nb_fac + 2);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, m_nb_fac + 2, m_nb_fac + 2, nb_instances);
 
         // Dessiner les facettes latérales
-        glDrawArrays(GL_TRIANGLE_STRIP, 2 * (m_nb_fac + 2), 2 * (m_nb_fac + 1));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 2 * (m_nb_fac + 2), 2 * (m_nb_fac + 1), nb_instances);
 
         glBindVertexArray(0);
     }
@@ -492,90 +616,21 @@ public:
 //------------------------------ P E D A L E  ----------------------------
 
 class Pedale {
-    GLfloat m_larg, m_long, m_haut, m_chanf;
-    GLfloat m_coul_r, m_coul_v, m_coul_b;
     GLuint m_VAO_id, m_VBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    Pedale(GLfloat larg, GLfloat long_, GLfloat haut, GLfloat chanf, 
-           GLfloat coul_r, GLfloat coul_v, GLfloat coul_b,
-           GLint vPos_loc, GLint vCol_loc)
-        : m_larg{larg}, m_long{long_}, m_haut{haut}, m_chanf{chanf},
-          m_coul_r{coul_r}, m_coul_v{coul_v}, m_coul_b{coul_b},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
-        
-        // les positions des sommets
-        GLfloat positions[] = {
-            // Devant
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-           m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            
-            // Derriere
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-           m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-
-            //Connecter les deux:
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 1
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-        };
-
-        // structure pour les sommets
-        std::vector<GLfloat> vertices;
-        for (int i =0 ; i<16; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r);
-            vertices.push_back(m_coul_v);
-            vertices.push_back(m_coul_b);
-        }
-        for (int i =16 ; i<34; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r * 0.7);
-            vertices.push_back(m_coul_v * 0.7);
-            vertices.push_back(m_coul_b * 0.7);
-        }
-
-
+    // mesh : static_mesh::chamfered_box, calculé à la compilation
+    Pedale(const static_mesh::ChamferedBoxMesh& mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
+        TRACE_SCOPE ("Pedale");
 
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
 
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), 
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE, 
                               6 * sizeof(GLfloat), reinterpret_cast<void*>(0));
@@ -593,12 +648,12 @@ public:
         glDeleteVertexArrays(1, &m_VAO_id);
     }
 
-    void draw() {
+    void draw(int nb_instances = 1) {
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
         glBindVertexArray(m_VAO_id);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 8, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 16, 18);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 8, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 16, 18, nb_instances);
         glBindVertexArray(0);
 
 
@@ -610,92 +665,22 @@ public:
 //------------------------------ B O I T E  ----------------------------
 
 
-class Boite
-{
-    GLfloat m_larg, m_long, m_haut, m_chanf;
-    GLfloat m_coul_r, m_coul_v, m_coul_b;
+class Boite {
     GLuint m_VAO_id, m_VBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    Boite(GLfloat larg, GLfloat long_, GLfloat haut, GLfloat chanf, 
-           GLfloat coul_r, GLfloat coul_v, GLfloat coul_b,
-           GLint vPos_loc, GLint vCol_loc)
-        : m_larg{larg}, m_long{long_}, m_haut{haut}, m_chanf{chanf},
-          m_coul_r{coul_r}, m_coul_v{coul_v}, m_coul_b{coul_b},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
-        
-        // les positions des sommets
-        GLfloat positions[] = {
-            // Devant
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-           m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            
-            // Derriere
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-           m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-
-            //Connecter les deux:
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 1
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-        };
-
-        // structure pour les sommets
-        std::vector<GLfloat> vertices;
-        for (int i =0 ; i<16; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r);
-            vertices.push_back(m_coul_v);
-            vertices.push_back(m_coul_b);
-        }
-        for (int i =16 ; i<34; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r * 0.7);
-            vertices.push_back(m_coul_v * 0.7);
-            vertices.push_back(m_coul_b * 0.7);
-        }
-
-
+    // mesh : static_mesh::chamfered_box, calculé à la compilation
+    Boite(const static_mesh::ChamferedBoxMesh& mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
+        TRACE_SCOPE ("Boite");
 
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
 
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), 
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE, 
                               6 * sizeof(GLfloat), reinterpret_cast<void*>(0));
@@ -713,12 +698,12 @@ public:
         glDeleteVertexArrays(1, &m_VAO_id);
     }
 
-    void draw() {
+    void draw(int nb_instances = 1) {
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
         glBindVertexArray(m_VAO_id);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 8, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 16, 18);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 8, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 16, 18, nb_instances);
         glBindVertexArray(0);
 
 
@@ -737,14 +722,14 @@ class Maillon {
     Cylindre* m_cylindre2;
 
 public:
-    Maillon(bool is_external, GLfloat width, GLfloat height, GLfloat depth, GLfloat chanf, 
-            double ep_cyl, double r_cyl, int nb_fac, float coul_r, float coul_v, float coul_b, 
-            GLint vPos_loc, GLint vCol_loc)
+    Maillon(bool is_external, const static_mesh::ChamferedBoxMesh& boite,
+            double ep_cyl, double r_cyl, int nb_fac, GLint vPos_loc, GLint vCol_loc)
         : m_is_external{is_external}
     {
+        TRACE_SCOPE ("Maillon");
         // Instancier les deux boîtes
-        m_boite1 = new Boite(width, depth, height, chanf, coul_r, coul_v, coul_b, vPos_loc, vCol_loc);
-        m_boite2 = new Boite(width, depth, height, chanf, coul_r, coul_v, coul_b, vPos_loc, vCol_loc);
+        m_boite1 = new Boite(boite, vPos_loc, vCol_loc);
+        m_boite2 = new Boite(boite, vPos_loc, vCol_loc);
 
         // Instancier les deux cylindres seulement si le maillon est externe
         if (m_is_external) {
@@ -765,26 +750,40 @@ public:
         }
     }
 
-    void draw(vmath::mat4& mat, GLint loc) {
+    // Décalage constant des deux boîtes
+    static constexpr vmath::Translation k_boite1 {0.06f, 0.0f, 0.0f};
+    static constexpr vmath::Translation k_boite2 {-0.06f, 0.0f, 0.0f};
+
+    void draw(const vmath::mat4& mat, GLint loc) {
         // Dessiner les deux boîtes
-        vmath::mat4 mat1 = mat * vmath::translate(0.06f, 0.0f, 0.0f);
+        vmath::mat4 mat1 = mat * k_boite1;
         glUniformMatrix4fv(loc, 1, GL_FALSE, mat1);
         m_boite1->draw();
 
-        vmath::mat4 mat2 = mat * vmath::translate(-0.06f, 0.0f, 0.0f);
+        vmath::mat4 mat2 = mat * k_boite2;
         glUniformMatrix4fv(loc, 1, GL_FALSE, mat2);
         m_boite2->draw();
 
         // Dessiner les deux cylindres seulement si le maillon est externe
         if (m_is_external) {
-            vmath::mat4 mat1 = mat * vmath::translate(0.06f, 0.0f, 0.0f);
             glUniformMatrix4fv(loc, 1, GL_FALSE, mat1);
             m_cylindre1->draw();
-            vmath::mat4 mat2 = mat * vmath::translate(-0.06f, 0.0f, 0.0f);
             glUniformMatrix4fv(loc, 1, GL_FALSE, mat2);
             m_cylindre2->draw();
         }
     }
+
+    // Programmes de pose : nb maillons en un appel par forme, matrices
+    // calculées par le shader
+    void draw_posed(GLint part_loc, int nb) {
+        glUniform1i(part_loc, PART_MAILLON_1);
+        m_boite1->draw(nb);
+        if (m_is_external) m_cylindre1->draw(nb);
+
+        glUniform1i(part_loc, PART_MAILLON_2);
+        m_boite2->draw(nb);
+        if (m_is_external) m_cylindre2->draw(nb);
+    }
 };
 
 
@@ -799,6 +798,7 @@ public:
     Manivelle(float ep_cyl, float r_cyl, int nb_fac, float coul_r, float coul_v, float coul_b, 
               GLint vPos_loc, GLint vCol_loc)
     {
+        TRACE_SCOPE ("Manivelle");
         // Instancier les trois cylindres
         m_cylindreCentral = new Cylindre(ep_cyl, r_cyl, nb_fac, 0, 1, 0, vPos_loc, vCol_loc);
         m_cylindreLienAuCentre = new Cylindre(ep_cyl+0.4f, r_cyl-0.1f, nb_fac, coul_r, coul_v, coul_b, vPos_loc, vCol_loc);
@@ -811,20 +811,37 @@ public:
         delete m_cylindreAPedale;
     }
 
-    void draw(vmath::mat4& mat, GLint loc){
+    // Sous-transformations constantes, calculées à la compilation : par
+    // image il ne reste que le produit avec la matrice animée
+    static constexpr vmath::Affine k_lien_au_centre =
+        vmath::Translation(0.5f, 0.0f, 0.0f) * vmath::AxisRotation::constant(90.0f, 0.0f, 1.0f, 0.0f);
+    static constexpr vmath::Translation k_a_pedale {0.78f, 0.0f, 0.4f};
+
+    void draw(const vmath::mat4& mat, GLint loc){
         // Dessiner les deux boîtes
         m_cylindreCentral->draw();
 
-        vmath::mat4 mat1 = mat * vmath::translate(0.5f, 0.0f, 0.0f);
-        mat1 = mat1 * vmath::rotate(90.0f ,0.0f, 1.0f, 0.0f);
+        vmath::mat4 mat1 = mat * k_lien_au_centre;
         glUniformMatrix4fv(loc, 1, GL_FALSE, mat1);
         m_cylindreLienAuCentre->draw();
 
-        vmath::mat4 mat2 = mat * vmath::translate(0.78f, 0.0f, 0.4f);
+        vmath::mat4 mat2 = mat * k_a_pedale;
         glUniformMatrix4fv(loc, 1, GL_FALSE, mat2);
         m_cylindreAPedale->draw();
     }
 
+    // Programmes de pose : les nb manivelles en un appel par cylindre
+    void draw_posed(GLint part_loc, int nb){
+        glUniform1i(part_loc, PART_MANIVELLE);
+        m_cylindreCentral->draw(nb);
+
+        glUniform1i(part_loc, PART_MANIVELLE_LIEN);
+        m_cylindreLienAuCentre->draw(nb);
+
+        glUniform1i(part_loc, PART_MANIVELLE_PEDALE);
+        m_cylindreAPedale->draw(nb);
+    }
+
 
 };
 
@@ -865,7 +882,8 @@ public:
     }
 
 
-    enum ShaderCateg { C_COLOR, C_TEXTURE, C_DIFFUSE, C_SPECULAR, C_NUM };
+    enum ShaderCateg { C_COLOR, C_TEXTURE, C_DIFFUSE, C_SPECULAR,
+                       C_POSE_COLOR, C_POSE_DIFFUSE, C_NUM };
 
     static const char* get_shader_categ_name (ShaderCateg categ)
     {
@@ -874,6 +892,8 @@ public:
             case C_TEXTURE  : return "texture";
             case C_DIFFUSE  : return "diffuse";
             case C_SPECULAR : return "specular";
+            case C_POSE_COLOR   : return "pose-color";
+            case C_POSE_DIFFUSE : return "pose-diffuse";
             default : return "";
         }
     }
@@ -884,6 +904,8 @@ public:
         if (!strcmp (name, "texture")) return C_TEXTURE;
         if (!strcmp (name, "diffuse")) return C_DIFFUSE;
         if (!strcmp (name, "specular")) return C_SPECULAR;
+        if (!strcmp (name, "pose-color")) return C_POSE_COLOR;
+        if (!strcmp (name, "pose-diffuse")) return C_POSE_DIFFUSE;
         return C_NUM;
     }
 
@@ -1128,6 +1150,113 @@ public:
             "    fragColor = clamp(result, 0.0, 1.0);\n"
             "}\n",
 
+            // Geometry shader
+            ""
+        },
+
+        // C_POSE_COLOR : comme C_COLOR, matrice monde calculée (POSE_GLSL)
+        {
+            // Vertex shader
+            "#version 330\n"
+            "in vec4 vPos;\n"
+            "in vec4 vCol;\n"
+            "out VertexData {\n"
+            "    vec4 color;\n"
+            "} vd_out;\n"
+            "layout (std140) uniform Uniforms {\n"
+            "    mat4 matProj;\n"
+            "    mat4 matCam;\n"
+            "    vec4 mousePos;\n"
+            "    float time;\n"
+            "};\n"
+            POSE_GLSL
+            "\n"
+            "void main()\n"
+            "{\n"
+            "    gl_Position = matProj * matCam * part_world() * vPos;\n"
+            "    vd_out.color = vCol;\n"
+            "}\n",
+
+            // Fragment shader
+            "#version 330\n"
+            "in VertexData {\n"
+            "    vec4 color;\n"
+            "} vd_in;\n"
+            "out vec4 fragColor;\n"
+            "\n"
+            "void main()\n"
+            "{\n"
+            "    fragColor = vd_in.color;\n"
+            "}\n",
+
+            // Geometry shader
+            ""
+        },
+
+        // C_POSE_DIFFUSE : comme C_DIFFUSE, matrices monde et des normales
+        // calculées (POSE_GLSL)
+        {
+            // Vertex shader
+            "#version 330\n"
+            "in vec4 vPos;\n"
+            "in vec4 vCol;\n"
+            "in vec3 vNor;\n"
+            "out VertexData {\n"
+            "    vec4 color;\n"
+            "    vec3 normal;\n"
+            "} vd_out;\n"
+            "layout (std140) uniform Uniforms {\n"
+            "    mat4 matProj;\n"
+            "    mat4 matCam;\n"
+            "    vec4 mousePos;\n"
+            "    float time;\n"
+            "};\n"
+            POSE_GLSL
+            "\n"
+            "void main()\n"
+            "{\n"
+            "    mat4 matWorld = part_world();\n"
+            "    mat3 matNor = transpose (inverse (mat3 (matWorld)));\n"
+            "    gl_Position = matProj * matCam * matWorld * vPos;\n"
+            "    vd_out.color = vCol;\n"
+            "    vd_out.normal = matNor * vNor;\n"
+            "}\n",
+
+            // Fragment shader
+            "#version 330\n"
+            "in VertexData {\n"
+            "    vec4 color;\n"
+            "    vec3 normal;\n"
+            "} vd_in;\n"
+            "out vec4 fragColor;\n"
+            "\n"
+            "void main()\n"
+            "{\n"
+            "    // Couleur et direction de lumière, normalisée\n"
+            "    vec3 lightColor = vec3(0.8);\n"
+            "    vec3 lightDir = normalize(vec3(0.0, 0.0, 10.0));\n"
+            "\n"
+            "    // Normale du fragment, normalisée\n"
+            "    vec3 nor3 = normalize(vd_in.normal);\n"
+            "\n"
+            "    // Cosinus de l'angle entre la normale et la lumière\n"
+            "    float cosTheta = dot(nor3, lightDir);\n"
+            "\n"
+            "    // Lumière diffuse\n"
+            "    vec3 diffuse = lightColor * max(cosTheta, 0.0);\n"
+            "\n"
+            "    // Lumière ambiante\n"
+            "    vec3 ambiant = vec3(0.3);\n"
+            "\n"
+            "    // Somme des lumières\n"
+            "    vec3 sumLight = diffuse + ambiant;\n"
+            "\n"
+            "    // Couleur de l'objet éclairé\n"
+            "    vec4 result = vec4(sumLight, 1.0) * vd_in.color;\n"
+            "\n"
+            "    fragColor = clamp(result, 0.0, 1.0);\n"
+            "}\n",
+
             // Geometry shader
             ""
         }
@@ -1203,6 +1332,7 @@ public:
 
     bool compile_program()
     {
+        TRACE_SCOPE ("compile_program");
         const char* name = get_shader_categ_name(m_shader_categ);
         std::cout << "Begin compilation of " << name << " program...\n";
 
@@ -1239,6 +1369,7 @@ public:
 
     bool compile_shader (GLuint shader, const char* name)
     {
+        TRACE_SCOPE ("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader (shader);
 
@@ -1261,6 +1392,7 @@ public:
 
     bool link_program()
     {
+        TRACE_SCOPE ("link_program");
         std::cout << "Link program...\n";
         glLinkProgram (m_program);
     
@@ -1325,25 +1457,81 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
+// Pas de la simulation, indépendant de la cadence d'affichage
+const double SIM_STEP        = 1.0 / 120;
+
+// Rotation du pédalier à chaque appui sur espace, en degrés
+const float CRANK_STEP       = 0.9f;
+
+// Roues dentées : centres sur l'axe x et rayons, pas de la chaîne
+const float PLATEAU_X = -0.8f, PLATEAU_R = 0.6f;
+const float PIGNON_X  =  1.0f, PIGNON_R  = 0.2f;
+const float CHAIN_PITCH = 0.25f;
+
+// Écart toléré entre matrices calculées par les shaders de pose et par
+// le CPU (--check-poses)
+const float POSE_TOLERANCE = 1e-4f;
+
+// Temps maximal consacré aux uploads de textures à chaque frame, en secondes
+const double TEXTURE_UPLOAD_BUDGET = 0.004;
+
 // En salle TP mettre à 0 si l'affichage "bave"
 const int NUM_SAMPLES = 16;
 
 enum CamProj { P_ORTHO, P_FRUSTUM, P_MAX };
 
+// État de la mécanique, avancé par le thread de simulation
+struct PedalierState
+{
+    double anim_angle = 0;      // rotation de l'ensemble, dans [0, 360[
+    float alpha = 0;            // rotation du pédalier
+};
+
+// anim_angle fait le tour : on interpole par le plus court chemin
+PedalierState interpolate (const PedalierState& a, const PedalierState& b,
+    double t)
+{
+    double d = b.anim_angle - a.anim_angle;
+    if (d > 180) d -= 360;
+    else if (d < -180) d += 360;
+
+    PedalierState s;
+    s.anim_angle = a.anim_angle + d * t;
+    s.alpha = a.alpha + (b.alpha - a.alpha) * t;
+    return s;
+}
+
+// Tout ce qui détermine une image, enregistré par --record et imposé par
+// --replay (voir replay.h)
+struct FrameState
+{
+    float alpha, anim_angle;
+    float time;                 // uniform time des shaders
+    float cam_z, cam_r, cam_near, cam_far;
+    float mouse_pos[4];
+    int32_t width, height;
+    int32_t cam_proj, cube_color;
+    uint8_t fill, depth, phong, gpu_poses;
+};
+
 
 class MyApp
 {
     bool m_ok = false;
     float m_alpha = 0.0f;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     double m_aspect_ratio = 1.0;
-    bool m_anim_flag = false;
+    std::atomic<bool> m_anim_flag {false};
     int m_cube_color = 1;
     float m_radius = 0.5;
-    float m_anim_angle = 0,  m_start_angle = 0;
+    float m_anim_angle = 0;
     float m_cam_z, m_cam_r, m_cam_near, m_cam_far;
     bool m_depth_flag = true;
     CamProj m_cam_proj;
@@ -1357,6 +1545,33 @@ class MyApp
     Manivelle *m_manivelle_devant = nullptr;
     bool m_flag_phong = false;
 
+    // Entrées transmises au thread de simulation : appuis sur espace pas
+    // encore appliqués. m_alpha et m_anim_angle ne sont que les valeurs
+    // interpolées de la frame en cours.
+    std::atomic<int> m_crank_presses {0};
+    SimLoop<PedalierState> m_sim {SIM_STEP, PedalierState(),
+        [this] (PedalierState& s, double dt) { advance (s, dt); }};
+    // Hors animation, on redessine jusqu'à ce que la dernière entrée soit
+    // visible
+    std::chrono::steady_clock::time_point m_settle_until;
+
+    // Date de l'image en cours, relue du flux en relecture
+    float m_time = 0;
+    replay::Recorder<FrameState> m_recorder;
+    replay::Player<FrameState> m_player;
+    bool m_replaying_keys = false;      // touches venues du flux
+
+    // Noeuds de la scène ; les maillons sont placés à chaque image sur le
+    // trajet de la chaîne, dans le repère du monde
+    SceneGraph m_scene;
+    int m_node_monde, m_node_plateau, m_node_pignon;
+    int m_node_manivelle_devant, m_node_manivelle_derriere;
+    int m_node_pedale_devant, m_node_pedale_derriere;
+    ChainPath m_chain {PLATEAU_X, 0.f, PLATEAU_R, PIGNON_X, 0.f, PIGNON_R};
+    std::vector<vmath::Affine> m_maillons;
+    ThreadPool* m_chain_pool = nullptr;     // pour place_parallel()
+    vmath::mat3 m_plateau_nor, m_pignon_nor;
+
     std::string m_shader_paths[ShaderProg::C_NUM][ShaderProg::T_NUM];
     std::string m_program_categ_to_print;
 
@@ -1365,8 +1580,17 @@ class MyApp
     ShaderProg* m_prog_diffuse = nullptr;
     ShaderProg* m_prog_specular = nullptr;
 
+    // Mode où les shaders calculent les poses à partir des angles : par
+    // image, le CPU n'envoie qu'alpha et animAngle, quel que soit le
+    // nombre de maillons
+    ShaderProg* m_prog_pose_color = nullptr;
+    ShaderProg* m_prog_pose_diffuse = nullptr;
+    bool m_gpu_poses = false;
+    bool m_check_poses = false;
+
     vmath::vec4 m_mousePos;  // mouse_x, mouse_y, width, height
 
+    TextureLoader* m_texture_loader = nullptr;
     GLuint m_texture_id1, m_texture_id2;
     const char* m_texture_path1 = "side1.png";
     const char* m_texture_path2 = "side2.png";
@@ -1376,6 +1600,7 @@ class MyApp
 
     void load_programs()
     {
+        TRACE_SCOPE ("load_programs");
         m_prog_color = new ShaderProg {
             ShaderProg::C_COLOR, m_shader_paths[ShaderProg::C_COLOR] };
         m_prog_color->compile_program();
@@ -1391,6 +1616,14 @@ class MyApp
         m_prog_specular = new ShaderProg {
             ShaderProg::C_SPECULAR, m_shader_paths[ShaderProg::C_SPECULAR] };
         m_prog_specular->compile_program();
+
+        m_prog_pose_color = new ShaderProg {
+            ShaderProg::C_POSE_COLOR, m_shader_paths[ShaderProg::C_POSE_COLOR] };
+        m_prog_pose_color->compile_program();
+
+        m_prog_pose_diffuse = new ShaderProg {
+            ShaderProg::C_POSE_DIFFUSE, m_shader_paths[ShaderProg::C_POSE_DIFFUSE] };
+        m_prog_pose_diffuse->compile_program();
     }
 
 
@@ -1400,6 +1633,8 @@ class MyApp
         delete m_prog_texture;  m_prog_texture = nullptr;
         delete m_prog_diffuse;  m_prog_diffuse = nullptr;
         delete m_prog_specular; m_prog_specular = nullptr;
+        delete m_prog_pose_color;   m_prog_pose_color = nullptr;
+        delete m_prog_pose_diffuse; m_prog_pose_diffuse = nullptr;
     }
 
 
@@ -1414,6 +1649,10 @@ class MyApp
                 m_prog_diffuse->print_shaders();
             else if (categ == "specular")
                 m_prog_specular->print_shaders();
+            else if (categ == "pose-color")
+                m_prog_pose_color->print_shaders();
+            else if (categ == "pose-diffuse")
+                m_prog_pose_diffuse->print_shaders();
             else
                 std::cerr << "### Error: program " << categ 
                     << " unknown" << std::endl;
@@ -1423,6 +1662,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE ("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable (GL_DEPTH_TEST);
@@ -1432,23 +1672,31 @@ class MyApp
 
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         m_mousePos = {width/2.0f, height/2.0f, (float) width, (float) height};
 
-        // Création des textures
+        // Création des textures : le décodage se fait en arrière-plan et
+        // la boucle d'événements est réveillée à chaque image décodée
+        m_texture_loader = new TextureLoader { [this] { m_ctx.post_empty_event(); } };
         m_texture_id1 = load_texture (m_texture_path1);
         m_texture_id2 = load_texture (m_texture_path2);
 
         // Création des objets graphiques
         m_plateau = new RoueNor {VPOS_LOC, VCOL_LOC, VNOR_LOC, 30, 0.1, 0.6, 0.1, 1.0, 0, 0, 0.1};
         m_pignon = new RoueNor {VPOS_LOC, VCOL_LOC, VNOR_LOC, 10, 0.03, 0.2, 0.05, 1.0, 0, 0, 0.1};
-        m_pedale_devant = new Pedale{0.3f, 0.5f, 0.1f, 0.03, 0.0f, 0.0, 1.0, VPOS_LOC, VCOL_LOC};
-        m_pedale_derriere = new Pedale{0.3f, 0.5f, 0.1f, 0.03, 0.0f, 0.0, 1.0, VPOS_LOC, VCOL_LOC};
-        m_maillon_intern = new Maillon{false,  0.1f, 0.1f, 0.05f, 0.015f, 0.07, 0.03, 32, 1.0f, 0.0f, 0.0f, 0, 1};
-        m_maillon_extern = new Maillon{true,  0.1f, 0.1f, 0.05f, 0.015f, 0.07, 0.03, 32, 1.0f, 0.0f, 0.0f, 0, 1};
+        // Boîtes chanfreinées : sommets calculés à la compilation
+        static constexpr auto PEDALE = static_mesh::chamfered_box (0.3f, 0.5f, 0.1f, 0.03f, 0.0f, 0.0f, 1.0f);
+        static constexpr auto MAILLON = static_mesh::chamfered_box (0.1f, 0.05f, 0.1f, 0.015f, 1.0f, 0.0f, 0.0f);
+        m_pedale_devant = new Pedale{PEDALE, VPOS_LOC, VCOL_LOC};
+        m_pedale_derriere = new Pedale{PEDALE, VPOS_LOC, VCOL_LOC};
+        m_maillon_intern = new Maillon{false, MAILLON, 0.07, 0.03, 32, 0, 1};
+        m_maillon_extern = new Maillon{true, MAILLON, 0.07, 0.03, 32, 0, 1};
         m_manivelle_devant = new Manivelle{0.3f, 0.15f, 32, 1.0f, 0.0f, 0.0f, 0, 1};
         m_manivelle_derriere = new Manivelle{0.3f, 0.15f, 32, 1.0f, 0.0f, 0.0f, 0, 1};
 
+        build_scene();
+        upload_pose_tables (m_prog_pose_color);
+        upload_pose_tables (m_prog_pose_diffuse);
 
         // Création UBO avec taille réservée
         glGenBuffers (1, &m_UBO_id);
@@ -1462,7 +1710,9 @@ class MyApp
              m_prog_color->get_program(),
              m_prog_texture->get_program(),
              m_prog_diffuse->get_program(),
-             m_prog_specular->get_program()
+             m_prog_specular->get_program(),
+             m_prog_pose_color->get_program(),
+             m_prog_pose_diffuse->get_program()
         };
         for (GLuint prog : program_ids) {
             glUniformBlockBinding (prog, glGetUniformBlockIndex (prog, "Uniforms"), 
@@ -1474,30 +1724,55 @@ class MyApp
     void tearGL()
     {
         // Destruction des objets graphiques
+        delete m_texture_loader; m_texture_loader = nullptr;
+        glDeleteTextures (1, &m_texture_id1);
+        glDeleteTextures (1, &m_texture_id2);
         glDeleteBuffers (1, &m_UBO_id);
         tear_programs();
     }
 
 
+    // Un pas de simulation, sur le thread de simulation
+    void advance (PedalierState& s, double dt)
+    {
+        if (m_anim_flag) {
+            // Un tour en ANIM_DURATION secondes
+            s.anim_angle += dt / ANIM_DURATION * 360.0;
+            if (s.anim_angle >= 360.0) s.anim_angle -= 360.0;
+        }
+        for (int n = m_crank_presses.exchange (0); n > 0; n--)
+            s.alpha += CRANK_STEP;
+    }
+
+
+    // Relève l'état interpolé pour la frame à dessiner
     void animate()
     {
-        auto frac_part = [](double x){ return x - std::floor(x); };
+        PedalierState s = m_sim.sample();
+        m_anim_angle = s.anim_angle;
+        m_alpha = s.alpha;
+    }
 
-        // Change la coordonnée en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
-        double slice = time / ANIM_DURATION;
-        double a = frac_part(slice);
-        m_anim_angle = m_start_angle + a*360.0;
+
+    void wait_settle()
+    {
+        m_settle_until = std::chrono::steady_clock::now()
+            + std::chrono::duration_cast<std::chrono::steady_clock::duration> (
+                std::chrono::duration<double> (4 * SIM_STEP));
     }
 
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         //glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
-        vmath::mat4 mat_proj, mat_cam, mat_world, mat_MVP;
-        vmath::mat3 mat_Nor;
+        // Remplace les textures provisoires par les images déjà décodées
+        m_texture_loader->upload_pending (TEXTURE_UPLOAD_BUDGET);
+
+        vmath::mat4 mat_proj, mat_cam;
         set_projection (mat_proj, mat_cam);
 
         // On met les données dans le UBO
@@ -1508,10 +1783,16 @@ class MyApp
             offsetof(UBO_Uniforms, matCam), sizeof(vmath::mat4), &mat_cam);
         glBufferSubData (GL_UNIFORM_BUFFER, 
             offsetof(UBO_Uniforms, mousePos), sizeof(vmath::vec4), &m_mousePos);
-        GLfloat time_f = glfwGetTime();  // GLdouble nécessite v4.0+, mal géré
+        // GLdouble nécessite v4.0+, mal géré
         glBufferSubData (GL_UNIFORM_BUFFER, 
-            offsetof(UBO_Uniforms, time), sizeof(GLfloat), &time_f);
+            offsetof(UBO_Uniforms, time), sizeof(GLfloat), &m_time);
         glBindBuffer (GL_UNIFORM_BUFFER, 0);
+        m_gpu_timer.end_pass ("upload");
+
+        if (m_gpu_poses) {
+            display_posed();
+            return;
+        }
 
         ShaderProg* prog = nullptr;
 
@@ -1522,135 +1803,291 @@ class MyApp
         prog = m_prog_diffuse;
         prog->use_program();
 
-        mat_world = vmath::translate (0.f, 0.f, 0.f) * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f);;
+        update_scene();
+        GLint matWorld_loc = prog->get_uniform ("matWorld");
 
-        vmath::mat4 plateau_matrix =  mat_world * vmath::translate (-0.8f, 0.f, 0.f) * vmath::rotate (m_alpha, 0.f, 0.f, 1.0f);
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, plateau_matrix);
-        mat_Nor = vmath::normal (plateau_matrix);
-        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, mat_Nor);
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_plateau));
+        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, m_plateau_nor);
         m_plateau->draw();
+        m_gpu_timer.end_object ("plateau");
 
-        vmath::mat4 pignon_matrix =  mat_world * vmath::translate (1.f, 0.f, 0.f)* vmath::rotate (3 * m_alpha, 0.f, 0.f, 1.0f);
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, pignon_matrix);
-        mat_Nor = vmath::normal (pignon_matrix);
-        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, mat_Nor);
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_pignon));
+        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, m_pignon_nor);
         m_pignon->draw();
+        m_gpu_timer.end_object ("pignon");
+        m_gpu_timer.end_pass ("diffuse");
 
         prog = m_prog_color;
         prog->use_program();
+        matWorld_loc = prog->get_uniform ("matWorld");
 
-        vmath::mat4 manivelle_devant_matrix =  mat_world * vmath::translate (-0.8f, 0.f, 0.2f) * vmath::rotate (m_alpha, 0.f, 0.f, 1.0f);
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, manivelle_devant_matrix);
-        m_manivelle_devant->draw(manivelle_devant_matrix, prog->get_uniform ("matWorld"));
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_manivelle_devant));
+        m_manivelle_devant->draw (m_scene.world (m_node_manivelle_devant), matWorld_loc);
 
-        vmath::mat4 manivelle_derriere_matrix =  mat_world * vmath::translate (-0.8f, 0.f, -0.2f) * vmath::rotate(180.0f, 1.0f, 0.0f, 0.0f) * vmath::rotate(180.0f, 0.0f, 0.0f, 1.0f) * vmath::rotate (-m_alpha, 0.f, 0.f, 1.0f);
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, manivelle_derriere_matrix);
-        m_manivelle_derriere->draw(manivelle_derriere_matrix, prog->get_uniform ("matWorld"));
-
-        
-        vmath::mat4 pedale_derriere_matrix = mat_world * vmath::translate(-0.8f, 0.f, 0.f);
-        pedale_derriere_matrix = pedale_derriere_matrix * vmath::rotate(m_alpha, 0.0f, 0.0f, 1.0f);
-        pedale_derriere_matrix = pedale_derriere_matrix * vmath::translate(-0.8f, 0.f, 0.f);
-        pedale_derriere_matrix = pedale_derriere_matrix * vmath::translate(0.0f, 0.f, -1.0f);
-        pedale_derriere_matrix = pedale_derriere_matrix * vmath::rotate(-m_alpha, 0.0f, 0.0f, 1.0f);
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_manivelle_derriere));
+        m_manivelle_derriere->draw (m_scene.world (m_node_manivelle_derriere), matWorld_loc);
+        m_gpu_timer.end_object ("manivelles");
 
-        glUniformMatrix4fv(prog->get_uniform("matWorld"), 1, GL_FALSE, pedale_derriere_matrix);
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_pedale_derriere));
         m_pedale_derriere->draw();
 
-        vmath::mat4 pedale_devant_matrix = mat_world * vmath::translate(-0.8f, 0.f, 0.f);
-        pedale_devant_matrix = pedale_devant_matrix * vmath::rotate(m_alpha, 0.0f, 0.0f, 1.0f);
-        pedale_devant_matrix = pedale_devant_matrix * vmath::translate(-0.8f, 0.f, 0.f);
-        pedale_devant_matrix = pedale_devant_matrix * vmath::translate(1.6f, 0.f, 0.0f);
-        pedale_devant_matrix = pedale_devant_matrix * vmath::translate(0.0f, 0.f, 1.0f);
-        pedale_devant_matrix = pedale_devant_matrix * vmath::rotate(-m_alpha, 0.0f, 0.0f, 1.0f);
-
-        glUniformMatrix4fv(prog->get_uniform("matWorld"), 1, GL_FALSE, pedale_devant_matrix);
+        glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, m_scene.world (m_node_pedale_devant));
         m_pedale_devant->draw();
-        
+        m_gpu_timer.end_object ("pedales");
 
-        // Maillons du plateau
-        for (int i = 0; i < 8; ++i) {
-            float angle = (360.0f / 30) * ((i+3)*2) + 20 ;
-            float radian = vmath::radians(angle);
-        
-            float x = 0.6f * cos(radian);
-            float y = 0.6f * sin(radian);
-        
-            vmath::mat4 maillon_matrix = mat_world * 
-                vmath::translate(-0.8f, 0.f, 0.f) *
-                vmath::translate(x, y, 0.0f) *   
-                vmath::rotate(angle + 90.f, 0.0f, 0.0f, 1.0f); 
-        
-            m_maillon_extern->draw(maillon_matrix, prog->get_uniform("matWorld"));
-            glUniformMatrix4fv(prog->get_uniform("matWorld"), 1, GL_FALSE, maillon_matrix);
-        }
-        
+        // Maillons de la chaîne
+        const vmath::mat4& monde = m_scene.world (m_node_monde);
+        for (const vmath::Affine& maillon : m_maillons)
+            m_maillon_extern->draw (monde * maillon, matWorld_loc);
+        m_gpu_timer.end_object ("chaine");
+        m_gpu_timer.end_pass ("color");
+    }
 
-            // Maillons du pignon
-        for (int i = 0; i < 3; ++i) {
-            float angle = (360.0f / 10) * ((i-1)*2) + 20; 
-            float radian = vmath::radians(angle);
-        
-            float x = 0.2f * cos(radian);
-            float y = 0.2f * sin(radian);
-        
-            vmath::mat4 maillon_matrix = mat_world * 
-                vmath::translate(1.0f, 0.f, 0.f) * 
-                vmath::translate(x, y, 0.0f) * 
-                vmath::rotate(angle + 90.f, 0.0f, 0.0f, 1.0f); 
 
-            m_maillon_extern->draw(maillon_matrix, prog->get_uniform ("matWorld"));
-            glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, maillon_matrix);
-        }
+    // Hiérarchie : monde -> centre du plateau -> plateau -> manivelles et
+    // pédales, monde -> centre du pignon -> pignon ; les maillons sont
+    // posés sur le monde par update_scene()
+    void build_scene()
+    {
+        m_node_monde = m_scene.add();
 
-        // Dessin de chaines
-        vmath::vec3 A = vmath::vec3(-0.58f, 0.58f, 0.f);  
-        vmath::vec3 D = vmath::vec3(0.87f, 0.22f, 0.f);  
+        int plateau_centre = m_scene.add (m_node_monde);
+        m_scene.set_translation (plateau_centre, PLATEAU_X, 0.f, 0.f);
+        m_node_plateau = m_scene.add (plateau_centre);
 
-        vmath::vec3 direction = D - A;
+        m_node_manivelle_devant = m_scene.add (m_node_plateau);
+        m_scene.set_translation (m_node_manivelle_devant, 0.f, 0.f, 0.2f);
 
-        float angle = atan2(direction[1], direction[0]);  
+        m_node_manivelle_derriere = m_scene.add (m_node_plateau);
+        m_scene.set_translation (m_node_manivelle_derriere, 0.f, 0.f, -0.2f);
+        m_scene.set_rotation (m_node_manivelle_derriere,
+            vmath::AxisRotation::constant (180.0f, 1.0f, 0.0f, 0.0f) *
+            vmath::AxisRotation::constant (180.0f, 0.0f, 0.0f, 1.0f));
 
+        m_node_pedale_derriere = m_scene.add (m_node_plateau);
+        m_scene.set_translation (m_node_pedale_derriere, -0.8f, 0.f, -1.0f);
 
-        int num_maillons = 7;
+        m_node_pedale_devant = m_scene.add (m_node_plateau);
+        m_scene.set_translation (m_node_pedale_devant, 0.8f, 0.f, 1.0f);
 
+        int pignon_centre = m_scene.add (m_node_monde);
+        m_scene.set_translation (pignon_centre, PIGNON_X, 0.f, 0.f);
+        m_node_pignon = m_scene.add (pignon_centre);
 
-        for (int i = 0; i < num_maillons; ++i) {
-            float t = float(i) / float(num_maillons - 1);
-            vmath::vec3 maillon_pos = A + direction * t;  
+        // Nombre entier de maillons au pas le plus proche de CHAIN_PITCH
+        int nb_maillons = std::max (1, int (std::lround (m_chain.length() / CHAIN_PITCH)));
+        m_maillons.resize (nb_maillons);
+        // Threads créés une fois, et seulement si la chaîne est assez
+        // longue pour que place_parallel() s'en serve
+        if (nb_maillons >= ChainPath::PARALLEL_MIN && !m_chain_pool)
+            m_chain_pool = new ThreadPool;
+    }
 
-            vmath::mat4 maillon_matrix = mat_world * 
-                vmath::translate(maillon_pos[0], maillon_pos[1], maillon_pos[2]) *
-                vmath::rotate(vmath::degrees(angle), 0.0f, 0.0f, 1.0f);
+    // Seuls les noeuds animés sont modifiés ; les matrices des normales ne
+    // sont refaites que si la matrice monde a changé
+    void update_scene()
+    {
+        m_scene.set_rotation (m_node_monde, m_anim_angle, 0.f, 1.f, 0.15f);
+        m_scene.set_rotation (m_node_plateau, m_alpha, 0.f, 0.f, 1.0f);
+        m_scene.set_rotation (m_node_pignon, 3 * m_alpha, 0.f, 0.f, 1.0f);
+        m_scene.set_rotation (m_node_pedale_derriere, -m_alpha, 0.0f, 0.0f, 1.0f);
+        m_scene.set_rotation (m_node_pedale_devant, -m_alpha, 0.0f, 0.0f, 1.0f);
+        m_scene.update();
+
+        if (m_scene.world_changed (m_node_plateau))
+            m_plateau_nor = vmath::normal_matrix (m_scene.world_xform (m_node_plateau));
+        if (m_scene.world_changed (m_node_pignon))
+            m_pignon_nor = vmath::normal_matrix (m_scene.world_xform (m_node_pignon));
+
+        // La chaîne avance comme la jante du plateau
+        m_chain.place_parallel (vmath::radians (m_alpha) * PLATEAU_R,
+            m_maillons.size(), m_maillons.data(), m_chain_pool);
+    }
+
+    // Tables constantes des programmes de pose (voir POSE_GLSL) ; les
+    // poses des instances sont les transformations locales posées par
+    // build_scene(), prises avant que update_scene() ne fasse tourner les
+    // pédales
+    void upload_pose_tables (ShaderProg* prog)
+    {
+        vmath::vec4 params[NB_POSE_PARTS];
+        vmath::mat4 instances[2 * NB_POSE_PARTS], subs[NB_POSE_PARTS];
+        for (int p = 0; p < NB_POSE_PARTS; p++) {
+            params[p] = vmath::vec4 (PLATEAU_X, 1.f, 0.f, 0.f);
+            instances[2*p] = instances[2*p + 1] = subs[p] = vmath::mat4::identity();
+        }
+        params[PART_PIGNON] = vmath::vec4 (PIGNON_X, 3.f, 0.f, 0.f);
+        params[PART_PEDALE][2] = 1.f;
+        params[PART_MAILLON_1] = params[PART_MAILLON_2] = vmath::vec4 (0.f, 0.f, 0.f, 1.f);
 
-            glUniformMatrix4fv(prog->get_uniform("matWorld"), 1, GL_FALSE, maillon_matrix);
-            m_maillon_extern->draw(maillon_matrix, prog->get_uniform("matWorld"));
+        for (int p : {PART_MANIVELLE, PART_MANIVELLE_LIEN, PART_MANIVELLE_PEDALE}) {
+            instances[2*p] = m_scene.local (m_node_manivelle_devant).matrix();
+            instances[2*p + 1] = m_scene.local (m_node_manivelle_derriere).matrix();
         }
+        instances[2*PART_PEDALE] = m_scene.local (m_node_pedale_devant).matrix();
+        instances[2*PART_PEDALE + 1] = m_scene.local (m_node_pedale_derriere).matrix();
+
+        subs[PART_MANIVELLE_LIEN] = Manivelle::k_lien_au_centre.matrix();
+        subs[PART_MANIVELLE_PEDALE] = vmath::Affine (Manivelle::k_a_pedale).matrix();
+        subs[PART_MAILLON_1] = vmath::Affine (Maillon::k_boite1).matrix();
+        subs[PART_MAILLON_2] = vmath::Affine (Maillon::k_boite2).matrix();
 
+        float pieces[ChainPath::NB_PIECES][8];
+        m_chain.table (pieces);
 
-        vmath::vec3 B = vmath::vec3(-0.65f, -0.58f, 0.f); 
-        vmath::vec3 C = vmath::vec3(0.88f, -0.24f, 0.f);    
+        prog->use_program();
+        glUniform4fv (prog->get_uniform ("partParams"), NB_POSE_PARTS, params[0]);
+        glUniformMatrix4fv (prog->get_uniform ("partInstance"), 2 * NB_POSE_PARTS,
+            GL_FALSE, instances[0][0]);
+        glUniformMatrix4fv (prog->get_uniform ("partSub"), NB_POSE_PARTS,
+            GL_FALSE, subs[0][0]);
+        glUniform4fv (prog->get_uniform ("chainPieces"), 2 * ChainPath::NB_PIECES,
+            pieces[0]);
+        glUniform2f (prog->get_uniform ("chainParams"), m_maillons.size(), PLATEAU_R);
+    }
 
-        direction = C - B;
 
-        angle = atan2(direction[1], direction[0]);  
+    // Par image : deux angles par programme, puis un appel de dessin par
+    // forme ; manivelles, pédales et maillons sont instanciés
+    void display_posed()
+    {
+        ShaderProg* prog = m_prog_pose_diffuse;
+        prog->use_program();
+        glUniform1f (prog->get_uniform ("alpha"), m_alpha);
+        glUniform1f (prog->get_uniform ("animAngle"), m_anim_angle);
+        GLint part_loc = prog->get_uniform ("part");
+
+        glUniform1i (part_loc, PART_PLATEAU);
+        m_plateau->draw();
+        m_gpu_timer.end_object ("plateau");
+        glUniform1i (part_loc, PART_PIGNON);
+        m_pignon->draw();
+        m_gpu_timer.end_object ("pignon");
+        m_gpu_timer.end_pass ("diffuse");
 
-        for (int i = 0; i < num_maillons; ++i) {
-            float t = float(i) / float(num_maillons - 1);
-            vmath::vec3 maillon_pos = B + direction * t;  
+        prog = m_prog_pose_color;
+        prog->use_program();
+        glUniform1f (prog->get_uniform ("alpha"), m_alpha);
+        glUniform1f (prog->get_uniform ("animAngle"), m_anim_angle);
+        part_loc = prog->get_uniform ("part");
+
+        m_manivelle_devant->draw_posed (part_loc, 2);
+        m_gpu_timer.end_object ("manivelles");
+        glUniform1i (part_loc, PART_PEDALE);
+        m_pedale_devant->draw (2);
+        m_gpu_timer.end_object ("pedales");
+        m_maillon_extern->draw_posed (part_loc, m_maillons.size());
+        m_gpu_timer.end_object ("chaine");
+        m_gpu_timer.end_pass ("color");
+    }
+
+
+    // Compare les matrices monde du programme pose-color à celles du
+    // graphe de scène pour quelques angles. Les colonnes de part_world()
+    // sont relevées par transform feedback de gl_Position, avec matProj et
+    // matCam à l'identité et vPos = e0, e1, e2, e3.
+    bool check_poses()
+    {
+        ShaderProg prog { ShaderProg::C_POSE_COLOR,
+                          m_shader_paths[ShaderProg::C_POSE_COLOR] };
+        const char* varyings[] = { "gl_Position" };
+        glTransformFeedbackVaryings (prog.get_program(), 1, varyings,
+            GL_INTERLEAVED_ATTRIBS);
+        if (!prog.compile_program()) return false;
+        GLuint prog_id = prog.get_program();
+        glUniformBlockBinding (prog_id, glGetUniformBlockIndex (prog_id, "Uniforms"),
+            UBO_BINDING_POINT);
+        upload_pose_tables (&prog);
+
+        vmath::mat4 ident = vmath::mat4::identity();
+        glBindBuffer (GL_UNIFORM_BUFFER, m_UBO_id);
+        glBufferSubData (GL_UNIFORM_BUFFER,
+            offsetof(UBO_Uniforms, matProj), sizeof(vmath::mat4), &ident);
+        glBufferSubData (GL_UNIFORM_BUFFER,
+            offsetof(UBO_Uniforms, matCam), sizeof(vmath::mat4), &ident);
+        glBindBuffer (GL_UNIFORM_BUFFER, 0);
 
-            vmath::mat4 maillon_matrix = mat_world * 
-                vmath::translate(maillon_pos[0], maillon_pos[1], maillon_pos[2]) *
-                vmath::rotate(vmath::degrees(angle), 0.0f, 0.0f, 1.0f);
+        GLuint vao, vbo, tfo;
+        glGenVertexArrays (1, &vao);
+        glBindVertexArray (vao);
+        glGenBuffers (1, &vbo);
+        glBindBuffer (GL_ARRAY_BUFFER, vbo);
+        glBufferData (GL_ARRAY_BUFFER, sizeof(vmath::mat4), ident, GL_STATIC_DRAW);
+        glVertexAttribPointer (VPOS_LOC, 4, GL_FLOAT, GL_FALSE, 0, 0);
+        glEnableVertexAttribArray (VPOS_LOC);
+
+        int nb_max = std::max<int> (2, m_maillons.size());
+        std::vector<vmath::mat4> got (nb_max);
+        glGenBuffers (1, &tfo);
+        glBindBuffer (GL_TRANSFORM_FEEDBACK_BUFFER, tfo);
+        glBufferData (GL_TRANSFORM_FEEDBACK_BUFFER, nb_max * sizeof(vmath::mat4),
+            NULL, GL_STREAM_READ);
+        glBindBufferBase (GL_TRANSFORM_FEEDBACK_BUFFER, 0, tfo);
+        glEnable (GL_RASTERIZER_DISCARD);
+
+        // Matrice attendue pour l'instance i de la pièce p, comme displayGL()
+        const vmath::mat4& monde = m_scene.world (m_node_monde);
+        auto expected = [&] (int p, int i) -> vmath::mat4 {
+            int manivelle = i == 0 ? m_node_manivelle_devant : m_node_manivelle_derriere;
+            switch (p) {
+            case PART_PLATEAU : return m_scene.world (m_node_plateau);
+            case PART_PIGNON  : return m_scene.world (m_node_pignon);
+            case PART_MANIVELLE : return m_scene.world (manivelle);
+            case PART_MANIVELLE_LIEN :
+                return m_scene.world (manivelle) * Manivelle::k_lien_au_centre;
+            case PART_MANIVELLE_PEDALE :
+                return m_scene.world (manivelle) * Manivelle::k_a_pedale;
+            case PART_PEDALE : return m_scene.world (
+                i == 0 ? m_node_pedale_devant : m_node_pedale_derriere);
+            case PART_MAILLON_1 : return monde * m_maillons[i] * Maillon::k_boite1;
+            default : return monde * m_maillons[i] * Maillon::k_boite2;
+            }
+        };
 
-            glUniformMatrix4fv(prog->get_uniform("matWorld"), 1, GL_FALSE, maillon_matrix);
-            m_maillon_extern->draw(maillon_matrix, prog->get_uniform("matWorld"));
+        const float angles[][2] = {         // alpha, anim_angle
+            {0.f, 0.f}, {0.9f, 12.5f}, {37.8f, 90.f}, {-123.3f, 200.f},
+            {721.8f, 359.f}, {-2400.3f, 181.f} };
+        float max_err = 0;
+        for (auto& a : angles) {
+            m_alpha = a[0];
+            m_anim_angle = a[1];
+            update_scene();
+            glUniform1f (prog.get_uniform ("alpha"), m_alpha);
+            glUniform1f (prog.get_uniform ("animAngle"), m_anim_angle);
+
+            for (int p = 0; p < NB_POSE_PARTS; p++) {
+                int nb = p >= PART_MAILLON_1 ? m_maillons.size() :
+                         p >= PART_MANIVELLE ? 2 : 1;
+                glUniform1i (prog.get_uniform ("part"), p);
+                glBeginTransformFeedback (GL_POINTS);
+                glDrawArraysInstanced (GL_POINTS, 0, 4, nb);
+                glEndTransformFeedback();
+                glGetBufferSubData (GL_TRANSFORM_FEEDBACK_BUFFER, 0,
+                    nb * sizeof(vmath::mat4), got.data());
+
+                for (int i = 0; i < nb; i++) {
+                    vmath::mat4 want = expected (p, i);
+                    for (int c = 0; c < 4; c++)
+                        for (int r = 0; r < 4; r++)
+                            max_err = std::max (max_err,
+                                std::fabs (got[i][c][r] - want[c][r]));
+                }
+            }
         }
 
+        glDisable (GL_RASTERIZER_DISCARD);
+        glBindBufferBase (GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glDeleteBuffers (1, &tfo);
+        glDeleteBuffers (1, &vbo);
+        glDeleteVertexArrays (1, &vao);
 
+        bool ok = max_err <= POSE_TOLERANCE;
+        std::cout << "Poses: max error " << max_err << " on "
+            << sizeof(angles) / sizeof(angles[0]) << " angle pairs, "
+            << (ok ? "OK" : "### MISMATCH") << std::endl;
+        return ok;
+    }
 
-    
-}
 
     void set_projection (vmath::mat4& mat_proj, vmath::mat4& mat_cam)
     {
@@ -1672,34 +2109,13 @@ class MyApp
     }
 
 
+    // Renvoie tout de suite une texture 1x1 provisoire ; l'image est
+    // décodée en arrière-plan puis envoyée par upload_pending()
     GLuint load_texture (const char* path)
     {
-        GLuint texture_id;
-
-        glGenTextures (1, &texture_id);
-        glBindTexture (GL_TEXTURE_2D, texture_id);
-
-        // Options de filtrage pour le mipmap
-        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri (GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        // Charge l'image et génère la texture
-        int width, height, n_comp;
+        TRACE_SCOPE ("load_texture");
         std::cout << "Loading texture \"" << path << "\" ..." << std::endl;
-        unsigned char *data = stbi_load (path, &width, &height, &n_comp, 0);
-
-        if (!data) {
-            std::cout << "### Loading error: " << stbi_failure_reason() << std::endl;
-            glDeleteTextures (1, &texture_id);
-            return 0;
-        }
-
-        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, 
-            GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap (GL_TEXTURE_2D);
-        stbi_image_free (data);
-
-        return texture_id;
+        return m_texture_loader->request (path);
     }
 
 
@@ -1730,7 +2146,8 @@ class MyApp
     static void print_help()
     {
         std::cout << "h help  i init  a anim  p proj  zZ cam_z  rR radius  nN near  "
-                  << "fF far  dD dist  b z-buffer  c cube  u update program  o Phong"
+                  << "fF far  dD dist  b z-buffer  c cube  u update program  o Phong  "
+                  << "g GPU poses"
                   << std::endl;
     }
 
@@ -1773,10 +2190,21 @@ class MyApp
         //std::cout << __func__ << " " << key << " " << scancode << " " 
         //    << action << " " << mods << std::endl;
 
+        MyApp* that = static_cast<MyApp*>(glfwGetWindowUserPointer (window));
+        handle_key (that, key, scancode, action, mods);
+    }
+
+
+    static void handle_key (MyApp* that, int key, int scancode, int action,
+        int mods)
+    {
         // action = GLFW_PRESS ou GLFW_REPEAT ou GLFW_RELEASE
         if (action == GLFW_RELEASE) return;
 
-        MyApp* that = static_cast<MyApp*>(glfwGetWindowUserPointer (window));
+        // En relecture, le clavier est celui du flux
+        if (that->m_player.is_open() && !that->m_replaying_keys) return;
+        if (that->m_recorder.is_open())
+            that->m_recorder.key (replay::KeyEvent {key, scancode, action, mods});
 
         int trans_key = translate_qwerty_to_azerty (key, scancode);
         switch (trans_key) {
@@ -1786,10 +2214,8 @@ class MyApp
             break;
         case GLFW_KEY_A :
             that->m_anim_flag = !that->m_anim_flag;
-            if (that->m_anim_flag) {
-                that->m_start_angle = that->m_anim_angle;
-                glfwSetTime (0);
-            }
+            if (that->m_anim_flag) that->m_ctx.set_time (0);
+            that->wait_settle();
             break;
         case GLFW_KEY_P : {
             int k = static_cast<int>(that->m_cam_proj) + 1;
@@ -1829,10 +2255,16 @@ class MyApp
         case GLFW_KEY_U :
             that->tear_programs();
             that->load_programs();
+            that->upload_pose_tables (that->m_prog_pose_color);
+            that->upload_pose_tables (that->m_prog_pose_diffuse);
             break;
         case GLFW_KEY_O :
             that->m_flag_phong = !that->m_flag_phong;
             break;
+        case GLFW_KEY_G :
+            that->m_gpu_poses = !that->m_gpu_poses;
+            std::cout << "gpu_poses is " << that->m_gpu_poses << std::endl;
+            break;
         case GLFW_KEY_H :
             print_help();
             break;
@@ -1843,7 +2275,8 @@ class MyApp
         std::cout << "Flag fill is now " << (flag_fill ? "ON" : "OFF") << std::endl;
         break;
         case GLFW_KEY_SPACE:
-            that->m_alpha += 0.9f; // Incrémenter l'angle (ajustez la valeur selon la vitesse souhaitée)
+            that->m_crank_presses++;
+            that->wait_settle();
         break;
         default: 
             return;
@@ -1909,9 +2342,56 @@ class MyApp
                 m_program_categ_to_print = argv[i+1];
                 i += 2 ; continue;
             }
+            if (strcmp(argv[i], "--gpu-poses") == 0) {
+                m_gpu_poses = true;
+                i += 1; continue;
+            }
+            if (strcmp(argv[i], "--check-poses") == 0) {
+                m_check_poses = true;
+                i += 1; continue;
+            }
+            if (strcmp(argv[i], "--record") == 0 && i+1 < argc) {
+                if (!m_recorder.open (argv[i+1])) return false;
+                i += 2; continue;
+            }
+            if (strcmp(argv[i], "--replay") == 0 && i+1 < argc) {
+                if (!m_player.open (argv[i+1])) return false;
+                i += 2; continue;
+            }
+            int nb_ctx_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_ctx_args < 0) return false;
+            if (nb_ctx_args > 0) {
+                i += nb_ctx_args; continue;
+            }
+            int nb_bench_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_bench_args < 0) return false;
+            if (nb_bench_args > 0) {
+                i += nb_bench_args; continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_pacer_args < 0) return false;
+            if (nb_pacer_args > 0) {
+                i += nb_pacer_args; continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_timer_args > 0) {
+                i += nb_timer_args; continue;
+            }
+            int nb_capture_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_capture_args < 0) return false;
+            if (nb_capture_args > 0) {
+                i += nb_capture_args; continue;
+            }
             if (strcmp(argv[i], "--help") == 0) {
                 std::cout << "USAGE:\n"
-                    << "  " << argv[0] << " [-vs|-fs|-gs categ path] [-ps categ]\n"
+                    << "  " << argv[0] << " [-vs|-fs|-gs categ path] [-ps categ]"
+                    << " [--gpu-poses] [--check-poses]\n"
+                    << "  [--record file | --replay file]\n"
+                    << "  " << GLContext::usage() << "\n"
+                    << "  " << FrameBench::usage() << " "
+                    << FramePacer::usage() << "\n"
+                    << "  " << GpuTimer::usage() << "\n"
+                    << "  " << FrameCapture::usage() << "\n"
                     << "  categ: " << ShaderProg::get_usage_for_shader_categs()
                     << std::endl;
                 return false;
@@ -1927,81 +2407,199 @@ public:
 
     MyApp (int argc, char* argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "UBO";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback (on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint (GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 3);
-        //glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "UBO", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetCursorPosCallback (m_window, on_mouse_func);
-        glfwSetKeyCallback (m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetCursorPosCallback (m_window, on_mouse_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL(); 
+        gladLoadGLLoader (GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
             << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
 
         initGL();
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_check_poses) return check_poses() ? 0 : 1;
+        if (m_ok && m_player.is_open()) return run_replay();
+        if (m_ok && m_bench.enabled()) return run_bench();
+        if (m_ok) m_sim.start();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            // Date relevée avant l'échantillonnage : si elle dépasse
+            // m_settle_until, l'image montre toutes les entrées
+            bool settling = std::chrono::steady_clock::now() < m_settle_until;
+            animate();
+            m_time = m_ctx.get_time();
+            if (m_recorder.is_open()) m_recorder.frame (capture_frame());
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
+
+            // La simulation avance d'elle-même : une frame lente ou sautée
+            // ne ralentit pas l'animation
+            if (m_anim_flag || settling)
+                m_pacer.wait (m_ctx);
+            // Des images décodées n'ont pas tenu dans le budget de la frame
+            else if (m_texture_loader->has_decoded()) m_ctx.poll_events();
+            else m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_sim.start();
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_time = m_ctx.get_time();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
+        }
+        return m_bench.report() && m_ok ? 0 : 1;
+    }
 
-            if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
-                animate();
-            }
-            else glfwWaitEvents();
+    // Rejoue le flux à vitesse maximale, sans synchronisation verticale
+    // ni simulation : chaque image reprend l'état enregistré
+    int run_replay()
+    {
+        m_ctx.swap_interval (0);
+        std::vector<replay::KeyEvent> keys;
+        FrameState state;
+        long nb_frames = 0;
+        auto start = std::chrono::steady_clock::now();
+
+        while (!m_ctx.should_close() && m_player.next (keys, state)) {
+            m_replaying_keys = true;
+            for (auto& k : keys)
+                handle_key (this, k.key, k.scancode, k.action, k.mods);
+            m_replaying_keys = false;
+
+            restore_frame (state);
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
+            nb_frames++;
         }
+        glFinish();
+
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        std::cout << "Replay: " << nb_frames << " frames in "
+            << std::setprecision (3) << elapsed.count() << " s, "
+            << nb_frames / elapsed.count() << " fps" << std::endl;
+        return m_player.failed() ? 1 : 0;
     }
 
+
+    FrameState capture_frame()
+    {
+        FrameState f;
+        f.alpha = m_alpha;
+        f.anim_angle = m_anim_angle;
+        f.time = m_time;
+        f.cam_z = m_cam_z;  f.cam_r = m_cam_r;
+        f.cam_near = m_cam_near;  f.cam_far = m_cam_far;
+        for (int i = 0; i < 4; i++) f.mouse_pos[i] = m_mousePos[i];
+        m_ctx.get_size (f.width, f.height);
+        f.cam_proj = m_cam_proj;
+        f.cube_color = m_cube_color;
+        f.fill = flag_fill;
+        f.depth = m_depth_flag;
+        f.phong = m_flag_phong;
+        f.gpu_poses = m_gpu_poses;
+        return f;
+    }
+
+
+    void restore_frame (const FrameState& f)
+    {
+        m_alpha = f.alpha;
+        m_anim_angle = f.anim_angle;
+        m_time = f.time;
+        m_cam_z = f.cam_z;  m_cam_r = f.cam_r;
+        m_cam_near = f.cam_near;  m_cam_far = f.cam_far;
+        for (int i = 0; i < 4; i++) m_mousePos[i] = f.mouse_pos[i];
+        // Hors écran, la taille est celle de --headless
+        int width, height;
+        m_ctx.get_size (width, height);
+        if (m_window && (width != f.width || height != f.height)) {
+            glfwSetWindowSize (m_window, f.width, f.height);
+            set_viewport (f.width, f.height);
+        }
+        m_cam_proj = static_cast<CamProj> (f.cam_proj);
+        m_cube_color = f.cube_color;
+        flag_fill = f.fill;
+        m_depth_flag = f.depth;
+        if (m_depth_flag) glEnable (GL_DEPTH_TEST);
+        else glDisable (GL_DEPTH_TEST);
+        m_flag_phong = f.phong;
+        m_gpu_poses = f.gpu_poses;
+    }
+
+
     ~MyApp()
     {
+        m_sim.stop();
         if (m_ok) tearGL();
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
+        delete m_chain_pool;
     }
 
 }; // MyApp
@@ -2010,6 +2608,6 @@ public:
 int main(int argc, char* argv[]) 
 {
     MyApp app {argc, argv};
-    app.run();
+    return app.run();
 }
 
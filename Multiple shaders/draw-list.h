@@ -0,0 +1,250 @@
+/*
+    Listes de dessin enregistrées en parallèle : --record-threads N
+
+    Une image se fait en deux phases. Des threads de travail parcourent
+    chacun une tranche disjointe de la scène et y calculent tout ce qui ne
+    touche pas à OpenGL (matrices du monde, matrices des normales) ; ils
+    l'enregistrent dans une DrawList, une suite de paquets compacts
+    (programme, maillage, objet) dont les uniformes sont déjà rangées dans
+    un tableau de floats. Le thread GL rassemble ensuite les uniformes de
+    toutes les listes dans un seul tableau d'instances, qu'il envoie en
+    une fois, puis fait un dessin instancié par lot (programme, maillage).
+
+    Programmes et maillages sont des indices choisis par l'application ;
+    les lots sont rangés par programme puis maillage croissants, et les
+    instances d'un lot dans l'ordre des listes puis des paquets, si bien
+    que le résultat ne dépend pas du nombre de threads et que chaque
+    programme n'est activé qu'une fois. Un paquet qui porte une étiquette
+    forme un lot à lui seul, pour que GpuTimer le mesure à part.
+
+        m_recorder.start (m_crowd > 0 ? 0 : 1);     // après parse_arg()
+        m_recorder.record (nb_items, [&] (DrawList& list, int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                float* u = list.add (program, mesh, 16);
+                ...                         // 16 floats d'uniformes
+            }
+        });
+        m_recorder.gather (25);             // 25 floats par instance
+        ...                                 // envoi de m_recorder.instances()
+        for (const DrawBatch& b : m_recorder.batches())
+            ...                             // appels GL
+
+    N compte le thread GL, qui enregistre lui aussi une tranche ; 1
+    enregistre tout sur le thread GL, 0 prend un thread par coeur. Sans
+    --record-threads, start() reçoit le défaut de l'application : la
+    scène de démonstration n'a pas à démarrer de threads. Une scène de
+    moins de MIN_ITEMS_PER_PART éléments n'est pas découpée : la répartir
+    coûterait plus que de l'enregistrer.
+*/
+
+#ifndef DRAW_LIST_H
+#define DRAW_LIST_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "thread-pool.h"
+#include "trace.h"
+
+
+// Commande de dessin sans appel GL
+struct DrawPacket
+{
+    uint16_t program;       // indices de l'application
+    uint16_t mesh;
+    uint32_t uniforms;      // premier float dans DrawList::uniforms
+    uint32_t nb_floats;
+    const char* label;      // objet pour GpuTimer::end_object(), ou nullptr
+
+    uint32_t key() const { return (uint32_t) program << 16 | mesh; }
+};
+
+
+// Instances [first, first + count) de DrawRecorder::instances(), à
+// dessiner d'un appel avec le même programme et le même maillage
+struct DrawBatch
+{
+    int program;
+    int mesh;
+    int first;
+    int count;
+    const char* label;      // objet seul du lot, ou nullptr
+};
+
+
+class DrawList
+{
+public:
+    std::vector<DrawPacket> packets;
+    std::vector<float> uniforms;
+
+    // Garde la capacité : en régime établi, plus d'allocation
+    void clear()
+    {
+        packets.clear();
+        uniforms.clear();
+    }
+
+    // Ajoute un paquet ; renvoie la place de ses nb_floats uniformes
+    float* add (int program, int mesh, int nb_floats, const char* label = nullptr)
+    {
+        uint32_t offset = uniforms.size();
+        packets.push_back ({ (uint16_t) program, (uint16_t) mesh, offset,
+                             (uint32_t) nb_floats, label });
+        uniforms.resize (offset + nb_floats);
+        return uniforms.data() + offset;
+    }
+
+    void sort_by_key()
+    {
+        auto by_key = [] (const DrawPacket& a, const DrawPacket& b)
+            { return a.key() < b.key(); };
+        if (!std::is_sorted (packets.begin(), packets.end(), by_key))
+            std::stable_sort (packets.begin(), packets.end(), by_key);
+    }
+};
+
+
+class DrawRecorder
+{
+public:
+    static const int MIN_ITEMS_PER_PART = 256;
+
+    static const char* usage() { return "[--record-threads N]"; }
+
+    // Même convention que GLContext::parse_arg()
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        if (strcmp (argv[i], "--record-threads") != 0 || i+1 >= argc) return 0;
+        char* end;
+        long n = strtol (argv[i+1], &end, 10);
+        if (*end != '\0' || n < 0 || n > 256) {
+            std::cerr << "### Error: --record-threads expects a number of "
+                "threads, 0 for one per core" << std::endl;
+            return -1;
+        }
+        m_nb_threads = n;
+        return 2;
+    }
+
+    // default_threads : N en l'absence de --record-threads
+    void start (int default_threads)
+    {
+        if (m_nb_threads < 0) m_nb_threads = default_threads;
+        if (m_nb_threads != 1)
+            m_pool.reset (new ThreadPool {m_nb_threads - 1});
+        int nb_parts = m_pool ? m_pool->size() + 1 : 1;
+        m_lists.resize (nb_parts);
+        m_cursors.resize (nb_parts);
+        std::cout << "Draw lists recorded by " << nb_parts << " thread(s)"
+            << std::endl;
+    }
+
+    // Découpe [0, nb_items) en tranches contiguës ; record_part (list,
+    // begin, end) est appelée une fois par tranche, en parallèle, et
+    // record() revient quand toutes les tranches sont enregistrées
+    template <typename F>
+    void record (int nb_items, F record_part)
+    {
+        int nb_parts = std::min<int> (m_lists.size(),
+            (nb_items + MIN_ITEMS_PER_PART - 1) / MIN_ITEMS_PER_PART);
+        if (nb_parts < 1) nb_parts = 1;
+        m_nb_used = nb_parts;
+
+        auto record_one = [&, nb_items, nb_parts] (int part) {
+            TRACE_SCOPE ("record");
+            DrawList& list = m_lists[part];
+            list.clear();
+            record_part (list, int ((long) nb_items * part / nb_parts),
+                               int ((long) nb_items * (part + 1) / nb_parts));
+            list.sort_by_key();
+        };
+
+        m_nb_pending = nb_parts - 1;
+        for (int part = 1; part < nb_parts; part++)
+            m_pool->submit ([this, &record_one, part] {
+                record_one (part);
+                std::lock_guard<std::mutex> lock (m_mutex);
+                if (--m_nb_pending == 0) m_done.notify_one();
+            });
+
+        // Le thread GL enregistre la première tranche pendant ce temps
+        record_one (0);
+
+        std::unique_lock<std::mutex> lock (m_mutex);
+        m_done.wait (lock, [this] { return m_nb_pending == 0; });
+    }
+
+    // Copie les uniformes des paquets, stride floats par instance, dans
+    // instances() et découpe batches() ; sur le thread GL, après record()
+    void gather (int stride)
+    {
+        TRACE_SCOPE ("gather");
+        size_t nb_packets = 0;
+        for (int l = 0; l < m_nb_used; l++)
+            nb_packets += m_lists[l].packets.size();
+        m_instances.assign (nb_packets * stride, 0.f);
+        m_batches.clear();
+
+        std::vector<size_t>& cursor = m_cursors;
+        std::fill (cursor.begin(), cursor.begin() + m_nb_used, 0);
+        int nb = 0;
+        for (;;) {
+            // Plus petite clé restante en tête d'une liste
+            bool found = false;
+            uint32_t key = 0;
+            for (int l = 0; l < m_nb_used; l++) {
+                const DrawList& list = m_lists[l];
+                if (cursor[l] < list.packets.size()) {
+                    uint32_t k = list.packets[cursor[l]].key();
+                    if (!found || k < key) key = k;
+                    found = true;
+                }
+            }
+            if (!found) return;
+
+            DrawBatch* batch = nullptr;
+            for (int l = 0; l < m_nb_used; l++) {
+                const DrawList& list = m_lists[l];
+                size_t& c = cursor[l];
+                for (; c < list.packets.size() && list.packets[c].key() == key; c++) {
+                    const DrawPacket& p = list.packets[c];
+                    if (!batch || batch->label || p.label) {
+                        m_batches.push_back ({ p.program, p.mesh, nb, 0, p.label });
+                        batch = &m_batches.back();
+                    }
+                    memcpy (&m_instances[(size_t) nb * stride],
+                        list.uniforms.data() + p.uniforms,
+                        std::min<size_t> (p.nb_floats, stride) * sizeof(float));
+                    batch->count++;
+                    nb++;
+                }
+            }
+        }
+    }
+
+    const std::vector<float>& instances() const { return m_instances; }
+    const std::vector<DrawBatch>& batches() const { return m_batches; }
+
+private:
+    int m_nb_threads = -1;              // 0 : un par coeur, -1 : non donné
+    std::unique_ptr<ThreadPool> m_pool;
+    std::vector<DrawList> m_lists;      // une par tranche
+    int m_nb_used = 0;                  // tranches de la dernière image
+    std::vector<size_t> m_cursors;      // pour gather()
+    std::vector<float> m_instances;
+    std::vector<DrawBatch> m_batches;
+
+    std::mutex m_mutex;
+    std::condition_variable m_done;
+    int m_nb_pending = 0;
+};
+
+#endif // DRAW_LIST_H
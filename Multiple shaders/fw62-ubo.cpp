@@ -22,8 +22,38 @@
 // + ajout de calculs dans vmath-et.h
 #include "vmath-et.h"
 
+// Transformations typées ; matrice des normales sans inverse si rigide
+#include "vmath-xform.h"
+
+// Produits de mat4 différés, calculés en une passe
+#include "vmath-expr.h"
+
+// Sommets des formes fixes, calculés à la compilation
+#include "static-mesh.h"
+
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
+// Listes de dessin enregistrées en parallèle (--record-threads)
+#include "draw-list.h"
+
 // Pour charger des images avec le module stb_image
 #include "stb_image.h"
 
@@ -32,8 +62,10 @@ bool flag_fill = false;
 
 //----------------------------- L O C A T I O N S -----------------------------
 
-// Vertex attribute location imposées
-enum VA_Locations{ VPOS_LOC = 0, VCOL_LOC = 1, VNOR_LOC = 2, VTEX_LOC = 3, LAST_LOC };
+// Vertex attribute location imposées ; matWorld occupe 4 locations, une
+// par colonne, et matNor 3 : ce sont des attributs par instance
+enum VA_Locations{ VPOS_LOC = 0, VCOL_LOC = 1, VNOR_LOC = 2, VTEX_LOC = 3,
+                   IWORLD_LOC = 4, INOR_LOC = 8, LAST_LOC = 11 };
 
 const char* get_vertex_attribute_name (VA_Locations loc)
 {
@@ -42,6 +74,8 @@ const char* get_vertex_attribute_name (VA_Locations loc)
         case VCOL_LOC  : return "vCol";
         case VNOR_LOC  : return "vNor";
         case VTEX_LOC  : return "vTex";
+        case IWORLD_LOC : return "matWorld";
+        case INOR_LOC  : return "matNor";
         default : return "";
     }
 }
@@ -65,70 +99,13 @@ const GLint UBO_BINDING_POINT = 0;
 
 class WireCube
 {
-    bool m_is_white;
-    GLfloat m_radius;
     GLuint m_VAO_id, m_VBO_id, m_EBO_id;
 
 public:
-    WireCube (bool is_white, GLfloat radius)
-        : m_is_white {is_white}, m_radius {radius}
+    // mesh : static_mesh::wire_cube, calculé à la compilation
+    WireCube (const static_mesh::WireCubeMesh& mesh)
     {
-        GLfloat r = m_radius;
-
-        // Positions
-        GLfloat positions[] = {
-           -r, -r, -r,  // P0                 6 ------- 7
-            r, -r, -r,  // P1               / |       / |
-           -r,  r, -r,  // P2             /   |     /   |
-            r,  r, -r,  // P3           2 ------- 3     |
-           -r, -r,  r,  // P4           |     4 --|---- 5
-            r, -r,  r,  // P5           |   /     |   /
-           -r,  r,  r,  // P6           | /       | /
-            r,  r,  r,  // P7           0 ------- 1
-        };
-
-        // Indices : positions, couleurs
-        GLint indexes[] = {
-            0, 1,   0, 0,
-            2, 3,   0, 0,
-            4, 5,   0, 0,
-            6, 7,   0, 0,
-            0, 2,   1, 1,
-            1, 3,   1, 1,
-            4, 6,   1, 1,
-            5, 7,   1, 1,
-            0, 4,   2, 2,
-            1, 5,   2, 2,
-            2, 6,   2, 2,
-            3, 7,   2, 2
-        };
-
-        // Couleurs
-        GLfloat colors_rgb[] = {
-            1.0, 0.0, 0.0,  // C0       C1  C2
-            0.0, 1.0, 0.0,  // C1       | /
-            0.0, 0.0, 1.0   // C2       + --C0
-        };
-        GLfloat colors_white[] = {
-            1.0, 1.0, 1.0,  // C0
-            1.0, 1.0, 1.0,  // C1
-            1.0, 1.0, 1.0   // C2
-        };
-        GLfloat *colors = (is_white) ? colors_white : colors_rgb;
-
-        // Création d'une structure de données à plat
-        std::vector<GLfloat> vertices;
-        for (int i = 0; i < 12*4; i+=4) {
-            for (int j = 0; j < 3; j++)
-                vertices.push_back (positions[indexes[i+0]*3+j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back (colors[indexes[i+2]*3+j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back (positions[indexes[i+1]*3+j]);
-            for (int j = 0; j < 3; j++)
-                vertices.push_back (colors[indexes[i+3]*3+j]);
-        }
-
+        TRACE_SCOPE ("WireCube");
         // Création du VAO
         glCreateVertexArrays (1, &m_VAO_id);
         glBindVertexArray (m_VAO_id);
@@ -138,8 +115,7 @@ public:
         glBindBuffer (GL_ARRAY_BUFFER, m_VBO_id);
 
         // Copie le buffer dans la mémoire du serveur
-        glBufferData (GL_ARRAY_BUFFER, vertices.size()*sizeof(GLfloat), 
-            vertices.data(), GL_STATIC_DRAW);
+        glBufferData (GL_ARRAY_BUFFER, sizeof (mesh), mesh.data(), GL_STATIC_DRAW);
 
         // VAA associant les données à la variable vPos du shader, avec l'offset 0
         glVertexAttribPointer (VPOS_LOC, 3, GL_FLOAT, GL_FALSE, 
@@ -162,10 +138,12 @@ public:
     }
 
 
-    void draw()
+    GLuint get_VAO() const { return m_VAO_id; }
+
+    void draw (GLsizei nb_instances = 1)
     {
         glBindVertexArray(m_VAO_id);
-        glDrawArrays (GL_LINES, 0, 24);
+        glDrawArraysInstanced (GL_LINES, 0, 24, nb_instances);
         glBindVertexArray (0);
     }
 
@@ -200,6 +178,7 @@ RoueNor (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc, int nb_dents, double r_
         m_ep_roue {ep_roue}
         
     {
+        TRACE_SCOPE ("RoueNor");
         std::vector<GLfloat> positions; // positions pour les 2 faces
 
 
@@ -451,17 +430,19 @@ RoueNor (GLint vPos_loc, GLint vCol_loc, GLint vNor_loc, int nb_dents, double r_
         glDeleteVertexArrays (1, &m_VAO_id);
     }
 
-    void draw ()
+    GLuint get_VAO() const { return m_VAO_id; }
+
+    void draw (GLsizei nb_instances = 1)
     {
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
         glBindVertexArray (m_VAO_id);
-        glDrawArrays (GL_TRIANGLE_STRIP, 0, 8*m_nb_dents + 2); // dessine face 1
-        glDrawArrays (GL_TRIANGLE_STRIP, 8*m_nb_dents + 2, 2* (8*m_nb_dents + 2)); // dessine face 2
-        glDrawArrays(GL_TRIANGLE_STRIP,8*m_nb_dents + 2 + 2* (8*m_nb_dents + 2), 4 * m_nb_dents + 2); // Dessine le pourtour du trou
+        glDrawArraysInstanced (GL_TRIANGLE_STRIP, 0, 8*m_nb_dents + 2, nb_instances); // dessine face 1
+        glDrawArraysInstanced (GL_TRIANGLE_STRIP, 8*m_nb_dents + 2, 2* (8*m_nb_dents + 2), nb_instances); // dessine face 2
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP,8*m_nb_dents + 2 + 2* (8*m_nb_dents + 2), 4 * m_nb_dents + 2, nb_instances); // Dessine le pourtour du trou
 
         int offset = 2 * (8 * m_nb_dents + 2) + (4 * m_nb_dents + 2); // Offset après le pourtour du trou
         for (int i = 0; i < m_nb_dents; i++) {
-            glDrawArrays(GL_TRIANGLE_STRIP, offset + i * 16, 16); // Chaque face a 4 sommets
+            glDrawArraysInstanced(GL_TRIANGLE_STRIP, offset + i * 16, 16, nb_instances); // Chaque face a 4 sommets
         }
 
         glBindVertexArray (0);
@@ -506,6 +487,7 @@ public:
         : m_ep_cyl(ep_cyl), m_r_cyl(r_cyl), m_nb_fac(nb_fac),
           m_coul_r(coul_r), m_coul_v(coul_v), m_coul_b(coul_b),
           m_vPos_loc(vPos_loc), m_vCol_loc(vCol_loc) {
+        TRACE_SCOPE ("Cylindre");
         generateVerticesAndColors();
         setupBuffers();
     }
@@ -583,18 +565,20 @@ public:
         glBindVertexArray(0);
     }
 
-    void draw() {
+    GLuint get_VAO() const { return m_VAO_id; }
+
+    void draw(GLsizei nb_instances = 1) {
         glBindVertexArray(m_VAO_id);
 
         // Dessiner la facette avant (côté -ep_cyl/2)
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
-        glDrawArrays(GL_TRIANGLE_FAN, 0, m_nb_fac + 2);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, 0, m_nb_fac + 2, nb_instances);
 
         // Dessiner la facette arrière (côté +ep_cyl/2)
-        glDrawArrays(GL_TRIANGLE_FAN, m_nb_fac + 2, m_nb_fac + 2);
+        glDrawArraysInstanced(GL_TRIANGLE_FAN, m_nb_fac + 2, m_nb_fac + 2, nb_instances);
 
         // Dessiner les facettes latérales
-        glDrawArrays(GL_TRIANGLE_STRIP, 2 * (m_nb_fac + 2), 2 * (m_nb_fac + 1));
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 2 * (m_nb_fac + 2), 2 * (m_nb_fac + 1), nb_instances);
 
         glBindVertexArray(0);
     }
@@ -604,90 +588,21 @@ public:
 //------------------------------ P E D A L E  ----------------------------
 
 class Pedale {
-    GLfloat m_larg, m_long, m_haut, m_chanf;
-    GLfloat m_coul_r, m_coul_v, m_coul_b;
     GLuint m_VAO_id, m_VBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    Pedale(GLfloat larg, GLfloat long_, GLfloat haut, GLfloat chanf, 
-           GLfloat coul_r, GLfloat coul_v, GLfloat coul_b,
-           GLint vPos_loc, GLint vCol_loc)
-        : m_larg{larg}, m_long{long_}, m_haut{haut}, m_chanf{chanf},
-          m_coul_r{coul_r}, m_coul_v{coul_v}, m_coul_b{coul_b},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
-        
-        // les positions des sommets
-        GLfloat positions[] = {
-            // Devant
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-           m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            
-            // Derriere
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-           m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-
-            //Connecter les deux:
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 1
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-        };
-
-        // structure pour les sommets
-        std::vector<GLfloat> vertices;
-        for (int i =0 ; i<16; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r);
-            vertices.push_back(m_coul_v);
-            vertices.push_back(m_coul_b);
-        }
-        for (int i =16 ; i<34; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r * 0.7);
-            vertices.push_back(m_coul_v * 0.7);
-            vertices.push_back(m_coul_b * 0.7);
-        }
-
-
+    // mesh : static_mesh::chamfered_box, calculé à la compilation
+    Pedale(const static_mesh::ChamferedBoxMesh& mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
+        TRACE_SCOPE ("Pedale");
 
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
 
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), 
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE, 
                               6 * sizeof(GLfloat), reinterpret_cast<void*>(0));
@@ -705,12 +620,14 @@ public:
         glDeleteVertexArrays(1, &m_VAO_id);
     }
 
-    void draw() {
+    GLuint get_VAO() const { return m_VAO_id; }
+
+    void draw(GLsizei nb_instances = 1) {
         glPolygonMode (GL_FRONT_AND_BACK, flag_fill ? GL_FILL : GL_LINE);
         glBindVertexArray(m_VAO_id);
-        glDrawArrays(GL_TRIANGLE_STRIP, 0, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 8, 8);
-        glDrawArrays(GL_TRIANGLE_STRIP, 16, 18);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 8, 8, nb_instances);
+        glDrawArraysInstanced(GL_TRIANGLE_STRIP, 16, 18, nb_instances);
         glBindVertexArray(0);
 
 
@@ -724,159 +641,39 @@ public:
 
 class Boite
 {
-    GLfloat m_width, m_height, m_depth;
     GLuint m_VAO_id, m_VBO_id, m_EBO_id;
 
 public:
-    Boite(GLfloat width, GLfloat height, GLfloat depth)
-        : m_width{width}, m_height{height}, m_depth{depth}
+    // mesh : static_mesh::box_with_normals, calculé à la compilation
+    Boite(const static_mesh::BoxWithNormalsMesh& mesh)
     {
-        
-        GLfloat halfWidth = m_width / 2.0f;
-        GLfloat halfHeight = m_height / 2.0f;
-        GLfloat halfDepth = m_depth / 2.0f;
-
-       
-        GLfloat positions[] = {
-            // Face avant
-            -halfWidth, -halfHeight,  halfDepth,  // 0
-             halfWidth, -halfHeight,  halfDepth,  // 1
-             halfWidth,  halfHeight,  halfDepth,  // 2
-            -halfWidth,  halfHeight,  halfDepth,  // 3
-
-            // Face arrière
-            -halfWidth, -halfHeight, -halfDepth,  // 4
-             halfWidth, -halfHeight, -halfDepth,  // 5
-             halfWidth,  halfHeight, -halfDepth,  // 6
-            -halfWidth,  halfHeight, -halfDepth,  // 7
-
-            // Face gauche
-            -halfWidth, -halfHeight, -halfDepth,  // 8
-            -halfWidth, -halfHeight,  halfDepth,  // 9
-            -halfWidth,  halfHeight,  halfDepth,  // 10
-            -halfWidth,  halfHeight, -halfDepth,  // 11
-
-            // Face droite
-             halfWidth, -halfHeight, -halfDepth,  // 12
-             halfWidth, -halfHeight,  halfDepth,  // 13
-             halfWidth,  halfHeight,  halfDepth,  // 14
-             halfWidth,  halfHeight, -halfDepth,  // 15
-
-            // Face supérieure
-            -halfWidth,  halfHeight,  halfDepth,  // 16
-             halfWidth,  halfHeight,  halfDepth,  // 17
-             halfWidth,  halfHeight, -halfDepth,  // 18
-            -halfWidth,  halfHeight, -halfDepth,  // 19
-
-            // Face inférieure
-            -halfWidth, -halfHeight,  halfDepth,  // 20
-             halfWidth, -halfHeight,  halfDepth,  // 21
-             halfWidth, -halfHeight, -halfDepth,  // 22
-            -halfWidth, -halfHeight, -halfDepth   // 23
-        };
-
-        
-        GLuint indices[] = {
-            // Face avant
-            0, 1, 2,  0, 2, 3,
-
-            // Face arrière
-            5, 4, 7,  5, 7, 6,
-
-            // Face gauche
-            8, 9, 10,  8, 10, 11,
-
-            // Face droite
-            12, 13, 14,  12, 14, 15,
-
-            // Face supérieure
-            16, 17, 18,  16, 18, 19,
-
-            // Face inférieure
-            20, 21, 22,  20, 22, 23
-        };
-
-    
-        GLfloat normals[] = {
-            // Face avant
-            0.0f, 0.0f, 1.0f,
-            0.0f, 0.0f, 1.0f,
-            0.0f, 0.0f, 1.0f,
-            0.0f, 0.0f, 1.0f,
-
-            // Face arrière
-            0.0f, 0.0f, -1.0f,
-            0.0f, 0.0f, -1.0f,
-            0.0f, 0.0f, -1.0f,
-            0.0f, 0.0f, -1.0f,
-
-            // Face gauche
-            -1.0f, 0.0f, 0.0f,
-            -1.0f, 0.0f, 0.0f,
-            -1.0f, 0.0f, 0.0f,
-            -1.0f, 0.0f, 0.0f,
-
-            // Face droite
-            1.0f, 0.0f, 0.0f,
-            1.0f, 0.0f, 0.0f,
-            1.0f, 0.0f, 0.0f,
-            1.0f, 0.0f, 0.0f,
-
-            // Face supérieure
-            0.0f, 1.0f, 0.0f,
-            0.0f, 1.0f, 0.0f,
-            0.0f, 1.0f, 0.0f,
-            0.0f, 1.0f, 0.0f,
-
-            // Face inférieure
-            0.0f, -1.0f, 0.0f,
-            0.0f, -1.0f, 0.0f,
-            0.0f, -1.0f, 0.0f,
-            0.0f, -1.0f, 0.0f
-        };
-
-        
-        std::vector<GLfloat> vertices;
-        for (int i = 0; i < 24; ++i) {
-            // Ajouter les positions
-            vertices.push_back(positions[i * 3]);
-            vertices.push_back(positions[i * 3 + 1]);
-            vertices.push_back(positions[i * 3 + 2]);
-
-            vertices.push_back(0.0f);
-            vertices.push_back(1.0f);
-            vertices.push_back(0.0f);
-
-            // Ajouter les normales
-            vertices.push_back(normals[i * 3]);
-            vertices.push_back(normals[i * 3 + 1]);
-            vertices.push_back(normals[i * 3 + 2]);
-        }
+        TRACE_SCOPE ("Boite");
+        static constexpr auto indices = static_mesh::box_with_normals_indices();
 
         // Création du VAO
         glGenVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
 
-        // Création du VBO pour les positions, normales et couleurs
+        // Création du VBO pour les positions, couleurs et normales
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         // Création de l'EBO pour les indices
         glGenBuffers(1, &m_EBO_id);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_EBO_id);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices.data(), GL_STATIC_DRAW);
 
         // Configuration des attributs de vertex
         // Positions (location = 0)
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void*)0);
         glEnableVertexAttribArray(0);
 
-        // Normales (location = 1)
+        // Couleurs (location = 1)
         glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
         glEnableVertexAttribArray(1);
 
-        // Couleurs (location = 2)
+        // Normales (location = 2)
         glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, 9 * sizeof(GLfloat), (void*)(6 * sizeof(GLfloat)));
         glEnableVertexAttribArray(2);
 
@@ -891,10 +688,12 @@ public:
         glDeleteVertexArrays(1, &m_VAO_id);
     }
 
-    void draw()
+    GLuint get_VAO() const { return m_VAO_id; }
+
+    void draw(GLsizei nb_instances = 1)
     {
         glBindVertexArray(m_VAO_id);
-        glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+        glDrawElementsInstanced(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0, nb_instances);
         glBindVertexArray(0);
     }
 };
@@ -992,7 +791,7 @@ public:
             "    vec4 mousePos;\n"
             "    float time;\n"
             "};\n"
-            "uniform mat4 matWorld;\n"
+            "in mat4 matWorld;\n"
             "\n"
             "void main()\n"
             "{\n"
@@ -1031,7 +830,7 @@ public:
             "    vec4 mousePos;\n"
             "    float time;\n"
             "};\n"
-            "uniform mat4 matWorld;\n"
+            "in mat4 matWorld;\n"
             "\n"
             "void main()\n"
             "{\n"
@@ -1073,8 +872,8 @@ public:
             "    vec4 mousePos;\n"
             "    float time;\n"
             "};\n"
-            "uniform mat4 matWorld;\n"
-            "uniform mat3 matNor;\n"
+            "in mat4 matWorld;\n"
+            "in mat3 matNor;\n"
             "\n"
             "void main()\n"
             "{\n"
@@ -1140,8 +939,8 @@ public:
             "    vec4 mousePos;\n"
             "    float time;\n"
             "};\n"
-            "uniform mat4 matWorld;\n"
-            "uniform mat3 matNor;\n"
+            "in mat4 matWorld;\n"
+            "in mat3 matNor;\n"
             "\n"
             "void main()\n"
             "{\n"
@@ -1262,7 +1061,7 @@ public:
             loc = static_cast<VA_Locations>((int)loc+1))
         {
             const char* name = get_vertex_attribute_name (loc);
-            if (!name) continue;
+            if (!name || !*name) continue;
             glBindAttribLocation (m_program, loc, name);
         }
     }
@@ -1276,6 +1075,7 @@ public:
 
     bool compile_program()
     {
+        TRACE_SCOPE ("compile_program");
         const char* name = get_shader_categ_name(m_shader_categ);
         std::cout << "Begin compilation of " << name << " program...\n";
 
@@ -1312,6 +1112,7 @@ public:
 
     bool compile_shader (GLuint shader, const char* name)
     {
+        TRACE_SCOPE ("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader (shader);
 
@@ -1334,6 +1135,7 @@ public:
 
     bool link_program()
     {
+        TRACE_SCOPE ("link_program");
         std::cout << "Link program...\n";
         glLinkProgram (m_program);
     
@@ -1398,7 +1200,6 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
 // En salle TP mettre à 0 si l'affichage "bave"
@@ -1407,10 +1208,42 @@ const int NUM_SAMPLES = 16;
 enum CamProj { P_ORTHO, P_FRUSTUM, P_MAX };
 
 
+// Objets de la scène : les cinq de la démo, ou une grille N x N (--crowd N)
+enum ActorKind { A_CUBE, A_CYLINDRE, A_PEDALE, A_BOITE, A_ROUE, A_NUM };
+
+struct Actor {
+    ActorKind kind;
+    GLfloat x, y, scale;
+    GLfloat phase;          // décalage de l'angle d'animation, en degrés
+    const char* label;      // objet mesuré par GpuTimer, ou nullptr
+};
+
+// Maillages des paquets de dessin
+enum MeshId { M_WIRE_CUBE_WHITE, M_WIRE_CUBE_RGB, M_CYLINDRE, M_PEDALE,
+              M_BOITE, M_ROUE };
+
+// Uniformes d'un paquet : matWorld, puis matNor pour les programmes éclairés ;
+// une instance en réserve toujours la place des deux
+const int UNI_WORLD = sizeof(vmath::mat4) / sizeof(GLfloat);
+const int UNI_NOR   = sizeof(vmath::mat3) / sizeof(GLfloat);
+const int INSTANCE_FLOATS = UNI_WORLD + UNI_NOR;
+
+bool categ_has_normals (int categ)
+{
+    return categ == ShaderProg::C_DIFFUSE || categ == ShaderProg::C_SPECULAR;
+}
+
+
 class MyApp
 {
     bool m_ok = false;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    DrawRecorder m_recorder;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -1426,6 +1259,8 @@ class MyApp
     RoueNor* m_roue = nullptr;
     Pedale* m_pedale = nullptr;
     bool m_flag_phong = false;
+    int m_crowd = 0;                    // côté de la grille, 0 sans foule
+    std::vector<Actor> m_actors;
 
     std::string m_shader_paths[ShaderProg::C_NUM][ShaderProg::T_NUM];
     std::string m_program_categ_to_print;
@@ -1442,10 +1277,12 @@ class MyApp
     const char* m_texture_path2 = "side2.png";
 
     GLuint m_UBO_id;
+    GLuint m_instance_VBO_id;           // matrices de l'image, par instance
 
 
     void load_programs()
     {
+        TRACE_SCOPE ("load_programs");
         m_prog_color = new ShaderProg {
             ShaderProg::C_COLOR, m_shader_paths[ShaderProg::C_COLOR] };
         m_prog_color->compile_program();
@@ -1493,6 +1330,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE ("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable (GL_DEPTH_TEST);
@@ -1502,7 +1340,7 @@ class MyApp
 
         // Init position de la souris au milieu de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         m_mousePos = {width/2.0f, height/2.0f, (float) width, (float) height};
 
         // Création des textures
@@ -1510,12 +1348,21 @@ class MyApp
         m_texture_id2 = load_texture (m_texture_path2);
 
         // Création des objets graphiques
-        m_wire_cube_white = new WireCube {true,  0.3};
-        m_wire_cube_rgb   = new WireCube {false, 0.3};
+        // Formes fixes : sommets calculés à la compilation
+        static constexpr auto WIRE_CUBE_WHITE = static_mesh::wire_cube (0.3f, true);
+        static constexpr auto WIRE_CUBE_RGB = static_mesh::wire_cube (0.3f, false);
+        static constexpr auto BOITE = static_mesh::box_with_normals (0.5f, 0.8f, 0.5f, 0.0f, 1.0f, 0.0f);
+        static constexpr auto PEDALE = static_mesh::chamfered_box (0.5f, 0.7f, 0.3f, 0.03f, 0.0f, 0.0f, 1.0f);
+        m_wire_cube_white = new WireCube {WIRE_CUBE_WHITE};
+        m_wire_cube_rgb   = new WireCube {WIRE_CUBE_RGB};
         m_roue = new RoueNor {VPOS_LOC, VCOL_LOC, VNOR_LOC, 10, 0.2, 0.4, 0.1, 1.0, 0, 0, 0.2};
-        m_boite = new Boite{0.5f, 0.8f, 0.5f};
+        m_boite = new Boite{BOITE};
         m_cylindre = new Cylindre{0.3f, 0.5, 36, 1.0f, 0.0f, 0.0f, VPOS_LOC, VCOL_LOC};
-        m_pedale = new Pedale{0.5f, 0.7f, 0.3f, 0.03, 0.0f, 0.0, 1.0, VPOS_LOC, VCOL_LOC};
+        m_pedale = new Pedale{PEDALE, VPOS_LOC, VCOL_LOC};
+        init_actors();
+
+        // Matrices des instances, renvoyées à chaque image
+        glGenBuffers (1, &m_instance_VBO_id);
 
         // Création UBO avec taille réservée
         glGenBuffers (1, &m_UBO_id);
@@ -1544,6 +1391,7 @@ class MyApp
         delete m_wire_cube_white;
         delete m_wire_cube_rgb;
         glDeleteBuffers (1, &m_UBO_id);
+        glDeleteBuffers (1, &m_instance_VBO_id);
         tear_programs();
     }
 
@@ -1553,7 +1401,7 @@ class MyApp
         auto frac_part = [](double x){ return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
+        double time = m_ctx.get_time();        // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a*360.0;
@@ -1562,11 +1410,12 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         //glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
-        vmath::mat4 mat_proj, mat_cam, mat_world, mat_MVP;
-        vmath::mat3 mat_Nor;
+        vmath::mat4 mat_proj, mat_cam;
         set_projection (mat_proj, mat_cam);
 
         // On met les données dans le UBO
@@ -1577,86 +1426,186 @@ class MyApp
             offsetof(UBO_Uniforms, matCam), sizeof(vmath::mat4), &mat_cam);
         glBufferSubData (GL_UNIFORM_BUFFER, 
             offsetof(UBO_Uniforms, mousePos), sizeof(vmath::vec4), &m_mousePos);
-        GLfloat time_f = glfwGetTime();  // GLdouble nécessite v4.0+, mal géré
+        GLfloat time_f = m_ctx.get_time();  // GLdouble nécessite v4.0+, mal géré
         glBufferSubData (GL_UNIFORM_BUFFER, 
             offsetof(UBO_Uniforms, time), sizeof(GLfloat), &time_f);
         glBindBuffer (GL_UNIFORM_BUFFER, 0);
+        m_gpu_timer.end_pass ("ubo");
+
+        // Phase 1 : matrices de chaque objet, enregistrées en parallèle
+        m_recorder.record (m_actors.size(),
+            [this] (DrawList& list, int begin, int end) {
+                for (int i = begin; i < end; i++)
+                    record_actor (list, m_actors[i]);
+            });
+
+        // Phase 2 : sur le thread GL, un seul envoi des matrices de toutes
+        // les instances, puis un dessin instancié par programme et maillage
+        m_recorder.gather (INSTANCE_FLOATS);
+        const std::vector<GLfloat>& instances = m_recorder.instances();
+        glBindBuffer (GL_ARRAY_BUFFER, m_instance_VBO_id);
+        glBufferData (GL_ARRAY_BUFFER, instances.size() * sizeof(GLfloat),
+            instances.data(), GL_STREAM_DRAW);
+
+        ShaderProg* progs[ShaderProg::C_NUM] = {
+            m_prog_color, m_prog_texture, m_prog_diffuse, m_prog_specular };
+        int categ = -1;
+        GLint matWorld_loc = -1, matNor_loc = -1;
+
+        for (const DrawBatch& batch : m_recorder.batches()) {
+            if (batch.program != categ) {
+                if (categ >= 0)
+                    m_gpu_timer.end_pass (ShaderProg::get_shader_categ_name (
+                        static_cast<ShaderProg::ShaderCateg>(categ)));
+                categ = batch.program;
+                ShaderProg* prog = progs[categ];
+                prog->use_program();
+                matWorld_loc = prog->get_uniform ("matWorld");
+                matNor_loc = prog->get_uniform ("matNor");
+            }
+            bind_instances (batch.mesh, batch.first);
+            if (matWorld_loc < 0)
+                draw_mesh (batch.mesh, batch.count);
+            else {
+                // Shader chargé par -vs qui déclare encore uniform mat4
+                // matWorld : un dessin par instance
+                for (int i = batch.first; i < batch.first + batch.count; i++) {
+                    const GLfloat* uniforms = &instances[(size_t) i * INSTANCE_FLOATS];
+                    glUniformMatrix4fv (matWorld_loc, 1, GL_FALSE, uniforms);
+                    if (categ_has_normals (categ))
+                        glUniformMatrix3fv (matNor_loc, 1, GL_FALSE, uniforms + UNI_WORLD);
+                    draw_mesh (batch.mesh, 1);
+                }
+            }
+            if (batch.label) m_gpu_timer.end_object (batch.label);
+        }
+        if (categ >= 0)
+            m_gpu_timer.end_pass (ShaderProg::get_shader_categ_name (
+                static_cast<ShaderProg::ShaderCateg>(categ)));
+        glBindBuffer (GL_ARRAY_BUFFER, 0);
+    }
 
-        ShaderProg* prog = nullptr;
-
-
-
-        // -------- Centre -----------
-
-        prog = m_prog_color;
-        prog->use_program();
-        
-        mat_world = vmath::translate (0.f, 0.f, 0.f) * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f);;
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, mat_world);
-
-        if (m_cube_color == 1)
-            m_wire_cube_white->draw();
-        else if (m_cube_color == 2)
-            m_wire_cube_rgb->draw();
-
-        //-------- En haut à gauche --------
-
-        prog = m_prog_color;
-        prog->use_program();
-
-        mat_world = vmath::translate (-0.8f, +0.7f, 0.f)
-                    * vmath::scale (0.7f)
-                    * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f);
-
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, mat_world);
-
-        m_cylindre->draw();
-
-        //-------- En haut à droite --------
-
-        prog = m_prog_color;
-        prog->use_program();
-
-        mat_world = vmath::translate (0.8f, +0.7f, 0.f)
-                    * vmath::scale (0.7f)
-                    * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f);
 
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, mat_world);
+    void init_actors()
+    {
+        m_actors.clear();
+        if (m_crowd <= 0) {
+            // Au centre, puis en haut à gauche, en haut à droite,
+            // en bas à gauche, en bas à droite
+            m_actors = {
+                { A_CUBE,       0.0f,  0.0f, 1.0f, 0.0f, "cube" },
+                { A_CYLINDRE,  -0.8f, +0.7f, 0.7f, 0.0f, "cylindre" },
+                { A_PEDALE,     0.8f, +0.7f, 0.7f, 0.0f, "pedale" },
+                { A_BOITE,     -0.8f, -0.7f, 0.9f, 0.0f, "boite" },
+                { A_ROUE,       0.8f, -0.7f, 0.9f, 0.0f, "roue" } };
+            return;
+        }
 
-        m_pedale->draw ();
+        // Foule : formes et phases alternées ; trop d'objets pour
+        // les mesurer un à un, seules les passes le sont
+        GLfloat cell = 2.4f / m_crowd;
+        for (int j = 0; j < m_crowd; j++)
+        for (int i = 0; i < m_crowd; i++) {
+            int k = j * m_crowd + i;
+            m_actors.push_back ({ static_cast<ActorKind>((i + 2 * j) % A_NUM),
+                -1.2f + (i + 0.5f) * cell, -1.2f + (j + 0.5f) * cell,
+                0.45f * cell, (k * 37) % 360 * 1.0f, nullptr });
+        }
+        std::cout << "Crowd of " << m_actors.size() << " objects" << std::endl;
+    }
 
-        //-------- En bas à gauche --------
 
-        prog = m_prog_diffuse;
-        prog->use_program();
+    // Sans appel GL : appelée en parallèle par les threads d'enregistrement
+    void record_actor (DrawList& list, const Actor& actor) const
+    {
+        GLfloat angle = m_anim_angle + actor.phase;
+        int categ, mesh;
+
+        switch (actor.kind) {
+        case A_CUBE :
+            if (m_cube_color == 1) mesh = M_WIRE_CUBE_WHITE;
+            else if (m_cube_color == 2) mesh = M_WIRE_CUBE_RGB;
+            else return;
+            categ = ShaderProg::C_COLOR;
+            break;
+        case A_CYLINDRE : mesh = M_CYLINDRE; categ = ShaderProg::C_COLOR; break;
+        case A_PEDALE :   mesh = M_PEDALE;   categ = ShaderProg::C_COLOR; break;
+        case A_BOITE :    mesh = M_BOITE;    categ = ShaderProg::C_DIFFUSE; break;
+        case A_ROUE :     mesh = M_ROUE;     categ = ShaderProg::C_SPECULAR; break;
+        default : return;
+        }
 
-        mat_world = vmath::translate (-0.8f, -0.7f, 0.f)
-                    * vmath::scale (0.9f)
-                    * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f)
-                    * vmath::rotate (-20.0f, 1.f, 0.f, 0.f);
-        mat_Nor = vmath::normal (mat_world);
+        if (!categ_has_normals (categ)) {
+            vmath::mat4 mat_world = vmath::chain (vmath::translate (actor.x, actor.y, 0.f))
+                                    * vmath::scale (actor.scale)
+                                    * vmath::rotate (angle, 0.f, 1.f, 0.15f);
+            GLfloat* uniforms = list.add (categ, mesh, UNI_WORLD, actor.label);
+            memcpy (uniforms, &mat_world, sizeof(mat_world));
+            return;
+        }
 
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, mat_world);
-        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, mat_Nor);
+        vmath::Affine xf_world = vmath::Translation (actor.x, actor.y, 0.f)
+                                 * vmath::UniformScale (actor.scale)
+                                 * vmath::AxisRotation (angle, 0.f, 1.f, 0.15f)
+                                 * vmath::AxisRotation (-20.0f, 1.f, 0.f, 0.f);
+        vmath::mat4 mat_world = xf_world.matrix();
+        vmath::mat3 mat_Nor = vmath::normal_matrix (xf_world);
 
-        m_boite->draw();
+        GLfloat* uniforms = list.add (categ, mesh, UNI_WORLD + UNI_NOR, actor.label);
+        memcpy (uniforms, &mat_world, sizeof(mat_world));
+        memcpy (uniforms + UNI_WORLD, &mat_Nor, sizeof(mat_Nor));
+    }
 
-        //-------- En bas à droite --------
 
-        prog = m_prog_specular;
-        prog->use_program();
+    void draw_mesh (int mesh, GLsizei nb_instances)
+    {
+        switch (mesh) {
+        case M_WIRE_CUBE_WHITE : m_wire_cube_white->draw (nb_instances); break;
+        case M_WIRE_CUBE_RGB :   m_wire_cube_rgb->draw (nb_instances); break;
+        case M_CYLINDRE :        m_cylindre->draw (nb_instances); break;
+        case M_PEDALE :          m_pedale->draw (nb_instances); break;
+        case M_BOITE :           m_boite->draw (nb_instances); break;
+        case M_ROUE :            m_roue->draw (nb_instances); break;
+        default : ;
+        }
+    }
 
-        mat_world = vmath::translate (0.8f, -0.7f, 0.f)
-                    * vmath::scale (0.9f)
-                    * vmath::rotate (m_anim_angle, 0.f, 1.f, 0.15f)
-                    * vmath::rotate (-20.0f, 1.f, 0.f, 0.f);
-        mat_Nor = vmath::normal (mat_world);
 
-        glUniformMatrix4fv (prog->get_uniform ("matWorld"), 1, GL_FALSE, mat_world);
-        glUniformMatrix3fv (prog->get_uniform ("matNor"), 1, GL_FALSE, mat_Nor);
+    GLuint get_mesh_VAO (int mesh)
+    {
+        switch (mesh) {
+        case M_WIRE_CUBE_WHITE : return m_wire_cube_white->get_VAO();
+        case M_WIRE_CUBE_RGB :   return m_wire_cube_rgb->get_VAO();
+        case M_CYLINDRE :        return m_cylindre->get_VAO();
+        case M_PEDALE :          return m_pedale->get_VAO();
+        case M_BOITE :           return m_boite->get_VAO();
+        case M_ROUE :            return m_roue->get_VAO();
+        default : return 0;
+        }
+    }
 
-        m_roue->draw();
 
+    // Fait lire matWorld et matNor au VAO du maillage, une fois par
+    // instance, dans m_instance_VBO_id (lié) à partir de l'instance first
+    void bind_instances (int mesh, int first)
+    {
+        const GLsizei stride = INSTANCE_FLOATS * sizeof(GLfloat);
+        const size_t base = (size_t) first * stride;
+
+        glBindVertexArray (get_mesh_VAO (mesh));
+        for (int c = 0; c < 4; c++) {
+            glVertexAttribPointer (IWORLD_LOC + c, 4, GL_FLOAT, GL_FALSE, stride,
+                reinterpret_cast<void*>(base + 4*c*sizeof(GLfloat)));
+            glVertexAttribDivisor (IWORLD_LOC + c, 1);
+            glEnableVertexAttribArray (IWORLD_LOC + c);
+        }
+        for (int c = 0; c < 3; c++) {
+            glVertexAttribPointer (INOR_LOC + c, 3, GL_FLOAT, GL_FALSE, stride,
+                reinterpret_cast<void*>(base + (UNI_WORLD + 3*c)*sizeof(GLfloat)));
+            glVertexAttribDivisor (INOR_LOC + c, 1);
+            glEnableVertexAttribArray (INOR_LOC + c);
+        }
+        glBindVertexArray (0);
     }
 
 
@@ -1682,6 +1631,7 @@ class MyApp
 
     GLuint load_texture (const char* path)
     {
+        TRACE_SCOPE ("load_texture");
         GLuint texture_id;
 
         glGenTextures (1, &texture_id);
@@ -1702,8 +1652,19 @@ class MyApp
             return 0;
         }
 
-        glTexImage2D (GL_TEXTURE_2D, 0, GL_RGB, width, height, 0, GL_RGB, 
+        // Format selon le nombre de composantes ; les niveaux de gris sont
+        // étendus par swizzle, et les lignes ne sont pas forcément alignées
+        GLenum format = n_comp == 1 ? GL_RED : n_comp == 2 ? GL_RG :
+                        n_comp == 3 ? GL_RGB : GL_RGBA;
+        if (n_comp <= 2) {
+            GLint swizzle[4] = { GL_RED, GL_RED, GL_RED,
+                                 n_comp == 2 ? GL_GREEN : GL_ONE };
+            glTexParameteriv (GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D (GL_TEXTURE_2D, 0, format, width, height, 0, format,
             GL_UNSIGNED_BYTE, data);
+        glPixelStorei (GL_UNPACK_ALIGNMENT, 4);
         glGenerateMipmap (GL_TEXTURE_2D);
         stbi_image_free (data);
 
@@ -1796,7 +1757,7 @@ class MyApp
             that->m_anim_flag = !that->m_anim_flag;
             if (that->m_anim_flag) {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime (0);
+                that->m_ctx.set_time (0);
             }
             break;
         case GLFW_KEY_P : {
@@ -1845,7 +1806,7 @@ class MyApp
             print_help();
             break;
         case GLFW_KEY_ESCAPE :
-            that->m_ok = false;
+            glfwSetWindowShouldClose (window, GL_TRUE);
             break;
         default: 
             return;
@@ -1898,6 +1859,35 @@ class MyApp
     {
         int i = 1;
         while (i < argc) {
+            int nb_ctx_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_ctx_args < 0) return false;
+            if (nb_ctx_args > 0) {
+                i += nb_ctx_args; continue;
+            }
+            int nb_bench_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_bench_args < 0) return false;
+            if (nb_bench_args > 0) {
+                i += nb_bench_args; continue;
+            }
+            int nb_pacer_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_pacer_args < 0) return false;
+            if (nb_pacer_args > 0) {
+                i += nb_pacer_args; continue;
+            }
+            int nb_timer_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_timer_args > 0) {
+                i += nb_timer_args; continue;
+            }
+            int nb_capture_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_capture_args < 0) return false;
+            if (nb_capture_args > 0) {
+                i += nb_capture_args; continue;
+            }
+            int nb_recorder_args = m_recorder.parse_arg (argc, argv, i);
+            if (nb_recorder_args < 0) return false;
+            if (nb_recorder_args > 0) {
+                i += nb_recorder_args; continue;
+            }
 
             auto type = ShaderProg::get_shader_type_from_argv (argv[i]);
             if (type != ShaderProg::T_NUM && i+1 < argc) {
@@ -1911,9 +1901,23 @@ class MyApp
                 m_program_categ_to_print = argv[i+1];
                 i += 2 ; continue;
             }
+            if (strcmp(argv[i], "--crowd") == 0 && i+1 < argc) {
+                m_crowd = atoi (argv[i+1]);
+                if (m_crowd < 0 || m_crowd > 1000) {
+                    std::cerr << "### Error: --crowd expects a grid side "
+                        "from 0 to 1000" << std::endl;
+                    return false;
+                }
+                i += 2 ; continue;
+            }
             if (strcmp(argv[i], "--help") == 0) {
                 std::cout << "USAGE:\n"
                     << "  " << argv[0] << " [-vs|-fs|-gs categ path] [-ps categ]\n"
+                    << "  " << GLContext::usage() << "\n"
+                    << "  " << FrameBench::usage() << " " << FramePacer::usage() << "\n"
+                    << "  " << GpuTimer::usage() << "\n"
+                    << "  " << FrameCapture::usage() << "\n"
+                    << "  [--crowd N] " << DrawRecorder::usage() << "\n"
                     << "  categ: " << ShaderProg::get_usage_for_shader_categs()
                     << std::endl;
                 return false;
@@ -1929,81 +1933,103 @@ public:
 
     MyApp (int argc, char* argv[])
     {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "UBO";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
         if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
-        }
         glfwSetErrorCallback (on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint (GLFW_SAMPLES, NUM_SAMPLES);
-
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 3);
-        //glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
-
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "UBO", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetCursorPosCallback (m_window, on_mouse_func);
-        glfwSetKeyCallback (m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetCursorPosCallback (m_window, on_mouse_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
+        // La scène de démonstration s'enregistre sur le thread GL
+        m_recorder.start (m_crowd > 0 ? 0 : 1);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL(); 
+        gladLoadGLLoader (GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
             << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
 
         initGL();
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_bench.enabled()) return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
+                m_pacer.wait (m_ctx);
                 animate();
             }
-            else glfwWaitEvents();
+            else m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
         if (m_ok) tearGL();
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
     }
 
 }; // MyApp
@@ -2012,6 +2038,6 @@ public:
 int main(int argc, char* argv[]) 
 {
     MyApp app {argc, argv};
-    app.run();
+    return app.run();
 }
 
@@ -0,0 +1,511 @@
+/*
+    Contexte OpenGL : fenêtre GLFW ou rendu hors écran sans fenêtre
+
+    En mode fenêtre, GLContext se contente de créer la fenêtre GLFW et de
+    relayer les appels à GLFW. En mode hors écran (option --headless WxH),
+    il n'ouvre aucune fenêtre et ne touche pas à GLFW : le contexte est
+    créé par EGL sur la plateforme EGL_MESA_platform_surfaceless (Mesa
+    llvmpipe sur un serveur sans écran, par exemple), et l'application
+    dessine dans un FBO de la taille demandée, multi-échantillonné si
+    samples > 0. swap_buffers() résout le FBO et compte les images ;
+    should_close() devient vrai après nb_frames images, et la dernière peut
+    être enregistrée en PPM (--dump).
+
+    L'application passe par GLContext pour tout ce qui dépend de la
+    fenêtre : taille, date, échange des tampons, attente des événements.
+    initGL(), displayGL() et tearGL() sont les mêmes dans les deux modes ;
+    les callbacks GLFW ne sont installés que s'il y a une fenêtre.
+
+        GLContext m_ctx;
+        m_ctx.config().title = "Demo";      // avant m_ctx.parse_arg()
+        ...
+        if (!m_ctx.create()) return;
+        gladLoadGLLoader (GLContext::get_proc_address);
+
+    À inclure après l'en-tête GL (glad.h ou GL/gl.h) ; édition de liens
+    avec -lEGL.
+*/
+
+#ifndef GL_CONTEXT_H
+#define GL_CONTEXT_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <GLFW/glfw3.h>
+
+// Sans les en-têtes X11, qui définissent des macros comme None ou Bool
+#define EGL_NO_X11
+#define MESA_EGL_NO_X11_HEADERS
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "trace.h"
+
+
+class GLContext
+{
+public:
+    enum Profile { PROFILE_ANY, PROFILE_CORE, PROFILE_COMPAT };
+
+    struct Config
+    {
+        const char* title = "OpenGL";
+        int width = 640, height = 480;
+        int samples = 0;
+        int major = 0, minor = 0;       // 0 : version par défaut
+        Profile profile = PROFILE_ANY;
+        bool headless = false;
+        long nb_frames = 100;           // hors écran : images avant la fin
+        std::string dump_path;          // hors écran : dernière image en PPM
+    };
+
+    static const char* usage()
+    {
+        return "[--headless WxH] [--samples N] [--frames N] [--dump file.ppm]";
+    }
+
+private:
+    // Fonctions GL du FBO, prises par eglGetProcAddress : l'en-tête n'a
+    // besoin ni de glad ni de glext.h
+    typedef void (*GenFn) (GLsizei, GLuint*);
+    typedef void (*DeleteFn) (GLsizei, const GLuint*);
+    typedef void (*BindFn) (GLenum, GLuint);
+    typedef void (*StorageFn) (GLenum, GLsizei, GLenum, GLsizei, GLsizei);
+    typedef void (*AttachFn) (GLenum, GLenum, GLenum, GLuint);
+    typedef GLenum (*StatusFn) (GLenum);
+    typedef void (*BlitFn) (GLint, GLint, GLint, GLint, GLint, GLint, GLint,
+                            GLint, GLbitfield, GLenum);
+    typedef void (*PixelStoreFn) (GLenum, GLint);
+    typedef void (*ReadPixelsFn) (GLint, GLint, GLsizei, GLsizei, GLenum,
+                                  GLenum, void*);
+    typedef void (*FinishFn) ();
+    typedef void (*GetIntegerFn) (GLenum, GLint*);
+
+    struct FboFunctions
+    {
+        GenFn gen_framebuffers, gen_renderbuffers;
+        DeleteFn delete_framebuffers, delete_renderbuffers;
+        BindFn bind_framebuffer, bind_renderbuffer;
+        StorageFn renderbuffer_storage_multisample;
+        AttachFn framebuffer_renderbuffer;
+        StatusFn check_framebuffer_status;
+        BlitFn blit_framebuffer;
+        PixelStoreFn pixel_store;
+        ReadPixelsFn read_pixels;
+        FinishFn finish;
+        GetIntegerFn get_integer;
+    };
+
+    // Constantes GL utilisées ici, absentes de GL/gl.h sans glext.h
+    static const GLenum FRAMEBUFFER = 0x8D40, READ_FRAMEBUFFER = 0x8CA8,
+        DRAW_FRAMEBUFFER = 0x8CA9, RENDERBUFFER = 0x8D41,
+        COLOR_ATTACHMENT0 = 0x8CE0, DEPTH_STENCIL_ATTACHMENT = 0x821A,
+        FRAMEBUFFER_COMPLETE = 0x8CD5, RGBA8 = 0x8058,
+        DEPTH24_STENCIL8 = 0x88F0, PACK_ALIGNMENT = 0x0D05,
+        MAX_SAMPLES = 0x8D57;
+
+    Config m_config;
+    GLFWwindow* m_window = nullptr;
+    bool m_glfw_init = false;
+
+    EGLDisplay m_display = EGL_NO_DISPLAY;
+    EGLContext m_egl_context = EGL_NO_CONTEXT;
+    FboFunctions m_gl {};
+    GLuint m_fbo = 0, m_resolve_fbo = 0;
+    GLuint m_color_rb = 0, m_depth_rb = 0, m_resolve_rb = 0;
+    long m_nb_frames = 0;
+    bool m_resolved = false;            // image en cours déjà résolue
+    std::chrono::steady_clock::time_point m_time_origin;
+
+    static GLContext*& current()
+    {
+        static GLContext* ctx = nullptr;
+        return ctx;
+    }
+
+    template <typename F>
+    static bool load (F& f, const char* name)
+    {
+        f = reinterpret_cast<F> (eglGetProcAddress (name));
+        return f != nullptr;
+    }
+
+    bool create_window()
+    {
+        if (!glfwInit()) {
+            std::cerr << "GLFW: initialization failed" << std::endl;
+            return false;
+        }
+        m_glfw_init = true;
+
+        // Hints à spécifier avant la création de la fenêtre
+        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
+        if (m_config.samples > 0)
+            glfwWindowHint (GLFW_SAMPLES, m_config.samples);
+        if (m_config.major > 0) {
+            glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, m_config.major);
+            glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, m_config.minor);
+        }
+        if (m_config.profile == PROFILE_CORE)
+            glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        else if (m_config.profile == PROFILE_COMPAT)
+            glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+
+        m_window = glfwCreateWindow (m_config.width, m_config.height,
+            m_config.title, NULL, NULL);
+        if (!m_window) {
+            std::cerr << "GLFW: window creation failed" << std::endl;
+            return false;
+        }
+
+        // Rend le contexte GL courant. Tous les appels GL seront placés après.
+        glfwMakeContextCurrent (m_window);
+        return true;
+    }
+
+    bool create_egl()
+    {
+        auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC> (
+            eglGetProcAddress ("eglGetPlatformDisplayEXT"));
+        if (get_platform_display)
+            m_display = get_platform_display (EGL_PLATFORM_SURFACELESS_MESA,
+                EGL_DEFAULT_DISPLAY, NULL);
+        if (m_display == EGL_NO_DISPLAY)
+            m_display = eglGetDisplay (EGL_DEFAULT_DISPLAY);
+
+        EGLint major, minor;
+        if (m_display == EGL_NO_DISPLAY || !eglInitialize (m_display, &major, &minor)) {
+            std::cerr << "EGL: initialization failed" << std::endl;
+            m_display = EGL_NO_DISPLAY;
+            return false;
+        }
+        eglBindAPI (EGL_OPENGL_API);
+
+        // Pas de surface : la config ne sert qu'à créer le contexte
+        const EGLint config_attribs[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+        EGLConfig config = nullptr;
+        EGLint nb_configs = 0;
+        eglChooseConfig (m_display, config_attribs, &config, 1, &nb_configs);
+
+        std::vector<EGLint> attribs;
+        if (m_config.major > 0) {
+            attribs.insert (attribs.end(), {
+                EGL_CONTEXT_MAJOR_VERSION, m_config.major,
+                EGL_CONTEXT_MINOR_VERSION, m_config.minor });
+        }
+        if (m_config.profile != PROFILE_ANY) {
+            attribs.insert (attribs.end(), { EGL_CONTEXT_OPENGL_PROFILE_MASK,
+                m_config.profile == PROFILE_CORE ?
+                    EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT :
+                    EGL_CONTEXT_OPENGL_COMPATIBILITY_PROFILE_BIT });
+        }
+        attribs.push_back (EGL_NONE);
+
+        m_egl_context = eglCreateContext (m_display,
+            nb_configs > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT,
+            attribs.data());
+        if (m_egl_context == EGL_NO_CONTEXT ||
+            !eglMakeCurrent (m_display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_egl_context))
+        {
+            std::cerr << "EGL: context creation failed (0x" << std::hex
+                << eglGetError() << std::dec << ")" << std::endl;
+            return false;
+        }
+        return create_fbo();
+    }
+
+    bool create_fbo()
+    {
+        bool ok = load (m_gl.gen_framebuffers, "glGenFramebuffers")
+            && load (m_gl.gen_renderbuffers, "glGenRenderbuffers")
+            && load (m_gl.delete_framebuffers, "glDeleteFramebuffers")
+            && load (m_gl.delete_renderbuffers, "glDeleteRenderbuffers")
+            && load (m_gl.bind_framebuffer, "glBindFramebuffer")
+            && load (m_gl.bind_renderbuffer, "glBindRenderbuffer")
+            && load (m_gl.renderbuffer_storage_multisample,
+                     "glRenderbufferStorageMultisample")
+            && load (m_gl.framebuffer_renderbuffer, "glFramebufferRenderbuffer")
+            && load (m_gl.check_framebuffer_status, "glCheckFramebufferStatus")
+            && load (m_gl.blit_framebuffer, "glBlitFramebuffer")
+            && load (m_gl.pixel_store, "glPixelStorei")
+            && load (m_gl.read_pixels, "glReadPixels")
+            && load (m_gl.finish, "glFinish")
+            && load (m_gl.get_integer, "glGetIntegerv");
+        if (!ok) {
+            std::cerr << "EGL: framebuffer objects not supported" << std::endl;
+            return false;
+        }
+
+        // GLFW_SAMPLES n'est qu'un souhait ; ici on se limite au maximum
+        GLint max_samples = 0;
+        m_gl.get_integer (MAX_SAMPLES, &max_samples);
+        m_config.samples = std::min (m_config.samples, int (max_samples));
+
+        int w = m_config.width, h = m_config.height;
+        GLuint rbs[3];
+        m_gl.gen_renderbuffers (3, rbs);
+        m_color_rb = rbs[0]; m_depth_rb = rbs[1]; m_resolve_rb = rbs[2];
+
+        // Tampon de dessin, multi-échantillonné si demandé
+        m_gl.gen_framebuffers (1, &m_fbo);
+        m_gl.bind_framebuffer (FRAMEBUFFER, m_fbo);
+        m_gl.bind_renderbuffer (RENDERBUFFER, m_color_rb);
+        m_gl.renderbuffer_storage_multisample (RENDERBUFFER, m_config.samples,
+            RGBA8, w, h);
+        m_gl.framebuffer_renderbuffer (FRAMEBUFFER, COLOR_ATTACHMENT0,
+            RENDERBUFFER, m_color_rb);
+        m_gl.bind_renderbuffer (RENDERBUFFER, m_depth_rb);
+        m_gl.renderbuffer_storage_multisample (RENDERBUFFER, m_config.samples,
+            DEPTH24_STENCIL8, w, h);
+        m_gl.framebuffer_renderbuffer (FRAMEBUFFER, DEPTH_STENCIL_ATTACHMENT,
+            RENDERBUFFER, m_depth_rb);
+        if (m_gl.check_framebuffer_status (FRAMEBUFFER) != FRAMEBUFFER_COMPLETE) {
+            std::cerr << "EGL: incomplete framebuffer" << std::endl;
+            return false;
+        }
+
+        // Image résolue, un échantillon par pixel, lue par --dump
+        m_resolve_fbo = m_fbo;
+        if (m_config.samples > 0) {
+            m_gl.gen_framebuffers (1, &m_resolve_fbo);
+            m_gl.bind_framebuffer (FRAMEBUFFER, m_resolve_fbo);
+            m_gl.bind_renderbuffer (RENDERBUFFER, m_resolve_rb);
+            m_gl.renderbuffer_storage_multisample (RENDERBUFFER, 0, RGBA8, w, h);
+            m_gl.framebuffer_renderbuffer (FRAMEBUFFER, COLOR_ATTACHMENT0,
+                RENDERBUFFER, m_resolve_rb);
+        }
+        m_gl.bind_renderbuffer (RENDERBUFFER, 0);
+        m_gl.bind_framebuffer (FRAMEBUFFER, m_fbo);
+        return true;
+    }
+
+    void destroy_egl()
+    {
+        if (m_egl_context != EGL_NO_CONTEXT) {
+            if (m_fbo) {
+                m_gl.bind_framebuffer (FRAMEBUFFER, 0);
+                if (m_resolve_fbo != m_fbo)
+                    m_gl.delete_framebuffers (1, &m_resolve_fbo);
+                m_gl.delete_framebuffers (1, &m_fbo);
+                const GLuint rbs[3] = { m_color_rb, m_depth_rb, m_resolve_rb };
+                m_gl.delete_renderbuffers (3, rbs);
+            }
+            eglMakeCurrent (m_display, EGL_NO_SURFACE, EGL_NO_SURFACE,
+                EGL_NO_CONTEXT);
+            eglDestroyContext (m_display, m_egl_context);
+        }
+        if (m_display != EGL_NO_DISPLAY) eglTerminate (m_display);
+    }
+
+    // Recopie l'image multi-échantillonnée, une fois par image
+    void resolve()
+    {
+        if (m_resolved || m_resolve_fbo == m_fbo) return;
+        int w = m_config.width, h = m_config.height;
+        m_gl.bind_framebuffer (READ_FRAMEBUFFER, m_fbo);
+        m_gl.bind_framebuffer (DRAW_FRAMEBUFFER, m_resolve_fbo);
+        m_gl.blit_framebuffer (0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT,
+            GL_NEAREST);
+        m_gl.bind_framebuffer (FRAMEBUFFER, m_fbo);
+        m_resolved = true;
+    }
+
+    // Image résolue en PPM binaire, de haut en bas
+    bool dump_ppm (const std::string& path)
+    {
+        int w = m_config.width, h = m_config.height;
+        std::vector<unsigned char> pixels (size_t (w) * h * 3);
+        m_gl.bind_framebuffer (READ_FRAMEBUFFER, m_resolve_fbo);
+        m_gl.pixel_store (PACK_ALIGNMENT, 1);
+        m_gl.read_pixels (0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        m_gl.bind_framebuffer (FRAMEBUFFER, m_fbo);
+
+        std::ofstream out (path, std::ios::binary);
+        out << "P6 " << w << " " << h << " 255\n";
+        for (int y = h - 1; y >= 0; y--)
+            out.write (reinterpret_cast<const char*> (&pixels[size_t (y) * w * 3]), w * 3);
+        if (!out) {
+            std::cerr << "### Error: cannot write \"" << path << "\"" << std::endl;
+            return false;
+        }
+        std::cout << "Frame " << m_nb_frames << " saved to \"" << path << "\""
+            << std::endl;
+        return true;
+    }
+
+public:
+    GLContext() = default;
+    GLContext (const GLContext&) = delete;
+    GLContext& operator= (const GLContext&) = delete;
+
+    ~GLContext()
+    {
+        if (current() == this) current() = nullptr;
+        if (m_config.headless) destroy_egl();
+        else {
+            if (m_window) glfwDestroyWindow (m_window);
+            if (m_glfw_init) glfwTerminate();
+        }
+    }
+
+    Config& config() { return m_config; }
+    const Config& config() const { return m_config; }
+
+    // Reconnaît une option de contexte en argv[i] ; renvoie le nombre
+    // d'arguments pris, 0 si argv[i] n'en est pas une, -1 si mal formée
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        bool has_value = i+1 < argc;
+        if (strcmp (argv[i], "--headless") == 0 && has_value) {
+            int w, h;
+            char tail;
+            if (sscanf (argv[i+1], "%dx%d%c", &w, &h, &tail) != 2 || w <= 0 || h <= 0) {
+                std::cerr << "### Error: --headless expects WxH" << std::endl;
+                return -1;
+            }
+            m_config.headless = true;
+            m_config.width = w;
+            m_config.height = h;
+            return 2;
+        }
+        if (strcmp (argv[i], "--samples") == 0 && has_value) {
+            m_config.samples = std::max (0, atoi (argv[i+1]));
+            return 2;
+        }
+        if (strcmp (argv[i], "--frames") == 0 && has_value) {
+            m_config.nb_frames = std::max (1L, atol (argv[i+1]));
+            return 2;
+        }
+        if (strcmp (argv[i], "--dump") == 0 && has_value) {
+            m_config.dump_path = argv[i+1];
+            return 2;
+        }
+        return 0;
+    }
+
+    // Crée la fenêtre ou le contexte hors écran et le rend courant
+    bool create()
+    {
+        TRACE_THREAD ("gl");
+        TRACE_SCOPE ("create context");
+        current() = this;
+        m_time_origin = std::chrono::steady_clock::now();
+        if (!m_config.headless) return create_window();
+
+        if (!create_egl()) return false;
+        std::cout << "Headless rendering " << m_config.width << "x"
+            << m_config.height << ", " << m_config.samples << " samples, "
+            << m_config.nb_frames << " frames" << std::endl;
+        return true;
+    }
+
+    // Chargeur pour gladLoadGLLoader(), selon le contexte créé
+    static void* get_proc_address (const char* name)
+    {
+        GLContext* ctx = current();
+        if (ctx && ctx->m_config.headless)
+            return reinterpret_cast<void*> (eglGetProcAddress (name));
+        return reinterpret_cast<void*> (glfwGetProcAddress (name));
+    }
+
+    GLFWwindow* window() const { return m_window; }
+    bool headless() const { return m_config.headless; }
+
+    void get_size (int& width, int& height) const
+    {
+        if (m_window) glfwGetWindowSize (m_window, &width, &height);
+        else { width = m_config.width; height = m_config.height; }
+    }
+
+    // Secondes depuis create() ou le dernier set_time()
+    double get_time() const
+    {
+        if (!m_config.headless) return glfwGetTime();
+        return std::chrono::duration<double> (
+            std::chrono::steady_clock::now() - m_time_origin).count();
+    }
+
+    void set_time (double t)
+    {
+        if (!m_config.headless) { glfwSetTime (t); return; }
+        m_time_origin = std::chrono::steady_clock::now() -
+            std::chrono::duration_cast<std::chrono::steady_clock::duration> (
+                std::chrono::duration<double> (t));
+    }
+
+    void swap_interval (int interval)
+    {
+        if (m_window) glfwSwapInterval (interval);
+    }
+
+    // Fréquence de l'écran en Hz : celui de la fenêtre en plein écran,
+    // sinon l'écran principal ; 0 si inconnue ou hors écran
+    double refresh_rate() const
+    {
+        if (!m_window) return 0;
+        GLFWmonitor* monitor = glfwGetWindowMonitor (m_window);
+        if (!monitor) monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = monitor ? glfwGetVideoMode (monitor) : nullptr;
+        return mode ? mode->refreshRate : 0;
+    }
+
+    // Framebuffer à lire pour l'image qui vient d'être échangée, juste
+    // après swap_buffers() : 0 (tampon avant) avec une fenêtre ; hors
+    // écran, le FBO résolu, qui la garde jusqu'à l'image suivante
+    GLuint presented_framebuffer() const
+    {
+        return m_window ? 0 : m_resolve_fbo;
+    }
+
+    // Hors écran : résout le FBO et attend la fin de l'image, pour que le
+    // temps par image soit celui du rendu complet
+    void swap_buffers()
+    {
+        TRACE_SCOPE ("swap_buffers");
+        if (m_window) { glfwSwapBuffers (m_window); return; }
+
+        m_nb_frames++;
+        resolve();
+        m_resolved = false;
+        m_gl.finish();
+        if (m_nb_frames == m_config.nb_frames && !m_config.dump_path.empty())
+            dump_ppm (m_config.dump_path);
+    }
+
+    bool should_close() const
+    {
+        if (m_window) return glfwWindowShouldClose (m_window);
+        return m_nb_frames >= m_config.nb_frames;
+    }
+
+    // Sans fenêtre, pas d'événements : on n'attend jamais
+    void wait_events()
+    {
+        TRACE_SCOPE ("wait_events");
+        if (m_window) glfwWaitEvents();
+    }
+
+    void wait_events_timeout (double t)
+    {
+        TRACE_SCOPE ("wait_events");
+        if (m_window) glfwWaitEventsTimeout (t);
+    }
+
+    void poll_events() { if (m_window) glfwPollEvents(); }
+
+    // Réveille wait_events() ; appelable depuis n'importe quel thread
+    void post_empty_event() { if (m_window) glfwPostEmptyEvent(); }
+
+}; // GLContext
+
+#endif // GL_CONTEXT_H
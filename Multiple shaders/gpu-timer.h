@@ -0,0 +1,459 @@
+/*
+    Temps GPU par passe de rendu :
+        --gpu-timer [--gpu-timer-objects] [--gpu-timer-csv file]
+
+    Chaque repère place une requête GL_TIMESTAMP (glQueryCounter) dans le
+    flux de commandes ; la durée d'une passe est l'écart entre son repère
+    et le repère de la passe précédente. Les requêtes d'une image sont
+    relues NB_SLOTS-1 images plus tard dans un anneau, seulement si leurs
+    résultats sont disponibles : le CPU n'attend jamais le GPU. Une image
+    dont les résultats ne sont pas prêts à temps est abandonnée et
+    comptée.
+
+    Les moyennes glissantes sont affichées dans un petit panneau en haut à
+    gauche de l'image, dessiné par des glClear() limités par glScissor() :
+    il ne dépend ni d'un programme ni de la version de GL. Avec
+    --gpu-timer-csv, chaque mesure est aussi écrite sur une ligne
+    « frame,kind,section,gpu_ms ».
+
+    Avec --gpu-timer-objects, les repères d'objets découpent en plus les
+    passes : un objet compte du repère précédent, quel qu'il soit, à son
+    propre repère, et il est affiché sous la passe dont le repère le suit.
+
+        m_gpu_timer.start();                // après le chargement de GL
+        while (...) {
+            m_gpu_timer.begin_frame();
+            displayGL();                    // glClear (...);
+                                            // m_gpu_timer.end_pass ("clear");
+                                            // m->draw();
+                                            // m_gpu_timer.end_object ("m");
+                                            // m_gpu_timer.end_pass ("scene");
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_gpu_timer.end_frame();
+        }
+
+    Les noms sont des chaînes littérales : seuls les pointeurs sont gardés
+    jusqu'à la relecture. Les requêtes de temps ne s'imbriquent pas avec
+    GL_TIME_ELAPSED : --bench peut mesurer en même temps.
+
+    À inclure après glad.h ou GL/gl.h et gl-context.h.
+*/
+
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include <cctype>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "gl-context.h"
+
+
+class GpuTimer
+{
+public:
+    static const char* usage()
+    {
+        return "[--gpu-timer] [--gpu-timer-objects] [--gpu-timer-csv file]";
+    }
+
+    enum Kind { KIND_FRAME, KIND_PASS, KIND_OBJECT };
+
+private:
+    // Requêtes GL, prises par GLContext::get_proc_address() comme dans
+    // FrameBench
+    typedef void (*GenQueriesFn) (GLsizei, GLuint*);
+    typedef void (*DeleteQueriesFn) (GLsizei, const GLuint*);
+    typedef void (*QueryCounterFn) (GLuint, GLenum);
+    typedef void (*GetQueryObjectFn) (GLuint, GLenum, GLint*);
+    typedef void (*GetQueryObjectU64Fn) (GLuint, GLenum, uint64_t*);
+
+    struct QueryFunctions
+    {
+        GenQueriesFn gen_queries;
+        DeleteQueriesFn delete_queries;
+        QueryCounterFn query_counter;
+        GetQueryObjectFn get_query_object;
+        GetQueryObjectU64Fn get_query_object_u64;
+    };
+
+    static const GLenum TIMESTAMP = 0x8E28, QUERY_RESULT = 0x8866,
+        QUERY_RESULT_AVAILABLE = 0x8867;
+
+    // Images en vol ; repères par image, début compris ; images de la
+    // moyenne glissante
+    static const int NB_SLOTS = 4, MAX_MARKS = 64, WINDOW = 32;
+
+    // Panneau : taille d'un pixel de la police 3x5, longueur des noms,
+    // longueur maximale des barres
+    static const int SCALE = 2, NAME_LEN = 10, BAR_LEN = 60;
+
+    struct Mark
+    {
+        const char* name;
+        Kind kind;
+    };
+
+    struct Slot
+    {
+        GLuint queries[MAX_MARKS];
+        Mark marks[MAX_MARKS];
+        int nb_marks = 0;
+        long frame = -1;                // -1 si libre
+    };
+
+    struct Section
+    {
+        std::string name;
+        Kind kind;
+        double values[WINDOW] {};
+        int nb_values = 0, pos = 0;
+        double sum = 0;
+        double frame_ms = 0;            // cumul de l'image relue
+        bool seen = false;
+        int pass = -1;                  // pour un objet, passe qui le contient
+
+        void add (double ms)
+        {
+            if (nb_values == WINDOW) sum -= values[pos];
+            else nb_values++;
+            values[pos] = ms;
+            sum += ms;
+            pos = (pos + 1) % WINDOW;
+        }
+
+        double mean() const { return nb_values ? sum / nb_values : 0; }
+    };
+
+    bool m_enabled = false, m_objects = false, m_has_queries = false;
+    std::string m_csv_path;
+    std::ofstream m_csv;
+
+    QueryFunctions m_gl {};
+    Slot m_slots[NB_SLOTS];
+    Slot* m_current = nullptr;          // image en cours de soumission
+    long m_frame = 0, m_nb_dropped = 0;
+    bool m_overflow_reported = false;
+
+    std::vector<Section> m_sections;
+
+    template <typename F>
+    static bool load (F& f, const char* name)
+    {
+        f = reinterpret_cast<F> (GLContext::get_proc_address (name));
+        return f != nullptr;
+    }
+
+    void mark (const char* name, Kind kind)
+    {
+        if (!m_current) return;
+        Slot& s = *m_current;
+        if (s.nb_marks == MAX_MARKS) {
+            if (!m_overflow_reported)
+                std::cerr << "### GPU timer: more than " << MAX_MARKS
+                    << " marks in a frame, extra marks ignored" << std::endl;
+            m_overflow_reported = true;
+            return;
+        }
+        m_gl.query_counter (s.queries[s.nb_marks], TIMESTAMP);
+        s.marks[s.nb_marks++] = { name, kind };
+    }
+
+    int section (const char* name, Kind kind)
+    {
+        for (size_t k = 0; k < m_sections.size(); k++)
+            if (m_sections[k].kind == kind && m_sections[k].name == name)
+                return k;
+        m_sections.emplace_back();
+        m_sections.back().name = name;
+        m_sections.back().kind = kind;
+        return m_sections.size() - 1;
+    }
+
+    // Relit l'image du créneau si ses requêtes sont terminées ; sinon, si
+    // abandon, libère le créneau sans rien relire
+    bool collect (Slot& s, bool drop)
+    {
+        if (s.frame < 0) return true;
+        GLint available = 0;
+        if (s.nb_marks > 0)
+            m_gl.get_query_object (s.queries[s.nb_marks-1],
+                QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            if (!drop) return false;
+            m_nb_dropped++;
+            s.frame = -1;
+            return true;
+        }
+
+        // Les requêtes s'achèvent dans l'ordre : la dernière prête, toutes
+        // le sont
+        uint64_t t[MAX_MARKS];
+        for (int i = 0; i < s.nb_marks; i++)
+            m_gl.get_query_object_u64 (s.queries[i], QUERY_RESULT, &t[i]);
+
+        for (auto& sec : m_sections) { sec.frame_ms = 0; sec.seen = false; }
+        auto add = [&] (const char* name, Kind kind, uint64_t ns) {
+            int k = section (name, kind);
+            m_sections[k].frame_ms += ns * 1e-6;
+            m_sections[k].seen = true;
+            return k;
+        };
+        // Les objets appartiennent à la passe dont le repère les suit
+        std::vector<int> objects;
+        uint64_t pass_start = t[0];
+        for (int i = 1; i < s.nb_marks; i++) {
+            if (s.marks[i].kind == KIND_OBJECT)
+                objects.push_back (
+                    add (s.marks[i].name, KIND_OBJECT, t[i] - t[i-1]));
+            else {
+                int pass = add (s.marks[i].name, KIND_PASS, t[i] - pass_start);
+                for (int k : objects) m_sections[k].pass = pass;
+                objects.clear();
+                pass_start = t[i];
+            }
+        }
+        add ("gpu", KIND_FRAME, t[s.nb_marks-1] - t[0]);
+
+        static const char* kind_names[] = { "frame", "pass", "object" };
+        for (auto& sec : m_sections) {
+            if (!sec.seen) continue;
+            sec.add (sec.frame_ms);
+            if (m_csv.is_open())
+                m_csv << s.frame << "," << kind_names[sec.kind] << ","
+                    << sec.name << "," << sec.frame_ms << "\n";
+        }
+        s.frame = -1;
+        return true;
+    }
+
+    // Police 3x5 : un chiffre octal par ligne, de haut en bas, le bit 4
+    // à gauche
+    static unsigned glyph (char c)
+    {
+        static const unsigned digits[10] = {
+            075557, 026227, 071747, 071717, 055711,
+            074717, 074757, 071111, 075757, 075717 };
+        static const unsigned letters[26] = {
+            025755, 065656, 034443, 065556, 074647, 074644, 034553,
+            055755, 072227, 011152, 055655, 044447, 057755, 065555,
+            025552, 065644, 025563, 065655, 034216, 072222, 055557,
+            055552, 055775, 055255, 055222, 071247 };
+        if (c >= '0' && c <= '9') return digits[c - '0'];
+        c = toupper (c);
+        if (c >= 'A' && c <= 'Z') return letters[c - 'A'];
+        switch (c) {
+        case '.': return 000002;
+        case '-': return 000700;
+        case '_': return 000007;
+        case ':': return 002020;
+        default: return 0;
+        }
+    }
+
+    static void fill (int x, int y, int w, int h, float r, float g, float b)
+    {
+        glScissor (x, y, w, h);
+        glClearColor (r, g, b, 1.0f);
+        glClear (GL_COLOR_BUFFER_BIT);
+    }
+
+    // Texte en blanc, coin haut gauche en (x, top) ; les pixels allumés
+    // contigus d'une ligne sont remplis d'un seul glClear()
+    static void draw_text (int x, int top, const char* text)
+    {
+        glClearColor (1.0f, 1.0f, 1.0f, 1.0f);
+        for (int row = 0; row < 5; row++) {
+            int y = top - (row + 1) * SCALE, run_start = -1, col = 0;
+            for (const char* c = text; ; c++) {
+                unsigned bits = *c ? (glyph (*c) >> (3 * (4 - row))) & 7 : 0;
+                // 3 colonnes et un espace par caractère
+                for (int k = 0; k < 4; k++, col++) {
+                    bool on = k < 3 && (bits & (4 >> k));
+                    if (on && run_start < 0) run_start = col;
+                    if (!on && run_start >= 0) {
+                        glScissor (x + run_start * SCALE, y,
+                            (col - run_start) * SCALE, SCALE);
+                        glClear (GL_COLOR_BUFFER_BIT);
+                        run_start = -1;
+                    }
+                }
+                if (!*c) break;
+            }
+        }
+    }
+
+public:
+    ~GpuTimer()
+    {
+        if (m_has_queries)
+            for (auto& s : m_slots) m_gl.delete_queries (MAX_MARKS, s.queries);
+        if (m_nb_dropped > 0)
+            std::cerr << "GPU timer: " << m_nb_dropped
+                << " frame(s) dropped, results not ready in time" << std::endl;
+    }
+
+    // Même convention que GLContext::parse_arg()
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        if (strcmp (argv[i], "--gpu-timer") == 0) {
+            m_enabled = true;
+            return 1;
+        }
+        if (strcmp (argv[i], "--gpu-timer-objects") == 0) {
+            m_enabled = m_objects = true;
+            return 1;
+        }
+        if (strcmp (argv[i], "--gpu-timer-csv") == 0 && i+1 < argc) {
+            m_enabled = true;
+            m_csv_path = argv[i+1];
+            return 2;
+        }
+        return 0;
+    }
+
+    bool enabled() const { return m_enabled; }
+
+    // Après le chargement des fonctions GL : crée les requêtes et ouvre
+    // le fichier CSV ; faux si le fichier n'a pu être créé
+    bool start()
+    {
+        if (!m_enabled) return true;
+        m_has_queries = load (m_gl.gen_queries, "glGenQueries") &&
+            load (m_gl.delete_queries, "glDeleteQueries") &&
+            load (m_gl.query_counter, "glQueryCounter") &&
+            load (m_gl.get_query_object, "glGetQueryObjectiv") &&
+            load (m_gl.get_query_object_u64, "glGetQueryObjectui64v");
+        if (!m_has_queries) {
+            std::cerr << "### GPU timer: no timestamp queries, disabled"
+                << std::endl;
+            m_enabled = false;
+            return true;
+        }
+        for (auto& s : m_slots) m_gl.gen_queries (MAX_MARKS, s.queries);
+
+        if (m_csv_path.empty()) return true;
+        m_csv.open (m_csv_path);
+        if (!m_csv) {
+            std::cerr << "### Error: cannot create \"" << m_csv_path << "\""
+                << std::endl;
+            return false;
+        }
+        m_csv << "frame,kind,section,gpu_ms\n";
+        return true;
+    }
+
+    // Juste avant displayGL() : relit ou abandonne l'image qui occupait le
+    // créneau, puis pose le repère de début
+    void begin_frame()
+    {
+        if (!m_enabled) return;
+        Slot& s = m_slots[m_frame % NB_SLOTS];
+        collect (s, true);
+        s.frame = m_frame;
+        s.nb_marks = 0;
+        m_current = &s;
+        mark ("start", KIND_PASS);
+    }
+
+    // Fin d'une passe de displayGL() : effacement, groupe de programmes...
+    void end_pass (const char* name)
+    {
+        if (m_enabled) mark (name, KIND_PASS);
+    }
+
+    // Fin du dessin d'un objet, avec --gpu-timer-objects
+    void end_object (const char* name)
+    {
+        if (m_objects) mark (name, KIND_OBJECT);
+    }
+
+    // Juste avant l'échange des tampons : panneau des moyennes glissantes,
+    // compté comme la passe « overlay »
+    void draw_overlay()
+    {
+        if (!m_enabled || m_sections.empty()) return;
+
+        GLint viewport[4], scissor_box[4];
+        GLfloat clear_color[4];
+        GLboolean scissor_test = glIsEnabled (GL_SCISSOR_TEST);
+        glGetIntegerv (GL_VIEWPORT, viewport);
+        glGetIntegerv (GL_SCISSOR_BOX, scissor_box);
+        glGetFloatv (GL_COLOR_CLEAR_VALUE, clear_color);
+        glEnable (GL_SCISSOR_TEST);
+
+        // Total d'abord, puis chaque passe suivie de ses objets
+        std::vector<const Section*> lines;
+        for (auto& s : m_sections)
+            if (s.kind == KIND_FRAME) lines.push_back (&s);
+        for (size_t k = 0; k < m_sections.size(); k++) {
+            if (m_sections[k].kind != KIND_PASS) continue;
+            lines.push_back (&m_sections[k]);
+            for (auto& s : m_sections)
+                if (s.kind == KIND_OBJECT && s.pass == int (k))
+                    lines.push_back (&s);
+        }
+        double total = lines[0]->kind == KIND_FRAME ? lines[0]->mean() : 0;
+
+        // "  nom        12.34 " puis la barre
+        const int line_h = 7 * SCALE, char_w = 4 * SCALE,
+            text_w = (NAME_LEN + 9) * char_w, margin = 2 * SCALE,
+            nb_lines = lines.size();
+        int x = viewport[0] + margin,
+            top = viewport[1] + viewport[3] - margin;
+        fill (x - margin, top - nb_lines * line_h - margin,
+            text_w + BAR_LEN * SCALE + 2 * margin,
+            nb_lines * line_h + 2 * margin, 0.1f, 0.1f, 0.1f);
+
+        for (int line = 0; line < nb_lines; line++) {
+            const Section& s = *lines[line];
+            int y = top - line * line_h;
+            double ms = s.mean();
+            int bar = total > 0 ? int (BAR_LEN * SCALE * ms / total) : 0;
+            if (bar > 0) {
+                if (s.kind == KIND_OBJECT)
+                    fill (x + text_w, y - 5 * SCALE, bar, 5 * SCALE,
+                        0.9f, 0.6f, 0.2f);
+                else
+                    fill (x + text_w, y - 5 * SCALE, bar, 5 * SCALE,
+                        0.3f, 0.7f, 0.3f);
+            }
+            // Objets en retrait sous leur passe, durées alignées
+            std::string label = s.kind == KIND_OBJECT ? "  " : "";
+            label += s.name.substr (0, NAME_LEN);
+            char text[64];
+            snprintf (text, sizeof text, "%-*s %6.2f", NAME_LEN + 2,
+                label.c_str(), ms);
+            draw_text (x, y, text);
+        }
+
+        if (!scissor_test) glDisable (GL_SCISSOR_TEST);
+        glScissor (scissor_box[0], scissor_box[1], scissor_box[2],
+            scissor_box[3]);
+        glClearColor (clear_color[0], clear_color[1], clear_color[2],
+            clear_color[3]);
+        end_pass ("overlay");
+    }
+
+    // Juste après l'échange des tampons : repère de fin, puis relit sans
+    // attendre les images déjà terminées, de la plus ancienne à la plus
+    // récente
+    void end_frame()
+    {
+        if (!m_enabled) return;
+        end_pass ("swap");
+        m_current = nullptr;
+        m_frame++;
+        for (int k = 0; k < NB_SLOTS; k++)
+            if (!collect (m_slots[(m_frame + k) % NB_SLOTS], false)) break;
+    }
+
+}; // GpuTimer
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,172 @@
+/*
+    Enregistrement et relecture d'une session, pour des mesures
+    reproductibles
+
+    Le flux binaire commence par un en-tête (signature, version, taille de
+    l'état) puis alterne des enregistrements d'un octet d'étiquette suivi
+    de leur contenu :
+      'K'  un événement clavier (KeyEvent)
+      'F'  l'état complet d'une image (Frame)
+    Les événements précèdent l'image qu'ils ont affectée. Frame est une
+    structure copiable bit à bit, fournie par l'application, avec tout ce
+    qui détermine l'image : angles, caméra, drapeaux, date. En relecture,
+    l'application impose cet état au lieu de le calculer ; les images sont
+    alors les mêmes d'une exécution à l'autre et d'une version à l'autre,
+    quel que soit le temps mis à les produire.
+
+        replay::Recorder<MyFrame> rec;      replay::Player<MyFrame> player;
+        rec.open ("session.rpl");           player.open ("session.rpl");
+        rec.key (ev);                       while (player.next (keys, f)) {
+        rec.frame (f);                          ...
+                                            }
+
+    Le flux est écrit dans l'ordre des octets de la machine : il n'est
+    relu que sur la même architecture, par un programme dont Frame a la
+    même taille (vérifiée à l'ouverture).
+*/
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace replay
+{
+    struct KeyEvent
+    {
+        int32_t key, scancode, action, mods;
+    };
+
+    const char MAGIC[4] = { 'R', 'P', 'L', 'Y' };
+    const uint32_t VERSION = 1;
+    const char TAG_KEY = 'K', TAG_FRAME = 'F';
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t frame_size;
+    };
+
+
+    template <typename Frame>
+    class Recorder
+    {
+        static_assert (std::is_trivially_copyable<Frame>::value,
+            "Frame doit être copiable bit à bit");
+
+        std::ofstream m_out;
+        long m_nb_frames = 0;
+
+        template <typename T>
+        void put (char tag, const T& value)
+        {
+            m_out.put (tag);
+            m_out.write (reinterpret_cast<const char*> (&value), sizeof value);
+        }
+
+    public:
+        bool open (const std::string& path)
+        {
+            m_out.open (path, std::ios::binary | std::ios::trunc);
+            if (!m_out) {
+                std::cerr << "### Error: cannot create \"" << path << "\""
+                    << std::endl;
+                return false;
+            }
+            Header h;
+            memcpy (h.magic, MAGIC, sizeof h.magic);
+            h.version = VERSION;
+            h.frame_size = sizeof (Frame);
+            m_out.write (reinterpret_cast<const char*> (&h), sizeof h);
+            return true;
+        }
+
+        bool is_open() const { return m_out.is_open(); }
+        long nb_frames() const { return m_nb_frames; }
+
+        void key (const KeyEvent& ev) { put (TAG_KEY, ev); }
+
+        void frame (const Frame& f)
+        {
+            put (TAG_FRAME, f);
+            m_nb_frames++;
+        }
+    };
+
+
+    template <typename Frame>
+    class Player
+    {
+        static_assert (std::is_trivially_copyable<Frame>::value,
+            "Frame doit être copiable bit à bit");
+
+        std::ifstream m_in;
+        bool m_failed = false;
+
+        template <typename T>
+        bool get (T& value)
+        {
+            m_in.read (reinterpret_cast<char*> (&value), sizeof value);
+            return bool (m_in);
+        }
+
+        bool fail (const char* what)
+        {
+            std::cerr << "### Error: replay stream " << what << std::endl;
+            m_failed = true;
+            return false;
+        }
+
+    public:
+        bool open (const std::string& path)
+        {
+            m_in.open (path, std::ios::binary);
+            if (!m_in) {
+                std::cerr << "### Error: cannot open \"" << path << "\""
+                    << std::endl;
+                return false;
+            }
+            Header h;
+            if (!get (h) || memcmp (h.magic, MAGIC, sizeof h.magic) != 0)
+                return fail ("has no valid header");
+            if (h.version != VERSION || h.frame_size != sizeof (Frame))
+                return fail ("was written by another version");
+            return true;
+        }
+
+        bool is_open() const { return m_in.is_open(); }
+
+        // Vrai si le flux était invalide ou tronqué
+        bool failed() const { return m_failed; }
+
+        // Événements précédant l'image suivante, puis l'état de cette
+        // image ; faux à la fin du flux
+        bool next (std::vector<KeyEvent>& keys, Frame& frame)
+        {
+            keys.clear();
+            if (m_failed) return false;
+            for (;;) {
+                int tag = m_in.get();
+                // Des touches après la dernière image n'ont rien affiché
+                if (tag == std::char_traits<char>::eof()) return false;
+                if (tag == TAG_FRAME)
+                    return get (frame) || fail ("is truncated");
+
+                KeyEvent ev;
+                if (tag != TAG_KEY) return fail ("has an unknown record");
+                if (!get (ev)) return fail ("is truncated");
+                keys.push_back (ev);
+            }
+        }
+    };
+
+} // namespace replay
+
+#endif // REPLAY_H
@@ -0,0 +1,174 @@
+/*
+    Simulation à pas fixe sur un thread dédié
+
+    Le thread de simulation fait avancer un état State par pas constants de
+    step secondes, quel que soit le rythme de l'affichage : si une frame
+    prend trop de temps, les pas en retard sont rattrapés d'un bloc au lieu
+    de ralentir l'animation. Chaque pas publie un Snapshot (les deux derniers
+    états et leurs dates) dans un triple tampon sans verrou ; le thread
+    d'affichage y prend le plus récent et interpole entre les deux états,
+    avec un pas de retard sur le temps réel :
+
+        SimLoop<MyState> sim (1.0/120, MyState(),
+            [this] (MyState& s, double dt) { ... });
+        sim.start();
+        ...
+        MyState s = sim.sample();       // à chaque frame
+
+    State doit être copiable et fournir une fonction libre (trouvée par ADL)
+
+        State interpolate (const State& a, const State& b, double t);
+
+    La fonction advance est appelée sur le thread de simulation : les
+    entrées venues du thread d'affichage doivent lui parvenir par des
+    std::atomic.
+*/
+
+#ifndef SIM_LOOP_H
+#define SIM_LOOP_H
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+
+// Triple tampon sans verrou, un écrivain et un lecteur. L'écrivain remplit
+// son tampon puis l'échange avec celui du milieu ; le lecteur reprend le
+// tampon du milieu s'il a été publié depuis sa dernière lecture. Aucun des
+// deux n'attend l'autre et le lecteur voit toujours la dernière valeur
+// publiée en entier.
+template <typename T>
+class TripleBuffer
+{
+    static const unsigned FRESH = 4;    // bit ajouté à l'indice du milieu
+
+    T m_buffers[3];
+    std::atomic<unsigned> m_middle {1};
+    unsigned m_write = 0, m_read = 2;   // propres à chaque thread
+
+public:
+    TripleBuffer (const T& init = T()) : m_buffers {init, init, init} {}
+
+    // Côté écrivain
+    T& write_buffer() { return m_buffers[m_write]; }
+
+    void publish()
+    {
+        m_write = m_middle.exchange (m_write | FRESH, std::memory_order_acq_rel) & 3;
+    }
+
+    // Côté lecteur ; renvoie vrai si une nouvelle valeur a été prise
+    bool update()
+    {
+        if (!(m_middle.load (std::memory_order_relaxed) & FRESH)) return false;
+        m_read = m_middle.exchange (m_read, std::memory_order_acq_rel) & 3;
+        return true;
+    }
+
+    const T& read_buffer() const { return m_buffers[m_read]; }
+};
+
+
+template <typename State>
+class SimLoop
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::function<void (State&, double)> Advance;
+
+    // Deux états successifs et leurs dates, en secondes depuis start()
+    struct Snapshot
+    {
+        State prev, cur;
+        double t_prev = 0, t_cur = 0;
+    };
+
+private:
+    const double m_step;
+    const Advance m_advance;
+    TripleBuffer<Snapshot> m_snapshots;
+    Clock::time_point m_start;
+    std::atomic<bool> m_running {false};
+    std::thread m_thread;
+
+    // Au-delà de ce retard, on renonce à rattraper les pas perdus
+    // (programme suspendu, débogueur...) pour ne pas boucler sans fin
+    static constexpr double MAX_LAG = 0.25;
+
+    double since_start (Clock::time_point t) const
+    {
+        return std::chrono::duration<double> (t - m_start).count();
+    }
+
+    void loop (State state)
+    {
+        double sim_time = 0;
+        auto next = m_start;
+        const auto step = std::chrono::duration_cast<Clock::duration> (
+            std::chrono::duration<double> (m_step));
+
+        while (m_running.load (std::memory_order_relaxed)) {
+            Snapshot& snap = m_snapshots.write_buffer();
+            snap.prev = state;
+            snap.t_prev = sim_time;
+            m_advance (state, m_step);
+            sim_time += m_step;
+            next += step;
+
+            double lag = since_start (Clock::now()) - sim_time;
+            if (lag > MAX_LAG) {
+                sim_time += lag;
+                next += std::chrono::duration_cast<Clock::duration> (
+                    std::chrono::duration<double> (lag));
+            }
+            snap.cur = state;
+            snap.t_cur = sim_time;
+            m_snapshots.publish();
+
+            std::this_thread::sleep_until (next);
+        }
+    }
+
+public:
+    SimLoop (double step, const State& init, Advance advance)
+        : m_step (step), m_advance (advance),
+          m_snapshots (Snapshot {init, init, 0, 0})
+    {}
+
+    ~SimLoop() { stop(); }
+
+    void start()
+    {
+        if (m_running) return;
+        m_running = true;
+        m_start = Clock::now();
+        State init = m_snapshots.read_buffer().cur;
+        m_thread = std::thread (&SimLoop::loop, this, init);
+    }
+
+    void stop()
+    {
+        m_running = false;
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    double step() const { return m_step; }
+
+    // État à afficher maintenant : le temps réel moins un pas tombe entre
+    // les deux états du dernier Snapshot publié
+    State sample()
+    {
+        m_snapshots.update();
+        const Snapshot& snap = m_snapshots.read_buffer();
+        double dt = snap.t_cur - snap.t_prev;
+        if (dt <= 0) return snap.cur;
+
+        double t = (since_start (Clock::now()) - m_step - snap.t_prev) / dt;
+        if (t < 0) t = 0;
+        else if (t > 1) t = 1;
+        return interpolate (snap.prev, snap.cur, t);
+    }
+};
+
+#endif // SIM_LOOP_H
@@ -0,0 +1,374 @@
+/*
+    Banc d'essai des produits de matrices : vmath::operator* contre les lots
+    SoA de vmath-batch.h
+
+    Simule la mise à jour des maillons d'une chaîne : monde = parent * locale,
+    avec un parent commun puis avec un parent par maillon. Chaque variante
+    est vérifiée bit à bit contre operator*. Mesure ensuite
+    SceneGraph::update() sur les mêmes maillons, noeud par noeud et par
+    lots. Compare le calcul des matrices des normales : vmath::normal(),
+    normal_matrix() de vmath-xform.h (cas général et rigide) et
+    batch_normal() (scalaire, SSE, AVX2). Compare enfin
+    une chaîne de 4 matrices, a * b * c * d, à vmath::chain() de
+    vmath-expr.h, en temps et en instructions exécutées (compteur matériel
+    via perf_event_open, si le noyau le permet). Mesure aussi le placement
+    des maillons de chain-path.h pour des chaînes de plus en plus longues :
+    le temps par maillon doit rester constant.
+
+    Usage : transform-bench [nb_maillons] [nb_repetitions]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "vmath.h"
+#include "vmath-et.h"
+#include "vmath-batch.h"
+#include "vmath-xform.h"
+#include "vmath-expr.h"
+#include "chain-path.h"
+#include "scene-graph.h"
+
+
+// Meilleur temps de nb_reps exécutions de f, en secondes
+template <typename F>
+double best_time (int nb_reps, F f)
+{
+    double best = 1e30;
+    for (int r = 0; r < nb_reps; r++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min (best, elapsed.count());
+    }
+    return best;
+}
+
+
+// Instructions exécutées (espace utilisateur) par f, -1 si indisponible
+template <typename F>
+long long count_instructions (F f)
+{
+#ifdef __linux__
+    perf_event_attr attr;
+    memset (&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    int fd = syscall (SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fd >= 0) {
+        ioctl (fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl (fd, PERF_EVENT_IOC_ENABLE, 0);
+        f();
+        ioctl (fd, PERF_EVENT_IOC_DISABLE, 0);
+        long long count;
+        if (read (fd, &count, sizeof count) != sizeof count) count = -1;
+        close (fd);
+        return count;
+    }
+#endif
+    f();
+    return -1;
+}
+
+
+void print_instructions (long long count, size_t n)
+{
+    std::cout << "  " << std::setw (26) << "" << std::setw (9);
+    if (count < 0) std::cout << "n/a";
+    else std::cout << std::setprecision (1) << double (count) / n;
+    std::cout << " instructions/mat" << std::endl;
+}
+
+
+template <typename M, int N>
+bool same (const std::vector<M>& ref, const vmath::MatBatch<N>& b)
+{
+    for (size_t i = 0; i < ref.size(); i++) {
+        M m = b.get (i);
+        if (memcmp (&m, &ref[i], sizeof m) != 0) return false;
+    }
+    return true;
+}
+
+
+void print_line (const char* name, double seconds, size_t n, double ref, bool ok)
+{
+    std::cout << "  " << std::left << std::setw (26) << name << std::right
+        << std::fixed << std::setprecision (3) << std::setw (9)
+        << seconds * 1000 << " ms" << std::setprecision (2) << std::setw (8)
+        << seconds * 1e9 / n << " ns/mat" << std::setw (7)
+        << ref / seconds << "x" << (ok ? "" : "   ### MISMATCH") << std::endl;
+}
+
+
+int main (int argc, char* argv[])
+{
+    size_t n = argc > 1 ? atol (argv[1]) : 100000;
+    int nb_reps = argc > 2 ? atoi (argv[2]) : 50;
+    if (n == 0 || nb_reps <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [nb_maillons] [nb_repetitions]"
+            << std::endl;
+        return 1;
+    }
+
+    // Maillons répartis sur un cercle, chacun tourné selon la tangente
+    std::vector<vmath::mat4> local (n), parents (n), ref (n);
+    vmath::Mat4Batch b_local (n), b_parents (n), b_world (n);
+    for (size_t i = 0; i < n; i++) {
+        float angle = 360.f * i / n;
+        float radian = vmath::radians (angle);
+        local[i] = vmath::translate (0.6f * cosf (radian), 0.6f * sinf (radian), 0.f)
+            * vmath::rotate (angle + 90.f, 0.f, 0.f, 1.f);
+        parents[i] = vmath::rotate (float (i % 360), 0.f, 1.f, 0.15f)
+            * vmath::translate (-0.8f, 0.f, 0.f);
+        b_local.set (i, local[i]);
+        b_parents.set (i, parents[i]);
+    }
+    vmath::mat4 parent = vmath::rotate (30.f, 0.f, 1.f, 0.15f)
+        * vmath::translate (-0.8f, 0.f, 0.f)
+        * vmath::rotate (12.f, 0.f, 0.f, 1.f);
+
+    std::vector<vmath::BatchIsa> isas { vmath::BATCH_SCALAR };
+#ifdef VMATH_BATCH_X86
+    if (vmath::batch_best_isa() >= vmath::BATCH_SSE)
+        isas.push_back (vmath::BATCH_SSE);
+    if (vmath::batch_best_isa() >= vmath::BATCH_AVX2)
+        isas.push_back (vmath::BATCH_AVX2);
+#endif
+    // batch_mul n'a que deux chemins : AVX2, sinon operator* par matrice
+    std::vector<vmath::BatchIsa> mul_isas { vmath::BATCH_SCALAR };
+    if (vmath::batch_best_isa() == vmath::BATCH_AVX2)
+        mul_isas.push_back (vmath::BATCH_AVX2);
+    auto mul_name = [] (vmath::BatchIsa isa) {
+        return std::string ("batch_mul ") +
+            (isa == vmath::BATCH_AVX2 ? "AVX2" : "per matrix");
+    };
+
+    std::cout << n << " matrices, best of " << nb_reps << " runs, dispatch: "
+        << vmath::batch_isa_name (vmath::batch_best_isa()) << std::endl;
+    bool all_ok = true;
+
+    std::cout << "Common parent" << std::endl;
+    double t_ref = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) ref[i] = parent * local[i];
+    });
+    print_line ("operator*", t_ref, n, t_ref, true);
+    for (auto isa : mul_isas) {
+        double t = best_time (nb_reps, [&] {
+            vmath::batch_mul (parent, b_local, b_world, isa);
+        });
+        bool ok = same (ref, b_world);
+        all_ok = all_ok && ok;
+        print_line (mul_name (isa).c_str(), t, n, t_ref, ok);
+    }
+
+    std::cout << "One parent per node" << std::endl;
+    t_ref = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) ref[i] = parents[i] * local[i];
+    });
+    print_line ("operator*", t_ref, n, t_ref, true);
+    for (auto isa : mul_isas) {
+        double t = best_time (nb_reps, [&] {
+            vmath::batch_mul (b_parents, b_local, b_world, isa);
+        });
+        bool ok = same (ref, b_world);
+        all_ok = all_ok && ok;
+        print_line (mul_name (isa).c_str(), t, n, t_ref, ok);
+    }
+
+    // Les mêmes maillons dans un SceneGraph : sous un parent commun, par
+    // groupes de 256 frères, puis répartis un à un sur n/16 parents
+    const char* shapes[] = { "SceneGraph, common parent",
+        "SceneGraph, 256 siblings per parent",
+        "SceneGraph, parents interleaved" };
+    for (int shape = 0; shape < 3; shape++) {
+        std::cout << shapes[shape] << std::endl;
+        SceneGraph graph;
+        int root = graph.add();
+        std::vector<int> mids;
+        size_t nb_mids = shape == 0 ? 0 : shape == 1 ? (n + 255) / 256 : n / 16;
+        for (size_t i = 0; i < nb_mids; i++) {
+            mids.push_back (graph.add (root));
+            graph.set_rotation (mids.back(), float (i % 360), 0.f, 1.f, 0.15f);
+            graph.set_translation (mids.back(), -0.8f, 0.f, 0.f);
+        }
+        std::vector<int> nodes (n);
+        for (size_t i = 0; i < n; i++) {
+            nodes[i] = graph.add (mids.empty() ? root : shape == 1 ?
+                mids[i / 256] : mids[i % mids.size()]);
+            float angle = 360.f * i / n, radian = vmath::radians (angle);
+            graph.set_translation (nodes[i], 0.6f * cosf (radian), 0.6f * sinf (radian), 0.f);
+            graph.set_rotation (nodes[i], angle + 90.f, 0.f, 0.f, 1.f);
+        }
+
+        // La racine tourne à chaque passe : tout est recalculé
+        float angle = 0;
+        auto update = [&] (vmath::BatchIsa isa) {
+            graph.set_rotation (root, angle += 1.f, 0.f, 1.f, 0.15f);
+            graph.update (isa);
+        };
+        t_ref = best_time (nb_reps, [&] { update (vmath::BATCH_SCALAR); });
+        std::vector<vmath::mat4> ref_world (n);
+        std::vector<vmath::Affine> ref_xf (n);
+        for (size_t i = 0; i < n; i++) {
+            ref_world[i] = graph.world (nodes[i]);
+            ref_xf[i] = graph.world_xform (nodes[i]);
+        }
+        print_line ("per node", t_ref, n, t_ref, true);
+
+        if (vmath::batch_best_isa() == vmath::BATCH_AVX2) {
+            angle -= nb_reps;
+            double t = best_time (nb_reps, [&] { update (vmath::BATCH_AVX2); });
+            // Mêmes opérations, aux termes nuls près : égalité des valeurs,
+            // mat4 et Affine du monde avec sa nature
+            bool ok = true;
+            for (size_t i = 0; i < n; i++) {
+                for (int c = 0; c < 4; c++)
+                    for (int l = 0; l < 4; l++)
+                        ok = ok && graph.world (nodes[i])[c][l] == ref_world[i][c][l];
+                const vmath::Affine& xf = graph.world_xform (nodes[i]);
+                for (int c = 0; c < 3; c++) {
+                    ok = ok && xf.t[c] == ref_xf[i].t[c];
+                    for (int l = 0; l < 3; l++)
+                        ok = ok && xf.m[c][l] == ref_xf[i].m[c][l];
+                }
+                ok = ok && xf.kind == ref_xf[i].kind && xf.scale == ref_xf[i].scale;
+            }
+            all_ok = all_ok && ok;
+            print_line ("batched AVX2", t, n, t_ref, ok);
+        }
+    }
+
+    // Matrices des normales des mondes par maillon (rotations d'axe non
+    // unitaire, comme dans les démos : cas général)
+    std::cout << "Normal matrices" << std::endl;
+    std::vector<vmath::mat3> nor (n);
+    std::vector<vmath::Affine> xf (n);
+    for (size_t i = 0; i < n; i++) xf[i] = vmath::Affine (parents[i]);
+    vmath::Mat3Batch b_nor (n);
+
+    t_ref = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) {
+            vmath::mat4 m = parents[i];
+            nor[i] = vmath::normal (m);
+        }
+    });
+    print_line ("vmath::normal", t_ref, n, t_ref, true);
+
+    std::vector<vmath::mat3> nor2 (n);
+    double t = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) nor2[i] = vmath::normal_matrix (xf[i]);
+    });
+    bool ok = memcmp (nor.data(), nor2.data(), n * sizeof (vmath::mat3)) == 0;
+    all_ok = all_ok && ok;
+    print_line ("normal_matrix general", t, n, t_ref, ok);
+
+    for (auto isa : isas) {
+        double t = best_time (nb_reps, [&] {
+            vmath::batch_normal (b_parents, b_nor, isa);
+        });
+        bool ok = same (nor, b_nor);
+        all_ok = all_ok && ok;
+        std::string name = std::string ("batch_normal ") + vmath::batch_isa_name (isa);
+        print_line (name.c_str(), t, n, t_ref, ok);
+    }
+
+    // Mêmes maillons avec un axe unitaire : la partie 3x3 suffit
+    for (size_t i = 0; i < n; i++)
+        xf[i] = vmath::Translation (-0.8f, 0.f, 0.f)
+            * vmath::AxisRotation (float (i % 360), 0.f, 0.f, 1.f);
+    t = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) nor2[i] = vmath::normal_matrix (xf[i]);
+    });
+    print_line ("normal_matrix rigid", t, n, t_ref, xf[0].kind == vmath::XF_RIGID);
+
+    // monde = parent * translate * locale * translate, comme dans dessin.cpp
+    std::cout << "Chains of 4 matrices" << std::endl;
+    const vmath::mat4 t1 = vmath::translate (-0.8f, 0.f, 0.f);
+    const vmath::mat4 t2 = vmath::translate (0.f, 0.f, 0.06f);
+    std::vector<vmath::mat4> world (n);
+
+    auto eager = [&] {
+        for (size_t i = 0; i < n; i++) ref[i] = parents[i] * t1 * local[i] * t2;
+    };
+    auto lazy = [&] {
+        for (size_t i = 0; i < n; i++)
+            world[i] = vmath::chain (parents[i]) * t1 * local[i] * t2;
+    };
+    t_ref = best_time (nb_reps, eager);
+    print_line ("operator*", t_ref, n, t_ref, true);
+    print_instructions (count_instructions (eager), n);
+    t = best_time (nb_reps, lazy);
+    ok = memcmp (ref.data(), world.data(), n * sizeof (vmath::mat4)) == 0;
+    all_ok = all_ok && ok;
+    print_line ("chain", t, n, t_ref, ok);
+    print_instructions (count_instructions (lazy), n);
+
+    // La même chaîne appliquée à un point
+    std::cout << "Chains of 4 matrices applied to a point" << std::endl;
+    const vmath::vec4 p (0.1f, 0.2f, 0.3f, 1.f);
+    std::vector<vmath::vec4> pos (n), pos2 (n);
+    auto eager_point = [&] {
+        for (size_t i = 0; i < n; i++)
+            pos[i] = vmath::transform (parents[i] * t1 * local[i] * t2, p);
+    };
+    auto lazy_point = [&] {
+        for (size_t i = 0; i < n; i++)
+            pos2[i] = vmath::chain (parents[i]) * t1 * local[i] * t2 * p;
+    };
+    t_ref = best_time (nb_reps, eager_point);
+    print_line ("operator*", t_ref, n, t_ref, true);
+    print_instructions (count_instructions (eager_point), n);
+    t = best_time (nb_reps, lazy_point);
+    // Ordre des opérations différent : comparaison à l'arrondi près
+    ok = true;
+    for (size_t i = 0; i < n; i++)
+        for (int k = 0; k < 4; k++)
+            ok = ok && std::fabs (pos[i][k] - pos2[i][k]) <= 1e-5f;
+    all_ok = all_ok && ok;
+    print_line ("chain right to left", t, n, t_ref, ok);
+    print_instructions (count_instructions (lazy_point), n);
+
+    // Chaîne du pédalier de dessin.cpp, de 1000 à 1000000 maillons ;
+    // comparé au temps par maillon de la plus courte
+    std::cout << "Chain links on the pedalier path" << std::endl;
+    ChainPath path (-0.8f, 0.f, 0.6f, 1.f, 0.f, 0.2f);
+    ThreadPool pool;
+    double t_link = 0;
+    for (int nb = 1000; nb <= 1000000; nb *= 10) {
+        std::vector<vmath::Affine> links (nb);
+        double s0 = 0;
+        t = best_time (std::max (1, nb_reps / 5), [&] {
+            path.place (s0, nb, 0, nb, links.data());
+            s0 += 0.01;
+        });
+        if (nb == 1000) t_link = t / nb;
+        std::string name = "place " + std::to_string (nb);
+        print_line (name.c_str(), t, nb, t_link * nb, true);
+        t = best_time (std::max (1, nb_reps / 5), [&] {
+            path.place_parallel (s0, nb, links.data(), &pool);
+            s0 += 0.01;
+        });
+        name = "place_parallel " + std::to_string (nb);
+        print_line (name.c_str(), t, nb, t_link * nb, true);
+    }
+
+    return all_ok ? 0 : 1;
+}
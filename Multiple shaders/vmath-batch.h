@@ -0,0 +1,320 @@
+/*
+    Lots de matrices 4x4 rangés en structure de tableaux (SoA)
+
+    Un Mat4Batch de n matrices contient 16 tableaux de n flottants, un par
+    coefficient : le coefficient (colonne c, ligne l) de toutes les matrices
+    est contigu, si bien qu'une instruction SIMD traite 4 (SSE) ou 8 (AVX2)
+    matrices à la fois, sans aucun réarrangement.
+
+    batch_mul() calcule parent * locale pour tout le lot, avec le même ordre
+    d'opérations que vmath::matNM::operator* : les résultats sont identiques
+    bit à bit quel que soit le jeu d'instructions. Seul le noyau AVX2 bat
+    operator* (transform-bench) ; sans AVX2, batch_mul() fait simplement
+    operator* matrice par matrice, les noyaux SoA scalaire et SSE étant
+    plus lents que lui.
+
+    batch_normal() calcule les matrices des normales d'un lot de matrices
+    monde, avec les calculs de vmath::normal() (comatrice / déterminant).
+*/
+
+#ifndef VMATH_BATCH_H
+#define VMATH_BATCH_H
+
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+
+#include "vmath.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define VMATH_BATCH_X86
+#include <immintrin.h>
+#endif
+
+namespace vmath
+{
+    enum BatchIsa { BATCH_SCALAR, BATCH_SSE, BATCH_AVX2 };
+
+    inline const char* batch_isa_name (BatchIsa isa)
+    {
+        switch (isa) {
+            case BATCH_SCALAR : return "scalar";
+            case BATCH_SSE    : return "SSE";
+            case BATCH_AVX2   : return "AVX2";
+        }
+        return "?";
+    }
+
+    // Meilleur jeu d'instructions disponible, détecté une seule fois
+    inline BatchIsa batch_best_isa()
+    {
+#ifdef VMATH_BATCH_X86
+        static BatchIsa isa = __builtin_cpu_supports ("avx2") ? BATCH_AVX2 :
+            __builtin_cpu_supports ("sse2") ? BATCH_SSE : BATCH_SCALAR;
+        return isa;
+#else
+        return BATCH_SCALAR;
+#endif
+    }
+
+
+    // Lot de matrices NxN : N*N tableaux, un par coefficient
+    template <int N>
+    class MatBatch
+    {
+    public:
+        typedef matNM<float, N, N> matrix_type;
+
+        // Nombre de matrices traitées par pas : la taille allouée est
+        // arrondie à un multiple, les coefficients en trop valent 0
+        static const size_t LANES = 8;
+
+        MatBatch() = default;
+        explicit MatBatch (size_t n) { resize (n); }
+        MatBatch (const MatBatch&) = delete;
+        MatBatch& operator= (const MatBatch&) = delete;
+
+        ~MatBatch() { std::free (m_data); }
+
+        // Change le nombre de matrices ; le contenu est perdu, sauf si la
+        // capacité ne change pas (seules les voies en trop sont remises à 0)
+        void resize (size_t n)
+        {
+            size_t capacity = (n + LANES-1) / LANES * LANES;
+            if (capacity != m_capacity) {
+                std::free (m_data);
+                m_data = capacity ? static_cast<float*> (std::aligned_alloc (
+                    32, capacity * N*N * sizeof (float))) : nullptr;
+                m_capacity = capacity;
+                if (m_data) memset (m_data, 0, m_capacity * N*N * sizeof (float));
+            }
+            else if (n < m_capacity)
+                for (int k = 0; k < N*N; k++)
+                    memset (plane (k) + n, 0, (m_capacity - n) * sizeof (float));
+            m_size = n;
+        }
+
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+
+        // Tableau du coefficient (colonne c, ligne l) : plane (c*N + l)
+        float* plane (int k) { return m_data + k * m_capacity; }
+        const float* plane (int k) const { return m_data + k * m_capacity; }
+
+        void set (size_t i, const matrix_type& m)
+        {
+            for (int c = 0; c < N; c++)
+                for (int l = 0; l < N; l++) plane (c*N + l)[i] = m[c][l];
+        }
+
+        matrix_type get (size_t i) const
+        {
+            matrix_type m;
+            for (int c = 0; c < N; c++)
+                for (int l = 0; l < N; l++) m[c][l] = plane (c*N + l)[i];
+            return m;
+        }
+
+    private:
+        float* m_data = nullptr;
+        size_t m_size = 0, m_capacity = 0;
+    };
+
+    typedef MatBatch<4> Mat4Batch;
+    typedef MatBatch<3> Mat3Batch;
+
+
+    namespace batch_detail
+    {
+        // Noyaux de batch_mul. ONE : a est une seule matrice
+        // répétée (16 coefficients), sinon a[k] est le plan k d'un lot de
+        // même taille que b. out[c][l] = somme sur n de a[n][l] * b[c][n],
+        // dans l'ordre de n. Les plans d'une même colonne de b sont tous
+        // lus avant d'écrire cette colonne de out : out peut être a ou b.
+        struct Planes {
+            const float* a[16];
+            const float* b[16];
+            float* out[16];
+        };
+
+        // Sans AVX2 : operator* matrice par matrice, sur les n premières
+        template <bool ONE>
+        inline void mul_each (const Planes& planes, size_t n)
+        {
+            // Copie locale : avec -fno-strict-aliasing, une écriture dans
+            // out pourrait sinon modifier les pointeurs de planes
+            Planes p = planes;
+            mat4 a, b;
+            for (size_t i = 0; i < n; i++) {
+                for (int c = 0; c < 4; c++)
+                    for (int l = 0; l < 4; l++) {
+                        if (!ONE || i == 0)
+                            a[c][l] = ONE ? *p.a[c*4 + l] : p.a[c*4 + l][i];
+                        b[c][l] = p.b[c*4 + l][i];
+                    }
+                mat4 m = a * b;
+                for (int c = 0; c < 4; c++)
+                    for (int l = 0; l < 4; l++) p.out[c*4 + l][i] = m[c][l];
+            }
+        }
+
+#ifdef VMATH_BATCH_X86
+        // Sans FMA : même arrondi que operator*
+        template <bool ONE>
+        __attribute__ ((target ("avx2")))
+        inline void mul_avx2 (const Planes& p, size_t capacity)
+        {
+            __m256 av[16];
+            if (ONE)
+                for (int k = 0; k < 16; k++) av[k] = _mm256_set1_ps (*p.a[k]);
+
+            for (size_t i = 0; i < capacity; i += 8) {
+                if (!ONE)
+                    for (int k = 0; k < 16; k++) av[k] = _mm256_load_ps (p.a[k] + i);
+                for (int c = 0; c < 4; c++) {
+                    __m256 bv[4];
+                    for (int n = 0; n < 4; n++)
+                        bv[n] = _mm256_load_ps (p.b[c*4 + n] + i);
+                    for (int l = 0; l < 4; l++) {
+                        __m256 sum = _mm256_setzero_ps();
+                        for (int n = 0; n < 4; n++)
+                            sum = _mm256_add_ps (sum, _mm256_mul_ps (av[n*4 + l], bv[n]));
+                        _mm256_store_ps (p.out[c*4 + l] + i, sum);
+                    }
+                }
+            }
+        }
+#endif
+
+        // Matrice des normales pour les voies de V (float, ou vecteur GCC
+        // de 4 ou 8 float) à partir de l'indice i. Les opérations sont
+        // celles de vmath::normal() : mêmes résultats bit à bit.
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void normal_lanes (const float* const a[16], float* const out[9],
+            size_t i)
+        {
+            V m[3][3];
+            for (int c = 0; c < 3; c++)
+                for (int l = 0; l < 3; l++)
+                    memcpy (&m[c][l], a[c*4 + l] + i, sizeof (V));
+
+            V d = m[0][0] * m[1][1] * m[2][2]
+                + m[1][0] * m[2][1] * m[0][2]
+                + m[2][0] * m[0][1] * m[1][2]
+                - m[0][2] * m[1][1] * m[2][0]
+                - m[1][2] * m[2][1] * m[0][0]
+                - m[2][2] * m[0][1] * m[1][0];
+            V k = 1.f / d;
+
+            V r[3][3] = {
+                { (m[1][1]*m[2][2] - m[1][2]*m[2][1]) * k,
+                  (m[1][2]*m[2][0] - m[1][0]*m[2][2]) * k,
+                  (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * k },
+                { (m[0][2]*m[2][1] - m[0][1]*m[2][2]) * k,
+                  (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * k,
+                  (m[0][1]*m[2][0] - m[0][0]*m[2][1]) * k },
+                { (m[0][1]*m[1][2] - m[0][2]*m[1][1]) * k,
+                  (m[0][2]*m[1][0] - m[0][0]*m[1][2]) * k,
+                  (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * k } };
+
+            // Non inversible : identité, comme vmath::inv()
+            V zero = d - d, one = zero + 1.f;
+            for (int c = 0; c < 3; c++)
+                for (int l = 0; l < 3; l++) {
+                    V v = d == zero ? (c == l ? one : zero) : r[c][l];
+                    memcpy (out[c*3 + l] + i, &v, sizeof (V));
+                }
+        }
+
+        inline void normal_scalar (const float* const a[16],
+            float* const out[9], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i++)
+                normal_lanes<float> (a, out, i);
+        }
+
+#ifdef VMATH_BATCH_X86
+        typedef float v4sf __attribute__ ((vector_size (16)));
+        typedef float v8sf __attribute__ ((vector_size (32)));
+
+        __attribute__ ((target ("sse2")))
+        inline void normal_sse (const float* const a[16], float* const out[9],
+            size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 4)
+                normal_lanes<v4sf> (a, out, i);
+        }
+
+        __attribute__ ((target ("avx2")))
+        inline void normal_avx2 (const float* const a[16], float* const out[9],
+            size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 8)
+                normal_lanes<v8sf> (a, out, i);
+        }
+#endif
+
+        template <bool ONE>
+        inline void mul (const Planes& p, size_t n, size_t capacity, BatchIsa isa)
+        {
+#ifdef VMATH_BATCH_X86
+            if (isa == BATCH_AVX2) { mul_avx2<ONE> (p, capacity); return; }
+#endif
+            mul_each<ONE> (p, n);
+        }
+    }
+
+
+    // out[i] = parent * local[i] : tous les noeuds d'un même parent
+    inline void batch_mul (const mat4& parent, const Mat4Batch& local,
+        Mat4Batch& out, BatchIsa isa = batch_best_isa())
+    {
+        if (out.size() != local.size()) out.resize (local.size());
+        batch_detail::Planes p;
+        const float* a = parent;
+        for (int k = 0; k < 16; k++) {
+            p.a[k] = a + k;
+            p.b[k] = local.plane (k);
+            p.out[k] = out.plane (k);
+        }
+        batch_detail::mul<true> (p, local.size(), local.capacity(), isa);
+    }
+
+    // out[i] = parent[i] * local[i] ; out peut être l'une des deux entrées
+    inline void batch_mul (const Mat4Batch& parent, const Mat4Batch& local,
+        Mat4Batch& out, BatchIsa isa = batch_best_isa())
+    {
+        if (out.size() != local.size()) out.resize (local.size());
+        batch_detail::Planes p;
+        for (int k = 0; k < 16; k++) {
+            p.a[k] = parent.plane (k);
+            p.b[k] = local.plane (k);
+            p.out[k] = out.plane (k);
+        }
+        batch_detail::mul<false> (p, local.size(), local.capacity(), isa);
+    }
+
+    // out[i] = matrice des normales de world[i] (mineur 3x3 inversé,
+    // transposé), comme vmath::normal()
+    inline void batch_normal (const Mat4Batch& world, Mat3Batch& out,
+        BatchIsa isa = batch_best_isa())
+    {
+        if (out.size() != world.size()) out.resize (world.size());
+        const float* a[16];
+        float* o[9];
+        for (int k = 0; k < 16; k++) a[k] = world.plane (k);
+        for (int k = 0; k < 9; k++) o[k] = out.plane (k);
+#ifdef VMATH_BATCH_X86
+        if (isa == BATCH_AVX2) {
+            batch_detail::normal_avx2 (a, o, world.capacity()); return;
+        }
+        if (isa == BATCH_SSE) {
+            batch_detail::normal_sse (a, o, world.capacity()); return;
+        }
+#endif
+        batch_detail::normal_scalar (a, o, world.capacity());
+    }
+}
+
+#endif // VMATH_BATCH_H
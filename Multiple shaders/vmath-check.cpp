@@ -0,0 +1,193 @@
+/*
+    Conformité des spécialisations SSE de vmath.h
+
+    Les templates génériques de vmath sont instanciés avec RefFloat, un float
+    enveloppé qui ne bénéficie d'aucune spécialisation : ce sont exactement
+    les boucles d'origine, en arithmétique float. Chaque opération de vec4 et
+    mat4 est comparée sur des valeurs aléatoires : égalité bit à bit, sauf
+    dot() et length() (sommation par paires), dont l'écart est toléré
+    jusqu'à 4 * FLT_EPSILON * somme des |a[i] * b[i]|, la borne d'erreur
+    d'une somme de 4 termes quel que soit l'ordre. Affiche aussi le temps de
+    mat4 * mat4 dans les deux versions.
+
+    Vérifie aussi AxisRotation::constant de vmath-xform.h (cos et sin
+    constexpr) : égalité bit à bit avec la version cosf/sinf pour les
+    multiples de 90 degrés, écart de 4 * FLT_EPSILON au plus ailleurs ;
+    et l'indicateur rigid des deux versions, pour un axe non unitaire et
+    deux axes unitaires.
+
+    Usage : vmath-check [nb_essais]
+*/
+
+#include <iostream>
+#include <chrono>
+#include <cfloat>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "vmath.h"
+#include "vmath-xform.h"
+
+// Évaluée à la compilation
+static constexpr vmath::Affine k_bras =
+    vmath::Translation (0.5f, 0.f, 0.f) * vmath::AxisRotation::constant (90.f, 0.f, 1.f, 0.f);
+static_assert (k_bras.kind == vmath::XF_RIGID, "rotation d'axe unitaire");
+
+
+struct RefFloat
+{
+    float v;
+    RefFloat() = default;
+    RefFloat (float x) : v {x} {}
+    RefFloat operator+ (RefFloat o) const { return v + o.v; }
+    RefFloat operator- (RefFloat o) const { return v - o.v; }
+    RefFloat operator* (RefFloat o) const { return v * o.v; }
+    RefFloat operator/ (RefFloat o) const { return v / o.v; }
+    RefFloat operator-() const { return -v; }
+    RefFloat& operator+= (RefFloat o) { v += o.v; return *this; }
+    explicit operator float() const { return v; }
+};
+
+RefFloat sqrt (RefFloat x) { return std::sqrt (x.v); }
+
+typedef vmath::vecN<RefFloat, 4> ref_vec4;
+typedef vmath::matNM<RefFloat, 4, 4> ref_mat4;
+
+
+float random_float()
+{
+    return (rand() / float (RAND_MAX) - 0.5f) * 20.f;
+}
+
+void random_fill (vmath::vec4& v, ref_vec4& rv)
+{
+    for (int i = 0; i < 4; i++) rv[i] = v[i] = random_float();
+}
+
+void copy_mat (const vmath::mat4& m, ref_mat4& rm)
+{
+    for (int c = 0; c < 4; c++)
+        for (int l = 0; l < 4; l++) rm[c][l] = m[c][l];
+}
+
+void random_fill (vmath::mat4& m, ref_mat4& rm)
+{
+    for (int c = 0; c < 4; c++)
+        for (int l = 0; l < 4; l++) m[c][l] = random_float();
+    copy_mat (m, rm);
+}
+
+
+int nb_errors = 0;
+
+void check_bits (const char* name, const void* simd, const void* ref, size_t size)
+{
+    if (memcmp (simd, ref, size) == 0) return;
+    if (nb_errors++ < 10)
+        std::cout << "### " << name << ": results differ" << std::endl;
+}
+
+void check_close (const char* name, float simd, float ref, float scale)
+{
+    if (std::fabs (simd - ref) <= 4 * FLT_EPSILON * scale) return;
+    if (nb_errors++ < 10)
+        std::cout << "### " << name << ": " << simd << " vs " << ref << std::endl;
+}
+
+
+int main (int argc, char* argv[])
+{
+    int nb_tests = argc > 1 ? atoi (argv[1]) : 100000;
+#ifdef VMATH_SIMD
+    std::cout << "vmath SIMD specializations: SSE" << std::endl;
+#else
+    std::cout << "vmath SIMD specializations: disabled" << std::endl;
+#endif
+
+    for (int t = 0; t < nb_tests; t++) {
+        vmath::vec4 a, b;
+        vmath::mat4 m, n;
+        ref_vec4 ra, rb;
+        ref_mat4 rm, rn;
+        random_fill (a, ra);
+        random_fill (b, rb);
+        random_fill (m, rm);
+        random_fill (n, rn);
+        float s = random_float();
+
+        vmath::vec4 v;
+        ref_vec4 rv;
+        v = a + b;  rv = ra + rb;  check_bits ("vec4 + vec4", &v, &rv, sizeof v);
+        v = a - b;  rv = ra - rb;  check_bits ("vec4 - vec4", &v, &rv, sizeof v);
+        v = -a;     rv = -ra;      check_bits ("-vec4", &v, &rv, sizeof v);
+        v = a * b;  rv = ra * rb;  check_bits ("vec4 * vec4", &v, &rv, sizeof v);
+        v = a * s;  rv = ra * RefFloat (s);  check_bits ("vec4 * float", &v, &rv, sizeof v);
+        v = a / b;  rv = ra / rb;  check_bits ("vec4 / vec4", &v, &rv, sizeof v);
+        v = a / s;  rv = ra / RefFloat (s);  check_bits ("vec4 / float", &v, &rv, sizeof v);
+        v = a;  v += b;  rv = ra;  rv += rb;  check_bits ("vec4 += vec4", &v, &rv, sizeof v);
+
+        float abs_sum = 0;
+        for (int i = 0; i < 4; i++) abs_sum += std::fabs (a[i] * b[i]);
+        check_close ("dot", vmath::dot (a, b), float (vmath::dot (ra, rb)),
+            abs_sum);
+        float len = float (vmath::length (ra));
+        check_close ("length", vmath::length (a), len, len);
+        v = vmath::normalize (a);
+        rv = ra / RefFloat (vmath::length (a));
+        check_bits ("normalize", &v, &rv, sizeof v);
+
+        vmath::mat4 p = m * n;
+        ref_mat4 rp = rm * rn;
+        check_bits ("mat4 * mat4", &p, &rp, sizeof p);
+        v = a * m;  rv = ra * rm;  check_bits ("vec4 * mat4", &v, &rv, sizeof v);
+    }
+
+    // Rotations constexpr : angles de -720 à 720 degrés par quart de degré,
+    // autour d'un axe non unitaire puis de deux axes unitaires, les seuls
+    // classés rigides
+    const float axes[3][3] = { {0.f, 1.f, 0.15f}, {0.f, 0.f, 1.f}, {0.6f, 0.f, 0.8f} };
+    for (int a = 0; a < 3; a++) {
+        const float* axis = axes[a];
+        bool unit = a > 0;
+        for (int q = -2880; q <= 2880; q++) {
+            float angle = q * 0.25f;
+            vmath::AxisRotation r (angle, axis[0], axis[1], axis[2]);
+            vmath::AxisRotation rc = vmath::AxisRotation::constant (angle,
+                axis[0], axis[1], axis[2]);
+            check_bits ("AxisRotation::rigid", &r.rigid, &unit, sizeof unit);
+            check_bits ("AxisRotation::constant rigid", &rc.rigid, &unit, sizeof unit);
+            if (q % 360 == 0)
+                check_bits ("AxisRotation::constant", r.m, rc.m, sizeof r.m);
+            for (int j = 0; j < 3; j++)
+                for (int i = 0; i < 3; i++)
+                    check_close ("AxisRotation::constant", rc.m[j][i], r.m[j][i], 1.f);
+        }
+    }
+    vmath::AxisRotation r90 (90.f, 0.f, 1.f, 0.f);
+    vmath::Affine bras = vmath::Translation (0.5f, 0.f, 0.f) * r90;
+    check_bits ("constexpr Affine", bras.m, k_bras.m, sizeof bras.m);
+
+    // Temps de mat4 * mat4 : une chaîne de produits dépendants
+    const int nb_products = 1000000;
+    vmath::mat4 m = vmath::rotate (1.f, 0.f, 1.f, 0.f), acc = vmath::mat4::identity();
+    ref_mat4 rm, racc;
+    copy_mat (m, rm);
+    copy_mat (acc, racc);
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nb_products; i++) acc = acc * m;
+    std::chrono::duration<double> t_simd = std::chrono::steady_clock::now() - start;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < nb_products; i++) racc = racc * rm;
+    std::chrono::duration<double> t_ref = std::chrono::steady_clock::now() - start;
+    check_bits ("mat4 * mat4 chain", &acc, &racc, sizeof acc);
+
+    std::cout << "mat4 * mat4: " << t_simd.count() * 1e9 / nb_products
+        << " ns (generic " << t_ref.count() * 1e9 / nb_products << " ns)"
+        << std::endl;
+
+    std::cout << nb_tests << " random tests, " << nb_errors << " errors"
+        << std::endl;
+    return nb_errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,152 @@
+/*
+    Produits de matrices différés : vmath::chain()
+
+    a * b * c * d sur des mat4 construit une mat4 temporaire de 64 octets
+    à chaque produit, relue aussitôt par le suivant. Ici
+
+        mat_world = vmath::chain (a) * b * c * d;
+
+    ne fait que relever les adresses des opérandes (MatChain<N>) ; le
+    produit est calculé une seule fois, à la conversion en mat4 ou par
+    eval_into(), de gauche à droite avec l'accumulateur gardé en registres
+    SSE et écrit une seule fois dans la destination. Les sommes sont celles
+    de matNM::operator* (et de sa spécialisation SSE) : le résultat est
+    identique bit à bit à a * b * c * d. Sans SSE (VMATH_NO_SIMD),
+    l'évaluation se ramène aux produits habituels dans un accumulateur.
+
+    Appliquée à un vecteur, la chaîne est évaluée de droite à gauche,
+    a * (b * (c * (d * v))) : 16 multiplications par matrice au lieu de 64
+    par produit de matrices. Le résultat peut alors différer de
+    (a * b * c * d) * v à l'arrondi près.
+
+    Opt-in : operator* de vmath.h reste inchangé, les appels existants
+    (glUniformMatrix4fv (..., a * b) par exemple) compilent tels quels.
+
+    Une MatChain ne garde que des adresses : elle doit être consommée dans
+    l'expression qui la construit (pas de auto c = vmath::chain (...)),
+    les temporaires comme vmath::translate (...) étant détruits à la fin de
+    l'expression.
+*/
+
+#ifndef VMATH_EXPR_H
+#define VMATH_EXPR_H
+
+#include "vmath.h"
+
+namespace vmath
+{
+#ifdef VMATH_SIMD
+    namespace expr_detail
+    {
+        // Colonne de (c0 c1 c2 c3) * b, b étant la colonne de droite
+        static inline __m128 column (__m128 c0, __m128 c1, __m128 c2, __m128 c3,
+            const vec4& b)
+        {
+            __m128 sum = _mm_setzero_ps();
+            sum = _mm_add_ps (sum, _mm_mul_ps (c0, _mm_set1_ps (b[0])));
+            sum = _mm_add_ps (sum, _mm_mul_ps (c1, _mm_set1_ps (b[1])));
+            sum = _mm_add_ps (sum, _mm_mul_ps (c2, _mm_set1_ps (b[2])));
+            sum = _mm_add_ps (sum, _mm_mul_ps (c3, _mm_set1_ps (b[3])));
+            return sum;
+        }
+    }
+#endif
+
+    template <int N>
+    struct MatChain
+    {
+        const mat4* m[N];
+
+        MatChain (const mat4& a) : m {&a} {}
+
+        MatChain (const MatChain<N - 1>& c, const mat4& b)
+        {
+            for (int k = 0; k < N - 1; k++) m[k] = c.m[k];
+            m[N - 1] = &b;
+        }
+
+#ifdef VMATH_SIMD
+        // Accumulateur * m[K] * ... * m[N-1], déroulé à la compilation
+        template <int K>
+        __attribute__ ((always_inline))
+        void mul_from (__m128& c0, __m128& c1, __m128& c2, __m128& c3) const
+        {
+            if constexpr (K < N) {
+                const mat4& b = *m[K];
+                __m128 r0 = expr_detail::column (c0, c1, c2, c3, b[0]);
+                __m128 r1 = expr_detail::column (c0, c1, c2, c3, b[1]);
+                __m128 r2 = expr_detail::column (c0, c1, c2, c3, b[2]);
+                __m128 r3 = expr_detail::column (c0, c1, c2, c3, b[3]);
+                c0 = r0; c1 = r1; c2 = r2; c3 = r3;
+                mul_from<K + 1> (c0, c1, c2, c3);
+            }
+        }
+#endif
+
+        // out peut être l'un des opérandes : il n'est écrit qu'à la fin
+        __attribute__ ((always_inline))
+        void eval_into (mat4& out) const
+        {
+#ifdef VMATH_SIMD
+            __m128 c0 = simd::load ((*m[0])[0]), c1 = simd::load ((*m[0])[1]),
+                   c2 = simd::load ((*m[0])[2]), c3 = simd::load ((*m[0])[3]);
+            mul_from<1> (c0, c1, c2, c3);
+            _mm_storeu_ps (&out[0][0], c0);
+            _mm_storeu_ps (&out[1][0], c1);
+            _mm_storeu_ps (&out[2][0], c2);
+            _mm_storeu_ps (&out[3][0], c3);
+#else
+            // Sans SSE : un seul accumulateur, recopié à la fin
+            mat4 acc = *m[0];
+            for (int k = 1; k < N; k++) acc = acc * *m[k];
+            out = acc;
+#endif
+        }
+
+        operator mat4() const
+        {
+            mat4 result;
+            eval_into (result);
+            return result;
+        }
+    };
+
+
+    inline MatChain<1> chain (const mat4& a)
+    {
+        return MatChain<1> (a);
+    }
+
+    template <int N>
+    inline MatChain<N + 1> operator* (const MatChain<N>& c, const mat4& b)
+    {
+        return MatChain<N + 1> (c, b);
+    }
+
+    // Produit matrice * vecteur colonne, comme gl_Position = mat * pos
+    inline vec4 transform (const mat4& a, const vec4& v)
+    {
+#ifdef VMATH_SIMD
+        __m128 sum = _mm_setzero_ps();
+        for (int n = 0; n < 4; n++)
+            sum = _mm_add_ps (sum, _mm_mul_ps (simd::load (a[n]), _mm_set1_ps (v[n])));
+        return simd::store (sum);
+#else
+        vec4 result (0.0f);
+        for (int n = 0; n < 4; n++)
+            for (int i = 0; i < 4; i++) result[i] += a[n][i] * v[n];
+        return result;
+#endif
+    }
+
+    // Chaîne appliquée à un vecteur : de droite à gauche
+    template <int N>
+    inline vec4 operator* (const MatChain<N>& c, const vec4& v)
+    {
+        vec4 result = transform (*c.m[N - 1], v);
+        for (int k = N - 2; k >= 0; k--) result = transform (*c.m[k], result);
+        return result;
+    }
+}
+
+#endif // VMATH_EXPR_H
@@ -18,9 +18,33 @@
 // RQ: provoque un warning avec -O2, supprimé avec -fno-strict-aliasing
 #include "vmath.h"
 
+// Translations et rotations composées sans passer par des mat4 complètes
+#include "vmath-xform.h"
+
+// Positions et angles de la bielle-manivelle, calculés par lots
+#include "kinematics.h"
+
 #include <GLFW/glfw3.h>
 #include <GL/glu.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 bool flag_fill = false;
 
 class Cylindre {
@@ -38,6 +62,7 @@ public:
     Cylindre(double ep_cyl, double r_cyl, int nb_fac, float coul_r, float coul_v, float coul_b)
         : m_ep_cyl(ep_cyl), m_r_cyl(r_cyl), m_nb_fac(nb_fac),
           m_coul_r(coul_r), m_coul_v(coul_v), m_coul_b(coul_b) {
+        TRACE_SCOPE("Cylindre");
         generateVerticesAndColors();
     }
 
@@ -130,7 +155,6 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC = 30.0;
 const double ANIM_DURATION = 18.0;
 
 // En salle TP mettre à 0 si l'affichage "bave"
@@ -147,7 +171,12 @@ class MyApp
 {
     bool m_ok = false;
     float m_alpha = 0.0f;
-    GLFWwindow *m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow *m_window = nullptr;    // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 2;
@@ -184,13 +213,18 @@ class MyApp
     GLint m_vPos_loc, m_vCol_loc;
     GLint m_matMVP_loc;
 
+    // La bielle-manivelle, lot d'un seul mécanisme, et les transformations
+    // de ses pièces
+    kinematics::CrankSliderBatch m_mecanisme {1};
+    std::vector<vmath::Affine> m_pieces;
+
     void animate()
     {
         auto frac_part = [](double x)
         { return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime(); // durée depuis init
+        double time = m_ctx.get_time(); // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a * 360.0;
@@ -198,6 +232,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable(GL_DEPTH_TEST);
@@ -219,12 +254,23 @@ class MyApp
         m_vPos_loc = glGetAttribLocation(m_program, "vPos");
         m_vCol_loc = glGetAttribLocation(m_program, "vCol");
         m_matMVP_loc = glGetUniformLocation(m_program, "matMVP");
+
+        // Manivelle de centre G = (1, 0, 0.06), GH = 0.4, bielle HJ = 0.8,
+        // piston K à 2.4 à gauche de G
+        m_mecanisme.field(kinematics::CS_GX)[0] = 1.0f;
+        m_mecanisme.field(kinematics::CS_GY)[0] = 0.0f;
+        m_mecanisme.field(kinematics::CS_GZ)[0] = 0.06f;
+        m_mecanisme.field(kinematics::CS_GH)[0] = 0.4f;
+        m_mecanisme.field(kinematics::CS_HJ)[0] = 0.8f;
+        m_mecanisme.field(kinematics::CS_GK)[0] = -2.4f;
     }
 
     void displayGL()
     {
+        TRACE_SCOPE("displayGL");
         // glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass("clear");
 
         glUseProgram(m_program);
 
@@ -233,95 +279,100 @@ class MyApp
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, matrix);
 
         // Dessins
-        float GH = 0.4f;
-        float HJ = 0.8f;
-
+        constexpr float HJ = 0.8f;
+
+        // Sous-transformations constantes des barres, calculées à la compilation
+        static constexpr vmath::AxisRotation barre_horizontale =
+            vmath::AxisRotation::constant(90.0f, 0.f, 1.f, 0.f);
+        static constexpr vmath::Affine demi_barre_hj =
+            vmath::Translation(HJ / 2.0f, 0.f, 0.1f) * barre_horizontale;
+        static constexpr vmath::Translation dessus_01 (0.f, 0.f, 0.1f);
+        static constexpr vmath::Translation dessus_02 (0.f, 0.f, 0.2f);
+
+        // H, J, beta et JK, puis les transformations des pièces
+        m_mecanisme.field(kinematics::CS_ALPHA)[0] = m_alpha;
+        kinematics::solve(m_mecanisme);
+        kinematics::emit_links(m_mecanisme, m_pieces);
+        const vmath::Affine* pieces = &m_pieces[0];
 
         vmath::vec3 O {1.0f, 0.0f, 0.0f};
-        vmath::vec3 G {1.0f, 0.0f, 0.06f};
 
         // Dessiner la grande Roue
-        vmath::mat4 translatedMatrix1 = matrix * vmath::translate(O);
-        translatedMatrix1 = translatedMatrix1 * vmath::rotate(static_cast<float>(m_alpha * 180.0 / M_PI), 0.f, 0.0f, 1.f);
+        vmath::mat4 translatedMatrix1 = matrix * vmath::Translation(O);
+        translatedMatrix1 = translatedMatrix1 * vmath::AxisRotation(static_cast<float>(m_alpha * 180.0 / M_PI), 0.f, 0.0f, 1.f);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix1);
         Cylindre roue(0.2f, 0.5f, 20, 0.0f, 0.0f, 1.0f);
         roue.draw();
 
         // Le petit cylindre au centre de la roue
         Cylindre cylindre2(0.8f, 0.05f, 20, 1.0f * 0.8, 0.0f * 0.8, 0.0f * 0.8);
-        vmath::mat4 translatedMatrix11 = matrix * vmath::translate(O[0], O[1], O[2]-0.2f);
+        vmath::mat4 translatedMatrix11 = matrix * vmath::Translation(O[0], O[1], O[2]-0.2f);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix11);
         cylindre2.draw();
-
-        vmath::vec3 H;
-        H[0] = G[0] + GH * cos(m_alpha);
-        H[1] = G[1] + GH * sin(m_alpha);
-        H[2] = G[2];
+        m_gpu_timer.end_object("roue");
 
         // Cylindre autour du point H (petit)
-        vmath::mat4 translatedMatrix3 = matrix * vmath::translate(H);
+        vmath::mat4 translatedMatrix3 = matrix * pieces[kinematics::CS_LINK_PIN];
         Cylindre cylindre3(0.4f,  0.05f, 20, 0.0f * 0.8, 1.0f * 0.8, 0.0f * 0.8);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix3);
         cylindre3.draw();
 
         // Cylindre autour du point H (grand)
-        vmath::mat4 translatedMatrix4 = matrix * vmath::translate(H[0], H[1], H[2]+0.1f);
+        vmath::mat4 translatedMatrix4 = matrix * pieces[kinematics::CS_LINK_PIN] * dessus_01;
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix4);
         Cylindre cylindre4(0.1f, 0.1f, 20, 0.0f * 0.8, 1.0f * 0.8, 0.0f * 0.8);
         cylindre4.draw();
+        m_gpu_timer.end_object("maneton");
 
 
-        // Calcule de I, J et beta
-        vmath::vec3 I {H[0],G[1],G[2]};
-        vmath::vec3 J{ I[0] - std::sqrt(std::pow(HJ, 2) - std::pow(GH * sin(m_alpha), 2)), 0.0f, G[2]};
-        float beta = std::atan(H[1]/abs(J[0]-H[0]));
-
-        //La barre HJ
-        vmath::mat4 translatedMatrix5 = matrix * vmath::translate(J[0], J[1], J[2]+0.1f);
-        translatedMatrix5 = translatedMatrix5 * vmath::rotate(static_cast<float>(beta * 180.0 / M_PI) , 0.f, 0.f, 1.f);
-        translatedMatrix5 = translatedMatrix5 * vmath::translate(HJ / 2.0f, 0.f, 0.f);
-        translatedMatrix5 = translatedMatrix5 * vmath::rotate(90.0f, 0.f, 1.f, 0.f);
+        //La barre HJ, tournée de beta autour de J
+        vmath::mat4 translatedMatrix5 = matrix * pieces[kinematics::CS_LINK_ROD];
+        translatedMatrix5 = translatedMatrix5 * demi_barre_hj;
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix5);
         Cylindre cylindre5(HJ, 0.05f, 20, 1.0f * 0.8, 0.0f * 0.8, 0.0f * 0.8);
         cylindre5.draw();
+        m_gpu_timer.end_object("bielle");
 
         //Cylindre vertical au J
-        vmath::mat4 translatedMatrix6 = matrix * vmath::translate(J[0], J[1], J[2]+0.2f);
+        vmath::mat4 translatedMatrix6 = matrix * pieces[kinematics::CS_LINK_SLIDER] * dessus_02;
         Cylindre cylindre6(0.2f, 0.04f, 20, 0.0f * 0.8, 1.0f * 0.8, 0.0f * 0.8);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix6);
         cylindre6.draw();
 
         // Les deux cylindres horizontaux au J rose et vert
-        vmath::mat4 translatedMatrix10 = matrix * vmath::translate(J[0], J[1], J[2]+0.1f);
+        vmath::mat4 translatedMatrix10 = matrix * pieces[kinematics::CS_LINK_SLIDER] * dessus_01;
         Cylindre cylindre7(0.1f, 0.1f, 20, 0.0f * 0.8, 1.0f * 0.8, 0.0f * 0.8);
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix10);
         cylindre7.draw();
 
         Cylindre cylindre8(0.1f, 0.08f, 20, 1.0f, 1.0f * 0.55, 1.0f * 0.8);
-        vmath::mat4 translatedMatrix7 = matrix * vmath::translate(J[0], J[1], J[2]+0.2f);
+        vmath::mat4 translatedMatrix7 = matrix * pieces[kinematics::CS_LINK_SLIDER] * dessus_02;
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix7);
         cylindre8.draw();
+        m_gpu_timer.end_object("coulisseau");
 
         // Barre JK
-        vmath::vec3 K{G[0]-2.4f, G[1], G[2]};
+        auto champ = [this](int k) { return m_mecanisme.field(k)[0]; };
+        vmath::vec3 J {champ(kinematics::CS_JX), champ(kinematics::CS_GY), champ(kinematics::CS_GZ)};
+        vmath::vec3 K {champ(kinematics::CS_GX) + champ(kinematics::CS_GK), J[1], J[2]};
 
-        float JK = abs(vmath::length(K - J));
+        float JK = champ(kinematics::CS_JK);
         vmath::vec3 centre_barre = (J+K) *0.5f;
-        vmath::mat4 translatedMatrix8 = matrix * vmath::translate(centre_barre[0], centre_barre[1], centre_barre[2]+0.2f);
-        translatedMatrix8 = translatedMatrix8 * vmath::rotate(90.0f, 0.f, 1.f, 0.f);
+        vmath::mat4 translatedMatrix8 = matrix * vmath::Translation(centre_barre[0], centre_barre[1], centre_barre[2]+0.2f);
+        translatedMatrix8 = translatedMatrix8 * barre_horizontale;
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix8);
         Cylindre cylindre9(JK, 0.06f, 20, 1.0f, 1.0f * 0.55, 1.0f * 0.8);
         cylindre9.draw();
+        m_gpu_timer.end_object("barre_jk");
 
         //Le piston
-        vmath::mat4 translatedMatrix9 = matrix * vmath::translate(K[0], K[1], K[2]+0.2f);
-        translatedMatrix9 = translatedMatrix9 * vmath::rotate(90.0f, 0.f, 1.f, 0.f);
+        vmath::mat4 translatedMatrix9 = matrix * vmath::Translation(K[0], K[1], K[2]+0.2f);
+        translatedMatrix9 = translatedMatrix9 * barre_horizontale;
         glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, translatedMatrix9);
         Cylindre piston(0.4f, 0.2f, 20, 1.0f * 0.8, 0.0f * 0.8, 0.0f * 0.8);
         piston.draw();
-
-        
-
+        m_gpu_timer.end_object("piston");
+        m_gpu_timer.end_pass("scene");
     }
 
     void set_projection(vmath::mat4 &matrix)
@@ -349,6 +400,7 @@ class MyApp
 
     void compile_shader(GLuint shader, const char *name)
     {
+        TRACE_SCOPE("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader(shader);
 
@@ -374,6 +426,7 @@ class MyApp
 
     void link_program(GLuint program)
     {
+        TRACE_SCOPE("link_program");
         std::cout << "Link program...\n";
         glLinkProgram(program);
 
@@ -471,7 +524,7 @@ class MyApp
             if (that->m_anim_flag)
             {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime(0);
+                that->m_ctx.set_time(0);
             }
             break;
         case GLFW_KEY_P:
@@ -521,7 +574,7 @@ class MyApp
             print_help();
             break;
         case GLFW_KEY_ESCAPE:
-            that->m_ok = false;
+            glfwSetWindowShouldClose(window, GL_TRUE);
             break;
         case GLFW_KEY_SPACE:
         that->m_alpha += 0.2f; // Incrémenter l'angle (ajustez la valeur selon la vitesse souhaitée)
@@ -578,89 +631,144 @@ class MyApp
         std::cerr << "Error: " << description << std::endl;
     }
 
-public:
-    MyApp()
+    // Seules les options du contexte sont reconnues
+    bool parse_args(int argc, char *argv[])
     {
-        if (!glfwInit())
+        int i = 1;
+        while (i < argc)
         {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
+            int nb_args = m_ctx.parse_arg(argc, argv, i);
+            if (nb_args == 0)
+                nb_args = m_bench.parse_arg(argc, argv, i);
+            if (nb_args == 0)
+                nb_args = m_pacer.parse_arg(argc, argv, i);
+            if (nb_args == 0)
+                nb_args = m_gpu_timer.parse_arg(argc, argv, i);
+            if (nb_args == 0)
+                nb_args = m_capture.parse_arg(argc, argv, i);
+            if (nb_args < 0)
+                return false;
+            if (nb_args == 0)
+            {
+                std::cerr << "Options: " << GLContext::usage() << " "
+                          << FrameBench::usage() << " "
+                          << FramePacer::usage() << " "
+                          << GpuTimer::usage() << " "
+                          << FrameCapture::usage() << std::endl;
+                return false;
+            }
+            i += nb_args;
         }
-        glfwSetErrorCallback(on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
-
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint(GLFW_SAMPLES, NUM_SAMPLES);
+        return true;
+    }
 
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
-        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
-        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
+public:
+    MyApp(int argc, char *argv[])
+    {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config &cfg = m_ctx.config();
+        cfg.title = "Shaders et projection";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 4;
+        cfg.minor = 5;
+        cfg.profile = GLContext::PROFILE_COMPAT;
+
+        if (!parse_args(argc, argv))
+            return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled())
+            cfg.nb_frames = m_bench.total_frames();
 
-        // Création de la fenêtre
-        m_window = glfwCreateWindow(640, 480, "Shaders et projection", NULL, NULL);
-        if (!m_window)
-        {
-            std::cerr << "GLFW: window creation failed" << std::endl;
+        glfwSetErrorCallback(on_error_func);
+        if (!m_ctx.create())
             return;
-        }
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer(m_window, this);
-        glfwSetWindowSizeCallback(m_window, on_reshape_func);
-        glfwSetKeyCallback(m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent(m_window);
-        glfwSwapInterval(1);
+        if (m_window)
+        {
+            glfwSetWindowUserPointer(m_window, this);
+            glfwSetWindowSizeCallback(m_window, on_reshape_func);
+            glfwSetKeyCallback(m_window, on_key_func);
+        }
+        m_pacer.start(m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL();
+        gladLoadGLLoader(GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
                   << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize(m_window, &width, &height);
+        m_ctx.get_size(width, height);
         set_viewport(width, height);
 
         initGL();
+        if (!m_gpu_timer.start())
+            m_ok = false;
+        if (!m_capture.start(m_ctx))
+            m_ok = false;
     }
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose(m_window))
+        if (m_ok && m_bench.enabled())
+            return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers(m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag)
             {
-                glfwWaitEventsTimeout(1.0 / FRAMES_PER_SEC);
+                m_pacer.wait(m_ctx);
                 animate();
             }
             else
-                glfwWaitEvents();
+                m_ctx.wait_events();
         }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
     }
 
-    ~MyApp()
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
     {
-        if (m_window)
-            glfwDestroyWindow(m_window);
-        glfwTerminate();
+        m_anim_flag = true;
+        m_ctx.swap_interval(0);
+        m_bench.start(m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done())
+        {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture(m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
+        }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
 }; // MyApp
 
-int main()
+int main(int argc, char *argv[])
 {
-    MyApp app;
-    app.run();
+    MyApp app{argc, argv};
+    return app.run();
 }
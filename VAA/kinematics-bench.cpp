@@ -0,0 +1,233 @@
+/*
+    Banc d'essai de kinematics.h : lots de bielles-manivelles et de
+    pédales-manivelles, en mécanismes par seconde
+
+    Chaque mécanisme (paramètres et angles aléatoires) est d'abord calculé
+    avec les formules de displayGL() de cylindres.cpp, reprises telles
+    quelles : c'est la référence en temps et en exactitude. Les noyaux
+    scalaire, SSE et AVX2 de solve() doivent s'en écarter de moins de
+    TOLERANCE et donner entre eux des résultats identiques bit à bit.
+    Mesure aussi emit_links(), qui écrit les transformations des pièces.
+
+    Usage : kinematics-bench [nb_mecanismes] [nb_repetitions]
+*/
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "vmath.h"
+#include "vmath-xform.h"
+#include "kinematics.h"
+
+
+// Écart maximal toléré avec la référence, en unités de longueur et en
+// radians (les grandeurs sont de l'ordre de 1)
+const double TOLERANCE = 2e-6;
+
+
+// Meilleur temps de nb_reps exécutions de f, en secondes
+template <typename F>
+double best_time (int nb_reps, F f)
+{
+    double best = 1e30;
+    for (int r = 0; r < nb_reps; r++) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        std::chrono::duration<double> elapsed =
+            std::chrono::steady_clock::now() - start;
+        best = std::min (best, elapsed.count());
+    }
+    return best;
+}
+
+
+void print_line (const std::string& name, double seconds, size_t n, double ref,
+    double err, bool ok)
+{
+    std::cout << "  " << std::left << std::setw (22) << name << std::right
+        << std::fixed << std::setprecision (3) << std::setw (9)
+        << seconds * 1000 << " ms" << std::setprecision (1) << std::setw (8)
+        << n / seconds * 1e-6 << " M/s" << std::setprecision (2) << std::setw (7)
+        << ref / seconds << "x" << std::scientific << std::setprecision (1)
+        << std::setw (10) << err << std::defaultfloat
+        << (ok ? "" : "   ### MISMATCH") << std::endl;
+}
+
+
+// Sorties de référence d'une bielle-manivelle
+struct CrankSliderRef
+{
+    float hx, hy, jx, beta, jk;
+};
+
+// Formules de displayGL() de cylindres.cpp, généralisées à G quelconque
+CrankSliderRef crank_slider_ref (float alpha, vmath::vec3 G, float GH,
+    float HJ, float GK)
+{
+    vmath::vec3 H;
+    H[0] = G[0] + GH * cos(alpha);
+    H[1] = G[1] + GH * sin(alpha);
+    H[2] = G[2];
+
+    vmath::vec3 I {H[0],G[1],G[2]};
+    vmath::vec3 J{ float(I[0] - std::sqrt(std::pow(HJ, 2) - std::pow(GH * sin(alpha), 2))), G[1], G[2]};
+    float beta = std::atan((H[1]-G[1])/std::abs(J[0]-H[0]));
+
+    vmath::vec3 K{G[0]+GK, G[1], G[2]};
+    float JK = std::abs(vmath::length(K - J));
+
+    return CrankSliderRef {H[0], H[1], J[0], beta, JK};
+}
+
+
+// Plus grand écart entre le lot et la référence
+double crank_slider_error (const kinematics::CrankSliderBatch& b,
+    const std::vector<CrankSliderRef>& ref)
+{
+    using namespace kinematics;
+    double err = 0;
+    for (size_t i = 0; i < ref.size(); i++) {
+        const float got[5] = { b.field (CS_HX)[i], b.field (CS_HY)[i],
+            b.field (CS_JX)[i], b.field (CS_BETA)[i], b.field (CS_JK)[i] };
+        const float want[5] = { ref[i].hx, ref[i].hy, ref[i].jx, ref[i].beta,
+            ref[i].jk };
+        for (int k = 0; k < 5; k++)
+            err = std::max (err, std::fabs (double (got[k]) - want[k]));
+    }
+    return err;
+}
+
+
+// Toutes les sorties des deux lots sont identiques bit à bit
+template <int NB>
+bool same_outputs (const kinematics::Fields<NB>& a,
+    const kinematics::Fields<NB>& b, int first_output)
+{
+    for (int k = first_output; k < NB; k++)
+        if (memcmp (a.field (k), b.field (k), a.size() * sizeof (float)) != 0)
+            return false;
+    return true;
+}
+
+
+int main (int argc, char* argv[])
+{
+    using namespace kinematics;
+
+    size_t n = argc > 1 ? atol (argv[1]) : 100000;
+    int nb_reps = argc > 2 ? atoi (argv[2]) : 50;
+    if (n == 0 || nb_reps <= 0) {
+        std::cerr << "Usage: " << argv[0] << " [nb_mecanismes] [nb_repetitions]"
+            << std::endl;
+        return 1;
+    }
+
+    // Mécanismes proches de celui de cylindres.cpp, manivelle tournée de
+    // plusieurs tours dans les deux sens
+    std::mt19937 gen (1);
+    auto uniform = [&] (float a, float b) {
+        return std::uniform_real_distribution<float> (a, b) (gen);
+    };
+    CrankSliderBatch cs (n), cs_ref (n);
+    for (size_t i = 0; i < n; i++) {
+        cs.field (CS_ALPHA)[i] = uniform (-20.f, 20.f);
+        cs.field (CS_GX)[i] = uniform (-1.f, 1.f);
+        cs.field (CS_GY)[i] = uniform (-1.f, 1.f);
+        cs.field (CS_GZ)[i] = uniform (-0.1f, 0.1f);
+        cs.field (CS_GH)[i] = uniform (0.2f, 0.5f);
+        cs.field (CS_HJ)[i] = uniform (0.6f, 1.0f);
+        cs.field (CS_GK)[i] = uniform (-3.f, -2.f);
+    }
+    // Le mécanisme de cylindres.cpp, manivelle à l'horizontale
+    cs.field (CS_ALPHA)[0] = 0.f;
+    cs.field (CS_GX)[0] = 1.f;
+    cs.field (CS_GY)[0] = 0.f;
+    cs.field (CS_GZ)[0] = 0.06f;
+    cs.field (CS_GH)[0] = 0.4f;
+    cs.field (CS_HJ)[0] = 0.8f;
+    cs.field (CS_GK)[0] = -2.4f;
+    for (int k = 0; k < CS_NB_FIELDS; k++)
+        memcpy (cs_ref.field (k), cs.field (k), n * sizeof (float));
+
+    std::vector<Isa> isas { ISA_SCALAR };
+#ifdef KINEMATICS_X86
+    if (best_isa() >= ISA_SSE) isas.push_back (ISA_SSE);
+    if (best_isa() >= ISA_AVX2) isas.push_back (ISA_AVX2);
+#endif
+
+    std::cout << n << " mechanisms, best of " << nb_reps << " runs, dispatch: "
+        << isa_name (best_isa()) << ", tolerance " << TOLERANCE << std::endl;
+    bool all_ok = true;
+
+    std::cout << "Crank-slider" << std::setw (52) << "max error" << std::endl;
+    std::vector<CrankSliderRef> ref (n);
+    double t_ref = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++)
+            ref[i] = crank_slider_ref (cs.field (CS_ALPHA)[i],
+                vmath::vec3 (cs.field (CS_GX)[i], cs.field (CS_GY)[i],
+                             cs.field (CS_GZ)[i]),
+                cs.field (CS_GH)[i], cs.field (CS_HJ)[i], cs.field (CS_GK)[i]);
+    });
+    print_line ("cylindres.cpp", t_ref, n, t_ref, 0, true);
+
+    solve (cs_ref, ISA_SCALAR);
+    for (auto isa : isas) {
+        double t = best_time (nb_reps, [&] { solve (cs, isa); });
+        double err = crank_slider_error (cs, ref);
+        bool ok = err <= TOLERANCE && same_outputs (cs, cs_ref, CS_COS);
+        all_ok = all_ok && ok;
+        print_line (std::string ("solve ") + isa_name (isa), t, n, t_ref, err, ok);
+    }
+
+    std::vector<vmath::Affine> links;
+    double t = best_time (nb_reps, [&] { emit_links (cs, links); });
+    print_line ("emit_links", t, n, t_ref, 0, true);
+
+    // Pédales : référence en cos et sin de la libm
+    std::cout << "Pedal-crank" << std::endl;
+    PedalCrankBatch pc (n), pc_ref (n);
+    for (size_t i = 0; i < n; i++) {
+        pc.field (PC_ALPHA)[i] = uniform (-20.f, 20.f);
+        pc.field (PC_CX)[i] = uniform (-1.f, 1.f);
+        pc.field (PC_CY)[i] = uniform (-1.f, 1.f);
+        pc.field (PC_CZ)[i] = uniform (-0.1f, 0.1f);
+        pc.field (PC_LEN)[i] = uniform (0.2f, 0.5f);
+    }
+    for (int k = 0; k < PC_NB_FIELDS; k++)
+        memcpy (pc_ref.field (k), pc.field (k), n * sizeof (float));
+
+    std::vector<float> px (n), py (n);
+    t_ref = best_time (nb_reps, [&] {
+        for (size_t i = 0; i < n; i++) {
+            float alpha = pc.field (PC_ALPHA)[i], len = pc.field (PC_LEN)[i];
+            px[i] = pc.field (PC_CX)[i] + len * std::cos (alpha);
+            py[i] = pc.field (PC_CY)[i] + len * std::sin (alpha);
+        }
+    });
+    print_line ("std::cos, std::sin", t_ref, n, t_ref, 0, true);
+
+    solve (pc_ref, ISA_SCALAR);
+    for (auto isa : isas) {
+        double t = best_time (nb_reps, [&] { solve (pc, isa); });
+        double err = 0;
+        for (size_t i = 0; i < n; i++)
+            err = std::max (err, std::max (
+                std::fabs (double (pc.field (PC_PX)[i]) - px[i]),
+                std::fabs (double (pc.field (PC_PY)[i]) - py[i])));
+        bool ok = err <= TOLERANCE && same_outputs (pc, pc_ref, PC_COS);
+        all_ok = all_ok && ok;
+        print_line (std::string ("solve ") + isa_name (isa), t, n, t_ref, err, ok);
+    }
+
+    t = best_time (nb_reps, [&] { emit_links (pc, links); });
+    print_line ("emit_links", t, n, t_ref, 0, true);
+
+    return all_ok ? 0 : 1;
+}
@@ -0,0 +1,426 @@
+/*
+    Cinématique analytique de lots de mécanismes, rangés en structure de
+    tableaux (SoA)
+
+    Bielle-manivelle : manivelle de centre G et de rayon GH, d'angle alpha
+    (radians) ; la bielle HJ guide le coulisseau J sur l'horizontale de G ;
+    le point fixe K est à l'abscisse gx + gk. On en déduit, comme le faisait
+    displayGL() de cylindres.cpp :
+        H    = G + GH (cos alpha, sin alpha)
+        J    = (hx - sqrt (HJ² - (GH sin alpha)²), gy)
+        beta = angle de la bielle, atan2 (hy - gy, hx - jx)
+        JK   = |kx - jx|
+    Il faut HJ >= GH, sinon la bielle ne peut pas suivre la manivelle et
+    les sorties valent NaN.
+
+    Pédale-manivelle : manivelle de centre C, de longueur len et d'angle
+    alpha ; la pédale, en P, reste horizontale.
+
+    Chaque grandeur est un tableau contigu : une instruction SIMD traite 4
+    (SSE) ou 8 (AVX2) mécanismes. sqrt est celle du processeur (exacte) ;
+    sin, cos et atan2 sont des polynômes sans branchement, réduits à
+    [-pi/4, pi/4] (erreur de l'ordre de 1e-7). Les mêmes opérations sont
+    faites dans le même ordre quel que soit le jeu d'instructions : les
+    résultats sont identiques bit à bit entre scalaire, SSE et AVX2.
+
+    emit_links() écrit ensuite les transformations monde de chaque pièce
+    dans un tableau de vmath::Affine, lu par l'affichage.
+*/
+
+#ifndef KINEMATICS_H
+#define KINEMATICS_H
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "vmath-xform.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define KINEMATICS_X86
+#include <immintrin.h>
+#endif
+
+namespace kinematics
+{
+    enum Isa { ISA_SCALAR, ISA_SSE, ISA_AVX2 };
+
+    inline const char* isa_name (Isa isa)
+    {
+        switch (isa) {
+            case ISA_SCALAR : return "scalar";
+            case ISA_SSE    : return "SSE";
+            case ISA_AVX2   : return "AVX2";
+        }
+        return "?";
+    }
+
+    // Meilleur jeu d'instructions disponible, détecté une seule fois
+    inline Isa best_isa()
+    {
+#ifdef KINEMATICS_X86
+        static Isa isa = __builtin_cpu_supports ("avx2") ? ISA_AVX2 :
+            __builtin_cpu_supports ("sse2") ? ISA_SSE : ISA_SCALAR;
+        return isa;
+#else
+        return ISA_SCALAR;
+#endif
+    }
+
+
+    // Lot de n mécanismes décrits par NB grandeurs : un tableau par grandeur
+    template <int NB>
+    class Fields
+    {
+    public:
+        // Nombre de mécanismes traités par pas : la taille allouée est
+        // arrondie à un multiple, les valeurs en trop valent 0
+        static const size_t LANES = 8;
+
+        Fields() = default;
+        explicit Fields (size_t n) { resize (n); }
+        Fields (const Fields&) = delete;
+        Fields& operator= (const Fields&) = delete;
+
+        ~Fields() { std::free (m_data); }
+
+        // Change le nombre de mécanismes ; le contenu est perdu
+        void resize (size_t n)
+        {
+            size_t capacity = (n + LANES-1) / LANES * LANES;
+            if (capacity != m_capacity) {
+                std::free (m_data);
+                m_data = capacity ? static_cast<float*> (std::aligned_alloc (
+                    32, capacity * NB * sizeof (float))) : nullptr;
+                m_capacity = capacity;
+            }
+            if (m_data) memset (m_data, 0, m_capacity * NB * sizeof (float));
+            m_size = n;
+        }
+
+        size_t size() const { return m_size; }
+        size_t capacity() const { return m_capacity; }
+
+        float* field (int k) { return m_data + k * m_capacity; }
+        const float* field (int k) const { return m_data + k * m_capacity; }
+
+    private:
+        float* m_data = nullptr;
+        size_t m_size = 0, m_capacity = 0;
+    };
+
+
+    enum CrankSliderField {
+        // Entrées
+        CS_ALPHA, CS_GX, CS_GY, CS_GZ, CS_GH, CS_HJ, CS_GK,
+        // Sorties
+        CS_COS, CS_SIN, CS_HX, CS_HY, CS_JX, CS_BETA, CS_JK,
+        CS_NB_FIELDS };
+
+    typedef Fields<CS_NB_FIELDS> CrankSliderBatch;
+
+    enum PedalCrankField {
+        // Entrées
+        PC_ALPHA, PC_CX, PC_CY, PC_CZ, PC_LEN,
+        // Sorties
+        PC_COS, PC_SIN, PC_PX, PC_PY,
+        PC_NB_FIELDS };
+
+    typedef Fields<PC_NB_FIELDS> PedalCrankBatch;
+
+
+    namespace detail
+    {
+        typedef float v4sf __attribute__ ((vector_size (16)));
+        typedef float v8sf __attribute__ ((vector_size (32)));
+        typedef int32_t v4si __attribute__ ((vector_size (16)));
+        typedef int32_t v8si __attribute__ ((vector_size (32)));
+
+        // Entiers de même largeur que V
+        template <typename V> struct Int;
+        template <> struct Int<float> { typedef int32_t type; };
+        template <> struct Int<v4sf> { typedef v4si type; };
+        template <> struct Int<v8sf> { typedef v8si type; };
+
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void load (V& v, const float* p)
+        {
+            memcpy (&v, p, sizeof v);
+        }
+
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void store (float* p, const V& v)
+        {
+            memcpy (p, &v, sizeof v);
+        }
+
+        // sin et cos de x : x est ramené à r dans [-pi/4, pi/4] par x =
+        // r + q pi/2 (pi/2 en trois morceaux, exact pour |q| < 2^16), puis
+        // les polynômes de Cephes sur r ; le quadrant q & 3 échange sin et
+        // cos et fixe les signes
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void sin_cos (const V& x, V& s, V& c)
+        {
+            typedef typename Int<V>::type I;
+
+            // Ajouter 1.5 * 2^23 arrondit à l'entier le plus proche, qui se
+            // lit dans les bits de poids faible de la mantisse
+            const V shifter = V {} + 0x1.8p23f;
+            V q = x * 0.636619772f + shifter;
+            I qi;
+            memcpy (&qi, &q, sizeof qi);
+            q = q - shifter;
+
+            V r = ((x - q * 1.5703125f) - q * 4.837512969970703125e-4f)
+                - q * 7.54978995489188216e-8f;
+            V r2 = r * r;
+            V ps = r + r * r2 * (-1.6666654611e-1f + r2 * (8.3321608736e-3f
+                + r2 * -1.9515295891e-4f));
+            V pc = 1.0f - 0.5f * r2 + r2 * r2 * (4.166664568298827e-2f
+                + r2 * (-1.388731625493765e-3f + r2 * 2.443315711809948e-5f));
+
+            V zero = V {};
+            auto swap = (qi & 1) != 0;
+            s = swap ? pc : ps;
+            c = swap ? ps : pc;
+            s = ((qi & 2) != 0) ? zero - s : s;
+            c = (((qi + 1) & 2) != 0) ? zero - c : c;
+        }
+
+        // r = atan2 (y, x) : atan de min/max dans [0, 1], ramené à
+        // [0, tan pi/8] par atan a = pi/4 + atan ((a-1)/(a+1)), polynôme de
+        // Cephes, puis octant selon |y| > |x| et les signes
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void atan2 (const V& y, const V& x, V& r)
+        {
+            V zero = V {}, one = zero + 1.0f;
+            V ax = x < zero ? zero - x : x;
+            V ay = y < zero ? zero - y : y;
+            auto steep = ay > ax;
+            V mn = steep ? ax : ay;
+            V mx = steep ? ay : ax;
+            V a = mn / (mx == zero ? one : mx);
+
+            auto big = a > 0.414213562f;
+            V t = big ? (a - 1.0f) / (a + 1.0f) : a;
+            V z = t * t;
+            r = (((8.05374449538e-2f * z - 1.38776856032e-1f) * z
+                + 1.99777106478e-1f) * z - 3.33329491539e-1f) * z * t + t;
+            r = big ? r + 0.785398163f : r;
+            r = steep ? 1.57079633f - r : r;
+            r = x < zero ? 3.14159265f - r : r;
+            r = y < zero ? zero - r : r;
+        }
+
+        // Bielles-manivelles des voies de V (float, ou vecteur GCC de 4 ou 8
+        // float) à partir de l'indice i. La racine carrée, seule opération
+        // propre au jeu d'instructions, est faite par le noyau entre begin()
+        // et end() : root = sqrt (radicand)
+        template <typename V>
+        struct CrankSliderLanes
+        {
+            V gx, gy, gh, hj, gk, c, s, hx, hy, radicand, root;
+
+            __attribute__ ((always_inline))
+            void begin (float* const f[CS_NB_FIELDS], size_t i)
+            {
+                V alpha;
+                load (alpha, f[CS_ALPHA] + i);
+                load (gx, f[CS_GX] + i);
+                load (gy, f[CS_GY] + i);
+                load (gh, f[CS_GH] + i);
+                load (hj, f[CS_HJ] + i);
+                load (gk, f[CS_GK] + i);
+
+                sin_cos (alpha, s, c);
+                hx = gx + gh * c;
+                hy = gy + gh * s;
+                V d = gh * s;
+                radicand = hj * hj - d * d;
+            }
+
+            __attribute__ ((always_inline))
+            void end (float* const f[CS_NB_FIELDS], size_t i)
+            {
+                V jx = hx - root;
+                V beta;
+                atan2 (hy - gy, hx - jx, beta);
+                V jk = gx + gk - jx;
+                jk = jk < V {} ? V {} - jk : jk;
+
+                store (f[CS_COS] + i, c);
+                store (f[CS_SIN] + i, s);
+                store (f[CS_HX] + i, hx);
+                store (f[CS_HY] + i, hy);
+                store (f[CS_JX] + i, jx);
+                store (f[CS_BETA] + i, beta);
+                store (f[CS_JK] + i, jk);
+            }
+        };
+
+        template <typename V>
+        __attribute__ ((always_inline))
+        inline void pedal_crank_lanes (float* const f[PC_NB_FIELDS], size_t i)
+        {
+            V alpha, cx, cy, len;
+            load (alpha, f[PC_ALPHA] + i);
+            load (cx, f[PC_CX] + i);
+            load (cy, f[PC_CY] + i);
+            load (len, f[PC_LEN] + i);
+
+            V s, c;
+            sin_cos (alpha, s, c);
+            store (f[PC_COS] + i, c);
+            store (f[PC_SIN] + i, s);
+            store (f[PC_PX] + i, cx + len * c);
+            store (f[PC_PY] + i, cy + len * s);
+        }
+
+        // Un noyau par jeu d'instructions pour chaque type de mécanisme
+        inline void crank_slider_scalar (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i++) {
+                CrankSliderLanes<float> l;
+                l.begin (f, i);
+                l.root = std::sqrt (l.radicand);
+                l.end (f, i);
+            }
+        }
+
+        inline void pedal_crank_scalar (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i++) pedal_crank_lanes<float> (f, i);
+        }
+
+#ifdef KINEMATICS_X86
+        __attribute__ ((target ("sse2")))
+        inline void crank_slider_sse (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 4) {
+                CrankSliderLanes<v4sf> l;
+                l.begin (f, i);
+                l.root = (v4sf) _mm_sqrt_ps ((__m128) l.radicand);
+                l.end (f, i);
+            }
+        }
+
+        __attribute__ ((target ("avx2")))
+        inline void crank_slider_avx2 (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 8) {
+                CrankSliderLanes<v8sf> l;
+                l.begin (f, i);
+                l.root = (v8sf) _mm256_sqrt_ps ((__m256) l.radicand);
+                l.end (f, i);
+            }
+        }
+
+        __attribute__ ((target ("sse2")))
+        inline void pedal_crank_sse (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 4) pedal_crank_lanes<v4sf> (f, i);
+        }
+
+        __attribute__ ((target ("avx2")))
+        inline void pedal_crank_avx2 (float* const f[], size_t capacity)
+        {
+            for (size_t i = 0; i < capacity; i += 8) pedal_crank_lanes<v8sf> (f, i);
+        }
+#endif
+
+        // Rotation d'angle (c, s) autour de z, puis translation (x, y, z)
+        inline vmath::Affine rot_z_at (float c, float s, float x, float y,
+            float z)
+        {
+            vmath::Affine a (vmath::Translation (x, y, z));
+            a.m[0][0] = c;   a.m[0][1] = s;
+            a.m[1][0] = -s;  a.m[1][1] = c;
+            return a;
+        }
+    }
+
+
+    // Calcule les sorties de tout le lot
+    inline void solve (CrankSliderBatch& b, Isa isa = best_isa())
+    {
+        float* f[CS_NB_FIELDS];
+        for (int k = 0; k < CS_NB_FIELDS; k++) f[k] = b.field (k);
+#ifdef KINEMATICS_X86
+        if (isa == ISA_AVX2) { detail::crank_slider_avx2 (f, b.capacity()); return; }
+        if (isa == ISA_SSE) { detail::crank_slider_sse (f, b.capacity()); return; }
+#endif
+        detail::crank_slider_scalar (f, b.capacity());
+    }
+
+    inline void solve (PedalCrankBatch& b, Isa isa = best_isa())
+    {
+        float* f[PC_NB_FIELDS];
+        for (int k = 0; k < PC_NB_FIELDS; k++) f[k] = b.field (k);
+#ifdef KINEMATICS_X86
+        if (isa == ISA_AVX2) { detail::pedal_crank_avx2 (f, b.capacity()); return; }
+        if (isa == ISA_SSE) { detail::pedal_crank_sse (f, b.capacity()); return; }
+#endif
+        detail::pedal_crank_scalar (f, b.capacity());
+    }
+
+
+    // Pièces d'une bielle-manivelle, en repère monde :
+    //   CS_LINK_CRANK   rotation alpha autour de G
+    //   CS_LINK_PIN     translation en H
+    //   CS_LINK_ROD     rotation beta autour de J (bielle selon +x)
+    //   CS_LINK_SLIDER  translation en J
+    enum CrankSliderLink {
+        CS_LINK_CRANK, CS_LINK_PIN, CS_LINK_ROD, CS_LINK_SLIDER, CS_NB_LINKS };
+
+    // Pièces d'une pédale-manivelle :
+    //   PC_LINK_CRANK   rotation alpha autour de C
+    //   PC_LINK_PEDAL   translation en P, pédale horizontale
+    enum PedalCrankLink { PC_LINK_CRANK, PC_LINK_PEDAL, PC_NB_LINKS };
+
+    // out[i * CS_NB_LINKS + lien], après solve(). cos et sin de beta se
+    // déduisent de la bielle : (hx - jx, hy - gy) / HJ
+    inline void emit_links (const CrankSliderBatch& b,
+        std::vector<vmath::Affine>& out)
+    {
+        out.resize (b.size() * CS_NB_LINKS);
+        const float *gx = b.field (CS_GX), *gy = b.field (CS_GY),
+                    *gz = b.field (CS_GZ), *hj = b.field (CS_HJ),
+                    *c = b.field (CS_COS), *s = b.field (CS_SIN),
+                    *hx = b.field (CS_HX), *hy = b.field (CS_HY),
+                    *jx = b.field (CS_JX);
+        for (size_t i = 0; i < b.size(); i++) {
+            vmath::Affine* links = &out[i * CS_NB_LINKS];
+            float inv = 1.0f / hj[i];
+            links[CS_LINK_CRANK] = detail::rot_z_at (c[i], s[i], gx[i], gy[i], gz[i]);
+            links[CS_LINK_PIN] = vmath::Translation (hx[i], hy[i], gz[i]);
+            links[CS_LINK_ROD] = detail::rot_z_at ((hx[i] - jx[i]) * inv,
+                (hy[i] - gy[i]) * inv, jx[i], gy[i], gz[i]);
+            links[CS_LINK_SLIDER] = vmath::Translation (jx[i], gy[i], gz[i]);
+        }
+    }
+
+    // out[i * PC_NB_LINKS + lien], après solve()
+    inline void emit_links (const PedalCrankBatch& b,
+        std::vector<vmath::Affine>& out)
+    {
+        out.resize (b.size() * PC_NB_LINKS);
+        const float *cx = b.field (PC_CX), *cy = b.field (PC_CY),
+                    *cz = b.field (PC_CZ), *c = b.field (PC_COS),
+                    *s = b.field (PC_SIN), *px = b.field (PC_PX),
+                    *py = b.field (PC_PY);
+        for (size_t i = 0; i < b.size(); i++) {
+            vmath::Affine* links = &out[i * PC_NB_LINKS];
+            links[PC_LINK_CRANK] = detail::rot_z_at (c[i], s[i], cx[i], cy[i], cz[i]);
+            links[PC_LINK_PEDAL] = vmath::Translation (px[i], py[i], cz[i]);
+        }
+    }
+}
+
+#endif // KINEMATICS_H
@@ -0,0 +1,589 @@
+/*
+    Banc d'essai d'une démo : --bench FRAMES[,WARMUP] [--bench-json file]
+
+    L'application rend WARMUP images non mesurées (10 par défaut) puis
+    FRAMES images mesurées, animation forcée, sans synchronisation
+    verticale ni attente entre les images, et sort. Pour chaque image :
+      - cpu : durée de displayGL(), c'est-à-dire de la soumission des
+        commandes ;
+      - gpu : durée d'exécution des mêmes commandes, par une requête
+        GL_TIME_ELAPSED ; les résultats sont relus quelques images plus
+        tard dans un anneau de requêtes, sans bloquer le CPU ;
+      - frame : durée entre deux échanges de tampons.
+    Le rapport JSON (sur la sortie standard par défaut) donne min, médiane,
+    p95, p99 et max de chacune en millisecondes, ainsi que le nombre
+    d'appels de dessin et d'octets envoyés au GPU (tampons et textures)
+    par image.
+
+    Les compteurs remplacent pendant la mesure les pointeurs de fonctions
+    de glad (glad_glDrawArrays, etc.) par des fonctions qui comptent puis
+    appellent l'original : le code de la démo n'est pas modifié. Sans
+    glad (GL/gl.h seul), ils ne sont pas disponibles et valent null.
+
+        FrameBench m_bench;
+        m_bench.parse_arg (argc, argv, i);  // comme GLContext::parse_arg()
+        ...
+        m_bench.start (m_ctx);              // après initGL()
+        while (!m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_ctx.swap_buffers();
+            m_bench.end_frame();
+            m_ctx.poll_events();
+        }
+        return m_bench.report() ? 0 : 1;
+
+    À inclure après glad.h et gl-context.h.
+*/
+
+#ifndef FRAME_BENCH_H
+#define FRAME_BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gl-context.h"
+
+
+class FrameBench
+{
+public:
+    static const char* usage()
+    {
+        return "[--bench FRAMES[,WARMUP]] [--bench-json file]";
+    }
+
+private:
+    // Requêtes GL, prises par GLContext::get_proc_address() : l'en-tête
+    // marche aussi sans glad
+    typedef void (*GenQueriesFn) (GLsizei, GLuint*);
+    typedef void (*DeleteQueriesFn) (GLsizei, const GLuint*);
+    typedef void (*BeginQueryFn) (GLenum, GLuint);
+    typedef void (*EndQueryFn) (GLenum);
+    typedef void (*GetQueryObjectFn) (GLuint, GLenum, GLint*);
+    typedef void (*GetQueryObjectU64Fn) (GLuint, GLenum, uint64_t*);
+
+    struct QueryFunctions
+    {
+        GenQueriesFn gen_queries;
+        DeleteQueriesFn delete_queries;
+        BeginQueryFn begin_query;
+        EndQueryFn end_query;
+        GetQueryObjectFn get_query_object;
+        GetQueryObjectU64Fn get_query_object_u64;
+    };
+
+    static const GLenum TIME_ELAPSED = 0x88BF, QUERY_RESULT = 0x8866,
+        QUERY_RESULT_AVAILABLE = 0x8867;
+
+    // Requêtes en vol : un résultat est attendu au plus NB_QUERIES images
+    // après sa requête
+    static const int NB_QUERIES = 8;
+
+    struct Stats
+    {
+        double min = 0, median = 0, p95 = 0, p99 = 0, max = 0;
+    };
+
+    // Compteurs de l'image en cours, alimentés par les fonctions de glad
+    // détournées
+    struct Counters
+    {
+        bool hooked = false;
+        long draw_calls = 0;
+        uint64_t uploaded_bytes = 0;
+    };
+
+    long m_nb_frames = 0, m_warmup = 10;
+    std::string m_json_path, m_name;
+    const GLContext* m_ctx = nullptr;
+
+    QueryFunctions m_gl {};
+    GLuint m_queries[NB_QUERIES] {};
+    long m_query_frame[NB_QUERIES];     // image de chaque requête, -1 si libre
+    bool m_has_queries = false;
+
+    long m_frame = 0;                   // images rendues, échauffement compris
+    std::chrono::steady_clock::time_point m_submit_start, m_last_swap;
+    std::vector<double> m_cpu_ms, m_gpu_ms, m_frame_ms;
+    std::vector<long> m_draw_calls;
+    std::vector<uint64_t> m_uploaded_bytes;
+
+    static Counters& counters()
+    {
+        static Counters c;
+        return c;
+    }
+
+    template <typename F>
+    static bool load (F& f, const char* name)
+    {
+        f = reinterpret_cast<F> (GLContext::get_proc_address (name));
+        return f != nullptr;
+    }
+
+    bool measured (long frame) const { return frame >= m_warmup; }
+
+    static double ms_since (std::chrono::steady_clock::time_point t)
+    {
+        return std::chrono::duration<double, std::milli> (
+            std::chrono::steady_clock::now() - t).count();
+    }
+
+    // Relit la requête du créneau k ; si wait, attend son résultat
+    void collect (int k, bool wait)
+    {
+        if (m_query_frame[k] < 0) return;
+        if (!wait) {
+            GLint available = 0;
+            m_gl.get_query_object (m_queries[k], QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        uint64_t ns = 0;
+        m_gl.get_query_object_u64 (m_queries[k], QUERY_RESULT, &ns);
+        if (measured (m_query_frame[k])) m_gpu_ms.push_back (ns * 1e-6);
+        m_query_frame[k] = -1;
+    }
+
+    // Centiles par rang le plus proche
+    static Stats stats (std::vector<double> v)
+    {
+        Stats s;
+        if (v.empty()) return s;
+        std::sort (v.begin(), v.end());
+        auto rank = [&] (double p) {
+            size_t r = size_t (std::ceil (p * v.size()));
+            return v[std::min (v.size(), std::max<size_t> (r, 1)) - 1];
+        };
+        s.min = v.front();
+        s.median = rank (0.5);
+        s.p95 = rank (0.95);
+        s.p99 = rank (0.99);
+        s.max = v.back();
+        return s;
+    }
+
+    static void put_stats (std::ostream& out, const char* name,
+        const std::vector<double>& v)
+    {
+        out << "  \"" << name << "\": ";
+        if (v.empty()) { out << "null,\n"; return; }
+        Stats s = stats (v);
+        out << "{ \"min\": " << s.min << ", \"median\": " << s.median
+            << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99
+            << ", \"max\": " << s.max << " },\n";
+    }
+
+    template <typename T>
+    static double mean (const std::vector<T>& v)
+    {
+        double sum = 0;
+        for (auto x : v) sum += double (x);
+        return v.empty() ? 0 : sum / v.size();
+    }
+
+    static std::string json_string (const std::string& s)
+    {
+        std::string r = "\"";
+        for (char c : s) {
+            if (c == '"' || c == '\\') r += '\\';
+            r += c;
+        }
+        return r + "\"";
+    }
+
+#ifdef __glad_h_
+    // Octets d'une image de texture non compressée, sans le bourrage de
+    // GL_UNPACK_ALIGNMENT
+    static uint64_t texel_bytes (GLenum format, GLenum type)
+    {
+        int nb_components = 4;
+        switch (format) {
+        case GL_RED: case GL_RED_INTEGER: case GL_DEPTH_COMPONENT:
+        case GL_STENCIL_INDEX:
+            nb_components = 1; break;
+        case GL_RG: case GL_RG_INTEGER: case GL_DEPTH_STENCIL:
+            nb_components = 2; break;
+        case GL_RGB: case GL_BGR: case GL_RGB_INTEGER:
+            nb_components = 3; break;
+        }
+        switch (type) {
+        case GL_UNSIGNED_BYTE: case GL_BYTE: return nb_components;
+        case GL_UNSIGNED_SHORT: case GL_SHORT: case GL_HALF_FLOAT:
+            return 2 * nb_components;
+        case GL_UNSIGNED_INT: case GL_INT: case GL_FLOAT:
+            return 4 * nb_components;
+        default: return 4;      // types tassés : un texel dans 32 bits
+        }
+    }
+
+    // Avec un tampon GL_PIXEL_UNPACK_BUFFER lié, pixels est un décalage :
+    // les octets ont déjà été comptés à l'écriture du tampon
+    static void count_pixels (const void* pixels, uint64_t bytes)
+    {
+        GLint unpack = 0;
+        glGetIntegerv (GL_PIXEL_UNPACK_BUFFER_BINDING, &unpack);
+        if (pixels && !unpack) counters().uploaded_bytes += bytes;
+    }
+
+    struct Originals
+    {
+        PFNGLDRAWARRAYSPROC draw_arrays;
+        PFNGLDRAWARRAYSINSTANCEDPROC draw_arrays_instanced;
+        PFNGLDRAWELEMENTSPROC draw_elements;
+        PFNGLDRAWELEMENTSINSTANCEDPROC draw_elements_instanced;
+        PFNGLMULTIDRAWARRAYSPROC multi_draw_arrays;
+        PFNGLBUFFERDATAPROC buffer_data;
+        PFNGLBUFFERSUBDATAPROC buffer_sub_data;
+        PFNGLMAPBUFFERRANGEPROC map_buffer_range;
+        PFNGLTEXIMAGE2DPROC tex_image_2d;
+        PFNGLTEXIMAGE3DPROC tex_image_3d;
+        PFNGLTEXSUBIMAGE2DPROC tex_sub_image_2d;
+        PFNGLTEXSUBIMAGE3DPROC tex_sub_image_3d;
+        PFNGLCOMPRESSEDTEXIMAGE2DPROC compressed_tex_image_2d;
+        PFNGLCOMPRESSEDTEXIMAGE3DPROC compressed_tex_image_3d;
+        PFNGLCOMPRESSEDTEXSUBIMAGE2DPROC compressed_tex_sub_image_2d;
+        PFNGLCOMPRESSEDTEXSUBIMAGE3DPROC compressed_tex_sub_image_3d;
+    };
+
+    static Originals& originals()
+    {
+        static Originals o;
+        return o;
+    }
+
+    static void APIENTRY draw_arrays (GLenum mode, GLint first, GLsizei count)
+    {
+        counters().draw_calls++;
+        originals().draw_arrays (mode, first, count);
+    }
+
+    static void APIENTRY draw_arrays_instanced (GLenum mode, GLint first,
+        GLsizei count, GLsizei nb_instances)
+    {
+        counters().draw_calls++;
+        originals().draw_arrays_instanced (mode, first, count, nb_instances);
+    }
+
+    static void APIENTRY draw_elements (GLenum mode, GLsizei count, GLenum type,
+        const void* indices)
+    {
+        counters().draw_calls++;
+        originals().draw_elements (mode, count, type, indices);
+    }
+
+    static void APIENTRY draw_elements_instanced (GLenum mode, GLsizei count,
+        GLenum type, const void* indices, GLsizei nb_instances)
+    {
+        counters().draw_calls++;
+        originals().draw_elements_instanced (mode, count, type, indices,
+            nb_instances);
+    }
+
+    static void APIENTRY multi_draw_arrays (GLenum mode, const GLint* first,
+        const GLsizei* count, GLsizei draw_count)
+    {
+        counters().draw_calls++;
+        originals().multi_draw_arrays (mode, first, count, draw_count);
+    }
+
+    static void APIENTRY buffer_data (GLenum target, GLsizeiptr size,
+        const void* data, GLenum usage)
+    {
+        if (data) counters().uploaded_bytes += size;
+        originals().buffer_data (target, size, data, usage);
+    }
+
+    static void APIENTRY buffer_sub_data (GLenum target, GLintptr offset,
+        GLsizeiptr size, const void* data)
+    {
+        counters().uploaded_bytes += size;
+        originals().buffer_sub_data (target, offset, size, data);
+    }
+
+    // Une projection en écriture compte pour toute sa longueur
+    static void* APIENTRY map_buffer_range (GLenum target, GLintptr offset,
+        GLsizeiptr length, GLbitfield access)
+    {
+        if (access & GL_MAP_WRITE_BIT) counters().uploaded_bytes += length;
+        return originals().map_buffer_range (target, offset, length, access);
+    }
+
+    static void APIENTRY tex_image_2d (GLenum target, GLint level,
+        GLint internal_format, GLsizei w, GLsizei h, GLint border,
+        GLenum format, GLenum type, const void* pixels)
+    {
+        count_pixels (pixels, uint64_t (w) * h * texel_bytes (format, type));
+        originals().tex_image_2d (target, level, internal_format, w, h, border,
+            format, type, pixels);
+    }
+
+    static void APIENTRY tex_image_3d (GLenum target, GLint level,
+        GLint internal_format, GLsizei w, GLsizei h, GLsizei d, GLint border,
+        GLenum format, GLenum type, const void* pixels)
+    {
+        count_pixels (pixels, uint64_t (w) * h * d * texel_bytes (format, type));
+        originals().tex_image_3d (target, level, internal_format, w, h, d,
+            border, format, type, pixels);
+    }
+
+    static void APIENTRY tex_sub_image_2d (GLenum target, GLint level,
+        GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLenum type,
+        const void* pixels)
+    {
+        count_pixels (pixels, uint64_t (w) * h * texel_bytes (format, type));
+        originals().tex_sub_image_2d (target, level, x, y, w, h, format, type,
+            pixels);
+    }
+
+    static void APIENTRY tex_sub_image_3d (GLenum target, GLint level,
+        GLint x, GLint y, GLint z, GLsizei w, GLsizei h, GLsizei d,
+        GLenum format, GLenum type, const void* pixels)
+    {
+        count_pixels (pixels, uint64_t (w) * h * d * texel_bytes (format, type));
+        originals().tex_sub_image_3d (target, level, x, y, z, w, h, d, format,
+            type, pixels);
+    }
+
+    static void APIENTRY compressed_tex_image_2d (GLenum target, GLint level,
+        GLenum internal_format, GLsizei w, GLsizei h, GLint border,
+        GLsizei size, const void* data)
+    {
+        count_pixels (data, size);
+        originals().compressed_tex_image_2d (target, level, internal_format,
+            w, h, border, size, data);
+    }
+
+    static void APIENTRY compressed_tex_image_3d (GLenum target, GLint level,
+        GLenum internal_format, GLsizei w, GLsizei h, GLsizei d, GLint border,
+        GLsizei size, const void* data)
+    {
+        count_pixels (data, size);
+        originals().compressed_tex_image_3d (target, level, internal_format,
+            w, h, d, border, size, data);
+    }
+
+    static void APIENTRY compressed_tex_sub_image_2d (GLenum target, GLint level,
+        GLint x, GLint y, GLsizei w, GLsizei h, GLenum format, GLsizei size,
+        const void* data)
+    {
+        count_pixels (data, size);
+        originals().compressed_tex_sub_image_2d (target, level, x, y, w, h,
+            format, size, data);
+    }
+
+    static void APIENTRY compressed_tex_sub_image_3d (GLenum target, GLint level,
+        GLint x, GLint y, GLint z, GLsizei w, GLsizei h, GLsizei d,
+        GLenum format, GLsizei size, const void* data)
+    {
+        count_pixels (data, size);
+        originals().compressed_tex_sub_image_3d (target, level, x, y, z, w, h,
+            d, format, size, data);
+    }
+
+    // Échange chaque pointeur de glad avec sa fonction de comptage ; un
+    // second appel remet les originaux
+    static void swap_hooks()
+    {
+        Originals& o = originals();
+        auto swap = [] (auto& glad_fn, auto& original, auto hook) {
+            if (!glad_fn) return;
+            if (glad_fn == hook) { glad_fn = original; return; }
+            original = glad_fn;
+            glad_fn = hook;
+        };
+        swap (glad_glDrawArrays, o.draw_arrays, draw_arrays);
+        swap (glad_glDrawArraysInstanced, o.draw_arrays_instanced,
+            draw_arrays_instanced);
+        swap (glad_glDrawElements, o.draw_elements, draw_elements);
+        swap (glad_glDrawElementsInstanced, o.draw_elements_instanced,
+            draw_elements_instanced);
+        swap (glad_glMultiDrawArrays, o.multi_draw_arrays, multi_draw_arrays);
+        swap (glad_glBufferData, o.buffer_data, buffer_data);
+        swap (glad_glBufferSubData, o.buffer_sub_data, buffer_sub_data);
+        swap (glad_glMapBufferRange, o.map_buffer_range, map_buffer_range);
+        swap (glad_glTexImage2D, o.tex_image_2d, tex_image_2d);
+        swap (glad_glTexImage3D, o.tex_image_3d, tex_image_3d);
+        swap (glad_glTexSubImage2D, o.tex_sub_image_2d, tex_sub_image_2d);
+        swap (glad_glTexSubImage3D, o.tex_sub_image_3d, tex_sub_image_3d);
+        swap (glad_glCompressedTexImage2D, o.compressed_tex_image_2d,
+            compressed_tex_image_2d);
+        swap (glad_glCompressedTexImage3D, o.compressed_tex_image_3d,
+            compressed_tex_image_3d);
+        swap (glad_glCompressedTexSubImage2D, o.compressed_tex_sub_image_2d,
+            compressed_tex_sub_image_2d);
+        swap (glad_glCompressedTexSubImage3D, o.compressed_tex_sub_image_3d,
+            compressed_tex_sub_image_3d);
+        counters().hooked = !counters().hooked;
+    }
+#else
+    static void swap_hooks() {}
+#endif
+
+public:
+    ~FrameBench()
+    {
+        if (counters().hooked) swap_hooks();
+    }
+
+    // Reconnaît une option du banc d'essai en argv[i] ; même convention
+    // que GLContext::parse_arg()
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        bool has_value = i+1 < argc;
+        if (strcmp (argv[i], "--bench") == 0 && has_value) {
+            long frames, warmup = m_warmup;
+            char tail;
+            int n = sscanf (argv[i+1], "%ld,%ld%c", &frames, &warmup, &tail);
+            if (n < 1 || n > 2 || frames <= 0 || warmup < 0 ||
+                (n == 1 && strchr (argv[i+1], ','))) {
+                std::cerr << "### Error: --bench expects FRAMES[,WARMUP]"
+                    << std::endl;
+                return -1;
+            }
+            m_nb_frames = frames;
+            m_warmup = warmup;
+            const char* slash = strrchr (argv[0], '/');
+            m_name = slash ? slash + 1 : argv[0];
+            return 2;
+        }
+        if (strcmp (argv[i], "--bench-json") == 0 && has_value) {
+            m_json_path = argv[i+1];
+            return 2;
+        }
+        return 0;
+    }
+
+    bool enabled() const { return m_nb_frames > 0; }
+    long total_frames() const { return m_warmup + m_nb_frames; }
+    bool done() const { return m_frame >= total_frames(); }
+
+    // Après initGL() : crée les requêtes et installe les compteurs
+    void start (const GLContext& ctx)
+    {
+        m_ctx = &ctx;
+        m_has_queries = load (m_gl.gen_queries, "glGenQueries") &&
+            load (m_gl.delete_queries, "glDeleteQueries") &&
+            load (m_gl.begin_query, "glBeginQuery") &&
+            load (m_gl.end_query, "glEndQuery") &&
+            load (m_gl.get_query_object, "glGetQueryObjectiv") &&
+            load (m_gl.get_query_object_u64, "glGetQueryObjectui64v");
+        if (m_has_queries) m_gl.gen_queries (NB_QUERIES, m_queries);
+        else std::cerr << "### Bench: no timer queries, gpu times omitted"
+            << std::endl;
+        std::fill (m_query_frame, m_query_frame + NB_QUERIES, -1);
+
+        m_cpu_ms.reserve (m_nb_frames);
+        m_gpu_ms.reserve (m_nb_frames);
+        m_frame_ms.reserve (m_nb_frames);
+        if (!counters().hooked) swap_hooks();
+        m_last_swap = std::chrono::steady_clock::now();
+    }
+
+    // Juste avant displayGL()
+    void begin_frame()
+    {
+        counters().draw_calls = 0;
+        counters().uploaded_bytes = 0;
+        if (m_has_queries) {
+            int k = m_frame % NB_QUERIES;
+            collect (k, true);          // anneau plein : rare, et borné
+            m_gl.begin_query (TIME_ELAPSED, m_queries[k]);
+            m_query_frame[k] = m_frame;
+        }
+        m_submit_start = std::chrono::steady_clock::now();
+    }
+
+    // Juste après displayGL()
+    void end_submit()
+    {
+        double cpu = ms_since (m_submit_start);
+        if (m_has_queries) m_gl.end_query (TIME_ELAPSED);
+        if (!measured (m_frame)) return;
+        m_cpu_ms.push_back (cpu);
+        m_draw_calls.push_back (counters().draw_calls);
+        m_uploaded_bytes.push_back (counters().uploaded_bytes);
+    }
+
+    // Juste après l'échange des tampons
+    void end_frame()
+    {
+        if (measured (m_frame)) m_frame_ms.push_back (ms_since (m_last_swap));
+        m_last_swap = std::chrono::steady_clock::now();
+        m_frame++;
+
+        // Résultats déjà prêts, sans attendre
+        if (m_has_queries)
+            for (int k = 0; k < NB_QUERIES; k++) collect (k, false);
+    }
+
+    // Relit les dernières requêtes, écrit le rapport JSON et retire les
+    // compteurs ; faux si le fichier n'a pu être écrit
+    bool report()
+    {
+        if (m_has_queries) {
+            for (int k = 0; k < NB_QUERIES; k++) collect (k, true);
+            m_gl.delete_queries (NB_QUERIES, m_queries);
+            m_has_queries = false;
+        }
+        if (counters().hooked) swap_hooks();
+
+        int width = 0, height = 0;
+        if (m_ctx) m_ctx->get_size (width, height);
+        bool has_counters = false;
+#ifdef __glad_h_
+        has_counters = true;
+#endif
+
+        std::ostringstream out;
+        out << "{\n"
+            << "  \"demo\": " << json_string (m_name) << ",\n"
+            << "  \"frames\": " << m_frame_ms.size()
+            << ", \"warmup\": " << m_warmup << ",\n"
+            << "  \"width\": " << width << ", \"height\": " << height
+            << ", \"samples\": " << (m_ctx ? m_ctx->config().samples : 0)
+            << ", \"headless\": "
+            << (m_ctx && m_ctx->headless() ? "true" : "false") << ",\n";
+        put_stats (out, "frame_ms", m_frame_ms);
+        put_stats (out, "cpu_ms", m_cpu_ms);
+        put_stats (out, "gpu_ms", m_gpu_ms);
+        if (has_counters)
+            out << "  \"draw_calls_per_frame\": " << mean (m_draw_calls) << ",\n"
+                << "  \"uploaded_bytes_per_frame\": " << mean (m_uploaded_bytes)
+                << "\n";
+        else
+            out << "  \"draw_calls_per_frame\": null,\n"
+                << "  \"uploaded_bytes_per_frame\": null\n";
+        out << "}\n";
+
+        if (m_json_path.empty() || m_json_path == "-") {
+            std::cout << out.str() << std::flush;
+            return true;
+        }
+        std::ofstream file (m_json_path);
+        file << out.str();
+        if (!file) {
+            std::cerr << "### Error: cannot write \"" << m_json_path << "\""
+                << std::endl;
+            return false;
+        }
+        std::cout << "Bench report written to \"" << m_json_path << "\""
+            << std::endl;
+        return true;
+    }
+
+}; // FrameBench
+
+#endif // FRAME_BENCH_H
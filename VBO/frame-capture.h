@@ -0,0 +1,591 @@
+/*
+    Capture des images : --capture file.y4m|name%04d.png [--capture-fps HZ]
+
+    Un glReadPixels() vers la mémoire du CPU attendrait à chaque image que
+    le GPU ait fini de dessiner. Ici, juste après l'échange, l'image qui
+    vient d'être présentée est lue dans un pixel pack buffer d'un anneau
+    de NB_SLOTS, sans attente : la copie se fait sur le GPU, suivie d'une
+    fence. La copie lancée à l'image N n'est regardée qu'à partir de
+    l'image N + MAP_DELAY, jamais dans l'image même : si sa fence est
+    passée, le PBO est mappé et son pointeur confié au thread d'encodage,
+    qui écrit l'image pendant que le rendu continue ; le PBO est démappé
+    à l'image qui suit la fin de l'encodage. Le thread GL ne fait que
+    lancer des copies, tester des fences, mapper et démapper.
+
+    Si l'encodeur prend du retard et qu'aucun PBO n'est libre, l'image
+    n'est pas capturée : le rendu n'attend jamais. Les images perdues et
+    le coût de la capture sur le thread GL sont résumés à la fin.
+
+      file.y4m       flux YUV4MPEG2 en 4:4:4 (BT.601, plage limitée), à
+                     HZ images par seconde (60 par défaut) :
+                     ffmpeg -i file.y4m file.mp4
+      name%04d.png   une image PNG par image rendue, numérotée à partir
+                     de 0 (une image perdue laisse un trou) ; les PNG ne
+                     sont pas compressés (blocs « stored » de deflate),
+                     faute de zlib
+
+    La taille capturée est celle de la fenêtre au démarrage ; les images
+    d'une autre taille sont ignorées. L'image capturée est celle qui vient
+    d'être affichée, panneau du GPU timer compris : le tampon avant d'une
+    fenêtre (que certains systèmes ne gardent pas si elle est cachée), le
+    FBO résolu hors écran.
+
+        if (!m_capture.start (m_ctx)) ...   // après le chargement de GL
+        while (...) {
+            displayGL();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);      // juste après l'échange
+        }
+                                            // à la destruction : PBO en
+                                            // vol relus, fichiers fermés
+
+    À inclure après glad.h ou GL/gl.h et gl-context.h ; GL 3.2 ou
+    ARB_sync requis.
+*/
+
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gl-context.h"
+#include "trace.h"
+
+
+class FrameCapture
+{
+public:
+    static const char* usage()
+    {
+        return "[--capture file.y4m|name%04d.png] [--capture-fps HZ]";
+    }
+
+private:
+    // Fonctions GL, prises par GLContext::get_proc_address() comme dans
+    // GpuTimer ; GLsync est gardé en void*
+    typedef void (*GenBuffersFn) (GLsizei, GLuint*);
+    typedef void (*DeleteBuffersFn) (GLsizei, const GLuint*);
+    typedef void (*BindBufferFn) (GLenum, GLuint);
+    typedef void (*BufferDataFn) (GLenum, ptrdiff_t, const void*, GLenum);
+    typedef void* (*MapBufferRangeFn) (GLenum, ptrdiff_t, ptrdiff_t, GLbitfield);
+    typedef GLboolean (*UnmapBufferFn) (GLenum);
+    typedef void* (*FenceSyncFn) (GLenum, GLbitfield);
+    typedef GLenum (*ClientWaitSyncFn) (void*, GLbitfield, uint64_t);
+    typedef void (*DeleteSyncFn) (void*);
+    typedef void (*BindFramebufferFn) (GLenum, GLuint);
+
+    struct BufferFunctions
+    {
+        GenBuffersFn gen_buffers;
+        DeleteBuffersFn delete_buffers;
+        BindBufferFn bind_buffer;
+        BufferDataFn buffer_data;
+        MapBufferRangeFn map_buffer_range;
+        UnmapBufferFn unmap_buffer;
+        FenceSyncFn fence_sync;
+        ClientWaitSyncFn client_wait_sync;
+        DeleteSyncFn delete_sync;
+        BindFramebufferFn bind_framebuffer;
+    };
+
+    // Constantes GL utilisées ici, absentes de GL/gl.h sans glext.h
+    static const GLenum PIXEL_PACK_BUFFER = 0x88EB, STREAM_READ = 0x88E1,
+        MAP_READ_BIT = 0x0001, SYNC_GPU_COMMANDS_COMPLETE = 0x9117,
+        SYNC_FLUSH_COMMANDS_BIT = 0x0001, ALREADY_SIGNALED = 0x911A,
+        CONDITION_SATISFIED = 0x911C, READ_FRAMEBUFFER = 0x8CA8,
+        READ_FRAMEBUFFER_BINDING = 0x8CAA, BGRA = 0x80E1,
+        PACK_ALIGNMENT = 0x0D05;
+
+    // PBO de l'anneau : deux images en copie, une ou deux à l'encodage
+    static const int NB_SLOTS = 4;
+
+    // Images laissées au GPU pour finir une copie avant de la mapper
+    static const int MAP_DELAY = 2;
+
+    enum State { FREE, READING, ENCODING, ENCODED };
+
+    struct Slot
+    {
+        GLuint pbo = 0;
+        void* fence = nullptr;          // posée après la copie
+        long frame = -1;
+        const unsigned char* pixels = nullptr;  // mappé, BGRA de bas en haut
+        std::atomic<int> state {FREE};  // ENCODED écrit par l'encodeur
+    };
+
+    enum Format { F_NONE, F_Y4M, F_PNG };
+
+    Format m_format = F_NONE;
+    std::string m_path;
+    int m_fps = 60;
+
+    BufferFunctions m_gl {};
+    bool m_has_buffers = false;
+    int m_width = 0, m_height = 0;
+    Slot m_slots[NB_SLOTS];
+    long m_frame = 0;                   // images rendues depuis start()
+    long m_nb_dropped = 0, m_nb_resized = 0;
+
+    // Coût sur le thread GL
+    typedef std::chrono::steady_clock Clock;
+    double m_cost_sum = 0, m_cost_max = 0;
+    long m_nb_costs = 0;
+
+    // Encodeur : file des créneaux mappés, traitée dans l'ordre
+    std::thread m_encoder;
+    std::mutex m_mutex;
+    std::condition_variable m_cond;
+    std::deque<Slot*> m_queue;
+    bool m_stop = false;
+    std::ofstream m_y4m;
+    std::vector<unsigned char> m_row;   // ligne convertie, sur l'encodeur
+    long m_nb_written = 0;
+    bool m_write_error = false;
+
+    template <typename F>
+    static bool load (F& f, const char* name)
+    {
+        f = reinterpret_cast<F> (GLContext::get_proc_address (name));
+        return f != nullptr;
+    }
+
+    static bool ends_with (const std::string& s, const char* suffix)
+    {
+        size_t n = strlen (suffix);
+        return s.size() >= n && s.compare (s.size() - n, n, suffix) == 0;
+    }
+
+    // Un seul %d, éventuellement %0Nd, et aucun autre %
+    static bool is_frame_pattern (const std::string& s)
+    {
+        size_t p = s.find ('%');
+        if (p == std::string::npos || s.find ('%', p+1) != std::string::npos)
+            return false;
+        size_t q = p + 1;
+        while (q < s.size() && isdigit ((unsigned char) s[q])) q++;
+        return q < s.size() && s[q] == 'd';
+    }
+
+    //------------------------------ E N C O D E U R ---------------------------
+
+    void encoder_loop()
+    {
+        TRACE_THREAD ("capture");
+        for (;;) {
+            Slot* slot;
+            {
+                std::unique_lock<std::mutex> lock (m_mutex);
+                m_cond.wait (lock, [this] { return m_stop || !m_queue.empty(); });
+                // À l'arrêt, la file est vidée avant de sortir
+                if (m_queue.empty()) return;
+                slot = m_queue.front();
+                m_queue.pop_front();
+            }
+            {
+                TRACE_SCOPE ("encode");
+                bool ok = m_format == F_Y4M ? write_y4m (*slot) : write_png (*slot);
+                if (ok) m_nb_written++;
+                else if (!m_write_error) {
+                    std::cerr << "### Error: frame capture, cannot write frame "
+                        << slot->frame << std::endl;
+                    m_write_error = true;
+                }
+            }
+            slot->state.store (ENCODED, std::memory_order_release);
+        }
+    }
+
+    // Ligne y de l'image, de haut en bas
+    const unsigned char* row_of (const Slot& slot, int y) const
+    {
+        return slot.pixels + size_t (m_height - 1 - y) * m_width * 4;
+    }
+
+    // BT.601, plage limitée, en entiers ; un plan après l'autre
+    bool write_y4m (const Slot& slot)
+    {
+        m_y4m << "FRAME\n";
+        for (int plane = 0; plane < 3; plane++) {
+            for (int y = 0; y < m_height; y++) {
+                const unsigned char* p = row_of (slot, y);
+                for (int x = 0; x < m_width; x++, p += 4) {
+                    int b = p[0], g = p[1], r = p[2];
+                    switch (plane) {
+                    case 0 : m_row[x] = ((66*r + 129*g + 25*b + 128) >> 8) + 16; break;
+                    case 1 : m_row[x] = ((-38*r - 74*g + 112*b + 128) >> 8) + 128; break;
+                    default: m_row[x] = ((112*r - 94*g - 18*b + 128) >> 8) + 128;
+                    }
+                }
+                m_y4m.write (reinterpret_cast<const char*> (m_row.data()), m_width);
+            }
+        }
+        return bool (m_y4m);
+    }
+
+    static uint32_t crc32 (uint32_t crc, const unsigned char* data, size_t n)
+    {
+        static const std::vector<uint32_t> table = [] {
+            std::vector<uint32_t> t (256);
+            for (uint32_t i = 0; i < 256; i++) {
+                uint32_t c = i;
+                for (int k = 0; k < 8; k++)
+                    c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[i] = c;
+            }
+            return t;
+        }();
+        crc = ~crc;
+        for (size_t i = 0; i < n; i++)
+            crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+        return ~crc;
+    }
+
+    // Flux d'un chunk IDAT : sortie et CRC tenus à jour ensemble
+    struct ChunkWriter
+    {
+        std::ofstream& out;
+        uint32_t crc = 0;
+
+        void put (const unsigned char* data, size_t n)
+        {
+            out.write (reinterpret_cast<const char*> (data), n);
+            crc = crc32 (crc, data, n);
+        }
+
+        void put_u32 (uint32_t v)
+        {
+            unsigned char b[4] = { (unsigned char) (v >> 24),
+                (unsigned char) (v >> 16), (unsigned char) (v >> 8),
+                (unsigned char) v };
+            put (b, 4);
+        }
+    };
+
+    static void put_chunk (std::ofstream& out, const char* type,
+                           const unsigned char* data, uint32_t size)
+    {
+        ChunkWriter w {out};
+        unsigned char len[4] = { (unsigned char) (size >> 24),
+            (unsigned char) (size >> 16), (unsigned char) (size >> 8),
+            (unsigned char) size };
+        out.write (reinterpret_cast<const char*> (len), 4);
+        w.put (reinterpret_cast<const unsigned char*> (type), 4);
+        w.put (data, size);
+        uint32_t crc = w.crc;
+        w.put_u32 (crc);
+    }
+
+    // PNG RGB 8 bits, filtre 0 ; les données zlib sont découpées en blocs
+    // deflate « stored » d'au plus 65535 octets, écrits au fil des lignes
+    bool write_png (const Slot& slot)
+    {
+        char path[4096];
+        snprintf (path, sizeof path, m_path.c_str(), int (slot.frame));
+        std::ofstream out (path, std::ios::binary);
+        out.write ("\x89PNG\r\n\x1a\n", 8);
+
+        unsigned char ihdr[13] = {
+            (unsigned char) (m_width >> 24), (unsigned char) (m_width >> 16),
+            (unsigned char) (m_width >> 8), (unsigned char) m_width,
+            (unsigned char) (m_height >> 24), (unsigned char) (m_height >> 16),
+            (unsigned char) (m_height >> 8), (unsigned char) m_height,
+            8, 2, 0, 0, 0 };
+        put_chunk (out, "IHDR", ihdr, 13);
+
+        const size_t BLOCK = 65535, row_size = 1 + size_t (m_width) * 3;
+        size_t raw_left = row_size * m_height;
+        size_t nb_blocks = (raw_left + BLOCK - 1) / BLOCK;
+        uint32_t idat_size = 2 + 5 * nb_blocks + raw_left + 4;
+
+        unsigned char len[4] = { (unsigned char) (idat_size >> 24),
+            (unsigned char) (idat_size >> 16), (unsigned char) (idat_size >> 8),
+            (unsigned char) idat_size };
+        out.write (reinterpret_cast<const char*> (len), 4);
+        ChunkWriter w {out};
+        w.put (reinterpret_cast<const unsigned char*> ("IDAT"), 4);
+        const unsigned char zlib_header[2] = { 0x78, 0x01 };
+        w.put (zlib_header, 2);
+
+        uint32_t adler_a = 1, adler_b = 0;
+        size_t block_left = 0;
+        for (int y = 0; y < m_height; y++) {
+            const unsigned char* p = row_of (slot, y);
+            m_row[0] = 0;
+            for (int x = 0; x < m_width; x++, p += 4) {
+                m_row[1 + 3*x] = p[2];
+                m_row[2 + 3*x] = p[1];
+                m_row[3 + 3*x] = p[0];
+            }
+            for (size_t i = 0; i < row_size; i++) {
+                adler_a = (adler_a + m_row[i]) % 65521;
+                adler_b = (adler_b + adler_a) % 65521;
+            }
+
+            // La ligne peut chevaucher plusieurs blocs
+            for (size_t done = 0; done < row_size; ) {
+                if (block_left == 0) {
+                    block_left = std::min (BLOCK, raw_left);
+                    unsigned char header[5] = {
+                        (unsigned char) (raw_left <= BLOCK ? 1 : 0),
+                        (unsigned char) block_left,
+                        (unsigned char) (block_left >> 8),
+                        (unsigned char) ~block_left,
+                        (unsigned char) (~block_left >> 8) };
+                    w.put (header, 5);
+                }
+                size_t n = std::min (block_left, row_size - done);
+                w.put (m_row.data() + done, n);
+                done += n; block_left -= n; raw_left -= n;
+            }
+        }
+        w.put_u32 ((adler_b << 16) | adler_a);
+        uint32_t crc = w.crc;
+        w.put_u32 (crc);
+
+        put_chunk (out, "IEND", nullptr, 0);
+        return bool (out);
+    }
+
+    //------------------------------- A N N E A U ------------------------------
+
+    // Démappe les créneaux encodés, confie à l'encodeur ceux dont la copie
+    // a au moins MAP_DELAY images et est finie ; si wait, toutes les
+    // copies en vol, en attendant le GPU
+    void advance (bool wait)
+    {
+        // Les copies se terminent dans l'ordre des images : la plus
+        // ancienne d'abord
+        for (;;) {
+            Slot* oldest = nullptr;
+            for (auto& s : m_slots)
+                if (s.state.load (std::memory_order_relaxed) == READING
+                    && (!oldest || s.frame < oldest->frame))
+                    oldest = &s;
+            if (!oldest) break;
+            if (!wait && m_frame - oldest->frame < MAP_DELAY) break;
+            GLenum status = m_gl.client_wait_sync (oldest->fence,
+                wait ? SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+            if (status != ALREADY_SIGNALED && status != CONDITION_SATISFIED)
+                break;
+            m_gl.delete_sync (oldest->fence);
+            oldest->fence = nullptr;
+
+            m_gl.bind_buffer (PIXEL_PACK_BUFFER, oldest->pbo);
+            oldest->pixels = static_cast<const unsigned char*> (
+                m_gl.map_buffer_range (PIXEL_PACK_BUFFER, 0,
+                    ptrdiff_t (m_width) * m_height * 4, MAP_READ_BIT));
+            m_gl.bind_buffer (PIXEL_PACK_BUFFER, 0);
+            if (!oldest->pixels) {
+                oldest->state.store (FREE, std::memory_order_relaxed);
+                m_nb_dropped++;
+                continue;
+            }
+            oldest->state.store (ENCODING, std::memory_order_relaxed);
+            {
+                std::lock_guard<std::mutex> lock (m_mutex);
+                m_queue.push_back (oldest);
+            }
+            m_cond.notify_one();
+        }
+
+        for (auto& s : m_slots)
+            if (s.state.load (std::memory_order_acquire) == ENCODED)
+                release (s);
+    }
+
+    void release (Slot& s)
+    {
+        m_gl.bind_buffer (PIXEL_PACK_BUFFER, s.pbo);
+        m_gl.unmap_buffer (PIXEL_PACK_BUFFER);
+        m_gl.bind_buffer (PIXEL_PACK_BUFFER, 0);
+        s.pixels = nullptr;
+        s.state.store (FREE, std::memory_order_relaxed);
+    }
+
+    // Relit les copies en vol, attend l'encodeur, libère les PBO
+    void finish()
+    {
+        if (!m_has_buffers) return;
+        advance (true);
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_stop = true;
+        }
+        m_cond.notify_all();
+        if (m_encoder.joinable()) m_encoder.join();
+
+        for (auto& s : m_slots) {
+            if (s.state.load() == ENCODED) release (s);
+            if (s.fence) m_gl.delete_sync (s.fence);
+            m_gl.delete_buffers (1, &s.pbo);
+        }
+        m_has_buffers = false;
+
+        std::cout << "Capture: " << m_nb_written << " frame(s) written to \""
+            << m_path << "\"";
+        if (m_nb_dropped > 0)
+            std::cout << ", " << m_nb_dropped << " dropped (encoder behind)";
+        if (m_nb_resized > 0)
+            std::cout << ", " << m_nb_resized << " skipped (size changed)";
+        if (m_nb_costs > 0)
+            std::cout << "; GL thread " << std::fixed << std::setprecision (3)
+                << m_cost_sum / m_nb_costs << " ms/frame, max " << m_cost_max
+                << " ms" << std::defaultfloat;
+        std::cout << std::endl;
+    }
+
+public:
+    FrameCapture() = default;
+    FrameCapture (const FrameCapture&) = delete;
+    FrameCapture& operator= (const FrameCapture&) = delete;
+
+    // Le contexte GL doit être encore courant
+    ~FrameCapture() { finish(); }
+
+    // Même convention que GLContext::parse_arg()
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        if (strcmp (argv[i], "--capture") == 0 && i+1 < argc) {
+            m_path = argv[i+1];
+            if (ends_with (m_path, ".y4m")) m_format = F_Y4M;
+            else if (ends_with (m_path, ".png") && is_frame_pattern (m_path))
+                m_format = F_PNG;
+            else {
+                std::cerr << "### Error: --capture expects file.y4m or a "
+                    "numbered name like frame%04d.png" << std::endl;
+                return -1;
+            }
+            return 2;
+        }
+        if (strcmp (argv[i], "--capture-fps") == 0 && i+1 < argc) {
+            m_fps = atoi (argv[i+1]);
+            if (m_fps <= 0) {
+                std::cerr << "### Error: --capture-fps expects a positive "
+                    "integer rate" << std::endl;
+                return -1;
+            }
+            return 2;
+        }
+        return 0;
+    }
+
+    bool enabled() const { return m_format != F_NONE; }
+
+    // Après le chargement des fonctions GL : crée les PBO, ouvre le flux
+    // y4m et lance l'encodeur ; faux en cas d'échec
+    bool start (GLContext& ctx)
+    {
+        if (!enabled()) return true;
+        bool ok = load (m_gl.gen_buffers, "glGenBuffers") &&
+            load (m_gl.delete_buffers, "glDeleteBuffers") &&
+            load (m_gl.bind_buffer, "glBindBuffer") &&
+            load (m_gl.buffer_data, "glBufferData") &&
+            load (m_gl.map_buffer_range, "glMapBufferRange") &&
+            load (m_gl.unmap_buffer, "glUnmapBuffer") &&
+            load (m_gl.fence_sync, "glFenceSync") &&
+            load (m_gl.client_wait_sync, "glClientWaitSync") &&
+            load (m_gl.delete_sync, "glDeleteSync") &&
+            load (m_gl.bind_framebuffer, "glBindFramebuffer");
+        if (!ok) {
+            std::cerr << "### Error: frame capture needs pixel buffers and "
+                "fences (GL 3.2)" << std::endl;
+            return false;
+        }
+
+        ctx.get_size (m_width, m_height);
+        m_row.resize (1 + size_t (m_width) * 3);
+        if (m_format == F_Y4M) {
+            m_y4m.open (m_path, std::ios::binary);
+            if (!m_y4m) {
+                std::cerr << "### Error: cannot create \"" << m_path << "\""
+                    << std::endl;
+                return false;
+            }
+            m_y4m << "YUV4MPEG2 W" << m_width << " H" << m_height
+                << " F" << m_fps << ":1 Ip A1:1 C444\n";
+        }
+
+        for (auto& s : m_slots) {
+            m_gl.gen_buffers (1, &s.pbo);
+            m_gl.bind_buffer (PIXEL_PACK_BUFFER, s.pbo);
+            m_gl.buffer_data (PIXEL_PACK_BUFFER,
+                ptrdiff_t (m_width) * m_height * 4, nullptr, STREAM_READ);
+        }
+        m_gl.bind_buffer (PIXEL_PACK_BUFFER, 0);
+        m_has_buffers = true;
+        m_encoder = std::thread ([this] { encoder_loop(); });
+        std::cout << "Capture " << m_width << "x" << m_height << " to \""
+            << m_path << "\"" << std::endl;
+        return true;
+    }
+
+    // Juste après l'échange des tampons : fait avancer l'anneau, puis
+    // lance la copie de l'image présentée dans un PBO libre, sans attendre
+    void capture (GLContext& ctx)
+    {
+        if (!m_has_buffers) return;
+        TRACE_SCOPE ("capture");
+        Clock::time_point t0 = Clock::now();
+
+        advance (false);
+
+        int width, height;
+        ctx.get_size (width, height);
+        Slot* slot = nullptr;
+        for (auto& s : m_slots)
+            if (s.state.load (std::memory_order_relaxed) == FREE) {
+                slot = &s;
+                break;
+            }
+        if (width != m_width || height != m_height) m_nb_resized++;
+        else if (!slot) m_nb_dropped++;
+        else {
+            GLint read_fbo, read_buffer, pack_alignment;
+            glGetIntegerv (READ_FRAMEBUFFER_BINDING, &read_fbo);
+            glGetIntegerv (PACK_ALIGNMENT, &pack_alignment);
+            GLuint fbo = ctx.presented_framebuffer();
+            m_gl.bind_framebuffer (READ_FRAMEBUFFER, fbo);
+            glGetIntegerv (GL_READ_BUFFER, &read_buffer);
+            if (fbo == 0) glReadBuffer (GL_FRONT);
+            m_gl.bind_buffer (PIXEL_PACK_BUFFER, slot->pbo);
+            glPixelStorei (PACK_ALIGNMENT, 4);
+            glReadPixels (0, 0, m_width, m_height, BGRA, GL_UNSIGNED_BYTE, nullptr);
+            glPixelStorei (PACK_ALIGNMENT, pack_alignment);
+            m_gl.bind_buffer (PIXEL_PACK_BUFFER, 0);
+            if (fbo == 0) glReadBuffer (read_buffer);
+            m_gl.bind_framebuffer (READ_FRAMEBUFFER, read_fbo);
+
+            slot->fence = m_gl.fence_sync (SYNC_GPU_COMMANDS_COMPLETE, 0);
+            slot->frame = m_frame;
+            slot->state.store (READING, std::memory_order_relaxed);
+        }
+        m_frame++;
+
+        double ms = std::chrono::duration<double, std::milli> (
+            Clock::now() - t0).count();
+        m_cost_sum += ms;
+        m_cost_max = std::max (m_cost_max, ms);
+        m_nb_costs++;
+    }
+
+}; // FrameCapture
+
+#endif // FRAME_CAPTURE_H
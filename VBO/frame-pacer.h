@@ -0,0 +1,173 @@
+/*
+    Cadence des images animées : --pace vsync|uncapped|HZ
+
+    Après l'échange des tampons, la boucle d'une démo attendait toujours
+    1/FRAMES_PER_SEC, quel que soit le temps déjà pris par l'image : la
+    latence s'ajoutait au coût de l'image et l'animation plafonnait à
+    30 Hz. FramePacer mesure le coût de chaque image et n'attend que ce
+    qui reste du budget, jusqu'à une échéance absolue : les images sont
+    régulières même quand leur coût varie.
+      vsync     (défaut) synchronisation verticale ; le budget est la
+                période de l'écran. L'échange des tampons bloque déjà
+                jusqu'au retour de trame ; si le pilote ne le fait pas,
+                l'attente prend le relais, avec une marge pour ne pas
+                manquer le retour suivant.
+      HZ        cadence fixe, sans synchronisation verticale
+      uncapped  ni synchronisation ni attente : aussi vite que possible
+    L'attente se fait dans glfwWaitEventsTimeout() : un événement réveille
+    la boucle sans délai. Sans animation, la démo attend les événements
+    sans rien consommer, comme avant.
+
+    Une image dont le coût dépasse le budget est une échéance manquée ;
+    les échéances manquées sont résumées au plus une fois par seconde.
+
+        m_pacer.start (m_ctx);              // après la création du contexte
+        while (...) {
+            m_pacer.begin_frame();
+            displayGL();
+            m_ctx.swap_buffers();
+            if (m_anim_flag) { m_pacer.wait (m_ctx); animate(); }
+            else m_ctx.wait_events();
+        }
+
+    À inclure après gl-context.h.
+*/
+
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+
+#include "gl-context.h"
+
+
+class FramePacer
+{
+public:
+    enum Mode { MODE_VSYNC, MODE_TARGET, MODE_UNCAPPED };
+
+    static const char* usage() { return "[--pace vsync|uncapped|HZ]"; }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef std::chrono::duration<double> Seconds;
+
+    // Fréquence supposée quand l'écran ne la donne pas
+    static constexpr double DEFAULT_REFRESH = 60.0;
+    // En vsync, fraction de la période gardée pour ne pas manquer le
+    // retour de trame ; une image compte comme manquée au-delà d'une
+    // période et demie (elle a sauté un retour)
+    static constexpr double VSYNC_MARGIN = 0.25, VSYNC_MISS = 1.5;
+    // Au-delà de ce retard, on repart de l'image courante au lieu de
+    // rattraper les échéances passées
+    static constexpr double MAX_LATE_PERIODS = 2.0;
+
+    Mode m_mode = MODE_VSYNC;
+    double m_target_hz = 0;
+    double m_period = 0;                // budget d'une image en secondes
+
+    Clock::time_point m_frame_start, m_deadline, m_last_log;
+    double m_cost = 0;                  // coût de la dernière image
+
+    long m_nb_missed = 0;               // depuis le dernier résumé
+    double m_worst_cost = 0;
+
+    void log_missed (Clock::time_point now)
+    {
+        if (m_nb_missed == 0 || now - m_last_log < Seconds (1.0)) return;
+        std::cerr << "Pacer: " << m_nb_missed << " missed deadline"
+            << (m_nb_missed > 1 ? "s" : "") << ", worst "
+            << std::fixed << std::setprecision (1) << m_worst_cost * 1000
+            << " ms for " << m_period * 1000 << " ms budget"
+            << std::defaultfloat << std::endl;
+        m_nb_missed = 0;
+        m_worst_cost = 0;
+        m_last_log = now;
+    }
+
+public:
+    // Même convention que GLContext::parse_arg()
+    int parse_arg (int argc, char* argv[], int i)
+    {
+        if (strcmp (argv[i], "--pace") != 0 || i+1 >= argc) return 0;
+        const char* value = argv[i+1];
+        if (strcmp (value, "vsync") == 0) m_mode = MODE_VSYNC;
+        else if (strcmp (value, "uncapped") == 0) m_mode = MODE_UNCAPPED;
+        else {
+            char* end;
+            double hz = strtod (value, &end);
+            if (*end != '\0' || hz <= 0) {
+                std::cerr << "### Error: --pace expects vsync, uncapped or a "
+                    "rate in Hz" << std::endl;
+                return -1;
+            }
+            m_mode = MODE_TARGET;
+            m_target_hz = hz;
+        }
+        return 2;
+    }
+
+    Mode mode() const { return m_mode; }
+    double period() const { return m_period; }
+    double last_cost() const { return m_cost; }
+
+    // Après la création du contexte : intervalle d'échange et budget
+    void start (GLContext& ctx)
+    {
+        switch (m_mode) {
+        case MODE_VSYNC: {
+            double hz = ctx.refresh_rate();
+            m_period = 1.0 / (hz > 0 ? hz : DEFAULT_REFRESH);
+            break;
+        }
+        case MODE_TARGET: m_period = 1.0 / m_target_hz; break;
+        case MODE_UNCAPPED: m_period = 0; break;
+        }
+        ctx.swap_interval (m_mode == MODE_VSYNC ? 1 : 0);
+        m_frame_start = m_deadline = m_last_log = Clock::now();
+    }
+
+    // Au début de chaque image, avant displayGL()
+    void begin_frame() { m_frame_start = Clock::now(); }
+
+    // Après l'échange des tampons, si l'animation tourne : attend
+    // l'échéance de l'image suivante en traitant les événements
+    void wait (GLContext& ctx)
+    {
+        Clock::time_point now = Clock::now();
+        m_cost = Seconds (now - m_frame_start).count();
+        if (m_mode == MODE_UNCAPPED) {
+            ctx.poll_events();
+            return;
+        }
+
+        double miss = m_mode == MODE_VSYNC ? VSYNC_MISS * m_period : m_period;
+        if (m_cost > miss) {
+            m_nb_missed++;
+            m_worst_cost = std::max (m_worst_cost, m_cost);
+        }
+        log_missed (now);
+
+        // Échéance suivante ; après une attente d'événements ou un gros
+        // retard, on repart de cette image
+        auto period = std::chrono::duration_cast<Clock::duration> (
+            Seconds (m_period));
+        m_deadline += period;
+        if (m_deadline < m_frame_start ||
+            now - m_deadline > MAX_LATE_PERIODS * period)
+            m_deadline = m_frame_start + period;
+
+        double remaining = Seconds (m_deadline - now).count();
+        if (m_mode == MODE_VSYNC) remaining -= VSYNC_MARGIN * m_period;
+        if (remaining > 0) ctx.wait_events_timeout (remaining);
+        else ctx.poll_events();
+    }
+
+}; // FramePacer
+
+#endif // FRAME_PACER_H
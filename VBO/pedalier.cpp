@@ -17,9 +17,31 @@
 // avec bugfix: erreur de signe dans Ortho().
 // RQ: provoque un warning avec -O2, supprimé avec -fno-strict-aliasing
 #include "vmath.h"
+#include "scene-graph.h"
+
+// Sommets des pédales, calculés à la compilation
+#include "static-mesh.h"
 
 #include <GLFW/glfw3.h>
 
+// Fenêtre GLFW ou rendu hors écran par EGL (--headless WxH)
+#include "gl-context.h"
+
+// Mesures --bench FRAMES[,WARMUP], rapport JSON
+#include "frame-bench.h"
+
+// Cadence des images animées (--pace)
+#include "frame-pacer.h"
+
+// Temps GPU par passe de rendu (--gpu-timer)
+#include "gpu-timer.h"
+
+// Capture des images par PBO, encodées en tâche de fond (--capture)
+#include "frame-capture.h"
+
+// Trace des portées chaudes du CPU (make TRACE=1)
+#include "trace.h"
+
 bool flag_fill =false;
 
 class Cylindre {
@@ -38,6 +60,7 @@ public:
         : m_ep_cyl(ep_cyl), m_r_cyl(r_cyl), m_nb_fac(nb_fac),
           m_coul_r(coul_r), m_coul_v(coul_v), m_coul_b(coul_b),
           m_vPos_loc(vPos_loc), m_vCol_loc(vCol_loc) {
+        TRACE_SCOPE ("Cylindre");
         generateVerticesAndColors();
         setupBuffers();
     }
@@ -136,90 +159,21 @@ public:
 
 
 class Pedale {
-    GLfloat m_larg, m_long, m_haut, m_chanf;
-    GLfloat m_coul_r, m_coul_v, m_coul_b;
     GLuint m_VAO_id, m_VBO_id;
     GLint m_vPos_loc, m_vCol_loc;
 
 public:
-    Pedale(GLfloat larg, GLfloat long_, GLfloat haut, GLfloat chanf, 
-           GLfloat coul_r, GLfloat coul_v, GLfloat coul_b,
-           GLint vPos_loc, GLint vCol_loc)
-        : m_larg{larg}, m_long{long_}, m_haut{haut}, m_chanf{chanf},
-          m_coul_r{coul_r}, m_coul_v{coul_v}, m_coul_b{coul_b},
-          m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
-        
-        // les positions des sommets
-        GLfloat positions[] = {
-            // Devant
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-           m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            
-            // Derriere
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-           m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-
-            //Connecter les deux:
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-            m_larg/2, m_haut/2 - m_chanf,m_long/2, //C 4
-            m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Cprime 12
-            m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //D 6
-            m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Dprime 14
-            m_larg/2-m_chanf, - m_haut/2,m_long/2, // E 8
-            m_larg/2-m_chanf, - m_haut/2, -m_long/2, // Eprime 16
-            -m_larg/2+m_chanf, - m_haut/2,m_long/2, //F 7
-            -m_larg/2+m_chanf, - m_haut/2, -m_long/2, //Fprime 15
-            -m_larg/2, -m_haut/2 + m_chanf ,m_long/2, //G 5
-            -m_larg/2, -m_haut/2 + m_chanf , -m_long/2, //Gprime 13
-            - m_larg/2, m_haut/2 - m_chanf,m_long/2, //H 3
-            - m_larg/2, m_haut/2 - m_chanf, -m_long/2, //Hprime 11
-            -m_larg/2+m_chanf, m_haut/2, m_long/2, // A 1
-            -m_larg/2+m_chanf, m_haut/2, -m_long/2, // Aprime 9
-            m_larg/2-m_chanf ,m_haut/2, m_long/2, //B 2
-            m_larg/2-m_chanf ,m_haut/2, -m_long/2, //Bprime 10
-        };
-
-        // structure pour les sommets
-        std::vector<GLfloat> vertices;
-        for (int i =0 ; i<16; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r);
-            vertices.push_back(m_coul_v);
-            vertices.push_back(m_coul_b);
-        }
-        for (int i =16 ; i<34; i+=1){
-            for(int j=0; j<3; j++){
-                vertices.push_back(positions[i*3+j]);
-            }
-            vertices.push_back(m_coul_r * 0.7);
-            vertices.push_back(m_coul_v * 0.7);
-            vertices.push_back(m_coul_b * 0.7);
-        }
-
-
+    // mesh : static_mesh::chamfered_box, calculé à la compilation
+    Pedale(const static_mesh::ChamferedBoxMesh& mesh, GLint vPos_loc, GLint vCol_loc)
+        : m_vPos_loc{vPos_loc}, m_vCol_loc{vCol_loc} {
+        TRACE_SCOPE ("Pedale");
 
         glCreateVertexArrays(1, &m_VAO_id);
         glBindVertexArray(m_VAO_id);
 
         glGenBuffers(1, &m_VBO_id);
         glBindBuffer(GL_ARRAY_BUFFER, m_VBO_id);
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), 
-                     vertices.data(), GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(mesh), mesh.data(), GL_STATIC_DRAW);
 
         glVertexAttribPointer(m_vPos_loc, 3, GL_FLOAT, GL_FALSE, 
                               6 * sizeof(GLfloat), reinterpret_cast<void*>(0));
@@ -253,7 +207,6 @@ public:
 
 //------------------------------------ A P P ----------------------------------
 
-const double FRAMES_PER_SEC  = 30.0;
 const double ANIM_DURATION   = 18.0;
 
 // En salle TP mettre à 0 si l'affichage "bave"
@@ -266,7 +219,12 @@ class MyApp
 {
     bool m_ok = false;
     float m_alpha = 0.0f;
-    GLFWwindow* m_window = nullptr;
+    GLContext m_ctx;
+    FrameBench m_bench;
+    FramePacer m_pacer;
+    GpuTimer m_gpu_timer;
+    FrameCapture m_capture;
+    GLFWwindow* m_window = nullptr;     // nullptr hors écran
     double m_aspect_ratio = 1.0;
     bool m_anim_flag = false;
     int m_cube_color = 1;
@@ -284,6 +242,13 @@ class MyApp
     Cylindre* cylindre_pedal1 = nullptr;
     Cylindre* cylindre_pedal2 = nullptr;
 
+    // Hiérarchie du pédalier : les matrices modèle sont mises en cache et
+    // ne sont recalculées que lorsque m_alpha change
+    SceneGraph m_scene;
+    int m_node_pedalier, m_node_barre1, m_node_barre2;
+    int m_node_pedale1, m_node_pedale2;
+    int m_node_cylindre_pedal1, m_node_cylindre_pedal2;
+
     const char* m_vertex_shader_text =
         "#version 330\n"
         "in vec4 vPos;\n"
@@ -317,7 +282,7 @@ class MyApp
         auto frac_part = [](double x){ return x - std::floor(x); };
 
         // Change la coordonnée en fonction du temps
-        double time = glfwGetTime();           // durée depuis init
+        double time = m_ctx.get_time();        // durée depuis init
         double slice = time / ANIM_DURATION;
         double a = frac_part(slice);
         m_anim_angle = m_start_angle + a*360.0;
@@ -326,6 +291,7 @@ class MyApp
 
     void initGL()
     {
+        TRACE_SCOPE ("initGL");
         std::cout << __func__ << std::endl;
 
         glEnable (GL_DEPTH_TEST);
@@ -349,14 +315,58 @@ class MyApp
         m_matMVP_loc = glGetUniformLocation (m_program, "matMVP");
 
         // Création des objets graphiques
-        m_pedale1 = new Pedale{0.4f, 0.6f, 0.2f, 0.03, 0.0f, 0.0, 1.0, m_vPos_loc, m_vCol_loc};
-        m_pedale2 = new Pedale{0.4f, 0.6f, 0.2f, 0.03f, 0.0f, 0.0, 1.0, m_vPos_loc, m_vCol_loc};
+        static constexpr auto PEDALE = static_mesh::chamfered_box (0.4f, 0.6f, 0.2f, 0.03f, 0.0f, 0.0f, 1.0f);
+        m_pedale1 = new Pedale{PEDALE, m_vPos_loc, m_vCol_loc};
+        m_pedale2 = new Pedale{PEDALE, m_vPos_loc, m_vCol_loc};
         m_roue = new Cylindre{0.2f, 0.4, 36, 1.0f, 0.0f, 0.0f, m_vPos_loc, m_vCol_loc};
         m_centre_roue = new Cylindre{0.7f, 0.08f, 36, 0.0f, 1.0f, 0.0f, m_vPos_loc, m_vCol_loc};
         barre1 = new Cylindre{0.7f, 0.04f, 36, 1.0f, 0.0f, 0.0f, m_vPos_loc, m_vCol_loc};
         barre2 = new Cylindre{0.7f, 0.04f, 36, 1.0f, 0.0f, 0.0f, m_vPos_loc, m_vCol_loc};
         cylindre_pedal1 = new Cylindre{0.6f, 0.06f, 36, 0.0f, 1.0f, 0.0f, m_vPos_loc, m_vCol_loc};
         cylindre_pedal2 = new Cylindre{0.6f, 0.06f, 36, 0.0f, 1.0f, 0.0f, m_vPos_loc, m_vCol_loc};
+
+        build_scene();
+    }
+
+
+    // Le plateau tourne de -alpha, les barres lui sont fixées, les pédales
+    // et leurs axes tournent de +alpha pour rester horizontaux
+    void build_scene()
+    {
+        m_node_pedalier = m_scene.add();
+
+        m_node_barre1 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_barre1, 0.4f, 0.0f, -0.2f);
+        m_scene.set_rotation (m_node_barre1, 90.0f, 0.0f, 1.0f, 0.0f);
+
+        m_node_barre2 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_barre2, -0.4f, 0.0f, 0.2f);
+        m_scene.set_rotation (m_node_barre2, 90.0f, 0.0f, 1.0f, 0.0f);
+
+        m_node_pedale1 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_pedale1, -0.8f, 0.0f, 0.8f);
+
+        m_node_pedale2 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_pedale2, 0.8f, 0.0f, -0.8f);
+
+        m_node_cylindre_pedal1 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_cylindre_pedal1, 0.8f, 0.0f, -0.45f);
+
+        m_node_cylindre_pedal2 = m_scene.add (m_node_pedalier);
+        m_scene.set_translation (m_node_cylindre_pedal2, -0.8f, 0.0f, 0.45f);
+    }
+
+
+    void update_scene()
+    {
+        float angle = static_cast<float>(m_alpha * 180.0 / M_PI);
+
+        m_scene.set_rotation (m_node_pedalier, -angle, 0.0f, 0.0f, 1.0f);
+        for (int n : { m_node_pedale1, m_node_pedale2,
+                       m_node_cylindre_pedal1, m_node_cylindre_pedal2 })
+            m_scene.set_rotation (n, angle, 0.0f, 0.0f, 1.0f);
+
+        m_scene.update();
     }
 
 
@@ -377,8 +387,10 @@ class MyApp
 
     void displayGL()
     {
+        TRACE_SCOPE ("displayGL");
         //glClearColor (0.95, 1.0, 0.8, 1.0);
         glClear (GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        m_gpu_timer.end_pass ("clear");
 
         glUseProgram (m_program);
 
@@ -387,61 +399,44 @@ class MyApp
         glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, matrix);
 
 
-        vmath::mat4 rouematrix = matrix * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, rouematrix);
+        update_scene();
+
+        vmath::mat4 mat_MVP = matrix * m_scene.world_xform (m_node_pedalier);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         m_roue->draw();
         m_centre_roue->draw();
+        m_gpu_timer.end_object ("roue");
 
-        vmath::mat4 barrematrix1 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        barrematrix1 = barrematrix1 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        barrematrix1 = barrematrix1 * vmath::translate(0.0f, 0.0f, 0.0f);
-        barrematrix1 = barrematrix1 * vmath::translate(0.4f, 0.0f, -0.2f);
-        barrematrix1 = barrematrix1 * vmath::rotate(90.0f ,0.0f, 1.0f, 0.0f);
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, barrematrix1);
+        mat_MVP = matrix * m_scene.world_xform (m_node_barre1);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         barre1->draw();
+        m_gpu_timer.end_object ("barre1");
 
-        vmath::mat4 barrematrix2 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        barrematrix2 = barrematrix2 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        barrematrix2 = barrematrix2 * vmath::translate(0.0f, 0.0f, 0.0f);
-        barrematrix2 = barrematrix2 * vmath::translate(-0.4f, 0.0f, 0.2f);
-        barrematrix2 = barrematrix2 * vmath::rotate(90.0f ,0.0f, 1.0f, 0.0f);
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, barrematrix2);
+        mat_MVP = matrix * m_scene.world_xform (m_node_barre2);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         barre2->draw();
+        m_gpu_timer.end_object ("barre2");
 
-
-        vmath::mat4 pedalmatrix1 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        pedalmatrix1 = pedalmatrix1 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        pedalmatrix1 = pedalmatrix1* vmath::translate(0.0f, 0.0f, 0.0f);
-        pedalmatrix1 = pedalmatrix1 * vmath::translate(-0.8f, 0.0f, 0.8f);
-        pedalmatrix1 = pedalmatrix1 * vmath::rotate(static_cast<float>( m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f); 
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, pedalmatrix1);
+        mat_MVP = matrix * m_scene.world_xform (m_node_pedale1);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         m_pedale1->draw();
+        m_gpu_timer.end_object ("pedale1");
 
-        vmath::mat4 pedalmatrix2 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        pedalmatrix2 = pedalmatrix2 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        pedalmatrix2 = pedalmatrix2* vmath::translate(0.0f, 0.0f, 0.0f);
-        pedalmatrix2 = pedalmatrix2 * vmath::translate(0.8f, 0.0f, -0.8f);
-        pedalmatrix2 = pedalmatrix2 * vmath::rotate(static_cast<float>( m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f); 
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, pedalmatrix2);
+        mat_MVP = matrix * m_scene.world_xform (m_node_pedale2);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         m_pedale2->draw();
+        m_gpu_timer.end_object ("pedale2");
 
-        vmath::mat4 cylindrepedalmatrix1 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        cylindrepedalmatrix1 = cylindrepedalmatrix1 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        cylindrepedalmatrix1 = cylindrepedalmatrix1* vmath::translate(0.0f, 0.0f, 0.0f);
-        cylindrepedalmatrix1 = cylindrepedalmatrix1 * vmath::translate(0.8f, 0.0f, -0.45f);
-        cylindrepedalmatrix1 = cylindrepedalmatrix1 * vmath::rotate(static_cast<float>( m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f); 
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, cylindrepedalmatrix1);
+        mat_MVP = matrix * m_scene.world_xform (m_node_cylindre_pedal1);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         cylindre_pedal1->draw();
+        m_gpu_timer.end_object ("axe1");
 
-        vmath::mat4 cylindrepedalmatrix2 = matrix * vmath::translate(0.0f, 0.0f, 0.0f);
-        cylindrepedalmatrix2 = cylindrepedalmatrix2 * vmath::rotate(static_cast<float>( -m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f);
-        cylindrepedalmatrix2 = cylindrepedalmatrix2* vmath::translate(0.0f, 0.0f, 0.0f);
-        cylindrepedalmatrix2 = cylindrepedalmatrix2 * vmath::translate(-0.8f, 0.0f, 0.45f);
-        cylindrepedalmatrix2 = cylindrepedalmatrix2 * vmath::rotate(static_cast<float>( m_alpha* 180.0 /M_PI), 0.0f, 0.0f, 1.0f); 
-        glUniformMatrix4fv(m_matMVP_loc, 1, GL_FALSE, cylindrepedalmatrix2);
+        mat_MVP = matrix * m_scene.world_xform (m_node_cylindre_pedal2);
+        glUniformMatrix4fv (m_matMVP_loc, 1, GL_FALSE, mat_MVP);
         cylindre_pedal2->draw();
-
-
+        m_gpu_timer.end_object ("axe2");
+        m_gpu_timer.end_pass ("scene");
     }
 
 
@@ -470,6 +465,7 @@ class MyApp
 
     void compile_shader (GLuint shader, const char* name)
     {
+        TRACE_SCOPE ("compile_shader");
         std::cout << "Compile " << name << " shader...\n";
         glCompileShader (shader);
 
@@ -491,6 +487,7 @@ class MyApp
 
     void link_program (GLuint program)
     {
+        TRACE_SCOPE ("link_program");
         std::cout << "Link program...\n";
         glLinkProgram (program);
     
@@ -578,7 +575,7 @@ class MyApp
             that->m_anim_flag = !that->m_anim_flag;
             if (that->m_anim_flag) {
                 that->m_start_angle = that->m_anim_angle;
-                glfwSetTime (0);
+                that->m_ctx.set_time (0);
             }
             break;
         case GLFW_KEY_P : {
@@ -622,7 +619,7 @@ class MyApp
             print_help ();
             break;
         case GLFW_KEY_ESCAPE :
-            that->m_ok = false;
+            glfwSetWindowShouldClose (window, GL_TRUE);
             break;
         case GLFW_KEY_SPACE:
             that->m_alpha += 0.1f; // Incrémenter l'angle (ajustez la valeur selon la vitesse souhaitée)
@@ -673,90 +670,135 @@ class MyApp
         std::cerr << "Error: " << description << std::endl;
     }
 
-public:
-
-    MyApp()
+    // Seules les options du contexte sont reconnues
+    bool parse_args (int argc, char* argv[])
     {
-        if (!glfwInit()) {
-            std::cerr << "GLFW: initialization failed" << std::endl;
-            return;
+        int i = 1;
+        while (i < argc) {
+            int nb_args = m_ctx.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_bench.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_pacer.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_gpu_timer.parse_arg (argc, argv, i);
+            if (nb_args == 0) nb_args = m_capture.parse_arg (argc, argv, i);
+            if (nb_args < 0) return false;
+            if (nb_args == 0) {
+                std::cerr << "Options: " << GLContext::usage() << " "
+                    << FrameBench::usage() << " " << FramePacer::usage()
+                    << " " << GpuTimer::usage() << " "
+                    << FrameCapture::usage() << std::endl;
+                return false;
+            }
+            i += nb_args;
         }
-        glfwSetErrorCallback (on_error_func);
-
-        // Hints à spécifier avant la création de la fenêtre
-        //   https://www.glfw.org/docs/latest/window.html#window_hints_fb
+        return true;
+    }
 
-        if (NUM_SAMPLES > 0)
-            glfwWindowHint (GLFW_SAMPLES, NUM_SAMPLES);
+public:
 
-        // On demande une version spécifique d'OpenGL
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MAJOR, 3);
-        glfwWindowHint (GLFW_CONTEXT_VERSION_MINOR, 3);
-        //glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_COMPAT_PROFILE);
-        glfwWindowHint (GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    MyApp (int argc, char* argv[])
+    {
+        // On demande une version spécifique d'OpenGL ; taille, nombre
+        // d'échantillons et mode hors écran peuvent venir des arguments
+        GLContext::Config& cfg = m_ctx.config();
+        cfg.title = "Cube avec VBO";
+        cfg.samples = NUM_SAMPLES;
+        cfg.major = 3;
+        cfg.minor = 3;
+        cfg.profile = GLContext::PROFILE_CORE;
+
+        if (!parse_args (argc, argv)) return;
+        // Hors écran, le banc d'essai fixe le nombre d'images
+        if (m_bench.enabled()) cfg.nb_frames = m_bench.total_frames();
 
-        // Création de la fenêtre
-        m_window = glfwCreateWindow (640, 480, "Cube avec VBO", NULL, NULL);
-        if (!m_window) {
-            std::cerr << "GLFW: window creation failed" << std::endl;
-            return;
-        }
+        glfwSetErrorCallback (on_error_func);
+        if (!m_ctx.create()) return;
+        m_window = m_ctx.window();
 
         // Les callbacks pour GLFW étant statiques, on mémorise l'instance
-        glfwSetWindowUserPointer (m_window, this);
-        glfwSetWindowSizeCallback (m_window, on_reshape_func);
-        glfwSetKeyCallback (m_window, on_key_func);
-
-        // Rend le contexte GL courant. Tous les appels GL seront placés après.
-        glfwMakeContextCurrent (m_window);
-        glfwSwapInterval (1);
+        if (m_window) {
+            glfwSetWindowUserPointer (m_window, this);
+            glfwSetWindowSizeCallback (m_window, on_reshape_func);
+            glfwSetKeyCallback (m_window, on_key_func);
+        }
+        m_pacer.start (m_ctx);
         m_ok = true;
 
         cam_init();
         print_help();
 
         // Initialisation de la machinerie GL en utilisant GLAD.
-        gladLoadGL(); 
+        gladLoadGLLoader (GLContext::get_proc_address);
         std::cout << "Loaded OpenGL "
             << GLVersion.major << "." << GLVersion.minor << std::endl;
 
         // Mise à jour viewport et ratio avec taille réelle de la fenêtre
         int width, height;
-        glfwGetWindowSize (m_window, &width, &height);
+        m_ctx.get_size (width, height);
         set_viewport (width, height);
 
         initGL();
+        if (!m_gpu_timer.start()) m_ok = false;
+        if (!m_capture.start (m_ctx)) m_ok = false;
     }
 
 
-    void run()
+    int run()
     {
-        while (m_ok && !glfwWindowShouldClose (m_window))
+        if (m_ok && m_bench.enabled()) return run_bench();
+
+        while (m_ok && !m_ctx.should_close())
         {
+            m_pacer.begin_frame();
+            m_gpu_timer.begin_frame();
             displayGL();
-            glfwSwapBuffers (m_window);
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_gpu_timer.end_frame();
 
             if (m_anim_flag) {
-                glfwWaitEventsTimeout (1.0/FRAMES_PER_SEC);
+                m_pacer.wait (m_ctx);
                 animate();
             }
-            else glfwWaitEvents();
+            else m_ctx.wait_events();
+        }
+        // Non nul si la création ou l'initialisation a échoué
+        return m_ok ? 0 : 1;
+    }
+
+    // --bench : animation forcée, sans synchronisation verticale ni attente
+    int run_bench()
+    {
+        m_anim_flag = true;
+        m_ctx.swap_interval (0);
+        m_bench.start (m_ctx);
+        while (m_ok && !m_ctx.should_close() && !m_bench.done()) {
+            animate();
+            m_bench.begin_frame();
+            m_gpu_timer.begin_frame();
+            displayGL();
+            m_bench.end_submit();
+            m_gpu_timer.draw_overlay();
+            m_ctx.swap_buffers();
+            m_capture.capture (m_ctx);
+            m_bench.end_frame();
+            m_gpu_timer.end_frame();
+            m_ctx.poll_events();
         }
+        return m_bench.report() && m_ok ? 0 : 1;
     }
 
     ~MyApp()
     {
         tearGL();
-        if (m_window) glfwDestroyWindow (m_window);
-        glfwTerminate();
     }
 
 }; // MyApp
 
 
-int main() 
+int main(int argc, char* argv[]) 
 {
-    MyApp app;
-    app.run();
+    MyApp app {argc, argv};
+    return app.run();
 }
 
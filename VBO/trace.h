@@ -0,0 +1,220 @@
+/*
+    Trace des portées chaudes du CPU, au format « trace event » de Chrome
+
+    Compilée seulement avec -DTRACE_EVENTS (make TRACE=1 clean all) ;
+    sinon les macros ne produisent aucun code.
+
+        void displayGL()
+        {
+            TRACE_SCOPE ("displayGL");      // jusqu'à la fin du bloc
+            ...
+        }
+        TRACE_THREAD ("worker");            // nomme le thread courant
+
+    Chaque portée donne un événement complet : nom, début et durée, thread.
+    Chaque thread écrit dans son propre tampon, une liste de blocs qu'il
+    est seul à allonger et dont il publie le remplissage par un atomique :
+    le chemin chaud ne prend aucun verrou, seul l'enregistrement du
+    tampon, une fois par thread, en prend un. À la sortie du programme, la
+    trace est écrite dans le fichier nommé par la variable d'environnement
+    TRACE_FILE (trace.json par défaut), à ouvrir dans chrome://tracing ou
+    https://ui.perfetto.dev.
+
+    Les noms sont des chaînes littérales : seuls les pointeurs sont gardés.
+    Les threads qui tracent doivent être arrêtés avant la sortie de main().
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#ifdef TRACE_EVENTS
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace trace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    struct Event
+    {
+        const char* name;
+        Clock::time_point start, end;
+    };
+
+    // Seul le thread propriétaire écrit ; count est publié après
+    // l'écriture de l'événement, next après l'initialisation du bloc
+    struct Block
+    {
+        static const int SIZE = 4096;
+        Event events[SIZE];
+        std::atomic<int> count {0};
+        std::atomic<Block*> next {nullptr};
+    };
+
+
+    class ThreadBuffer
+    {
+        Block m_first;
+        Block* m_last = &m_first;
+
+    public:
+        const int tid;
+        std::atomic<const char*> name {nullptr};
+
+        explicit ThreadBuffer (int id) : tid {id} {}
+
+        ~ThreadBuffer()
+        {
+            Block* b = m_first.next.load();
+            while (b) {
+                Block* next = b->next.load();
+                delete b;
+                b = next;
+            }
+        }
+
+        void add (const Event& ev)
+        {
+            int n = m_last->count.load (std::memory_order_relaxed);
+            if (n == Block::SIZE) {
+                Block* b = new Block;
+                m_last->next.store (b, std::memory_order_release);
+                m_last = b;
+                n = 0;
+            }
+            m_last->events[n] = ev;
+            m_last->count.store (n + 1, std::memory_order_release);
+        }
+
+        // Événements publiés, lisibles depuis un autre thread
+        template <typename F>
+        void for_each (F f) const
+        {
+            for (const Block* b = &m_first; b;
+                 b = b->next.load (std::memory_order_acquire)) {
+                int n = b->count.load (std::memory_order_acquire);
+                for (int i = 0; i < n; i++) f (b->events[i]);
+            }
+        }
+    };
+
+
+    // Tampons de tous les threads ; écrit la trace à sa destruction
+    class Registry
+    {
+        std::mutex m_mutex;
+        std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+        const Clock::time_point m_origin = Clock::now();
+
+        static void put_string (std::ostream& out, const char* s)
+        {
+            out << '"';
+            for (; *s; s++) {
+                if (*s == '"' || *s == '\\') out << '\\';
+                out << *s;
+            }
+            out << '"';
+        }
+
+        double us (Clock::time_point t) const
+        {
+            return std::chrono::duration<double, std::micro> (t - m_origin).count();
+        }
+
+    public:
+        ThreadBuffer* add_thread()
+        {
+            std::lock_guard<std::mutex> lock (m_mutex);
+            m_buffers.emplace_back (new ThreadBuffer (m_buffers.size()));
+            return m_buffers.back().get();
+        }
+
+        ~Registry()
+        {
+            const char* path = getenv ("TRACE_FILE");
+            if (!path || !*path) path = "trace.json";
+            std::ofstream out (path);
+            out.setf (std::ios::fixed);
+            out.precision (3);          // à la nanoseconde
+            out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+            bool first = true;
+            std::lock_guard<std::mutex> lock (m_mutex);
+            for (auto& buffer : m_buffers) {
+                const char* name = buffer->name.load();
+                out << (first ? "" : ",\n")
+                    << "{\"ph\": \"M\", \"name\": \"thread_name\", \"pid\": 1, "
+                    << "\"tid\": " << buffer->tid << ", \"args\": {\"name\": ";
+                if (name) put_string (out, name);
+                else out << "\"thread " << buffer->tid << "\"";
+                out << "}}";
+                first = false;
+                buffer->for_each ([&] (const Event& ev) {
+                    out << ",\n{\"ph\": \"X\", \"name\": ";
+                    put_string (out, ev.name);
+                    out << ", \"pid\": 1, \"tid\": " << buffer->tid
+                        << ", \"ts\": " << us (ev.start)
+                        << ", \"dur\": " << us (ev.end) - us (ev.start) << "}";
+                });
+            }
+            out << "\n]}\n";
+            if (!out)
+                std::cerr << "### Error: cannot write trace \"" << path << "\""
+                    << std::endl;
+            else std::cout << "Trace written to \"" << path << "\"" << std::endl;
+        }
+    };
+
+    inline Registry& registry()
+    {
+        static Registry r;
+        return r;
+    }
+
+    inline ThreadBuffer& thread_buffer()
+    {
+        thread_local ThreadBuffer* buffer = registry().add_thread();
+        return *buffer;
+    }
+
+
+    // Le tampon est pris avant de lire l'horloge : le premier appel crée
+    // le registre, dont la création fixe l'origine des temps
+    class Scope
+    {
+        ThreadBuffer& m_buffer;
+        const char* m_name;
+        Clock::time_point m_start;
+
+    public:
+        explicit Scope (const char* name)
+            : m_buffer {thread_buffer()}, m_name {name}, m_start {Clock::now()} {}
+
+        ~Scope() { m_buffer.add ({ m_name, m_start, Clock::now() }); }
+
+        Scope (const Scope&) = delete;
+        Scope& operator= (const Scope&) = delete;
+    };
+
+} // namespace trace
+
+#define TRACE_CAT_(a, b) a ## b
+#define TRACE_CAT(a, b) TRACE_CAT_(a, b)
+#define TRACE_SCOPE(label) trace::Scope TRACE_CAT (trace_scope_, __LINE__) {label}
+#define TRACE_THREAD(label) trace::thread_buffer().name.store (label)
+
+#else
+
+#define TRACE_SCOPE(label) do {} while (0)
+#define TRACE_THREAD(label) do {} while (0)
+
+#endif // TRACE_EVENTS
+
+#endif // TRACE_H
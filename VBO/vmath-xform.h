@@ -0,0 +1,340 @@
+/*
+    Transformations typées pour composer sans matrices 4x4 complètes
+
+    vmath::translate, rotate et scale renvoient des mat4 dont chaque produit
+    coûte 64 multiplications, alors que la plupart des coefficients valent 0
+    ou 1. Ici chaque transformation garde sa structure :
+      Translation    3 flottants
+      AxisRotation   3x3, mêmes coefficients que vmath::rotate
+      UniformScale   1 flottant
+      Affine         3x3 + translation (matrice 3x4, dernière ligne 0 0 0 1)
+    et les produits n'effectuent que les opérations utiles : Affine * Affine
+    coûte 36 multiplications, Affine * Translation 9, mat4 * Translation 12.
+    La mat4 n'est construite qu'à la fin, par matrix() ou par un produit
+    avec une mat4 (projection, caméra).
+
+    Les sommes sont faites dans le même ordre que matNM::operator*, en
+    omettant les termes nuls : le résultat est celui du produit de mat4.
+
+    Chaque Affine connaît sa nature, tenue à jour par les produits :
+    rigide (rotation + translation), échelle uniforme (rigide * s) ou
+    quelconque. normal_matrix() en profite : la partie 3x3 telle quelle
+    pour une rigide, divisée par s² pour une échelle uniforme, et
+    l'inverse (comatrice) seulement dans le cas général. Une AxisRotation
+    n'est rigide que si son axe est unitaire, vmath::rotate ne le
+    normalisant pas.
+
+    Tout est constexpr sauf ce qui touche une mat4 : une sous-transformation
+    constante (AxisRotation::constant pour un angle fixe, cos et sin étant
+    alors évalués à la compilation) se plie en données constantes, et seule
+    la partie animée est calculée à chaque image :
+
+        static constexpr vmath::Affine k_bras =
+            vmath::Translation (0.5f, 0.f, 0.f) * vmath::AxisRotation::constant (90.f, 0.f, 1.f, 0.f);
+*/
+
+#ifndef VMATH_XFORM_H
+#define VMATH_XFORM_H
+
+#include <cmath>
+
+#include "vmath.h"
+
+namespace vmath
+{
+    // Du plus particulier au plus général : le produit prend le maximum
+    enum XformKind { XF_RIGID, XF_UNIFORM_SCALE, XF_GENERAL };
+
+    namespace xform_detail
+    {
+        // Séries de Taylor en double pour |x| <= pi/4, arrondies en float ;
+        // vmath-check les compare à cosf et sinf : égalité bit à bit aux
+        // multiples de 90 degrés, écart d'au plus 4 * FLT_EPSILON ailleurs
+        constexpr double sin_series (double x)
+        {
+            double x2 = x * x, term = x, sum = x;
+            for (int k = 1; k < 10; k++) {
+                term *= -x2 / ((2 * k) * (2 * k + 1));
+                sum += term;
+            }
+            return sum;
+        }
+
+        constexpr double cos_series (double x)
+        {
+            double x2 = x * x, term = 1, sum = 1;
+            for (int k = 1; k < 10; k++) {
+                term *= -x2 / ((2 * k - 1) * (2 * k));
+                sum += term;
+            }
+            return sum;
+        }
+
+        // Réduction à [-pi/4, pi/4] par le multiple de pi/2 le plus proche
+        constexpr void sin_cos (double x, double& s, double& c)
+        {
+            const double half_pi = 1.57079632679489661923;
+            double q = x / half_pi;
+            long n = q >= 0 ? long (q + 0.5) : -long (-q + 0.5);
+            double r = x - n * half_pi;
+            double sr = sin_series (r), cr = cos_series (r);
+            switch (n & 3) {
+                case 0:  s = sr;  c = cr;  break;
+                case 1:  s = cr;  c = -sr; break;
+                case 2:  s = -sr; c = -cr; break;
+                default: s = -cr; c = sr;  break;
+            }
+        }
+    }
+
+
+    struct Translation
+    {
+        float t[3];
+
+        constexpr Translation (float x, float y, float z) : t {x, y, z} {}
+        explicit Translation (const vec3& v) : t {v[0], v[1], v[2]} {}
+    };
+
+
+    struct UniformScale
+    {
+        float s;
+
+        constexpr explicit UniformScale (float s) : s {s} {}
+    };
+
+
+    // Rotation de angle degrés autour de (x, y, z), comme vmath::rotate
+    // (l'axe n'est pas normalisé)
+    struct AxisRotation
+    {
+        float m[3][3];      // colonnes
+        bool rigid;         // axe unitaire
+
+        AxisRotation (float angle, float x, float y, float z)
+            : AxisRotation (x, y, z, cosf (angle * 0.0174532925f),
+                            sinf (angle * 0.0174532925f)) {}
+
+        // Angle connu à la compilation : mêmes coefficients, sans appel
+        // à cosf et sinf
+        static constexpr AxisRotation constant (float angle, float x, float y,
+            float z)
+        {
+            double s = 0, c = 0;
+            xform_detail::sin_cos (angle * 0.0174532925f, s, c);
+            return AxisRotation (x, y, z, float (c), float (s));
+        }
+
+    private:
+        constexpr AxisRotation (float x, float y, float z, float c, float s)
+            : m {}, rigid {x*x + y*y + z*z - 1.0f < 1e-6f &&
+                           x*x + y*y + z*z - 1.0f > -1e-6f}
+        {
+            const float x2 = x * x, y2 = y * y, z2 = z * z;
+            const float omc = 1.0f - c;
+
+            m[0][0] = x2 * omc + c;
+            m[0][1] = y * x * omc + z * s;
+            m[0][2] = x * z * omc - y * s;
+            m[1][0] = x * y * omc - z * s;
+            m[1][1] = y2 * omc + c;
+            m[1][2] = y * z * omc + x * s;
+            m[2][0] = x * z * omc + y * s;
+            m[2][1] = y * z * omc - x * s;
+            m[2][2] = z2 * omc + c;
+        }
+    };
+
+
+    struct Affine
+    {
+        float m[3][3];      // partie linéaire, colonnes
+        float t[3];         // translation
+        XformKind kind = XF_RIGID;
+        float scale = 1;    // facteur d'échelle si kind <= XF_UNIFORM_SCALE
+
+        // Identité
+        constexpr Affine() : m {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, t {0, 0, 0} {}
+
+        constexpr Affine (const Translation& tr)
+            : m {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}, t {tr.t[0], tr.t[1], tr.t[2]} {}
+
+        constexpr Affine (const UniformScale& sc)
+            : m {{sc.s, 0, 0}, {0, sc.s, 0}, {0, 0, sc.s}}, t {0, 0, 0},
+              kind {sc.s == 1 ? XF_RIGID : XF_UNIFORM_SCALE}, scale {sc.s} {}
+
+        constexpr Affine (const AxisRotation& r)
+            : m {}, t {0, 0, 0}, kind {r.rigid ? XF_RIGID : XF_GENERAL}
+        {
+            for (int j = 0; j < 3; j++)
+                for (int i = 0; i < 3; i++) m[j][i] = r.m[j][i];
+        }
+
+        // Partie 3x4 d'une mat4 dont la dernière ligne est 0 0 0 1 ; sa
+        // nature est inconnue, elle est donc considérée quelconque
+        explicit Affine (const mat4& a) : kind {XF_GENERAL}
+        {
+            for (int j = 0; j < 3; j++)
+                for (int i = 0; i < 3; i++) m[j][i] = a[j][i];
+            for (int i = 0; i < 3; i++) t[i] = a[3][i];
+        }
+
+        mat4 matrix() const
+        {
+            return mat4 (vec4 (m[0][0], m[0][1], m[0][2], 0.0f),
+                         vec4 (m[1][0], m[1][1], m[1][2], 0.0f),
+                         vec4 (m[2][0], m[2][1], m[2][2], 0.0f),
+                         vec4 (t[0], t[1], t[2], 1.0f));
+        }
+    };
+
+
+    namespace xform_detail
+    {
+        // a.m * b, b étant 3x3 en colonnes
+        constexpr void mul_linear (const float a[3][3], const float b[3][3],
+            float out[3][3])
+        {
+            for (int j = 0; j < 3; j++)
+                for (int i = 0; i < 3; i++)
+                    out[j][i] = a[0][i] * b[j][0] + a[1][i] * b[j][1] +
+                                a[2][i] * b[j][2];
+        }
+
+        // a.m * v + a.t
+        constexpr void apply (const Affine& a, const float v[3], float out[3])
+        {
+            for (int i = 0; i < 3; i++)
+                out[i] = a.m[0][i] * v[0] + a.m[1][i] * v[1] +
+                         a.m[2][i] * v[2] + a.t[i];
+        }
+
+        // Nature de a * b
+        constexpr void compose_kind (const Affine& a, XformKind b_kind,
+            float b_scale, Affine& out)
+        {
+            out.kind = a.kind > b_kind ? a.kind : b_kind;
+            out.scale = a.scale * b_scale;
+            if (out.kind == XF_UNIFORM_SCALE && out.scale == 1)
+                out.kind = XF_RIGID;
+        }
+    }
+
+
+    constexpr Translation operator* (const Translation& a, const Translation& b)
+    {
+        return Translation (a.t[0] + b.t[0], a.t[1] + b.t[1], a.t[2] + b.t[2]);
+    }
+
+    constexpr Affine operator* (const Affine& a, const Translation& b)
+    {
+        Affine result;
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 3; i++) result.m[j][i] = a.m[j][i];
+        xform_detail::apply (a, b.t, result.t);
+        result.kind = a.kind;
+        result.scale = a.scale;
+        return result;
+    }
+
+    constexpr Affine operator* (const Affine& a, const AxisRotation& b)
+    {
+        Affine result;
+        xform_detail::mul_linear (a.m, b.m, result.m);
+        for (int i = 0; i < 3; i++) result.t[i] = a.t[i];
+        xform_detail::compose_kind (a, b.rigid ? XF_RIGID : XF_GENERAL, 1, result);
+        return result;
+    }
+
+    constexpr Affine operator* (const Affine& a, const UniformScale& b)
+    {
+        Affine result;
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 3; i++) result.m[j][i] = a.m[j][i] * b.s;
+        for (int i = 0; i < 3; i++) result.t[i] = a.t[i];
+        xform_detail::compose_kind (a, b.s == 1 ? XF_RIGID : XF_UNIFORM_SCALE,
+            b.s, result);
+        return result;
+    }
+
+    constexpr Affine operator* (const Affine& a, const Affine& b)
+    {
+        Affine result;
+        xform_detail::mul_linear (a.m, b.m, result.m);
+        xform_detail::apply (a, b.t, result.t);
+        xform_detail::compose_kind (a, b.kind, b.scale, result);
+        return result;
+    }
+
+
+    // mat4 quelconque (projection, caméra...) à gauche : résultat mat4
+
+    inline mat4 operator* (const mat4& a, const Translation& b)
+    {
+        mat4 result = a;
+        for (int i = 0; i < 4; i++)
+            result[3][i] = a[0][i] * b.t[0] + a[1][i] * b.t[1] +
+                           a[2][i] * b.t[2] + a[3][i];
+        return result;
+    }
+
+    inline mat4 operator* (const mat4& a, const Affine& b)
+    {
+        mat4 result;
+        for (int j = 0; j < 3; j++)
+            for (int i = 0; i < 4; i++)
+                result[j][i] = a[0][i] * b.m[j][0] + a[1][i] * b.m[j][1] +
+                               a[2][i] * b.m[j][2];
+        for (int i = 0; i < 4; i++)
+            result[3][i] = a[0][i] * b.t[0] + a[1][i] * b.t[1] +
+                           a[2][i] * b.t[2] + a[3][i];
+        return result;
+    }
+
+    inline mat4 operator* (const mat4& a, const AxisRotation& b)
+    {
+        return a * Affine (b);
+    }
+
+
+    // Matrice des normales, transposée de l'inverse de la partie 3x3 ; dans
+    // le cas général, mêmes calculs que vmath::normal() de vmath-et.h
+    inline mat3 normal_matrix (const Affine& a)
+    {
+        const float (*m)[3] = a.m;
+        mat3 result;
+
+        if (a.kind != XF_GENERAL) {
+            // R orthogonale : (s R)^-T = R / s = (s R) / s²
+            float k = a.kind == XF_RIGID ? 1.0f : 1.0f / (a.scale * a.scale);
+            for (int j = 0; j < 3; j++)
+                for (int i = 0; i < 3; i++)
+                    result[j][i] = a.kind == XF_RIGID ? m[j][i] : m[j][i] * k;
+            return result;
+        }
+
+        float d = m[0][0] * m[1][1] * m[2][2]
+                + m[1][0] * m[2][1] * m[0][2]
+                + m[2][0] * m[0][1] * m[1][2]
+                - m[0][2] * m[1][1] * m[2][0]
+                - m[1][2] * m[2][1] * m[0][0]
+                - m[2][2] * m[0][1] * m[1][0];
+        if (d == 0) return mat3::identity();
+
+        // Comatrice / det : l'inverse transposé
+        float k = 1.f / d;
+        result[0] = vec3 ((m[1][1]*m[2][2] - m[1][2]*m[2][1]) * k,
+                          (m[1][2]*m[2][0] - m[1][0]*m[2][2]) * k,
+                          (m[1][0]*m[2][1] - m[1][1]*m[2][0]) * k);
+        result[1] = vec3 ((m[0][2]*m[2][1] - m[0][1]*m[2][2]) * k,
+                          (m[0][0]*m[2][2] - m[0][2]*m[2][0]) * k,
+                          (m[0][1]*m[2][0] - m[0][0]*m[2][1]) * k);
+        result[2] = vec3 ((m[0][1]*m[1][2] - m[0][2]*m[1][1]) * k,
+                          (m[0][2]*m[1][0] - m[0][0]*m[1][2]) * k,
+                          (m[0][0]*m[1][1] - m[0][1]*m[1][0]) * k);
+        return result;
+    }
+}
+
+#endif // VMATH_XFORM_H
@@ -3,6 +3,10 @@
 //
 // BUGFIX 09/01/2025 - Edouard.Thiel@univ-amu.fr
 //   fonction ortho() : erreur de signe corrigée
+//
+// AJOUT : spécialisations SSE de vecN<float,4> et matNM<float,4,4> en fin
+//   de fichier, désactivables avec -DVMATH_NO_SIMD ; vérifiées par
+//   vmath-check (make check) contre les templates génériques
 
 #ifndef __VMATH_H__
 #define __VMATH_H__
@@ -10,6 +14,11 @@
 #define _USE_MATH_DEFINES 1 // Include constants defined in math.h
 #include <math.h>
 
+#if defined(__SSE2__) && !defined(VMATH_NO_SIMD)
+#define VMATH_SIMD 1
+#include <emmintrin.h>
+#endif
+
 namespace vmath
 {
 
@@ -1313,6 +1322,133 @@ namespace vmath
         return B + t * (B - A);
     }
 
+
+#ifdef VMATH_SIMD
+    // SSE specializations of vecN<float, 4> and matNM<float, 4, 4>.
+    // Every operation keeps the order of the generic loops (no FMA), so
+    // results are bit-identical, except dot() and length() whose sum is
+    // done pairwise: (a0*b0 + a2*b2) + (a1*b1 + a3*b3). The difference is
+    // within the usual bound of a 4-term sum, 4 * FLT_EPSILON * sum |ai*bi|.
+
+    namespace simd
+    {
+        static inline __m128 load(const vecN<float, 4> &v)
+        {
+            return _mm_loadu_ps(&v[0]);
+        }
+
+        static inline vecN<float, 4> store(__m128 x)
+        {
+            vecN<float, 4> result;
+            _mm_storeu_ps(&result[0], x);
+            return result;
+        }
+
+        static inline float hsum(__m128 x)
+        {
+            __m128 t = _mm_add_ps(x, _mm_movehl_ps(x, x));
+            return _mm_cvtss_f32(_mm_add_ss(t, _mm_shuffle_ps(t, t, 1)));
+        }
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator+(const vecN<float, 4> &that) const
+    {
+        return simd::store(_mm_add_ps(simd::load(*this), simd::load(that)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator-() const
+    {
+        return simd::store(_mm_xor_ps(simd::load(*this), _mm_set1_ps(-0.0f)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator-(const vecN<float, 4> &that) const
+    {
+        return simd::store(_mm_sub_ps(simd::load(*this), simd::load(that)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator*(const vecN<float, 4> &that) const
+    {
+        return simd::store(_mm_mul_ps(simd::load(*this), simd::load(that)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator*(const float &that) const
+    {
+        return simd::store(_mm_mul_ps(simd::load(*this), _mm_set1_ps(that)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator/(const vecN<float, 4> &that) const
+    {
+        return simd::store(_mm_div_ps(simd::load(*this), simd::load(that)));
+    }
+
+    template <>
+    inline vecN<float, 4> vecN<float, 4>::operator/(const float &that) const
+    {
+        return simd::store(_mm_div_ps(simd::load(*this), _mm_set1_ps(that)));
+    }
+
+    template <>
+    inline float dot(const vecN<float, 4> &a, const vecN<float, 4> &b)
+    {
+        return simd::hsum(_mm_mul_ps(simd::load(a), simd::load(b)));
+    }
+
+    template <>
+    inline float length(const vecN<float, 4> &v)
+    {
+        __m128 x = simd::load(v);
+        return _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(simd::hsum(_mm_mul_ps(x, x)))));
+    }
+
+    template <>
+    inline vecN<float, 4> normalize(const vecN<float, 4> &v)
+    {
+        return v / length(v);
+    }
+
+    template <>
+    inline matNM<float, 4, 4> matNM<float, 4, 4>::operator*(const matNM<float, 4, 4> &that) const
+    {
+        const __m128 c0 = simd::load(data[0]), c1 = simd::load(data[1]),
+                     c2 = simd::load(data[2]), c3 = simd::load(data[3]);
+        my_type result;
+
+        for (int j = 0; j < 4; j++)
+        {
+            __m128 sum = _mm_setzero_ps();
+            sum = _mm_add_ps(sum, _mm_mul_ps(c0, _mm_set1_ps(that[j][0])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(c1, _mm_set1_ps(that[j][1])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(c2, _mm_set1_ps(that[j][2])));
+            sum = _mm_add_ps(sum, _mm_mul_ps(c3, _mm_set1_ps(that[j][3])));
+            _mm_storeu_ps(&result[j][0], sum);
+        }
+
+        return result;
+    }
+
+    template <>
+    inline vecN<float, 4> operator*(const vecN<float, 4> &vec, const matNM<float, 4, 4> &mat)
+    {
+        // Rows of mat, so that result += vec[m] * row m as in the generic loop
+        __m128 r0 = simd::load(mat[0]), r1 = simd::load(mat[1]),
+               r2 = simd::load(mat[2]), r3 = simd::load(mat[3]);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+        __m128 sum = _mm_setzero_ps();
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vec[0]), r0));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vec[1]), r1));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vec[2]), r2));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(vec[3]), r3));
+        return simd::store(sum);
+    }
+#endif // VMATH_SIMD
+
 };
 
 #endif /* __VMATH_H__ */